@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/breadcrumb.c
+ * @brief   Decimated track shape in RAM for the map screen
+ *
+ * Points are projected around the first one and every stride-th point is
+ * stored. Once the buffer is full every other point is dropped and the
+ * stride doubles, so the buffer always covers the whole track with evenly
+ * spaced points. The bounding box is kept for all added points, the map
+ * scale is known without going through the points.
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#include <string.h>
+
+#include "breadcrumb.h"
+
+/**
+ * Keep every other point, the stride doubles
+ */
+static void Breadcrumbi_Decimate(breadcrumb_t *bc)
+{
+    for (uint16_t i = 1; i < bc->count/2; i++) {
+        bc->points[i] = bc->points[2*i];
+    }
+    bc->count /= 2;
+    bc->stride *= 2;
+}
+
+void Breadcrumb_Add(breadcrumb_t *bc, const gps_info_t *gps)
+{
+    flat_pos_t pos;
+
+    if (bc->total == 0) {
+        Flat_Origin(&bc->origin, Flat_Deg7(&gps->lat), Flat_Deg7(&gps->lon));
+    }
+    pos = Flat_Project(&bc->origin, gps);
+
+    if (bc->total == 0) {
+        bc->min = pos;
+        bc->max = pos;
+    }
+    bc->min.x = pos.x < bc->min.x ? pos.x : bc->min.x;
+    bc->min.y = pos.y < bc->min.y ? pos.y : bc->min.y;
+    bc->max.x = pos.x > bc->max.x ? pos.x : bc->max.x;
+    bc->max.y = pos.y > bc->max.y ? pos.y : bc->max.y;
+    bc->last = pos;
+    bc->total++;
+
+    if (bc->pending == 0) {
+        /* Point index is a multiple of the doubled stride as well */
+        if (bc->count == BREADCRUMB_SIZE) {
+            Breadcrumbi_Decimate(bc);
+        }
+        bc->points[bc->count++] = pos;
+    }
+    bc->pending++;
+    if (bc->pending >= bc->stride) {
+        bc->pending = 0;
+    }
+}
+
+void Breadcrumb_Fit(const breadcrumb_t *bc, breadcrumb_view_t *view,
+        uint16_t width, uint16_t height)
+{
+    uint32_t w = bc->max.x - bc->min.x;
+    uint32_t h = bc->max.y - bc->min.y;
+    uint32_t scale_x = (w + width - 2)/(width - 1);
+    uint32_t scale_y = (h + height - 2)/(height - 1);
+
+    view->mm_per_px = scale_x > scale_y ? scale_x : scale_y;
+    if (view->mm_per_px < BREADCRUMB_MIN_MM_PX) {
+        view->mm_per_px = BREADCRUMB_MIN_MM_PX;
+    }
+
+    /* Center of the box in the center of the area */
+    view->left_mm = bc->min.x + w/2 - (int64_t)view->mm_per_px*(width - 1)/2;
+    view->top_mm = bc->min.y + h/2 + (int64_t)view->mm_per_px*(height - 1)/2;
+}
+
+void Breadcrumb_ToScreen(const breadcrumb_view_t *view,
+        const flat_pos_t *pos, uint16_t *x, uint16_t *y)
+{
+    *x = ((int64_t)pos->x - view->left_mm + view->mm_per_px/2)/
+            view->mm_per_px;
+    *y = ((int64_t)view->top_mm - pos->y + view->mm_per_px/2)/
+            view->mm_per_px;
+}
+
+void Breadcrumb_Reset(breadcrumb_t *bc)
+{
+    memset(bc, 0, sizeof(*bc));
+    bc->stride = 1;
+}
+
+/** @} */
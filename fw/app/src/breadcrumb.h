@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/breadcrumb.h
+ * @brief   Decimated track shape in RAM for the map screen
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#ifndef __APP_BREADCRUMB_H_
+#define __APP_BREADCRUMB_H_
+
+#include <types.h>
+#include "drivers/gps.h"
+#include "gps/flat.h"
+
+/** Max amount of stored points, power of two, 8 bytes each */
+#define BREADCRUMB_SIZE 128
+/** Map scale is never finer, stationary noise doesn't fill the screen */
+#define BREADCRUMB_MIN_MM_PX 1000
+
+typedef struct {
+    flat_origin_t origin;       /**< The first point */
+    flat_pos_t points[BREADCRUMB_SIZE];
+    uint16_t count;             /**< Amount of stored points */
+    uint32_t stride;            /**< Track points per stored point */
+    uint32_t pending;           /**< Points added since last stored one */
+    uint32_t total;             /**< Amount of added points */
+    flat_pos_t last;            /**< The newest point, current position */
+    flat_pos_t min;             /**< Bounding box of all added points */
+    flat_pos_t max;
+} breadcrumb_t;
+
+/** Projection of the track to the screen area */
+typedef struct {
+    uint32_t mm_per_px;         /**< Scale, same in both directions */
+    int32_t left_mm;            /**< Position shown at x = 0 */
+    int32_t top_mm;             /**< Position shown at y = 0 */
+} breadcrumb_view_t;
+
+/**
+ * Add point to the track, only every stride-th point is stored, the stride
+ * is doubled once the buffer is full
+ *
+ * @param bc    Breadcrumb buffer
+ * @param gps   New point
+ */
+extern void Breadcrumb_Add(breadcrumb_t *bc, const gps_info_t *gps);
+
+/**
+ * Fit the bounding box of the track to the area, north is up, aspect ratio
+ * is kept and the track is centered
+ *
+ * @param bc            Breadcrumb buffer with at least one point
+ * @param [out] view    Projection to be set
+ * @param width         Area width in px
+ * @param height        Area height in px
+ */
+extern void Breadcrumb_Fit(const breadcrumb_t *bc, breadcrumb_view_t *view,
+        uint16_t width, uint16_t height);
+
+/**
+ * Get position of the point in the area
+ *
+ * @param view      Projection
+ * @param pos       Track point
+ * @param [out] x   Column
+ * @param [out] y   Row
+ */
+extern void Breadcrumb_ToScreen(const breadcrumb_view_t *view,
+        const flat_pos_t *pos, uint16_t *x, uint16_t *y);
+
+/**
+ * Forget the track
+ *
+ * @param bc    Breadcrumb buffer
+ */
+extern void Breadcrumb_Reset(breadcrumb_t *bc);
+
+#endif
+
+/** @} */
@@ -26,9 +26,110 @@
 #ifndef __APP_CONFIG_H_
 #define __APP_CONFIG_H_
 
-/** Size of the external flash in bytes */
+/** Size of the external flash in bytes used for gps records */
 #define STORAGE_SIZE 4000000U
 
+/*
+ * Rest of the 4 MiB flash after the gps records holds small append only
+ * logs, all of them are cleared together with records by chip erase
+ */
+/** Log of sync cursor values acknowledged by host */
+#define STORAGE_SYNC_ADDR STORAGE_SIZE
+#define STORAGE_SYNC_SIZE 16384U
+/** Log of positions used for GPS receiver start assistance */
+#define STORAGE_ASSIST_ADDR (STORAGE_SYNC_ADDR + STORAGE_SYNC_SIZE)
+#define STORAGE_ASSIST_SIZE 16384U
+/** Index of tracks with their summary, for browsing without reading records */
+#define STORAGE_TRACKS_ADDR (STORAGE_ASSIST_ADDR + STORAGE_ASSIST_SIZE)
+#define STORAGE_TRACKS_SIZE 65536U
+
+/** Protocol of the GPS receiver, GNSS_PROTO_UBX for u-blox modules */
+#define GNSS_PROTOCOL GNSS_PROTO_NMEA
+/** Baudrate negotiated with NMEA receiver at init */
+#define GNSS_BAUDRATE 57600
+
+/*
+ * GPS duty cycling, fix interval is GPS_INTERVAL_S when walking, shorter when
+ * moving faster and doubled with every fix while stationary
+ */
+#define GPS_INTERVAL_S 10
+#define GPS_INTERVAL_MIN_S 2
+#define GPS_INTERVAL_MAX_S 600
+/** Speed in dm/s for which GPS_INTERVAL_S is used (5 km/h) */
+#define GPS_REF_SPEED_DMS 14
+/** Slower movement is considered as stationary (noise) */
+#define GPS_STILL_SPEED_DMS 3
+/** Max time to wait for the fix before giving up the slot */
+#define GPS_FIX_TIMEOUT_S 60
+/** Ephemeris are kept valid in standby, hot start is expected */
+#define GPS_HOT_WINDOW_S 1800
+
+/*
+ * Filtering of fixes before storage, worse or unrealistic fixes are dropped,
+ * stationary position is stored once per FILTER_KEEPALIVE_S. Receiver duty
+ * cycling uses the same quality limits, so the slot ends only with a fix
+ * that the filter accepts
+ */
+#define FILTER_HDOP_MAX_DM 30
+#define FILTER_SATS_MIN 5
+/** Faster movement is an outlier (250 km/h) */
+#define FILTER_SPEED_MAX_DMS 700
+/** Movement below this distance from last point is considered stationary */
+#define FILTER_MIN_DIST_M 5
+/** Distance from stationary position to continue the track */
+#define FILTER_MOVE_DIST_M 25
+#define FILTER_KEEPALIVE_S 300
+
+/*
+ * Smoothing of fixes, position error is KALMAN_UERE_DM times hdop, track
+ * follows acceleration around KALMAN_ACCEL_DMS2 quickly
+ */
+#define KALMAN_UERE_DM 40
+#define KALMAN_ACCEL_DMS2 10
+/** Longer gap between fixes (duty cycling) starts from the raw fix */
+#define KALMAN_RESET_S 30
+
+/*
+ * Ascent and descent accumulation, elevation is low pass filtered (new
+ * sample weight 1/2^shift) and changes below deadband are ignored
+ */
+#define STATS_ELEV_DEADBAND_DM 50
+#define STATS_ELEV_LOWPASS_SHIFT 2
+
+/** Longer time between stored points starts a new track */
+#define TRACK_GAP_S 3600
+
+/*
+ * Track simplification, dropped points are within SIMPLIFY_TOLERANCE_M from
+ * the stored track and SIMPLIFY_VTOLERANCE_M from its interpolated elevation
+ * (below the ascent deadband), stationary keepalive points are kept
+ */
+#define SIMPLIFY_TOLERANCE_M 5
+#define SIMPLIFY_VTOLERANCE_M 3
+#define SIMPLIFY_MAX_INTERVAL_S FILTER_KEEPALIVE_S
+
+/** Max display refresh rate on data change, button presses are not limited */
+#define GUI_FPS 4
+
+/*
+ * Display is switched off after DISPCTL_TIMEOUT_S without button press (0 for
+ * never, can be changed in menu), currents are used for saved charge stats
+ */
+#define DISPCTL_TIMEOUT_S 30
+/** Average current of the panel with typical screen content */
+#define DISPCTL_ON_UA 6000
+/** Panel current in sleep mode */
+#define DISPCTL_OFF_UA 10
+
+/** Shorter sleeps are done with clocks running, stop mode needs crystal start */
+#define POWER_STOP_MIN_MS 20
+
+/*
+ * Run I2C at 1 MHz (fast mode plus) instead of 400 kHz, SSD1306 datasheet
+ * specifies 2.5 us minimal clock cycle, so it's out of spec for the panel
+ */
+#define I2C_FAST_PLUS false
+
 #define USB_VENDOR 0x0483 /* STMicroelectronics */
 #define USB_PRODUCT 0x5720 /* Mass storage device */
 #define USB_MANUFACTURE_STR "Deadbadger"
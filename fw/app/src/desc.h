@@ -27,11 +27,9 @@
 #define __APP_DESC_H_
 
 #include <types.h>
-#include <drivers/gps.h>
 #include <drivers/spi_flash.h>
 #include <drivers/ssd1306.h>
 
-extern gps_desc_t gps_desc;
 extern spiflash_desc_t spiflash_desc;
 extern ssd1306_desc_t ssd1306_desc;
 
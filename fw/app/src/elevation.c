@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file    app/elevation.c
+ * @brief   Accumulation of ascent and descent from noisy elevation
+ *
+ * Elevation is low pass filtered first, then the change is accounted only
+ * once the filtered elevation gets deadband_dm away from the reference,
+ * which moves to the accounted elevation. Noise within the deadband
+ * doesn't add anything, real climb is accounted in deadband steps.
+ *
+ * Stats feed the same stored records to it live and when rebuilding from
+ * storage, so both give the same totals.
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#include <string.h>
+
+#include "elevation.h"
+
+/** Fractional bits of filtered elevation */
+#define ELEVATION_FRAC 4
+
+int32_t Elevation_Add(elevation_t *elev, int32_t elevation_dm)
+{
+    int32_t sample = elevation_dm*(1 << ELEVATION_FRAC);
+    int32_t deadband = elev->cfg->deadband_dm*(1 << ELEVATION_FRAC);
+    int32_t diff;
+    int32_t delta;
+
+    if (!elev->valid) {
+        elev->filtered = sample;
+        elev->ref = sample;
+        elev->valid = true;
+        return 0;
+    }
+
+    elev->filtered += (sample - elev->filtered)/(1 << elev->cfg->lowpass_shift);
+    diff = elev->filtered - elev->ref;
+    if (diff >= deadband || -diff >= deadband) {
+        /* Rounding telescopes, no drift over many steps */
+        delta = elev->filtered/(1 << ELEVATION_FRAC) -
+                elev->ref/(1 << ELEVATION_FRAC);
+        elev->ref = elev->filtered;
+        return delta;
+    }
+    return 0;
+}
+
+void Elevation_Reset(elevation_t *elev)
+{
+    elev->valid = false;
+}
+
+void Elevation_Init(elevation_t *elev, const elevation_config_t *config)
+{
+    memset(elev, 0, sizeof(*elev));
+    elev->cfg = config;
+}
+
+/** @} */
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file    app/elevation.h
+ * @brief   Accumulation of ascent and descent from noisy elevation
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#ifndef __APP_ELEVATION_H_
+#define __APP_ELEVATION_H_
+
+#include <types.h>
+
+typedef struct {
+    uint16_t deadband_dm;       /**< Smaller elevation changes are noise */
+    uint8_t lowpass_shift;      /**< New sample weight is 1/2^shift */
+} elevation_config_t;
+
+typedef struct {
+    const elevation_config_t *cfg;
+    bool valid;
+    int32_t filtered;           /**< Low pass filtered elevation, dm in Q4 */
+    int32_t ref;                /**< Elevation changes are counted from */
+} elevation_t;
+
+/**
+ * Add elevation sample
+ *
+ * @param elev          Accumulator
+ * @param elevation_dm  Elevation of the new point
+ * @return Ascent (positive) or descent (negative) in dm to be accounted
+ */
+extern int32_t Elevation_Add(elevation_t *elev, int32_t elevation_dm);
+
+/**
+ * Start over, e.g. on the new record, next sample is the reference
+ *
+ * @param elev  Accumulator
+ */
+extern void Elevation_Reset(elevation_t *elev);
+
+/**
+ * Initialize accumulator
+ *
+ * @param elev      Accumulator
+ * @param config    Configuration, must be valid while used
+ */
+extern void Elevation_Init(elevation_t *elev, const elevation_config_t *config);
+
+#endif
+
+/** @} */
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/gps/assist.c
+ * @brief   GPS receiver start assistance by last known position and RTC time
+ *
+ * The receiver only needs a rough position to pick visible satellites, so
+ * the position is stored to flash only after moving ASSIST_SAVE_DIST_M away
+ * from the stored one. Time is kept by RTC, synchronized with every fix.
+ * Ephemeris are kept by the receiver itself while in standby.
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <hal/rtc.h>
+#include <hal/uart.h>
+#include "utils/nav.h"
+#include "board_gpio.h"
+#include "nmea_ring.h"
+#include "ubx_ring.h"
+#include "assist.h"
+
+/** Stored position is updated after moving this far from it */
+#define ASSIST_SAVE_DIST_M 10000
+/** RTC is set from GPS if off by more */
+#define ASSIST_RTC_DRIFT_S 1
+/** Expected RTC accuracy told to u-blox receiver */
+#define ASSIST_TIME_ACC_S 10
+/** RTC showing earlier time was not set since backup domain reset */
+#define ASSIST_MIN_TIME 1577836800
+/** Scale of stored coordinates */
+#define ASSIST_SCALE 10000000
+
+/** MGA-INI message types */
+#define UBX_MGA_INI_POS_LLH     0x01
+#define UBX_MGA_INI_TIME_UTC    0x10
+#define UBX_MGA_INI_POS_LEN     20
+#define UBX_MGA_INI_TIME_LEN    24
+/** Leap seconds unknown */
+#define UBX_MGA_INI_LEAP_UNKNOWN 0x80
+
+/**
+ * Store little endian value
+ */
+static void Assisti_Put(uint8_t *buf, uint32_t val, uint8_t size)
+{
+    while (size--) {
+        *buf++ = val & 0xff;
+        val >>= 8;
+    }
+}
+
+/**
+ * Format coordinate in 1e-7 degrees as decimal degrees
+ */
+static int Assisti_Deg(char *buf, size_t size, int32_t val)
+{
+    const char *sign = val < 0 ? "-" : "";
+    uint32_t abs = val < 0 ? -(uint32_t)val : (uint32_t)val;
+
+    return snprintf(buf, size, "%s%u.%07u", sign,
+            (unsigned)(abs/ASSIST_SCALE), (unsigned)(abs % ASSIST_SCALE));
+}
+
+static uint16_t Assisti_Nmea(char *buf, const storage_assist_t *pos,
+        const struct tm *tm)
+{
+    char body[NMEA_RING_MAX_LEN];
+    int len;
+
+    if (pos == NULL) {
+        len = snprintf(body, sizeof(body), "PMTK740");
+    } else {
+        len = snprintf(body, sizeof(body), "PMTK741,");
+        len += Assisti_Deg(body + len, sizeof(body) - len, pos->lat);
+        body[len++] = ',';
+        len += Assisti_Deg(body + len, sizeof(body) - len, pos->lon);
+        len += snprintf(body + len, sizeof(body) - len, ",%d",
+                pos->elevation_m);
+    }
+    snprintf(body + len, sizeof(body) - len, ",%d,%02d,%02d,%02d,%02d,%02d",
+            tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday, tm->tm_hour,
+            tm->tm_min, tm->tm_sec);
+
+    return NmeaRing_Frame(buf, body);
+}
+
+static uint16_t Assisti_Ubx(uint8_t *buf, const storage_assist_t *pos,
+        const struct tm *tm)
+{
+    uint8_t payload[UBX_MGA_INI_TIME_LEN];
+    uint16_t len;
+
+    memset(payload, 0, sizeof(payload));
+    payload[0] = UBX_MGA_INI_TIME_UTC;
+    payload[3] = UBX_MGA_INI_LEAP_UNKNOWN;
+    Assisti_Put(&payload[4], tm->tm_year + 1900, 2);
+    payload[6] = tm->tm_mon + 1;
+    payload[7] = tm->tm_mday;
+    payload[8] = tm->tm_hour;
+    payload[9] = tm->tm_min;
+    payload[10] = tm->tm_sec;
+    Assisti_Put(&payload[16], ASSIST_TIME_ACC_S, 2);
+    len = UbxRing_Frame(buf, UBX_CLASS_MGA, UBX_MGA_INI, payload,
+            UBX_MGA_INI_TIME_LEN);
+
+    if (pos == NULL) {
+        return len;
+    }
+
+    memset(payload, 0, sizeof(payload));
+    payload[0] = UBX_MGA_INI_POS_LLH;
+    Assisti_Put(&payload[4], pos->lat, 4);
+    Assisti_Put(&payload[8], pos->lon, 4);
+    Assisti_Put(&payload[12], pos->elevation_m*100, 4);
+    Assisti_Put(&payload[16], ASSIST_SAVE_DIST_M*100, 4);
+    len += UbxRing_Frame(buf + len, UBX_CLASS_MGA, UBX_MGA_INI, payload,
+            UBX_MGA_INI_POS_LEN);
+    return len;
+}
+
+uint16_t Assist_Build(uint8_t *buf, gnss_proto_t proto,
+        const storage_assist_t *pos, time_t now)
+{
+    const struct tm *tm = gmtime(&now);
+
+    if (proto == GNSS_PROTO_UBX) {
+        return Assisti_Ubx(buf, pos, tm);
+    }
+    return Assisti_Nmea((char *) buf, pos, tm);
+}
+
+bool Assist_Inject(gnss_proto_t proto)
+{
+    uint8_t buf[ASSIST_MAX_LEN];
+    storage_assist_t pos;
+    const storage_assist_t *known = NULL;
+    time_t now = RTCd_GetTime();
+    uint16_t len;
+
+    if (now < ASSIST_MIN_TIME) {
+        return false;
+    }
+    /* RTC behind the stored fix was reset meanwhile */
+    if (Storage_GetAssist(&pos)) {
+        if (now < (time_t) pos.timestamp) {
+            return false;
+        }
+        known = &pos;
+    }
+
+    len = Assist_Build(buf, proto, known, now);
+    UARTd_Write(USART_GPS_TX, buf, len);
+    return true;
+}
+
+/**
+ * Convert coordinate to 1e-7 degrees
+ */
+static int32_t Assisti_Scale(const nmea_float_t *coord)
+{
+    return (int64_t) coord->num*ASSIST_SCALE/coord->scale;
+}
+
+void Assist_Update(const gps_info_t *gps)
+{
+    storage_assist_t pos;
+    nmea_float_t lat = { 0, ASSIST_SCALE };
+    nmea_float_t lon = { 0, ASSIST_SCALE };
+    time_t rtc = RTCd_GetTime();
+
+    if (rtc > gps->timestamp + ASSIST_RTC_DRIFT_S ||
+            rtc < gps->timestamp - ASSIST_RTC_DRIFT_S) {
+        RTCd_SetTime(gps->timestamp);
+    }
+
+    if (Storage_GetAssist(&pos)) {
+        lat.num = pos.lat;
+        lon.num = pos.lon;
+        if (Nav_GetDistanceDm(&lat, &lon, &gps->lat, &gps->lon) <
+                ASSIST_SAVE_DIST_M*10) {
+            return;
+        }
+    }
+
+    pos.lat = Assisti_Scale(&gps->lat);
+    pos.lon = Assisti_Scale(&gps->lon);
+    pos.timestamp = gps->timestamp;
+    pos.elevation_m = gps->altitude_dm/10;
+    Storage_SetAssist(&pos);
+}
+
+/** @} */
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/gps/assist.h
+ * @brief   GPS receiver start assistance by last known position and RTC time
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#ifndef __APP_GPS_ASSIST_H_
+#define __APP_GPS_ASSIST_H_
+
+#include <types.h>
+#include "drivers/gps.h"
+#include "storage.h"
+#include "gnss.h"
+
+/** Longest assistance data produced by Assist_Build */
+#define ASSIST_MAX_LEN 128
+
+/**
+ * Build assistance messages for receiver, PMTK741 (PMTK740 without position)
+ * for NMEA, MGA-INI-TIME_UTC and MGA-INI-POS_LLH for UBX
+ *
+ * @param buf       Target buffer, ASSIST_MAX_LEN long
+ * @param proto     Protocol of the receiver
+ * @param pos       Last known position, NULL if not known
+ * @param now       Current UTC time
+ * @return Length of the data
+ */
+extern uint16_t Assist_Build(uint8_t *buf, gnss_proto_t proto,
+        const storage_assist_t *pos, time_t now);
+
+/**
+ * Send stored position and RTC time to receiver, call right after receiver
+ * power up
+ *
+ * @param proto     Protocol of the receiver
+ * @return False if RTC time is not valid, nothing sent
+ */
+extern bool Assist_Inject(gnss_proto_t proto);
+
+/**
+ * Keep RTC synchronized with GPS time and store the position once receiver
+ * moves far from the last stored one
+ *
+ * @param gps   Accepted fix
+ */
+extern void Assist_Update(const gps_info_t *gps);
+
+#endif
+
+/** @} */
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/gps/filter.c
+ * @brief   Filtering of fixes before they are stored and added to stats
+ *
+ * Stages are applied in order:
+ *  - quality, hdop and amount of satellites within limits, time moving on
+ *  - outliers, speed from the last good fix must be realistic, if the next
+ *    fix agrees with the rejected one the jump is real (or the last good
+ *    fix was wrong) and the track continues from there
+ *  - smoothing, optional Kalman filter, so the position noise doesn't get
+ *    to the following stage and to the track
+ *  - stationary, once the movement from the last stored point drops below
+ *    min_dist_m, points are suppressed until receiver gets move_dist_m
+ *    away, the stationary position is stored again every keepalive_s to
+ *    keep the time
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#include <string.h>
+
+#include "utils/nav.h"
+#include "filter.h"
+
+static const filter_config_t *filteri_cfg;
+static filter_stats_t filteri_stats;
+
+static struct {
+    bool prev_valid;
+    bool still;             /**< Stationary, waiting for move_dist_m */
+    bool jump_valid;
+    gps_info_t prev;        /**< Last fix which passed outlier check */
+    gps_info_t stored;      /**< Last point passed to storage */
+    gps_info_t jump;        /**< Last fix rejected as outlier */
+} filteri;
+
+static bool Filteri_Quality(const gps_info_t *gps)
+{
+    if (gps->timestamp == 0 || gps->hdop_dm == 0 ||
+            gps->hdop_dm > filteri_cfg->hdop_max_dm ||
+            gps->satellites < filteri_cfg->sats_min) {
+        return false;
+    }
+    return !filteri.prev_valid || gps->timestamp > filteri.prev.timestamp;
+}
+
+/**
+ * Check if movement between fixes is possible
+ */
+static bool Filteri_Reachable(const gps_info_t *from, const gps_info_t *to)
+{
+    uint32_t dist = Nav_GetDistanceDm(&from->lat, &from->lon, &to->lat,
+            &to->lon);
+    uint32_t time = to->timestamp - from->timestamp;
+
+    /* Position error makes short intervals look fast */
+    if (dist <= filteri_cfg->min_dist_m*10) {
+        return true;
+    }
+    return time != 0 && dist/time <= filteri_cfg->speed_max_dms;
+}
+
+static bool Filteri_Outlier(const gps_info_t *gps)
+{
+    if (!filteri.prev_valid || Filteri_Reachable(&filteri.prev, gps)) {
+        filteri.jump_valid = false;
+        return false;
+    }
+
+    if (filteri.jump_valid && gps->timestamp > filteri.jump.timestamp &&
+            Filteri_Reachable(&filteri.jump, gps)) {
+        /* Two fixes agree, start over from them */
+        filteri_stats.resets++;
+        filteri.jump_valid = false;
+        if (filteri_cfg->kalman != NULL) {
+            Kalman_Reset();
+        }
+        filteri.still = false;
+        return false;
+    }
+
+    memcpy(&filteri.jump, gps, sizeof(filteri.jump));
+    filteri.jump_valid = true;
+    return true;
+}
+
+/**
+ * Check if the point should be stored with regard to stationary hysteresis
+ */
+static bool Filteri_Moved(const gps_info_t *gps)
+{
+    uint32_t dist;
+
+    if (!filteri.prev_valid) {
+        return true;
+    }
+
+    dist = Nav_GetDistanceDm(&filteri.stored.lat, &filteri.stored.lon,
+            &gps->lat, &gps->lon);
+    if (filteri.still) {
+        if (dist >= filteri_cfg->move_dist_m*10) {
+            filteri.still = false;
+            return true;
+        }
+    } else if (dist >= filteri_cfg->min_dist_m*10) {
+        return true;
+    } else {
+        filteri.still = true;
+    }
+    return false;
+}
+
+const gps_info_t *Filter_Process(const gps_info_t *gps)
+{
+    bool moved;
+
+    filteri_stats.fixes++;
+    if (!Filteri_Quality(gps)) {
+        filteri_stats.quality++;
+        return NULL;
+    }
+    if (Filteri_Outlier(gps)) {
+        filteri_stats.jumps++;
+        return NULL;
+    }
+    if (filteri_cfg->kalman != NULL) {
+        gps = Kalman_Process(gps);
+    }
+
+    moved = Filteri_Moved(gps);
+    memcpy(&filteri.prev, gps, sizeof(filteri.prev));
+    filteri.prev_valid = true;
+
+    if (moved) {
+        memcpy(&filteri.stored, gps, sizeof(filteri.stored));
+    } else if (gps->timestamp - filteri.stored.timestamp >=
+            filteri_cfg->keepalive_s) {
+        /* Position noise is not stored, only the time spent */
+        filteri.stored.timestamp = gps->timestamp;
+        filteri.stored.time = gps->time;
+        filteri_stats.keepalive++;
+    } else {
+        filteri_stats.still++;
+        return NULL;
+    }
+
+    filteri_stats.stored++;
+    return &filteri.stored;
+}
+
+const filter_stats_t *Filter_GetStats(void)
+{
+    return &filteri_stats;
+}
+
+void Filter_Init(const filter_config_t *config)
+{
+    filteri_cfg = config;
+    memset(&filteri, 0, sizeof(filteri));
+    memset(&filteri_stats, 0, sizeof(filteri_stats));
+    if (config->kalman != NULL) {
+        Kalman_Init(config->kalman);
+    }
+}
+
+/** @} */
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/gps/filter.h
+ * @brief   Filtering of fixes before they are stored and added to stats
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#ifndef __APP_GPS_FILTER_H_
+#define __APP_GPS_FILTER_H_
+
+#include <types.h>
+#include "drivers/gps.h"
+#include "kalman.h"
+
+typedef struct {
+    uint16_t hdop_max_dm;       /**< Worst hdop of the point to be stored */
+    uint8_t sats_min;           /**< Minimal amount of satellites used */
+    uint16_t speed_max_dms;     /**< Faster movement is considered a jump */
+    uint16_t min_dist_m;        /**< Shorter movement stops the track */
+    uint16_t move_dist_m;       /**< Distance to leave stationary position */
+    uint32_t keepalive_s;       /**< Point interval while stationary */
+    const kalman_config_t *kalman;  /**< Smoothing, NULL to disable */
+} filter_config_t;
+
+typedef struct {
+    uint32_t fixes;             /**< Fixes processed */
+    uint32_t quality;           /**< Rejected by hdop, satellites or time */
+    uint32_t jumps;             /**< Rejected as position outliers */
+    uint32_t resets;            /**< Jumps confirmed by following fix */
+    uint32_t still;             /**< Suppressed as stationary */
+    uint32_t keepalive;         /**< Stored while stationary */
+    uint32_t stored;            /**< Passed all stages */
+} filter_stats_t;
+
+/**
+ * Pass fix through quality, outlier and stationary filters
+ *
+ * @param gps   Fix accepted by receiver control
+ * @return Point to be stored and added to stats, NULL if filtered out
+ */
+extern const gps_info_t *Filter_Process(const gps_info_t *gps);
+
+/**
+ * Get amount of points processed by each stage
+ *
+ * @return Statistics
+ */
+extern const filter_stats_t *Filter_GetStats(void);
+
+/**
+ * Initialize filter
+ *
+ * @param config    Configuration, must be valid while used
+ */
+extern void Filter_Init(const filter_config_t *config);
+
+#endif
+
+/** @} */
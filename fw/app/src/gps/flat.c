@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file    app/gps/flat.c
+ * @brief   Local flat projection of coordinates, integer math only
+ *
+ * Conversion between 1e-7 deg and mm uses multiplication by Q16/Q24
+ * constants, division is needed only when origin is set.
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#include "flat.h"
+
+/** 1e-7 deg of latitude is 11.132 mm, Q16 */
+#define FLAT_MM_Q16 729551
+/** mm in 1e-7 deg of latitude, Q24 */
+#define FLAT_DEG7_Q24 1507098
+/** Step of the cosine table in 1e-2 deg */
+#define FLAT_COS_STEP 500
+
+/** cos(x) in Q15 for 0 to 90 deg */
+static const uint16_t flati_cos[] = {
+    32767, 32642, 32269, 31650, 30791, 29697, 28377, 26841, 25101, 23170,
+    21062, 18794, 16384, 13848, 11207, 8481, 5690, 2856, 0,
+};
+
+/**
+ * Get cosine of latitude in Q15
+ */
+static uint16_t Flati_Cos(int32_t lat)
+{
+    uint32_t deg = (lat < 0 ? -(int64_t)lat : lat)/(FLAT_SCALE/100);
+    uint32_t i = deg/FLAT_COS_STEP;
+    uint32_t frac = deg % FLAT_COS_STEP;
+
+    if (i >= sizeof(flati_cos)/sizeof(flati_cos[0]) - 1) {
+        return 0;
+    }
+    return flati_cos[i] - (flati_cos[i] - flati_cos[i + 1])*frac/
+            FLAT_COS_STEP;
+}
+
+static int32_t Flati_Saturate(int64_t val)
+{
+    if (val > FLAT_MAX_MM) {
+        return FLAT_MAX_MM;
+    }
+    if (val < -FLAT_MAX_MM) {
+        return -FLAT_MAX_MM;
+    }
+    return val;
+}
+
+int32_t Flat_Deg7(const nmea_float_t *coord)
+{
+    if (coord->scale == FLAT_SCALE) {
+        return coord->num;
+    }
+    return (int64_t) coord->num*FLAT_SCALE/coord->scale;
+}
+
+void Flat_Origin(flat_origin_t *origin, int32_t lat, int32_t lon)
+{
+    origin->lat = lat;
+    origin->lon = lon;
+    origin->cos = Flati_Cos(lat);
+    origin->sec = (1UL << 30)/(origin->cos != 0 ? origin->cos : 1);
+}
+
+flat_pos_t Flat_Project(const flat_origin_t *origin, const gps_info_t *point)
+{
+    flat_pos_t pos;
+    int64_t dlat = (int64_t) Flat_Deg7(&point->lat) - origin->lat;
+    int64_t dlon = (int64_t) Flat_Deg7(&point->lon) - origin->lon;
+
+    pos.y = Flati_Saturate((dlat*FLAT_MM_Q16) >> 16);
+    pos.x = Flati_Saturate((((dlon*FLAT_MM_Q16) >> 16)*origin->cos) >> 15);
+    return pos;
+}
+
+void Flat_Unproject(const flat_origin_t *origin, const flat_pos_t *pos,
+        gps_info_t *point)
+{
+    int64_t dlat = ((int64_t) pos->y*FLAT_DEG7_Q24) >> 24;
+    int64_t dlon = ((int64_t) pos->x*FLAT_DEG7_Q24) >> 24;
+
+    point->lat.num = origin->lat + dlat;
+    point->lat.scale = FLAT_SCALE;
+    point->lon.num = origin->lon + ((dlon*origin->sec) >> 15);
+    point->lon.scale = FLAT_SCALE;
+}
+
+/** @} */
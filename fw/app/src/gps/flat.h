@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file    app/gps/flat.h
+ * @brief   Local flat projection of coordinates, integer math only
+ *
+ * Good enough for distances up to tens of km from the origin, the
+ * error at 10 km is in the order of cm.
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#ifndef __APP_GPS_FLAT_H_
+#define __APP_GPS_FLAT_H_
+
+#include <types.h>
+#include "drivers/gps.h"
+
+/** Scale of coordinates used by projection, 1e-7 deg */
+#define FLAT_SCALE 10000000
+/** Projected positions are limited to about 1000 km, products fit int64 */
+#define FLAT_MAX_MM (1L << 30)
+
+typedef struct {
+    int32_t lat;                /**< Origin latitude in 1e-7 deg */
+    int32_t lon;                /**< Origin longitude in 1e-7 deg */
+    uint16_t cos;               /**< Cosine of latitude in Q15 */
+    uint32_t sec;               /**< Inverse of cosine in Q15 */
+} flat_origin_t;
+
+typedef struct {
+    int32_t x;                  /**< mm east of the origin */
+    int32_t y;                  /**< mm north of the origin */
+} flat_pos_t;
+
+/**
+ * Convert coordinate to 1e-7 deg
+ *
+ * @param coord     Coordinate
+ * @return Coordinate in 1e-7 deg
+ */
+extern int32_t Flat_Deg7(const nmea_float_t *coord);
+
+/**
+ * Set projection origin
+ *
+ * @param [out] origin  Origin to be set
+ * @param lat           Latitude in 1e-7 deg
+ * @param lon           Longitude in 1e-7 deg
+ */
+extern void Flat_Origin(flat_origin_t *origin, int32_t lat, int32_t lon);
+
+/**
+ * Project point to plane around origin, far away points are saturated
+ * to FLAT_MAX_MM
+ *
+ * @param origin    Projection origin
+ * @param point     Point to project
+ * @return Position relative to the origin
+ */
+extern flat_pos_t Flat_Project(const flat_origin_t *origin,
+        const gps_info_t *point);
+
+/**
+ * Get coordinates of position relative to origin
+ *
+ * @param origin    Projection origin
+ * @param pos       Position relative to origin
+ * @param [out] point   Latitude and longitude are set in 1e-7 deg
+ */
+extern void Flat_Unproject(const flat_origin_t *origin, const flat_pos_t *pos,
+        gps_info_t *point);
+
+#endif
+
+/** @} */
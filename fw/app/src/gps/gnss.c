@@ -0,0 +1,390 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/gps/gnss.c
+ * @brief   GPS receiver data reception, UART fed by DMA to a ring buffer
+ *
+ * USART2 RX is served by DMA1 channel 5 in circular mode, the core is woken
+ * up by half and full transfer interrupts only. The USART interrupt vector
+ * belongs to the uart driver, so idle line is not used, the tail of the
+ * burst is picked up by polling the DMA counter while the receiver runs.
+ *
+ * At init the MTK receiver is limited to RMC and GGA sentences and moved to
+ * GNSS_BAUDRATE, every step is confirmed by PMTK001 and the receiver stays
+ * at 9600 baud with default output if it doesn't answer. GSV is enabled only
+ * while somebody looks at the satellites.
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#include <string.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/stm32/usart.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/cm3/nvic.h>
+
+#include <hal/uart.h>
+#include <modules/log.h>
+#include <utils/time.h>
+
+#include "board_gpio.h"
+#include "config.h"
+#include "sched.h"
+#include "gnss.h"
+
+/** Size of the ring, 89 ms of data at 57600 baud */
+#define GNSS_RING_SIZE 512
+#define GNSS_USART USART2
+#define GNSS_DMA_CHANNEL DMA_CHANNEL5
+/** Time to wait for PMTK001, receiver needs a while after power up */
+#define GNSS_ACK_TIMEOUT_MS 1500
+
+/** PMTK commands used */
+#define PMTK_TEST           0
+#define PMTK_SET_BAUD       251
+#define PMTK_SET_OUTPUT     314
+
+#define GNSS_STR(x) #x
+#define GNSS_XSTR(x) GNSS_STR(x)
+
+static uint8_t gnssi_ring[GNSS_RING_SIZE];
+static nmea_ring_t gnssi_nmea;
+static ubx_ring_t gnssi_ubx;
+static gnss_proto_t gnssi_proto;
+static gps_info_t gnssi_info;
+static gps_sat_t gnssi_sat;
+static uint32_t gnssi_baud = GNSS_BAUD_DEFAULT;
+static bool gnssi_on = true;
+static bool gnssi_sat_output;
+
+/**
+ * Half and full transfer of the GPS ring buffer
+ */
+void dma1_channel4_7_dma2_channel3_5_isr(void)
+{
+    if (dma_get_interrupt_flag(DMA1, GNSS_DMA_CHANNEL, DMA_HTIF | DMA_TCIF)) {
+        dma_clear_interrupt_flags(DMA1, GNSS_DMA_CHANNEL, DMA_HTIF | DMA_TCIF);
+        Sched_Event(SCHED_EVT_UART_RX);
+    }
+}
+
+/**
+ * Get position of the next byte written by DMA
+ */
+static uint16_t Gnssi_Head(void)
+{
+    return (GNSS_RING_SIZE -
+            dma_get_number_of_data(DMA1, GNSS_DMA_CHANNEL)) % GNSS_RING_SIZE;
+}
+
+const gps_info_t *Gnss_Loop(void)
+{
+    uint8_t flags;
+
+    /* Overrun blocks the reception until cleared */
+    if (USART_ISR(GNSS_USART) & USART_ISR_ORE) {
+        USART_ICR(GNSS_USART) = USART_ICR_ORECF;
+    }
+
+    if (gnssi_proto == GNSS_PROTO_UBX) {
+        flags = UbxRing_Process(&gnssi_ubx, Gnssi_Head(), &gnssi_info,
+                &gnssi_sat);
+        if (flags & UBX_RING_FIX) {
+            return &gnssi_info;
+        }
+        return NULL;
+    }
+
+    flags = NmeaRing_Process(&gnssi_nmea, Gnssi_Head(), &gnssi_info,
+            &gnssi_sat);
+    if (flags & NMEA_RING_FIX) {
+        return &gnssi_info;
+    }
+    return NULL;
+}
+
+const gps_info_t *Gnss_Get(void)
+{
+    return &gnssi_info;
+}
+
+const gps_sat_t *Gnss_GetSat(void)
+{
+    return &gnssi_sat;
+}
+
+const nmea_ring_stats_t *Gnss_GetStats(void)
+{
+    return &gnssi_nmea.stats;
+}
+
+const ubx_ring_stats_t *Gnss_GetUbxStats(void)
+{
+    return &gnssi_ubx.stats;
+}
+
+/**
+ * Send UBX message to receiver
+ */
+static void Gnssi_UbxSend(uint8_t cls, uint8_t id, const uint8_t *payload,
+        uint16_t len)
+{
+    uint8_t buf[32];
+    uint16_t size;
+
+    size = UbxRing_Frame(buf, cls, id, payload, len);
+    UARTd_Write(USART_GPS_TX, buf, size);
+}
+
+/**
+ * Send NMEA sentence to receiver
+ *
+ * @param body  Sentence without $ and checksum
+ */
+static void Gnssi_NmeaSend(const char *body)
+{
+    char buf[NMEA_RING_MAX_LEN + 3];
+
+    NmeaRing_Frame(buf, body);
+    UARTd_Puts(USART_GPS_TX, buf);
+}
+
+/**
+ * Configure sentences sent by the receiver, RMC and GGA every fix, GSV only
+ * if requested
+ */
+static void Gnssi_Output(void)
+{
+    /* CFG-MSG NAV-SAT every navigation solution on current port */
+    uint8_t msg[] = { UBX_CLASS_NAV, UBX_NAV_SAT, 0x00 };
+
+    if (gnssi_proto == GNSS_PROTO_UBX) {
+        msg[2] = gnssi_sat_output ? 1 : 0;
+        Gnssi_UbxSend(UBX_CLASS_CFG, UBX_CFG_MSG, msg, sizeof(msg));
+        return;
+    }
+
+    /* GLL, RMC, VTG, GGA, GSA, GSV, 13 reserved/unused, ZDA */
+    if (gnssi_sat_output) {
+        Gnssi_NmeaSend("PMTK314,0,1,0,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0");
+    } else {
+        Gnssi_NmeaSend("PMTK314,0,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0");
+    }
+}
+
+/**
+ * Wait for acknowledge of PMTK command
+ *
+ * @param cmd   Command number
+ * @return True if receiver confirmed the command succeeded
+ */
+static bool Gnssi_WaitAck(int16_t cmd)
+{
+    uint32_t start = millis();
+
+    while (millis() - start < GNSS_ACK_TIMEOUT_MS) {
+        if ((NmeaRing_Process(&gnssi_nmea, Gnssi_Head(), &gnssi_info,
+                &gnssi_sat) & NMEA_RING_ACK) && gnssi_nmea.ack_cmd == cmd) {
+            return gnssi_nmea.ack_flag == NMEA_ACK_SUCCESS;
+        }
+    }
+    return false;
+}
+
+/**
+ * Change baudrate of the MCU side of the link
+ */
+static void Gnssi_SetBaud(uint32_t baud)
+{
+    /* Let the last command leave at the old speed */
+    while (!(USART_ISR(GNSS_USART) & USART_ISR_TC)) {
+        ;
+    }
+    UARTd_Init(USART_GPS_TX, baud);
+    Gnss_InitUart();
+    gnssi_baud = baud;
+}
+
+/**
+ * Find receiver baudrate, trim its output and switch it to GNSS_BAUDRATE
+ *
+ * @return False if receiver doesn't answer at any baudrate
+ */
+static bool Gnssi_Negotiate(void)
+{
+    /* Receiver keeps the baudrate while backup domain is powered */
+    static const uint32_t bauds[] = { GNSS_BAUD_DEFAULT, GNSS_BAUDRATE };
+    uint32_t old;
+    uint8_t i;
+
+    for (i = 0; i < sizeof(bauds)/sizeof(bauds[0]); i++) {
+        Gnssi_SetBaud(bauds[i]);
+        Gnssi_Output();
+        if (Gnssi_WaitAck(PMTK_SET_OUTPUT)) {
+            break;
+        }
+    }
+    if (i == sizeof(bauds)/sizeof(bauds[0])) {
+        Log_Error("GPS", "No answer from receiver");
+        Gnssi_SetBaud(GNSS_BAUD_DEFAULT);
+        return false;
+    }
+    if (gnssi_baud == GNSS_BAUDRATE) {
+        return true;
+    }
+
+    /* No acknowledge for baudrate change, check by test packet */
+    old = gnssi_baud;
+    Gnssi_NmeaSend("PMTK251," GNSS_XSTR(GNSS_BAUDRATE));
+    Gnssi_SetBaud(GNSS_BAUDRATE);
+    Gnssi_NmeaSend("PMTK000");
+    if (Gnssi_WaitAck(PMTK_TEST)) {
+        Log_Info("GPS", "Running at %d baud", GNSS_BAUDRATE);
+        return true;
+    }
+
+    /* Receiver may have kept old baudrate, make sure it still answers */
+    Log_Warning("GPS", "Baudrate change failed");
+    Gnssi_SetBaud(old);
+    Gnssi_NmeaSend("PMTK000");
+    return Gnssi_WaitAck(PMTK_TEST);
+}
+
+void Gnss_SetSatOutput(bool enable)
+{
+    if (enable == gnssi_sat_output) {
+        return;
+    }
+    gnssi_sat_output = enable;
+    /* Any byte wakes up the receiver, sent on next power up otherwise */
+    if (gnssi_on) {
+        Gnssi_Output();
+    }
+}
+
+uint32_t Gnss_GetBaudrate(void)
+{
+    return gnssi_baud;
+}
+
+void Gnss_Power(bool on)
+{
+    /* RXM-PMREQ, infinite backup mode, wake up by uart rx */
+    static const uint8_t pmreq[] = {
+        0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00,
+        0x06, 0x00, 0x00, 0x00,
+        0x08, 0x00, 0x00, 0x00,
+    };
+    static const uint8_t wakeup[] = { 0xff, 0xff, 0xff, 0xff };
+
+    gnssi_on = on;
+    if (gnssi_proto == GNSS_PROTO_UBX) {
+        if (on) {
+            UARTd_Write(USART_GPS_TX, wakeup, sizeof(wakeup));
+            Gnssi_Output();
+        } else {
+            Gnssi_UbxSend(UBX_CLASS_RXM, UBX_RXM_PMREQ, pmreq, sizeof(pmreq));
+        }
+        return;
+    }
+
+    if (on) {
+        /* Any byte wakes the receiver up, satellite output might have changed */
+        Gnssi_Output();
+    } else {
+        UARTd_Puts(USART_GPS_TX, "$PMTK161,0*28\r\n");
+    }
+}
+
+void Gnss_SetProtocol(gnss_proto_t proto)
+{
+    /* CFG-PRT for UART1, current baudrate 8N1, UBX+NMEA in, UBX or NMEA out */
+    uint8_t prt[] = {
+        0x01, 0x00, 0x00, 0x00,
+        0xd0, 0x08, 0x00, 0x00,
+        gnssi_baud & 0xff, (gnssi_baud >> 8) & 0xff,
+        (gnssi_baud >> 16) & 0xff, gnssi_baud >> 24,
+        0x03, 0x00, 0x01, 0x00,
+        0x00, 0x00, 0x00, 0x00,
+    };
+    /* CFG-MSG NAV-PVT every navigation solution on current port */
+    static const uint8_t msg[] = { UBX_CLASS_NAV, UBX_NAV_PVT, 0x01 };
+    /* CFG-RATE 1000 ms measurement, one solution per measurement, UTC */
+    static const uint8_t rate[] = { 0xe8, 0x03, 0x01, 0x00, 0x00, 0x00 };
+
+    if (proto == GNSS_PROTO_UBX) {
+        Gnssi_UbxSend(UBX_CLASS_CFG, UBX_CFG_PRT, prt, sizeof(prt));
+        Gnssi_UbxSend(UBX_CLASS_CFG, UBX_CFG_MSG, msg, sizeof(msg));
+        Gnssi_UbxSend(UBX_CLASS_CFG, UBX_CFG_RATE, rate, sizeof(rate));
+        gnssi_proto = proto;
+        Gnssi_Output();
+    } else if (gnssi_proto == GNSS_PROTO_UBX) {
+        /* Back to NMEA output on u-blox */
+        prt[14] = 0x02;
+        Gnssi_UbxSend(UBX_CLASS_CFG, UBX_CFG_PRT, prt, sizeof(prt));
+    }
+
+    NmeaRing_Init(&gnssi_nmea, gnssi_ring, GNSS_RING_SIZE);
+    UbxRing_Init(&gnssi_ubx, gnssi_ring, GNSS_RING_SIZE);
+    gnssi_nmea.pos = Gnssi_Head();
+    gnssi_ubx.pos = gnssi_nmea.pos;
+    gnssi_proto = proto;
+}
+
+void Gnss_InitUart(void)
+{
+    usart_disable_rx_interrupt(GNSS_USART);
+    usart_enable_rx_dma(GNSS_USART);
+    USART_ICR(GNSS_USART) = USART_ICR_ORECF;
+}
+
+void Gnss_Init(gnss_proto_t proto)
+{
+    memset(&gnssi_info, 0, sizeof(gnssi_info));
+    memset(&gnssi_sat, 0, sizeof(gnssi_sat));
+    gnssi_proto = GNSS_PROTO_NMEA;
+
+    rcc_periph_clock_enable(RCC_DMA);
+    dma_channel_reset(DMA1, GNSS_DMA_CHANNEL);
+    dma_set_peripheral_address(DMA1, GNSS_DMA_CHANNEL,
+            (uint32_t) &USART_RDR(GNSS_USART));
+    dma_set_memory_address(DMA1, GNSS_DMA_CHANNEL, (uint32_t) gnssi_ring);
+    dma_set_number_of_data(DMA1, GNSS_DMA_CHANNEL, GNSS_RING_SIZE);
+    dma_set_read_from_peripheral(DMA1, GNSS_DMA_CHANNEL);
+    dma_enable_memory_increment_mode(DMA1, GNSS_DMA_CHANNEL);
+    dma_set_peripheral_size(DMA1, GNSS_DMA_CHANNEL, DMA_CCR_PSIZE_8BIT);
+    dma_set_memory_size(DMA1, GNSS_DMA_CHANNEL, DMA_CCR_MSIZE_8BIT);
+    dma_set_priority(DMA1, GNSS_DMA_CHANNEL, DMA_CCR_PL_HIGH);
+    dma_enable_circular_mode(DMA1, GNSS_DMA_CHANNEL);
+    dma_enable_half_transfer_interrupt(DMA1, GNSS_DMA_CHANNEL);
+    dma_enable_transfer_complete_interrupt(DMA1, GNSS_DMA_CHANNEL);
+    dma_enable_channel(DMA1, GNSS_DMA_CHANNEL);
+    nvic_enable_irq(NVIC_DMA1_CHANNEL4_7_DMA2_CHANNEL3_5_IRQ);
+
+    Gnss_InitUart();
+    if (proto == GNSS_PROTO_NMEA) {
+        NmeaRing_Init(&gnssi_nmea, gnssi_ring, GNSS_RING_SIZE);
+        gnssi_nmea.pos = Gnssi_Head();
+        Gnssi_Negotiate();
+    }
+    Gnss_SetProtocol(proto);
+}
+
+/** @} */
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/gps/gnss.h
+ * @brief   GPS receiver data reception, UART fed by DMA to a ring buffer
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#ifndef __APP_GPS_GNSS_H_
+#define __APP_GPS_GNSS_H_
+
+#include <types.h>
+#include "drivers/gps.h"
+#include "nmea_ring.h"
+#include "ubx_ring.h"
+
+/** Baudrate of the receiver after power up */
+#define GNSS_BAUD_DEFAULT 9600
+
+typedef enum {
+    GNSS_PROTO_NMEA,        /**< NMEA text, MTK receivers (SIM28ML) */
+    GNSS_PROTO_UBX,         /**< UBX NAV-PVT, u-blox receivers */
+} gnss_proto_t;
+
+/**
+ * Process data received since last call
+ *
+ * @return Fix data if new fix was received, NULL otherwise
+ */
+extern const gps_info_t *Gnss_Loop(void);
+
+/**
+ * Get last received fix data
+ *
+ * @return Fix data
+ */
+extern const gps_info_t *Gnss_Get(void);
+
+/**
+ * Get last received satellite info
+ *
+ * @return Satellite info
+ */
+extern const gps_sat_t *Gnss_GetSat(void);
+
+/**
+ * Get NMEA parser statistics
+ *
+ * @return Statistics
+ */
+extern const nmea_ring_stats_t *Gnss_GetStats(void);
+
+/**
+ * Get UBX parser statistics
+ *
+ * @return Statistics
+ */
+extern const ubx_ring_stats_t *Gnss_GetUbxStats(void);
+
+/**
+ * Put the receiver to standby or wake it up
+ *
+ * @param on    True to wake up
+ */
+extern void Gnss_Power(bool on);
+
+/**
+ * Enable satellite info output (GSV or NAV-SAT), sent to receiver right away
+ * if running or with the next power up
+ *
+ * @param enable    True to enable
+ */
+extern void Gnss_SetSatOutput(bool enable);
+
+/**
+ * Get baudrate negotiated with receiver
+ *
+ * @return Baudrate
+ */
+extern uint32_t Gnss_GetBaudrate(void);
+
+/**
+ * Switch protocol used by receiver, UBX configures receiver to send NAV-PVT
+ * messages only
+ *
+ * @param proto     Protocol to be used
+ */
+extern void Gnss_SetProtocol(gnss_proto_t proto);
+
+/**
+ * Switch GPS uart reception to DMA, call after every uart initialization
+ */
+extern void Gnss_InitUart(void);
+
+/**
+ * Initialize GPS reception, NMEA receiver is switched to RMC and GGA output
+ * at GNSS_BAUDRATE if it answers
+ *
+ * @param proto     Protocol used by receiver
+ */
+extern void Gnss_Init(gnss_proto_t proto);
+
+#endif
+
+/** @} */
@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/gps/gpsctl.c
+ * @brief   GPS receiver duty cycling, powers receiver only to get a fix
+ *
+ * The receiver is powered up shortly before the fix is due (by expected time
+ * to fix), the first good fix is accepted and the receiver is put to standby
+ * until the next slot. Interval between fixes is scaled by measured speed.
+ * If the interval is too short for the power cycle to pay off, the receiver
+ * is kept running and fixes are just taken once per interval.
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#include <string.h>
+
+#include "utils/nav.h"
+#include "gpsctl.h"
+
+/** Added to expected time to fix when planning the power up */
+#define GPSCTL_LEAD_MARGIN_MS 500
+/** Shortest standby time, keep receiver running if it would be shorter */
+#define GPSCTL_MIN_OFF_MS 5000
+
+/** Type of the receiver start, time to fix is tracked for each */
+typedef enum {
+    GPSCTL_START_COLD,  /**< First start after boot */
+    GPSCTL_START_HOT,   /**< Off for up to hot_window_s */
+    GPSCTL_START_WARM,  /**< Off for longer time */
+} gpsctl_start_t;
+
+static const gpsctl_config_t *gpsctli_cfg;
+static gpsctl_power_cb_t gpsctli_power;
+static gpsctl_stats_t gpsctli_stats;
+
+static struct {
+    bool on;                /**< Receiver powered */
+    bool starting;          /**< Powered up, waiting for first fix */
+    gpsctl_start_t start;   /**< Type of the last start */
+    uint32_t on_at;         /**< Time of last power up */
+    uint32_t off_at;        /**< Time of last power down */
+    uint32_t wake_at;       /**< Power up time, or next fix time if on */
+    uint32_t on_ms;         /**< Power on time not yet added to stats */
+    bool prev_valid;
+    gps_info_t prev;        /**< Last accepted fix */
+} gpsctli;
+
+/**
+ * Check if time a is before time b, handles overflow
+ */
+static bool GpsCtli_Before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+/**
+ * Update running average of time to fix, the first sample is used as is
+ */
+static void GpsCtli_Average(uint32_t *avg, uint32_t ttff)
+{
+    if (*avg == 0) {
+        *avg = ttff;
+    } else {
+        *avg = (*avg*3 + ttff)/4;
+    }
+}
+
+static void GpsCtli_Power(bool on, uint32_t now)
+{
+    if (on == gpsctli.on) {
+        return;
+    }
+
+    if (on) {
+        if (gpsctli_stats.starts == 0) {
+            gpsctli.start = GPSCTL_START_COLD;
+        } else if (now - gpsctli.off_at <= gpsctli_cfg->hot_window_s*1000) {
+            gpsctli.start = GPSCTL_START_HOT;
+        } else {
+            gpsctli.start = GPSCTL_START_WARM;
+        }
+        gpsctli_stats.starts++;
+        gpsctli.starting = true;
+        gpsctli.on_at = now;
+        gpsctli.wake_at = now;
+    } else {
+        gpsctli.on_ms += now - gpsctli.on_at;
+        gpsctli_stats.on_s += gpsctli.on_ms/1000;
+        gpsctli.on_ms %= 1000;
+        gpsctli.off_at = now;
+    }
+    gpsctli.on = on;
+    gpsctli_power(on);
+}
+
+/**
+ * Plan the next fix, power receiver down if it pays off
+ *
+ * @param now       Current time
+ * @param interval  Time to the next fix in s
+ */
+static void GpsCtli_Schedule(uint32_t now, uint32_t interval)
+{
+    uint32_t interval_ms = interval*1000;
+    uint32_t lead;
+
+    if (interval <= gpsctli_cfg->hot_window_s) {
+        lead = gpsctli_stats.ttff_hot_ms;
+    } else {
+        lead = gpsctli_stats.ttff_warm_ms;
+    }
+    lead += GPSCTL_LEAD_MARGIN_MS;
+
+    if (interval_ms <= lead + GPSCTL_MIN_OFF_MS) {
+        /* Keep running, take next fix once interval passes */
+        gpsctli.starting = false;
+        gpsctli.wake_at = now + interval_ms;
+        return;
+    }
+
+    GpsCtli_Power(false, now);
+    gpsctli.wake_at = now + interval_ms - lead;
+}
+
+/**
+ * Get next fix interval based on speed between last two fixes
+ *
+ * @param speed     Speed in dm/s
+ * @return Interval in s
+ */
+static uint32_t GpsCtli_Interval(uint32_t speed)
+{
+    const gpsctl_config_t *cfg = gpsctli_cfg;
+    uint32_t interval;
+
+    if (speed < cfg->still_speed_dms) {
+        /* Stationary, back off */
+        interval = gpsctli_stats.interval_s*2;
+    } else {
+        interval = cfg->interval_s*cfg->ref_speed_dms/speed;
+    }
+
+    if (interval < cfg->interval_min_s) {
+        interval = cfg->interval_min_s;
+    } else if (interval > cfg->interval_max_s) {
+        interval = cfg->interval_max_s;
+    }
+    return interval;
+}
+
+static bool GpsCtli_IsValid(const gps_info_t *gps)
+{
+    if (gps->timestamp == 0 || gps->hdop_dm == 0 ||
+            gps->hdop_dm > gpsctli_cfg->hdop_max_dm ||
+            gps->satellites < gpsctli_cfg->sats_min) {
+        return false;
+    }
+    /* Receiver can report last known fix after power up */
+    if (gpsctli.prev_valid && gps->timestamp <= gpsctli.prev.timestamp) {
+        return false;
+    }
+    return true;
+}
+
+static void GpsCtli_Fix(const gps_info_t *gps, uint32_t now)
+{
+    uint32_t ttff;
+
+    if (gpsctli.starting) {
+        ttff = now - gpsctli.on_at;
+        if (ttff > gpsctli_stats.ttff_max_ms) {
+            gpsctli_stats.ttff_max_ms = ttff;
+        }
+        if (gpsctli.start == GPSCTL_START_COLD) {
+            gpsctli_stats.ttff_cold_ms = ttff;
+        } else if (gpsctli.start == GPSCTL_START_HOT) {
+            GpsCtli_Average(&gpsctli_stats.ttff_hot_ms, ttff);
+        } else if (gpsctli.start == GPSCTL_START_WARM) {
+            GpsCtli_Average(&gpsctli_stats.ttff_warm_ms, ttff);
+        }
+        gpsctli.starting = false;
+    }
+
+    if (gpsctli.prev_valid) {
+        gpsctli_stats.speed_dms = Nav_GetDistanceDm(&gps->lat, &gps->lon,
+                &gpsctli.prev.lat, &gpsctli.prev.lon) /
+                (gps->timestamp - gpsctli.prev.timestamp);
+        gpsctli_stats.interval_s = GpsCtli_Interval(gpsctli_stats.speed_dms);
+    }
+
+    memcpy(&gpsctli.prev, gps, sizeof(gpsctli.prev));
+    gpsctli.prev_valid = true;
+    gpsctli_stats.fixes++;
+    GpsCtli_Schedule(now, gpsctli_stats.interval_s);
+}
+
+const gps_info_t *GpsCtl_Process(const gps_info_t *gps, uint32_t now_ms)
+{
+    if (!gpsctli.on) {
+        if (!GpsCtli_Before(now_ms, gpsctli.wake_at)) {
+            GpsCtli_Power(true, now_ms);
+        }
+        return NULL;
+    }
+
+    if (GpsCtli_Before(now_ms, gpsctli.wake_at)) {
+        return NULL;
+    }
+    if (gps != NULL && GpsCtli_IsValid(gps)) {
+        GpsCtli_Fix(gps, now_ms);
+        return &gpsctli.prev;
+    }
+
+    if (now_ms - gpsctli.wake_at >= gpsctli_cfg->timeout_s*1000) {
+        gpsctli_stats.timeouts++;
+        GpsCtli_Schedule(now_ms, gpsctli_stats.interval_s);
+    }
+    return NULL;
+}
+
+uint32_t GpsCtl_GetDelayMs(uint32_t now_ms)
+{
+    if (gpsctli.on || !GpsCtli_Before(now_ms, gpsctli.wake_at)) {
+        return 0;
+    }
+    return gpsctli.wake_at - now_ms;
+}
+
+bool GpsCtl_IsOn(void)
+{
+    return gpsctli.on;
+}
+
+const gpsctl_stats_t *GpsCtl_GetStats(void)
+{
+    return &gpsctli_stats;
+}
+
+void GpsCtl_Init(const gpsctl_config_t *config, gpsctl_power_cb_t power_cb,
+        uint32_t now_ms)
+{
+    gpsctli_cfg = config;
+    gpsctli_power = power_cb;
+    memset(&gpsctli, 0, sizeof(gpsctli));
+    memset(&gpsctli_stats, 0, sizeof(gpsctli_stats));
+    gpsctli_stats.interval_s = config->interval_s;
+    GpsCtli_Power(true, now_ms);
+}
+
+/** @} */
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/gps/gpsctl.h
+ * @brief   GPS receiver duty cycling, powers receiver only to get a fix
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#ifndef __APP_GPS_GPSCTL_H_
+#define __APP_GPS_GPSCTL_H_
+
+#include <types.h>
+#include "drivers/gps.h"
+
+typedef struct {
+    uint32_t interval_s;        /**< Fix interval when moving at ref_speed */
+    uint32_t interval_min_s;    /**< Shortest interval (fast movement) */
+    uint32_t interval_max_s;    /**< Longest interval (stationary) */
+    uint16_t ref_speed_dms;     /**< Speed the interval_s is set for */
+    uint16_t still_speed_dms;   /**< Slower movement considered stationary */
+    uint16_t hdop_max_dm;       /**< Worst hdop of the fix to be accepted */
+    uint8_t sats_min;           /**< Minimal amount of satellites used */
+    uint32_t timeout_s;         /**< Max time to wait for the fix */
+    uint32_t hot_window_s;      /**< Max off time for hot start */
+} gpsctl_config_t;
+
+typedef struct {
+    uint32_t fixes;             /**< Amount of accepted fixes */
+    uint32_t timeouts;          /**< Amount of slots without fix */
+    uint32_t starts;            /**< Amount of receiver power ups */
+    uint32_t on_s;              /**< Total time the receiver was powered */
+    uint32_t ttff_cold_ms;      /**< Time to the first fix after boot */
+    uint32_t ttff_hot_ms;       /**< Average time to fix after short off */
+    uint32_t ttff_warm_ms;      /**< Average time to fix after long off */
+    uint32_t ttff_max_ms;       /**< Longest time to fix */
+    uint32_t interval_s;        /**< Currently used fix interval */
+    uint32_t speed_dms;         /**< Speed between last two fixes */
+} gpsctl_stats_t;
+
+/**
+ * Power the receiver up or put it to standby
+ *
+ * @param on    True to power up
+ */
+typedef void (*gpsctl_power_cb_t)(bool on);
+
+/**
+ * Process data from receiver, switch receiver on/off as needed
+ *
+ * @param gps       New data from receiver or NULL if none
+ * @param now_ms    Current time in ms
+ * @return Fix to be stored or NULL
+ */
+extern const gps_info_t *GpsCtl_Process(const gps_info_t *gps,
+        uint32_t now_ms);
+
+/**
+ * Get time until receiver is powered up again
+ *
+ * @param now_ms    Current time in ms
+ * @return Time in ms, 0 if receiver is powered (data should be polled)
+ */
+extern uint32_t GpsCtl_GetDelayMs(uint32_t now_ms);
+
+/**
+ * Check if receiver is powered
+ *
+ * @return True if powered
+ */
+extern bool GpsCtl_IsOn(void);
+
+/**
+ * Get duty cycling statistics
+ *
+ * @return Statistics
+ */
+extern const gpsctl_stats_t *GpsCtl_GetStats(void);
+
+/**
+ * Initialize duty cycling, receiver is powered up immediately
+ *
+ * @param config    Configuration, must be valid while used
+ * @param power_cb  Receiver power control
+ * @param now_ms    Current time in ms
+ */
+extern void GpsCtl_Init(const gpsctl_config_t *config,
+        gpsctl_power_cb_t power_cb, uint32_t now_ms);
+
+#endif
+
+/** @} */
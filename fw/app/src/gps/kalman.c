@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file    app/gps/kalman.c
+ * @brief   Smoothing of fixes by constant velocity Kalman filter
+ *
+ * Each axis (east, north, up) has its own position and velocity state,
+ * positions are in mm on a flat projection around the last estimate.
+ * Measurement error is uere_dm scaled by hdop, vertical error is taken
+ * as 1.5 times horizontal as receivers don't report vdop in GGA.
+ *
+ * Integer math only. Per fix there are 6 64-bit divisions (gains) and
+ * about 40 64-bit multiplications, which is roughly 6000 cycles on
+ * Cortex-M0 without divider in the worst case. Budget is 10000 cycles,
+ * 0.2 ms at 48 MHz.
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#include <string.h>
+
+#include "flat.h"
+#include "kalman.h"
+
+/** Velocity error of the first fix, 50 m/s in mm/s */
+#define KALMAN_VEL_INIT_MM 50000
+
+typedef struct {
+    int32_t pos;            /**< mm */
+    int32_t vel;            /**< mm/s */
+    int64_t p00;            /**< Position variance, mm^2 */
+    int64_t p01;            /**< Covariance, mm^2/s */
+    int64_t p11;            /**< Velocity variance, mm^2/s^2 */
+} kalmani_axis_t;
+
+static const kalman_config_t *kalmani_cfg;
+static kalman_stats_t kalmani_stats;
+
+static struct {
+    bool valid;
+    flat_origin_t origin;   /**< Horizontal position of the last estimate */
+    kalmani_axis_t x;
+    kalmani_axis_t y;
+    kalmani_axis_t z;
+    gps_info_t out;
+} kalmani;
+
+static void Kalmani_Start(kalmani_axis_t *axis, int32_t pos, int64_t r)
+{
+    axis->pos = pos;
+    axis->vel = 0;
+    axis->p00 = r;
+    axis->p01 = 0;
+    axis->p11 = (int64_t) KALMAN_VEL_INIT_MM*KALMAN_VEL_INIT_MM;
+}
+
+/**
+ * Move state forward by dt, variance grows by acceleration noise q
+ */
+static void Kalmani_Predict(kalmani_axis_t *axis, uint32_t dt, int64_t q)
+{
+    int64_t dt2 = (int64_t) dt*dt;
+
+    axis->pos += axis->vel*(int32_t) dt;
+    axis->p00 += dt*(2*axis->p01 + dt*axis->p11) + q*dt2*dt2/4;
+    axis->p01 += dt*axis->p11 + q*dt2*dt/2;
+    axis->p11 += q*dt2;
+}
+
+/**
+ * Correct state by measurement z with variance r
+ */
+static void Kalmani_Update(kalmani_axis_t *axis, int32_t z, int64_t r)
+{
+    int64_t s = axis->p00 + r;
+    int64_t y = (int64_t) z - axis->pos;
+    /* Gains in Q16 */
+    int64_t k0 = axis->p00*65536/s;
+    int64_t k1 = axis->p01*65536/s;
+
+    axis->pos += (k0*y) >> 16;
+    axis->vel += (k1*y) >> 16;
+    axis->p11 -= (k1*axis->p01) >> 16;
+    axis->p00 = (k0*r) >> 16;
+    axis->p01 = (k1*r) >> 16;
+}
+
+const gps_info_t *Kalman_Process(const gps_info_t *gps)
+{
+    int64_t err = (int64_t) gps->hdop_dm*kalmani_cfg->uere_dm*10;
+    int64_t r = err*err;
+    int64_t r_up = r*9/4;
+    int64_t accel = (int64_t) kalmani_cfg->accel_dms2*100;
+    uint32_t dt = gps->timestamp - kalmani.out.timestamp;
+    flat_pos_t pos;
+
+    kalmani_stats.fixes++;
+    memcpy(&kalmani.out, gps, sizeof(kalmani.out));
+    if (!kalmani.valid || dt > kalmani_cfg->reset_s) {
+        if (kalmani.valid) {
+            kalmani_stats.resets++;
+        }
+        Flat_Origin(&kalmani.origin, Flat_Deg7(&gps->lat),
+                Flat_Deg7(&gps->lon));
+        Kalmani_Start(&kalmani.x, 0, r);
+        Kalmani_Start(&kalmani.y, 0, r);
+        Kalmani_Start(&kalmani.z, gps->altitude_dm*100, r_up);
+        kalmani.valid = true;
+        return &kalmani.out;
+    }
+
+    Kalmani_Predict(&kalmani.x, dt, accel*accel);
+    Kalmani_Predict(&kalmani.y, dt, accel*accel);
+    Kalmani_Predict(&kalmani.z, dt, accel*accel);
+
+    pos = Flat_Project(&kalmani.origin, gps);
+    Kalmani_Update(&kalmani.x, pos.x, r);
+    Kalmani_Update(&kalmani.y, pos.y, r);
+    Kalmani_Update(&kalmani.z, gps->altitude_dm*100, r_up);
+
+    /* Projection is kept around the estimate */
+    pos.x = kalmani.x.pos;
+    pos.y = kalmani.y.pos;
+    Flat_Unproject(&kalmani.origin, &pos, &kalmani.out);
+    Flat_Origin(&kalmani.origin, kalmani.out.lat.num, kalmani.out.lon.num);
+    kalmani.x.pos = 0;
+    kalmani.y.pos = 0;
+    kalmani.out.altitude_dm = kalmani.z.pos/100;
+
+    return &kalmani.out;
+}
+
+void Kalman_Reset(void)
+{
+    kalmani.valid = false;
+}
+
+const kalman_stats_t *Kalman_GetStats(void)
+{
+    return &kalmani_stats;
+}
+
+void Kalman_Init(const kalman_config_t *config)
+{
+    kalmani_cfg = config;
+    memset(&kalmani, 0, sizeof(kalmani));
+    memset(&kalmani_stats, 0, sizeof(kalmani_stats));
+}
+
+/** @} */
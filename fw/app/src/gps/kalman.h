@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file    app/gps/kalman.h
+ * @brief   Smoothing of fixes by constant velocity Kalman filter
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#ifndef __APP_GPS_KALMAN_H_
+#define __APP_GPS_KALMAN_H_
+
+#include <types.h>
+#include "drivers/gps.h"
+
+typedef struct {
+    uint16_t uere_dm;           /**< Position error at hdop 1.0 */
+    uint16_t accel_dms2;        /**< Expected acceleration (process noise) */
+    uint16_t reset_s;           /**< Longer gap between fixes starts over */
+} kalman_config_t;
+
+typedef struct {
+    uint32_t fixes;             /**< Fixes processed */
+    uint32_t resets;            /**< Restarts from raw fix after long gap */
+} kalman_stats_t;
+
+/**
+ * Smooth fix position and altitude
+ *
+ * @param gps   Fix which passed quality checks, time must be increasing
+ * @return Smoothed fix, valid until next call
+ */
+extern const gps_info_t *Kalman_Process(const gps_info_t *gps);
+
+/**
+ * Forget the state, next fix is used as is (position is known to jump)
+ */
+extern void Kalman_Reset(void);
+
+/**
+ * Get smoothing statistics
+ *
+ * @return Statistics
+ */
+extern const kalman_stats_t *Kalman_GetStats(void);
+
+/**
+ * Initialize smoothing
+ *
+ * @param config    Configuration, must be valid while used
+ */
+extern void Kalman_Init(const kalman_config_t *config);
+
+#endif
+
+/** @} */
@@ -0,0 +1,455 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/gps/nmea_ring.c
+ * @brief   NMEA parser working directly on a circular receive buffer
+ *
+ * Each byte is visited once by the scanner computing the checksum, valid
+ * sentences are then parsed in place, only field positions are stored and
+ * only fields used by the logger are converted.
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#include <string.h>
+
+#include "nmea_ring.h"
+
+/** Max amount of fields in sentence (GSV has 20) */
+#define NMEA_RING_MAX_FIELDS 21
+/** Scale of the parsed coordinates */
+#define NMEA_RING_COORD_SCALE 10000000
+
+/** Character at given position of the ring */
+#define NMEA_RING_CHAR(ring, p) ((ring)->buf[(p) & (ring)->mask])
+
+typedef enum {
+    NMEA_RING_STATE_IDLE,   /**< Waiting for $ */
+    NMEA_RING_STATE_BODY,   /**< Sentence body, computing checksum */
+    NMEA_RING_STATE_CS1,    /**< First checksum digit */
+    NMEA_RING_STATE_CS2,    /**< Second checksum digit */
+} nmea_ring_state_t;
+
+static int8_t NmeaRingi_Hex(uint8_t c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/**
+ * Parse decimal number from field
+ *
+ * @param ring      Ring description
+ * @param p         Position of the field
+ * @param decimals  Amount of decimal places kept (value is scaled by 10^x)
+ * @param val       Parsed value
+ * @return False if field is empty
+ */
+static bool NmeaRingi_Fixed(const nmea_ring_t *ring, uint16_t p,
+        uint8_t decimals, int32_t *val)
+{
+    bool neg = false;
+    bool point = false;
+    bool digits = false;
+    uint8_t dec = 0;
+    int32_t v = 0;
+    uint8_t c;
+
+    if (NMEA_RING_CHAR(ring, p) == '-') {
+        neg = true;
+        p++;
+    }
+
+    while (1) {
+        c = NMEA_RING_CHAR(ring, p++);
+        if (c >= '0' && c <= '9') {
+            if (!point) {
+                v = v*10 + c - '0';
+            } else if (dec < decimals) {
+                v = v*10 + c - '0';
+                dec++;
+            }
+            digits = true;
+        } else if (c == '.' && !point) {
+            point = true;
+        } else {
+            break;
+        }
+    }
+    if (!digits) {
+        return false;
+    }
+
+    while (dec++ < decimals) {
+        v *= 10;
+    }
+    *val = neg ? -v : v;
+    return true;
+}
+
+/**
+ * Parse coordinate in (d)ddmm.mmmm format to degrees
+ *
+ * @param ring      Ring description
+ * @param p         Position of the value field
+ * @param hemi      Position of the hemisphere field
+ * @param coord     Parsed coordinate
+ * @return False if field is empty
+ */
+static bool NmeaRingi_Coord(const nmea_ring_t *ring, uint16_t p,
+        uint16_t hemi, nmea_float_t *coord)
+{
+    int32_t raw;
+    int32_t deg;
+    uint8_t c;
+
+    /* 5 decimal places of minutes fit into int32 for longitude */
+    if (!NmeaRingi_Fixed(ring, p, 5, &raw)) {
+        return false;
+    }
+    deg = raw / 10000000;
+    raw = deg*NMEA_RING_COORD_SCALE + (raw % 10000000)*100/60;
+
+    c = NMEA_RING_CHAR(ring, hemi);
+    if (c == 'S' || c == 'W') {
+        raw = -raw;
+    }
+    coord->num = raw;
+    coord->scale = NMEA_RING_COORD_SCALE;
+    return true;
+}
+
+/**
+ * Parse hhmmss.sss time to seconds from midnight
+ *
+ * @return Time of day or -1 if field is empty
+ */
+static int32_t NmeaRingi_Tod(const nmea_ring_t *ring, uint16_t p)
+{
+    int32_t hms;
+
+    if (!NmeaRingi_Fixed(ring, p, 0, &hms)) {
+        return -1;
+    }
+    return (hms/10000)*3600 + ((hms/100) % 100)*60 + hms % 100;
+}
+
+static void NmeaRingi_Rmc(nmea_ring_t *ring, const uint16_t *field,
+        uint8_t fields, gps_info_t *info)
+{
+    int32_t date;
+    int32_t tod;
+
+    if (fields < 10) {
+        ring->stats.errors++;
+        return;
+    }
+    ring->stats.rmc++;
+
+    tod = NmeaRingi_Tod(ring, field[1]);
+    if (tod < 0 || !NmeaRingi_Fixed(ring, field[9], 0, &date)) {
+        info->timestamp = 0;
+        return;
+    }
+    /* Two digit year, receivers can't report dates before 1980 */
+    info->time = NmeaRing_MkTime(date % 100 + (date % 100 < 80 ? 2000 : 1900),
+            (date/100) % 100, date/10000, tod);
+
+    if (NMEA_RING_CHAR(ring, field[2]) != 'A' ||
+            !NmeaRingi_Coord(ring, field[3], field[4], &info->lat) ||
+            !NmeaRingi_Coord(ring, field[5], field[6], &info->lon)) {
+        info->timestamp = 0;
+        return;
+    }
+    info->timestamp = info->time;
+    ring->rmc_tod = tod;
+}
+
+static void NmeaRingi_Gga(nmea_ring_t *ring, const uint16_t *field,
+        uint8_t fields, gps_info_t *info)
+{
+    int32_t val;
+
+    if (fields < 11) {
+        ring->stats.errors++;
+        return;
+    }
+    ring->stats.gga++;
+
+    if (NmeaRingi_Fixed(ring, field[7], 0, &val)) {
+        info->satellites = val;
+    }
+    if (!NmeaRingi_Fixed(ring, field[6], 0, &val) || val == 0) {
+        /* No fix */
+        info->hdop_dm = 0;
+        return;
+    }
+
+    NmeaRingi_Coord(ring, field[2], field[3], &info->lat);
+    NmeaRingi_Coord(ring, field[4], field[5], &info->lon);
+    if (NmeaRingi_Fixed(ring, field[8], 1, &val)) {
+        info->hdop_dm = val;
+    }
+    if (NmeaRingi_Fixed(ring, field[9], 1, &val)) {
+        info->altitude_dm = val;
+    }
+    ring->gga_tod = NmeaRingi_Tod(ring, field[1]);
+}
+
+static void NmeaRingi_Gsv(nmea_ring_t *ring, const uint16_t *field,
+        uint8_t fields, gps_sat_t *sat)
+{
+    const uint8_t max = sizeof(sat->sat)/sizeof(sat->sat[0]);
+    int32_t msg;
+    int32_t visible;
+    int32_t snr;
+    uint8_t id;
+
+    if (fields < 4 || !NmeaRingi_Fixed(ring, field[2], 0, &msg) || msg < 1 ||
+            !NmeaRingi_Fixed(ring, field[3], 0, &visible)) {
+        ring->stats.errors++;
+        return;
+    }
+    ring->stats.gsv++;
+
+    if (msg == 1) {
+        sat->count = 0;
+    }
+    sat->visible = visible;
+
+    /* Groups of prn, elevation, azimuth, snr */
+    id = (msg - 1)*4;
+    for (uint8_t i = 7; i < fields && id < max; i += 4, id++) {
+        if (!NmeaRingi_Fixed(ring, field[i], 0, &snr)) {
+            snr = 0;
+        }
+        sat->sat[id].snr = snr;
+        sat->count = id + 1;
+    }
+}
+
+/**
+ * Compare ring content at given position with string
+ */
+static bool NmeaRingi_Match(const nmea_ring_t *ring, uint16_t p,
+        const char *str)
+{
+    while (*str != '\0') {
+        if (NMEA_RING_CHAR(ring, p++) != *str++) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Parse acknowledge of PMTK command sent to receiver
+ */
+static void NmeaRingi_Ack(nmea_ring_t *ring, const uint16_t *field,
+        uint8_t fields)
+{
+    int32_t cmd;
+    int32_t flag;
+
+    if (fields < 3 || !NmeaRingi_Fixed(ring, field[1], 0, &cmd) ||
+            !NmeaRingi_Fixed(ring, field[2], 0, &flag)) {
+        ring->stats.errors++;
+        return;
+    }
+    ring->stats.ack++;
+    ring->ack_cmd = cmd;
+    ring->ack_flag = flag;
+}
+
+/**
+ * Parse sentence validated by scanner
+ *
+ * @param ring  Ring description
+ * @param end   Position of the * character
+ * @return NMEA_RING_* flags
+ */
+static uint8_t NmeaRingi_Parse(nmea_ring_t *ring, uint16_t end,
+        gps_info_t *info, gps_sat_t *sat)
+{
+    uint16_t field[NMEA_RING_MAX_FIELDS];
+    uint8_t fields = 0;
+    uint16_t p = (ring->start + 1) & ring->mask;
+    uint8_t t1, t2, t3;
+
+    field[fields++] = p;
+    while (p != end) {
+        if (NMEA_RING_CHAR(ring, p) == ',') {
+            if (fields == NMEA_RING_MAX_FIELDS) {
+                ring->stats.errors++;
+                return 0;
+            }
+            field[fields++] = (p + 1) & ring->mask;
+        }
+        p = (p + 1) & ring->mask;
+    }
+
+    if (NmeaRingi_Match(ring, field[0], "PMTK001,")) {
+        NmeaRingi_Ack(ring, field, fields);
+        return NMEA_RING_ACK;
+    }
+
+    /* Skip two characters of talker id */
+    t1 = NMEA_RING_CHAR(ring, field[0] + 2);
+    t2 = NMEA_RING_CHAR(ring, field[0] + 3);
+    t3 = NMEA_RING_CHAR(ring, field[0] + 4);
+    if (t1 == 'R' && t2 == 'M' && t3 == 'C') {
+        NmeaRingi_Rmc(ring, field, fields, info);
+        return NMEA_RING_RMC;
+    }
+    if (t1 == 'G' && t2 == 'G' && t3 == 'A') {
+        NmeaRingi_Gga(ring, field, fields, info);
+        return NMEA_RING_GGA;
+    }
+    if (t1 == 'G' && t2 == 'S' && t3 == 'V') {
+        NmeaRingi_Gsv(ring, field, fields, sat);
+        return NMEA_RING_GSV;
+    }
+    /* Not used, counted to check receiver output configuration */
+    if (t1 == 'G' && t2 == 'S' && t3 == 'A') {
+        ring->stats.gsa++;
+        return 0;
+    }
+    if (t1 == 'V' && t2 == 'T' && t3 == 'G') {
+        ring->stats.vtg++;
+        return 0;
+    }
+    ring->stats.ignored++;
+    return 0;
+}
+
+time_t NmeaRing_MkTime(int32_t year, int32_t month, int32_t day, int32_t tod)
+{
+    int32_t doy, yoe;
+
+    /* Days from civil, year starts in March */
+    if (month <= 2) {
+        year--;
+    }
+    yoe = year % 400;
+    doy = (153*(month > 2 ? month - 3 : month + 9) + 2)/5 + day - 1;
+    return (time_t)((year/400)*146097 + yoe*365 + yoe/4 - yoe/100 + doy -
+            719468)*86400 + tod;
+}
+
+uint8_t NmeaRing_Process(nmea_ring_t *ring, uint16_t head,
+        gps_info_t *info, gps_sat_t *sat)
+{
+    uint8_t flags = 0;
+    uint8_t c;
+    int8_t hex;
+
+    while (ring->pos != head) {
+        c = ring->buf[ring->pos];
+
+        switch (ring->state) {
+        case NMEA_RING_STATE_IDLE:
+            if (c == '$') {
+                ring->start = ring->pos;
+                ring->sum = 0;
+                ring->len = 1;
+                ring->state = NMEA_RING_STATE_BODY;
+            }
+            break;
+        case NMEA_RING_STATE_BODY:
+            if (c == '*') {
+                ring->state = NMEA_RING_STATE_CS1;
+            } else if (c == '$' || c < ' ' || ++ring->len > NMEA_RING_MAX_LEN) {
+                /* Start of next sentence or garbage, drop current one */
+                ring->stats.errors++;
+                ring->state = NMEA_RING_STATE_IDLE;
+                if (c == '$') {
+                    continue;
+                }
+            } else {
+                ring->sum ^= c;
+            }
+            break;
+        case NMEA_RING_STATE_CS1:
+            hex = NmeaRingi_Hex(c);
+            ring->checksum = hex << 4;
+            ring->state = hex < 0 ? NMEA_RING_STATE_IDLE : NMEA_RING_STATE_CS2;
+            if (hex < 0) {
+                ring->stats.errors++;
+            }
+            break;
+        case NMEA_RING_STATE_CS2:
+            hex = NmeaRingi_Hex(c);
+            ring->state = NMEA_RING_STATE_IDLE;
+            if (hex < 0 || (ring->checksum | hex) != ring->sum) {
+                ring->stats.errors++;
+                break;
+            }
+            flags |= NmeaRingi_Parse(ring, (ring->pos - 2) & ring->mask,
+                    info, sat);
+            if (ring->rmc_tod >= 0 && ring->rmc_tod == ring->gga_tod) {
+                flags |= NMEA_RING_FIX;
+                ring->rmc_tod = -1;
+                ring->gga_tod = -1;
+            }
+            break;
+        }
+
+        ring->pos = (ring->pos + 1) & ring->mask;
+        ring->stats.bytes++;
+    }
+
+    return flags;
+}
+
+uint16_t NmeaRing_Frame(char *buf, const char *body)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    uint8_t sum = 0;
+    uint16_t len = 0;
+
+    buf[len++] = '$';
+    while (*body != '\0') {
+        sum ^= *body;
+        buf[len++] = *body++;
+    }
+    buf[len++] = '*';
+    buf[len++] = hex[sum >> 4];
+    buf[len++] = hex[sum & 0x0f];
+    buf[len++] = '\r';
+    buf[len++] = '\n';
+    buf[len] = '\0';
+    return len;
+}
+
+void NmeaRing_Init(nmea_ring_t *ring, const uint8_t *buf, uint16_t size)
+{
+    memset(ring, 0, sizeof(nmea_ring_t));
+    ring->buf = buf;
+    ring->mask = size - 1;
+    ring->rmc_tod = -1;
+    ring->gga_tod = -1;
+    ring->ack_cmd = -1;
+}
+
+/** @} */
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/gps/nmea_ring.h
+ * @brief   NMEA parser working directly on a circular receive buffer
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#ifndef __APP_GPS_NMEA_RING_H_
+#define __APP_GPS_NMEA_RING_H_
+
+#include <types.h>
+#include "drivers/gps.h"
+
+/** Longest sentence allowed by NMEA 0183 including $ and checksum */
+#define NMEA_RING_MAX_LEN 82
+/** $, checksum and line end */
+#define NMEA_RING_OVERHEAD 6
+
+/** PMTK001 flag values */
+#define NMEA_ACK_INVALID        0   /**< Invalid command */
+#define NMEA_ACK_UNSUPPORTED    1   /**< Unsupported command */
+#define NMEA_ACK_FAILED         2   /**< Valid command, action failed */
+#define NMEA_ACK_SUCCESS        3   /**< Valid command, action succeeded */
+
+/** Flags returned by NmeaRing_Process */
+#define NMEA_RING_RMC   0x01    /**< RMC sentence parsed */
+#define NMEA_RING_GGA   0x02    /**< GGA sentence parsed */
+#define NMEA_RING_GSV   0x04    /**< GSV sentence parsed */
+#define NMEA_RING_ACK   0x08    /**< PMTK001 command acknowledge parsed */
+#define NMEA_RING_FIX   0x80    /**< RMC and GGA of the same epoch parsed */
+
+typedef struct {
+    uint32_t bytes;         /**< Bytes processed */
+    uint32_t rmc;           /**< Amount of RMC sentences parsed */
+    uint32_t gga;           /**< Amount of GGA sentences parsed */
+    uint32_t gsv;           /**< Amount of GSV sentences parsed */
+    uint32_t gsa;           /**< Amount of GSA sentences received */
+    uint32_t vtg;           /**< Amount of VTG sentences received */
+    uint32_t ack;           /**< Amount of PMTK001 sentences parsed */
+    uint32_t ignored;       /**< Valid sentences of other types */
+    uint32_t errors;        /**< Bad checksum or malformed sentences */
+} nmea_ring_stats_t;
+
+typedef struct {
+    const uint8_t *buf;     /**< Ring memory, size must be power of 2 */
+    uint16_t mask;          /**< Size of the ring - 1 */
+    /* internal */
+    uint16_t pos;           /**< Next byte to be scanned */
+    uint16_t start;         /**< Start of currently scanned sentence */
+    uint8_t state;
+    uint8_t sum;            /**< Running checksum of the sentence */
+    uint8_t len;            /**< Length of the sentence scanned so far */
+    uint8_t checksum;       /**< Received checksum */
+    int32_t rmc_tod;        /**< Time of day of last RMC, -1 if none */
+    int32_t gga_tod;        /**< Time of day of last GGA, -1 if none */
+    int16_t ack_cmd;        /**< Command of last PMTK001, -1 if none */
+    uint8_t ack_flag;       /**< Flag of last PMTK001, NMEA_ACK_* */
+    nmea_ring_stats_t stats;
+} nmea_ring_t;
+
+/**
+ * Convert UTC date and time to unix time
+ *
+ * @param year      Full year (e.g. 2020)
+ * @param month     Month 1 to 12
+ * @param day       Day of month 1 to 31
+ * @param tod       Seconds since midnight
+ * @return Unix time
+ */
+extern time_t NmeaRing_MkTime(int32_t year, int32_t month, int32_t day,
+        int32_t tod);
+
+/**
+ * Parse all complete sentences received since last call
+ *
+ * Incomplete sentence at the end stays in the ring until the next call, the
+ * caller must process data before the writer gets back to it.
+ *
+ * @param ring  Ring description
+ * @param head  Index of the next byte to be written by the receiver
+ * @param info  Fix data updated by RMC and GGA
+ * @param sat   Satellite data updated by GSV
+ * @return NMEA_RING_* flags, ack_cmd and ack_flag hold the acknowledge if
+ *      NMEA_RING_ACK is set of parsed sentences
+ */
+extern uint8_t NmeaRing_Process(nmea_ring_t *ring, uint16_t head,
+        gps_info_t *info, gps_sat_t *sat);
+
+/**
+ * Build NMEA sentence, add $, checksum and line end
+ *
+ * @param buf   Target buffer, strlen(body) + NMEA_RING_OVERHEAD + 1 long
+ * @param body  Sentence without $ and checksum
+ * @return Length of the sentence, terminating zero not included
+ */
+extern uint16_t NmeaRing_Frame(char *buf, const char *body);
+
+/**
+ * Initialize parser
+ *
+ * @param ring  Ring description to be initialized
+ * @param buf   Ring memory
+ * @param size  Ring size, must be power of 2
+ */
+extern void NmeaRing_Init(nmea_ring_t *ring, const uint8_t *buf,
+        uint16_t size);
+
+#endif
+
+/** @} */
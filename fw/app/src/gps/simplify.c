@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/gps/simplify.c
+ * @brief   Online track simplification, only shape significant points kept
+ *
+ * Opening window algorithm, points after the last stored one (anchor) are
+ * kept in window as long as all of them are within tolerance from the line
+ * between the anchor and the newest point. Once a point doesn't fit, the
+ * previous point is stored and becomes the new anchor.
+ *
+ * Elevation is interpolated along the line the same way, so climbs on
+ * straight segments are kept. Point is also stored when the newest one is
+ * more than max_interval_s after the anchor, stationary points from the
+ * filter keep the time spent at the stop.
+ *
+ * Only the newest point can be stored, so the window keeps just positions
+ * in mm relative to the anchor, computed on a local flat projection, and
+ * elevation in dm relative to the anchor.
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#include <string.h>
+
+#include "flat.h"
+#include "simplify.h"
+
+static simplify_stats_t simplifyi_stats;
+
+static struct {
+    const simplify_config_t *cfg;
+    uint32_t tolerance_mm;
+    bool anchor_valid;
+    gps_info_t anchor;      /**< Last stored point */
+    flat_origin_t origin;   /**< Projection around anchor */
+    uint8_t count;          /**< Points in window */
+    flat_pos_t window[SIMPLIFY_WINDOW];
+    int32_t alt_dm[SIMPLIFY_WINDOW];    /**< Elevation of window points */
+    gps_info_t last;        /**< Newest point in window */
+} simplifyi;
+
+/**
+ * Set new anchor, point which was just stored
+ */
+static void Simplifyi_Anchor(const gps_info_t *point)
+{
+    memcpy(&simplifyi.anchor, point, sizeof(simplifyi.anchor));
+    Flat_Origin(&simplifyi.origin, Flat_Deg7(&point->lat),
+            Flat_Deg7(&point->lon));
+    simplifyi.anchor_valid = true;
+    simplifyi.count = 0;
+    simplifyi_stats.stored++;
+}
+
+static uint64_t Simplifyi_Sqrt(uint64_t val)
+{
+    uint64_t res = 0;
+    uint64_t bit = (uint64_t) 1 << 62;
+
+    while (bit > val) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (val >= res + bit) {
+            val -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return res;
+}
+
+/**
+ * Check if elevation is within tolerance from the line between anchor and
+ * end, interpolated by the position of the point projected to the segment
+ */
+static bool Simplifyi_FitsAlt(int32_t alt_dm, int32_t end_dm, int64_t dot,
+        int64_t len2)
+{
+    int64_t tol = simplifyi.cfg->vtolerance_m*10;
+    int64_t diff;
+
+    if (dot <= 0 || len2 == 0) {
+        diff = alt_dm;
+    } else if (dot >= len2) {
+        diff = alt_dm - end_dm;
+    } else {
+        /* Scaled by len2 to keep integer math */
+        diff = ((int64_t) alt_dm*len2 - dot*end_dm)/len2;
+    }
+    return diff <= tol && -diff <= tol;
+}
+
+/**
+ * Check if point is within tolerance from segment between anchor and end
+ */
+static bool Simplifyi_Fits(uint8_t index, const flat_pos_t *end,
+        int32_t end_dm)
+{
+    const flat_pos_t *p = &simplifyi.window[index];
+    int64_t tol = simplifyi.tolerance_mm;
+    int64_t dot = (int64_t) p->x*end->x + (int64_t) p->y*end->y;
+    int64_t len2 = (int64_t) end->x*end->x + (int64_t) end->y*end->y;
+    int64_t cross;
+    int64_t dx, dy;
+
+    if (!Simplifyi_FitsAlt(simplifyi.alt_dm[index], end_dm, dot, len2)) {
+        return false;
+    }
+    if (dot <= 0) {
+        /* Behind the anchor */
+        return (int64_t) p->x*p->x + (int64_t) p->y*p->y <= tol*tol;
+    }
+    if (dot >= len2) {
+        /* Beyond the end */
+        dx = p->x - end->x;
+        dy = p->y - end->y;
+        return dx*dx + dy*dy <= tol*tol;
+    }
+
+    cross = (int64_t) end->x*p->y - (int64_t) end->y*p->x;
+    if (cross < 0) {
+        cross = -cross;
+    }
+    return cross <= tol*(int64_t) Simplifyi_Sqrt(len2);
+}
+
+const gps_info_t *Simplify_Process(const gps_info_t *point)
+{
+    flat_pos_t pos;
+    int32_t alt;
+    uint8_t i = 0;
+
+    simplifyi_stats.points++;
+    if (!simplifyi.anchor_valid) {
+        Simplifyi_Anchor(point);
+        return &simplifyi.anchor;
+    }
+
+    pos = Flat_Project(&simplifyi.origin, point);
+    alt = point->altitude_dm - simplifyi.anchor.altitude_dm;
+    if (point->timestamp - simplifyi.anchor.timestamp <=
+            simplifyi.cfg->max_interval_s) {
+        for (i = 0; i < simplifyi.count; i++) {
+            if (!Simplifyi_Fits(i, &pos, alt)) {
+                break;
+            }
+        }
+    }
+
+    if (simplifyi.count == 0 || (i == simplifyi.count &&
+            simplifyi.count < SIMPLIFY_WINDOW)) {
+        simplifyi.window[simplifyi.count] = pos;
+        simplifyi.alt_dm[simplifyi.count++] = alt;
+        memcpy(&simplifyi.last, point, sizeof(simplifyi.last));
+        return NULL;
+    }
+
+    /* Newest point doesn't fit, previous one is needed for the shape */
+    Simplifyi_Anchor(&simplifyi.last);
+    simplifyi.window[simplifyi.count] = Flat_Project(&simplifyi.origin,
+            point);
+    simplifyi.alt_dm[simplifyi.count++] = point->altitude_dm -
+            simplifyi.anchor.altitude_dm;
+    memcpy(&simplifyi.last, point, sizeof(simplifyi.last));
+    return &simplifyi.anchor;
+}
+
+const gps_info_t *Simplify_Flush(void)
+{
+    if (simplifyi.count == 0) {
+        return NULL;
+    }
+    Simplifyi_Anchor(&simplifyi.last);
+    return &simplifyi.anchor;
+}
+
+const simplify_stats_t *Simplify_GetStats(void)
+{
+    return &simplifyi_stats;
+}
+
+void Simplify_Init(const simplify_config_t *config)
+{
+    memset(&simplifyi, 0, sizeof(simplifyi));
+    memset(&simplifyi_stats, 0, sizeof(simplifyi_stats));
+    simplifyi.cfg = config;
+    simplifyi.tolerance_mm = config->tolerance_m*1000;
+}
+
+/** @} */
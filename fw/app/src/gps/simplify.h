@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/gps/simplify.h
+ * @brief   Online track simplification, only shape significant points kept
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#ifndef __APP_GPS_SIMPLIFY_H_
+#define __APP_GPS_SIMPLIFY_H_
+
+#include <types.h>
+#include "drivers/gps.h"
+
+/** Max amount of points waiting for decision */
+#define SIMPLIFY_WINDOW 32
+
+typedef struct {
+    uint16_t tolerance_m;       /**< Max distance of dropped point from track */
+    uint16_t vtolerance_m;      /**< Max elevation error of dropped point */
+    uint32_t max_interval_s;    /**< Max time between stored points */
+} simplify_config_t;
+
+typedef struct {
+    uint32_t points;            /**< Points processed */
+    uint32_t stored;            /**< Points returned for storage */
+} simplify_stats_t;
+
+/**
+ * Add point to the track
+ *
+ * @param point     Point to be added
+ * @return Point to be stored or NULL, valid until next call
+ */
+extern const gps_info_t *Simplify_Process(const gps_info_t *point);
+
+/**
+ * Get the last point waiting for decision, call before shutdown or when
+ * the storage is about to be read, the track continues from it
+ *
+ * @return Point to be stored or NULL if there is none
+ */
+extern const gps_info_t *Simplify_Flush(void);
+
+/**
+ * Get amount of processed and stored points
+ *
+ * @return Statistics
+ */
+extern const simplify_stats_t *Simplify_GetStats(void);
+
+/**
+ * Initialize simplification
+ *
+ * @param config    Configuration, must stay valid
+ */
+extern void Simplify_Init(const simplify_config_t *config);
+
+#endif
+
+/** @} */
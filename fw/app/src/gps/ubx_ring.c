@@ -0,0 +1,314 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/gps/ubx_ring.c
+ * @brief   u-blox UBX protocol parser working on a circular receive buffer
+ *
+ * The scanner computes the checksum of each byte once, valid messages are
+ * then read from fixed payload offsets directly in the ring.
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#include <string.h>
+
+#include "nmea_ring.h"
+#include "ubx_ring.h"
+
+#define UBX_SYNC1 0xb5
+#define UBX_SYNC2 0x62
+
+/** NAV-PVT payload offsets */
+#define UBX_PVT_LEN         92
+#define UBX_PVT_YEAR        4
+#define UBX_PVT_MONTH       6
+#define UBX_PVT_DAY         7
+#define UBX_PVT_HOUR        8
+#define UBX_PVT_MIN         9
+#define UBX_PVT_SEC         10
+#define UBX_PVT_VALID       11
+#define UBX_PVT_FIX_TYPE    20
+#define UBX_PVT_FLAGS       21
+#define UBX_PVT_NUM_SV      23
+#define UBX_PVT_LON         24
+#define UBX_PVT_LAT         28
+#define UBX_PVT_HMSL        36
+#define UBX_PVT_PDOP        76
+
+/** valid field, date and time are valid */
+#define UBX_PVT_VALID_DATETIME  0x03
+/** flags field, fix within limits */
+#define UBX_PVT_FLAGS_FIX_OK    0x01
+#define UBX_PVT_FIX_3D          3
+
+/** NAV-SAT payload offsets */
+#define UBX_SAT_NUM_SVS     5
+#define UBX_SAT_BLOCK       8
+#define UBX_SAT_BLOCK_LEN   12
+#define UBX_SAT_CNO         2
+
+/** Coordinates in NAV-PVT are in 1e-7 deg */
+#define UBX_COORD_SCALE 10000000
+
+typedef enum {
+    UBX_RING_STATE_SYNC1,
+    UBX_RING_STATE_SYNC2,
+    UBX_RING_STATE_CLASS,
+    UBX_RING_STATE_ID,
+    UBX_RING_STATE_LEN1,
+    UBX_RING_STATE_LEN2,
+    UBX_RING_STATE_PAYLOAD,
+    UBX_RING_STATE_CK_A,
+    UBX_RING_STATE_CK_B,
+    UBX_RING_STATE_SKIP,    /**< Skipping message too long for ring */
+} ubx_ring_state_t;
+
+static uint8_t UbxRingi_U1(const ubx_ring_t *ring, uint16_t offset)
+{
+    return ring->buf[(ring->payload + offset) & ring->mask];
+}
+
+static uint16_t UbxRingi_U2(const ubx_ring_t *ring, uint16_t offset)
+{
+    return UbxRingi_U1(ring, offset) | UbxRingi_U1(ring, offset + 1) << 8;
+}
+
+static int32_t UbxRingi_I4(const ubx_ring_t *ring, uint16_t offset)
+{
+    return (int32_t)((uint32_t)UbxRingi_U2(ring, offset) |
+            (uint32_t)UbxRingi_U2(ring, offset + 2) << 16);
+}
+
+/**
+ * Parse NAV-PVT message
+ *
+ * @return True if message contains valid 3D fix
+ */
+static bool UbxRingi_Pvt(ubx_ring_t *ring, gps_info_t *info)
+{
+    uint8_t valid;
+
+    if (ring->len < UBX_PVT_LEN) {
+        ring->stats.errors++;
+        return false;
+    }
+    ring->stats.pvt++;
+
+    valid = UbxRingi_U1(ring, UBX_PVT_VALID);
+    if ((valid & UBX_PVT_VALID_DATETIME) == UBX_PVT_VALID_DATETIME) {
+        info->time = NmeaRing_MkTime(UbxRingi_U2(ring, UBX_PVT_YEAR),
+                UbxRingi_U1(ring, UBX_PVT_MONTH),
+                UbxRingi_U1(ring, UBX_PVT_DAY),
+                UbxRingi_U1(ring, UBX_PVT_HOUR)*3600 +
+                UbxRingi_U1(ring, UBX_PVT_MIN)*60 +
+                UbxRingi_U1(ring, UBX_PVT_SEC));
+    }
+    info->satellites = UbxRingi_U1(ring, UBX_PVT_NUM_SV);
+
+    if (UbxRingi_U1(ring, UBX_PVT_FIX_TYPE) != UBX_PVT_FIX_3D ||
+            !(UbxRingi_U1(ring, UBX_PVT_FLAGS) & UBX_PVT_FLAGS_FIX_OK) ||
+            (valid & UBX_PVT_VALID_DATETIME) != UBX_PVT_VALID_DATETIME) {
+        info->timestamp = 0;
+        info->hdop_dm = 0;
+        return false;
+    }
+
+    info->lat.num = UbxRingi_I4(ring, UBX_PVT_LAT);
+    info->lat.scale = UBX_COORD_SCALE;
+    info->lon.num = UbxRingi_I4(ring, UBX_PVT_LON);
+    info->lon.scale = UBX_COORD_SCALE;
+    /* mm to dm */
+    info->altitude_dm = UbxRingi_I4(ring, UBX_PVT_HMSL)/100;
+    /* No hdop in NAV-PVT, pdop (0.01 units) is used instead */
+    info->hdop_dm = UbxRingi_U2(ring, UBX_PVT_PDOP)/10;
+    info->timestamp = info->time;
+    return true;
+}
+
+static void UbxRingi_Sat(ubx_ring_t *ring, gps_sat_t *sat)
+{
+    const uint8_t max = sizeof(sat->sat)/sizeof(sat->sat[0]);
+    uint8_t num;
+    uint8_t i;
+
+    num = UbxRingi_U1(ring, UBX_SAT_NUM_SVS);
+    if (ring->len < UBX_SAT_BLOCK + num*UBX_SAT_BLOCK_LEN) {
+        ring->stats.errors++;
+        return;
+    }
+    ring->stats.sat++;
+
+    sat->visible = num;
+    for (i = 0; i < num && i < max; i++) {
+        sat->sat[i].snr = UbxRingi_U1(ring,
+                UBX_SAT_BLOCK + i*UBX_SAT_BLOCK_LEN + UBX_SAT_CNO);
+    }
+    sat->count = i;
+}
+
+/**
+ * Parse message validated by scanner
+ *
+ * @return UBX_RING_* flags
+ */
+static uint8_t UbxRingi_Parse(ubx_ring_t *ring, gps_info_t *info,
+        gps_sat_t *sat)
+{
+    if (ring->cls == UBX_CLASS_NAV && ring->id == UBX_NAV_PVT) {
+        if (UbxRingi_Pvt(ring, info)) {
+            return UBX_RING_PVT | UBX_RING_FIX;
+        }
+        return UBX_RING_PVT;
+    }
+    if (ring->cls == UBX_CLASS_NAV && ring->id == UBX_NAV_SAT) {
+        UbxRingi_Sat(ring, sat);
+        return UBX_RING_SAT;
+    }
+    ring->stats.ignored++;
+    return 0;
+}
+
+static void UbxRingi_Checksum(ubx_ring_t *ring, uint8_t c)
+{
+    ring->ck_a += c;
+    ring->ck_b += ring->ck_a;
+}
+
+uint8_t UbxRing_Process(ubx_ring_t *ring, uint16_t head,
+        gps_info_t *info, gps_sat_t *sat)
+{
+    uint8_t flags = 0;
+    uint8_t c;
+
+    while (ring->pos != head) {
+        c = ring->buf[ring->pos];
+
+        switch (ring->state) {
+        case UBX_RING_STATE_SYNC1:
+            if (c == UBX_SYNC1) {
+                ring->state = UBX_RING_STATE_SYNC2;
+            }
+            break;
+        case UBX_RING_STATE_SYNC2:
+            if (c == UBX_SYNC2) {
+                ring->ck_a = 0;
+                ring->ck_b = 0;
+                ring->state = UBX_RING_STATE_CLASS;
+            } else if (c != UBX_SYNC1) {
+                ring->state = UBX_RING_STATE_SYNC1;
+            }
+            break;
+        case UBX_RING_STATE_CLASS:
+            ring->cls = c;
+            UbxRingi_Checksum(ring, c);
+            ring->state = UBX_RING_STATE_ID;
+            break;
+        case UBX_RING_STATE_ID:
+            ring->id = c;
+            UbxRingi_Checksum(ring, c);
+            ring->state = UBX_RING_STATE_LEN1;
+            break;
+        case UBX_RING_STATE_LEN1:
+            ring->len = c;
+            UbxRingi_Checksum(ring, c);
+            ring->state = UBX_RING_STATE_LEN2;
+            break;
+        case UBX_RING_STATE_LEN2:
+            ring->len |= c << 8;
+            UbxRingi_Checksum(ring, c);
+            ring->cnt = 0;
+            ring->payload = (ring->pos + 1) & ring->mask;
+            if (ring->len > ring->mask + 1 - UBX_OVERHEAD) {
+                ring->stats.errors++;
+                ring->state = UBX_RING_STATE_SKIP;
+            } else if (ring->len == 0) {
+                ring->state = UBX_RING_STATE_CK_A;
+            } else {
+                ring->state = UBX_RING_STATE_PAYLOAD;
+            }
+            break;
+        case UBX_RING_STATE_PAYLOAD:
+            UbxRingi_Checksum(ring, c);
+            if (++ring->cnt == ring->len) {
+                ring->state = UBX_RING_STATE_CK_A;
+            }
+            break;
+        case UBX_RING_STATE_CK_A:
+            if (c == ring->ck_a) {
+                ring->state = UBX_RING_STATE_CK_B;
+            } else {
+                ring->stats.errors++;
+                ring->state = UBX_RING_STATE_SYNC1;
+            }
+            break;
+        case UBX_RING_STATE_CK_B:
+            ring->state = UBX_RING_STATE_SYNC1;
+            if (c != ring->ck_b) {
+                ring->stats.errors++;
+                break;
+            }
+            flags |= UbxRingi_Parse(ring, info, sat);
+            break;
+        case UBX_RING_STATE_SKIP:
+            /* Payload and checksum */
+            if (++ring->cnt == ring->len + 2) {
+                ring->state = UBX_RING_STATE_SYNC1;
+            }
+            break;
+        }
+
+        ring->pos = (ring->pos + 1) & ring->mask;
+        ring->stats.bytes++;
+    }
+
+    return flags;
+}
+
+uint16_t UbxRing_Frame(uint8_t *buf, uint8_t cls, uint8_t id,
+        const uint8_t *payload, uint16_t len)
+{
+    uint8_t ck_a = 0;
+    uint8_t ck_b = 0;
+    uint16_t i;
+
+    buf[0] = UBX_SYNC1;
+    buf[1] = UBX_SYNC2;
+    buf[2] = cls;
+    buf[3] = id;
+    buf[4] = len & 0xff;
+    buf[5] = len >> 8;
+    memcpy(&buf[6], payload, len);
+
+    for (i = 2; i < len + 6; i++) {
+        ck_a += buf[i];
+        ck_b += ck_a;
+    }
+    buf[i++] = ck_a;
+    buf[i++] = ck_b;
+    return i;
+}
+
+void UbxRing_Init(ubx_ring_t *ring, const uint8_t *buf, uint16_t size)
+{
+    memset(ring, 0, sizeof(ubx_ring_t));
+    ring->buf = buf;
+    ring->mask = size - 1;
+}
+
+/** @} */
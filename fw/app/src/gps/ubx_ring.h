@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/gps/ubx_ring.h
+ * @brief   u-blox UBX protocol parser working on a circular receive buffer
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#ifndef __APP_GPS_UBX_RING_H_
+#define __APP_GPS_UBX_RING_H_
+
+#include <types.h>
+#include "drivers/gps.h"
+
+#define UBX_CLASS_NAV   0x01
+#define UBX_CLASS_RXM   0x02
+#define UBX_CLASS_CFG   0x06
+#define UBX_CLASS_MGA   0x13
+#define UBX_NAV_PVT     0x07
+#define UBX_NAV_SAT     0x35
+#define UBX_RXM_PMREQ   0x41
+#define UBX_CFG_PRT     0x00
+#define UBX_CFG_MSG     0x01
+#define UBX_CFG_RATE    0x08
+#define UBX_MGA_INI     0x40
+
+/** Sync chars, class, id, length and checksum */
+#define UBX_OVERHEAD    8
+
+/** Flags returned by UbxRing_Process */
+#define UBX_RING_PVT    0x01    /**< NAV-PVT parsed */
+#define UBX_RING_SAT    0x02    /**< NAV-SAT parsed */
+#define UBX_RING_FIX    0x80    /**< NAV-PVT with valid 3D fix parsed */
+
+typedef struct {
+    uint32_t bytes;         /**< Bytes processed */
+    uint32_t pvt;           /**< Amount of NAV-PVT messages parsed */
+    uint32_t sat;           /**< Amount of NAV-SAT messages parsed */
+    uint32_t ignored;       /**< Valid messages of other types */
+    uint32_t errors;        /**< Bad checksum or too long messages */
+} ubx_ring_stats_t;
+
+typedef struct {
+    const uint8_t *buf;     /**< Ring memory, size must be power of 2 */
+    uint16_t mask;          /**< Size of the ring - 1 */
+    /* internal */
+    uint16_t pos;           /**< Next byte to be scanned */
+    uint16_t payload;       /**< Start of the payload of current message */
+    uint8_t state;
+    uint8_t cls;            /**< Class of current message */
+    uint8_t id;             /**< Id of current message */
+    uint16_t len;           /**< Payload length of current message */
+    uint16_t cnt;           /**< Payload bytes scanned so far */
+    uint8_t ck_a;           /**< Running checksum */
+    uint8_t ck_b;
+    ubx_ring_stats_t stats;
+} ubx_ring_t;
+
+/**
+ * Parse all complete messages received since last call
+ *
+ * Messages longer than ring size - UBX_OVERHEAD are skipped. Incomplete
+ * message at the end stays in the ring until the next call, the caller must
+ * process data before the writer gets back to it.
+ *
+ * @param ring  Ring description
+ * @param head  Index of the next byte to be written by the receiver
+ * @param info  Fix data updated by NAV-PVT
+ * @param sat   Satellite data updated by NAV-SAT
+ * @return UBX_RING_* flags of parsed messages
+ */
+extern uint8_t UbxRing_Process(ubx_ring_t *ring, uint16_t head,
+        gps_info_t *info, gps_sat_t *sat);
+
+/**
+ * Build UBX message
+ *
+ * @param buf       Target buffer, len + UBX_OVERHEAD bytes long
+ * @param cls       Message class
+ * @param id        Message id
+ * @param payload   Payload data
+ * @param len       Payload length
+ * @return Size of the message
+ */
+extern uint16_t UbxRing_Frame(uint8_t *buf, uint8_t cls, uint8_t id,
+        const uint8_t *payload, uint16_t len);
+
+/**
+ * Initialize parser
+ *
+ * @param ring  Ring description to be initialized
+ * @param buf   Ring memory
+ * @param size  Ring size, must be power of 2
+ */
+extern void UbxRing_Init(ubx_ring_t *ring, const uint8_t *buf, uint16_t size);
+
+#endif
+
+/** @} */
@@ -46,27 +46,44 @@
 
 #define GPX_FOOTER "    </trkseg>\n  </trk>\n</gpx>"
 
+/** Footer of the file without any track */
+#define GPX_FOOTER_EMPTY "</gpx>"
+
+/**
+ * Last generated item, sequential reads split items between sectors, the
+ * remainder is served from here instead of generating the item again
+ */
+static struct {
+    uint32_t first;     /**< First record of the range */
+    uint32_t count;     /**< Amount of records in range */
+    uint32_t id;        /**< Item id in the file */
+    bool valid;
+    uint8_t buf[GPX_ITEM_SIZE+1];
+} gpxi_last;
+
 /**
  * Generate trk header with constant length equal to GPX_ITEM_SIZE
  *
  * If id item was not found (last item), generate gpx footer
  *
  * @param id    First item of the track id
+ * @param end   Id of the item after the end of generated range
+ * @param close Close previous track before starting new one
  * @param buf   Target buffer to generate data to (length GPX_ITEM_SIZE + 1)
  * @return  False if item of given id not found
  */
-static bool GPXi_GetTrkHeader(uint32_t id, char *buf)
+static bool GPXi_GetTrkHeader(uint32_t id, uint32_t end, bool close, char *buf)
 {
     storage_item_t item;
     struct tm *time;
     time_t timestamp;
     uint32_t len = 0;
 
-    if (Storage_Get(id, &item) == false) {
+    if (id >= end || Storage_Get(id, &item) == false) {
         return false;
     }
 
-    if (id != 0) {
+    if (close) {
         snprintf(buf, GPX_ITEM_SIZE, "    </trkseg>\n  </trk>\n");
         len = strlen(buf);
     }
@@ -93,10 +110,11 @@ static bool GPXi_GetTrkHeader(uint32_t id, char *buf)
  * Generate single track point item of constant length equal to GPX_ITEM_SIZE
  *
  * @param id    Item id
+ * @param end   Id of the item after the end of generated range
  * @param buf   Target buffer to generate data to (length GPX_ITEM_SIZE + 1)
  * @return  False if item of given id not found
  */
-static bool GPXi_GetTrkpt(uint32_t id, char *buf)
+static bool GPXi_GetTrkpt(uint32_t id, uint32_t end, char *buf)
 {
     storage_item_t item;
     struct tm *time;
@@ -105,12 +123,12 @@ static bool GPXi_GetTrkpt(uint32_t id, char *buf)
     int32_t lat_dec, lon_dec;
     uint32_t len;
 
-    if (Storage_Get(id, &item) == false) {
+    if (id >= end || Storage_Get(id, &item) == false) {
         return false;
     }
 
     if (Storage_IsEOL(&item)) {
-        return GPXi_GetTrkHeader(id + 1, buf);
+        return GPXi_GetTrkHeader(id + 1, end, true, buf);
     }
 
     lat_deg = item.lat / item.lat_scale;
@@ -157,17 +175,16 @@ static bool GPXi_GetTrkpt(uint32_t id, char *buf)
     return true;
 }
 
-/**
- * Get size of the GPX file
- *
- * @return  Size of the file in bytes
- */
-uint32_t GPX_GetSize(void)
+uint32_t GPX_GetRangeSize(uint32_t first, uint32_t count)
 {
-    uint32_t items = Storage_SpaceUsed();
+    uint32_t items = count;
     storage_item_t item;
 
-    Storage_Get(items-1, &item);
+    if (count == 0) {
+        return strlen(GPX_HEADER) + strlen(GPX_FOOTER_EMPTY);
+    }
+
+    Storage_Get(first + count - 1, &item);
     if (!Storage_IsEOL(&item)) {
         items += 1;
     }
@@ -175,23 +192,21 @@ uint32_t GPX_GetSize(void)
     return strlen(GPX_HEADER)+items*GPX_ITEM_SIZE + strlen(GPX_FOOTER);
 }
 
-/**
- * Read logged data and generate gpx file on the fly
- *
- * @param offset        Offset to the file
- * @param buf           Buffer to store data to
- * @param len           Amount of bytes to store
- * @return  true if succeeded
- */
-bool GPX_Get(uint32_t offset, uint8_t *buf, uint32_t len)
+bool GPX_GetRange(uint32_t first, uint32_t count, uint32_t offset,
+        uint8_t *buf, uint32_t len)
 {
     char *header = GPX_HEADER;
     uint32_t header_len;
+    uint32_t item_len;
     uint32_t bytes;
     uint32_t id;
-    uint8_t itembuf[GPX_ITEM_SIZE+1];
+    uint8_t *itembuf = gpxi_last.buf;
+    bool footer = false;
+    bool cached = gpxi_last.valid && gpxi_last.first == first &&
+            gpxi_last.count == count;
 
     header_len = strlen(GPX_HEADER);
+    gpxi_last.valid = false;
 
     if (offset < header_len) {
         if (offset + len > header_len) {
@@ -217,18 +232,39 @@ bool GPX_Get(uint32_t offset, uint8_t *buf, uint32_t len)
     offset %= GPX_ITEM_SIZE;
 
     while (len != 0) {
-        bytes = GPX_ITEM_SIZE - offset;
+        item_len = GPX_ITEM_SIZE;
+        if (cached && id == gpxi_last.id) {
+            /* Remainder of the item generated by previous read */
+        } else if (count == 0) {
+            strcpy((char *) itembuf, GPX_FOOTER_EMPTY);
+            item_len = strlen(GPX_FOOTER_EMPTY);
+            footer = true;
+        } else if (id == 0) {
+            GPXi_GetTrkHeader(first, first + count, false, (char *) itembuf);
+        } else if (id - 1 >= count) {
+            strcpy((char *) itembuf, GPX_FOOTER);
+            item_len = strlen(GPX_FOOTER);
+            footer = true;
+        } else if (GPXi_GetTrkpt(first + id - 1, first + count,
+                    (char *) itembuf) == false) {
+            /* End of log mark at the end of range takes no space in file */
+            cached = false;
+            id++;
+            continue;
+        }
+        cached = false;
+
+        if (offset >= item_len) {
+            break;
+        }
+        bytes = item_len - offset;
         if (bytes > len) {
             bytes = len;
-        }
-        if (id == 0) {
-            GPXi_GetTrkHeader(0, (char *) itembuf);
-        } else if (id - 1 == Storage_SpaceUsed()) {
-            strcpy((char *) buf, GPX_FOOTER);
-            return true;
-        } else {
-            if (GPXi_GetTrkpt(id - 1, (char *) itembuf) == false) {
-                bytes = 0;
+            if (!footer) {
+                gpxi_last.first = first;
+                gpxi_last.count = count;
+                gpxi_last.id = id;
+                gpxi_last.valid = true;
             }
         }
         memcpy(buf, &itembuf[offset], bytes);
@@ -236,9 +272,24 @@ bool GPX_Get(uint32_t offset, uint8_t *buf, uint32_t len)
         len -= bytes;
         buf += bytes;
         id++;
+        if (footer) {
+            break;
+        }
     }
 
+    /* Reading past the end of file, fill the rest with zeros */
+    memset(buf, 0x00, len);
     return true;
 }
 
+uint32_t GPX_GetSize(void)
+{
+    return GPX_GetRangeSize(0, Storage_SpaceUsed());
+}
+
+bool GPX_Get(uint32_t offset, uint8_t *buf, uint32_t len)
+{
+    return GPX_GetRange(0, Storage_SpaceUsed(), offset, buf, len);
+}
+
 /** @} */
@@ -29,14 +29,44 @@
 #include <types.h>
 
 /**
- * Get size of gpx file
+ * Get size of gpx file containing all records
  *
  * @return Size in bytes
  */
 extern uint32_t GPX_GetSize(void);
 
+/**
+ * Read gpx file containing all records, generated on the fly
+ *
+ * @param offset        Offset to the file
+ * @param buf           Buffer to store data to
+ * @param len           Amount of bytes to store
+ * @return  true if succeeded
+ */
 extern bool GPX_Get(uint32_t offset, uint8_t *buf, uint32_t len);
 
+/**
+ * Get size of gpx file containing only given range of records
+ *
+ * @param first         Id of the first record
+ * @param count         Amount of records
+ * @return Size in bytes
+ */
+extern uint32_t GPX_GetRangeSize(uint32_t first, uint32_t count);
+
+/**
+ * Read gpx file containing only given range of records
+ *
+ * @param first         Id of the first record
+ * @param count         Amount of records
+ * @param offset        Offset to the file
+ * @param buf           Buffer to store data to
+ * @param len           Amount of bytes to store
+ * @return  true if succeeded
+ */
+extern bool GPX_GetRange(uint32_t first, uint32_t count, uint32_t offset,
+        uint8_t *buf, uint32_t len);
+
 #endif
 
 /** @} */
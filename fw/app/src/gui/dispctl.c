@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/gui/dispctl.c
+ * @brief   Display power control, display is switched off after inactivity
+ *
+ * The display is switched off (panel and charge pump) when no button was
+ * pressed for the timeout and switched on again by the next press, which is
+ * consumed by the wake up. Display RAM is kept in sleep, content shown before
+ * switch off appears again. Time spent in each state is accounted to get the
+ * charge saved compared to display always on.
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#include <string.h>
+
+#include "dispctl.h"
+
+static const dispctl_config_t *dispctli_cfg;
+static dispctl_power_cb_t dispctli_power;
+static dispctl_stats_t dispctli_stats;
+
+static struct {
+    bool on;                /**< Display switched on */
+    uint32_t timeout_s;     /**< Inactivity timeout, 0 for never */
+    uint32_t activity_at;   /**< Time of last user activity */
+    uint32_t account_at;    /**< Time accounted to stats */
+    uint32_t on_ms;         /**< On time not yet added to stats */
+    uint32_t off_ms;        /**< Off time not yet added to stats */
+} dispctli;
+
+/**
+ * Add time since last accounting to the current state
+ */
+static void DispCtli_Account(uint32_t now_ms)
+{
+    uint32_t charge_ua;
+
+    if (dispctli.on) {
+        dispctli.on_ms += now_ms - dispctli.account_at;
+    } else {
+        dispctli.off_ms += now_ms - dispctli.account_at;
+    }
+    dispctli.account_at = now_ms;
+
+    dispctli_stats.on_s += dispctli.on_ms/1000;
+    dispctli.on_ms %= 1000;
+    dispctli_stats.off_s += dispctli.off_ms/1000;
+    dispctli.off_ms %= 1000;
+
+    charge_ua = dispctli_cfg->on_ua > dispctli_cfg->off_ua ?
+            dispctli_cfg->on_ua - dispctli_cfg->off_ua : 0;
+    dispctli_stats.saved_uah =
+            (uint64_t)dispctli_stats.off_s*charge_ua/3600;
+}
+
+static void DispCtli_Power(bool on, uint32_t now_ms)
+{
+    DispCtli_Account(now_ms);
+    dispctli.on = on;
+    dispctli_power(on);
+}
+
+bool DispCtl_Activity(uint32_t now_ms)
+{
+    dispctli.activity_at = now_ms;
+    if (dispctli.on) {
+        return false;
+    }
+    dispctli_stats.wakeups++;
+    DispCtli_Power(true, now_ms);
+    return true;
+}
+
+uint32_t DispCtl_Process(uint32_t now_ms)
+{
+    uint32_t timeout_ms = dispctli.timeout_s*1000;
+    uint32_t idle_ms = now_ms - dispctli.activity_at;
+
+    DispCtli_Account(now_ms);
+    if (!dispctli.on || dispctli.timeout_s == 0) {
+        return 0;
+    }
+    if (idle_ms < timeout_ms) {
+        return timeout_ms - idle_ms;
+    }
+    dispctli_stats.offs++;
+    DispCtli_Power(false, now_ms);
+    return 0;
+}
+
+bool DispCtl_IsOn(void)
+{
+    return dispctli.on;
+}
+
+void DispCtl_SetTimeout(uint32_t timeout_s)
+{
+    dispctli.timeout_s = timeout_s;
+}
+
+uint32_t DispCtl_GetTimeout(void)
+{
+    return dispctli.timeout_s;
+}
+
+const dispctl_stats_t *DispCtl_GetStats(void)
+{
+    return &dispctli_stats;
+}
+
+void DispCtl_Init(const dispctl_config_t *config,
+        dispctl_power_cb_t power_cb, uint32_t now_ms)
+{
+    memset(&dispctli, 0, sizeof(dispctli));
+    memset(&dispctli_stats, 0, sizeof(dispctli_stats));
+    dispctli_cfg = config;
+    dispctli_power = power_cb;
+    dispctli.on = true;
+    dispctli.timeout_s = config->timeout_s;
+    dispctli.activity_at = now_ms;
+    dispctli.account_at = now_ms;
+}
+
+/** @} */
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/gui/dispctl.h
+ * @brief   Display power control, display is switched off after inactivity
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#ifndef __APP_GUI_DISPCTL_H_
+#define __APP_GUI_DISPCTL_H_
+
+#include <types.h>
+
+typedef struct {
+    uint32_t timeout_s;         /**< Inactivity before switch off, 0 never */
+    uint16_t on_ua;             /**< Display current when on */
+    uint16_t off_ua;            /**< Display current in sleep */
+} dispctl_config_t;
+
+typedef struct {
+    uint32_t on_s;              /**< Total time the display was on */
+    uint32_t off_s;             /**< Total time the display was off */
+    uint32_t offs;              /**< Amount of switch offs on inactivity */
+    uint32_t wakeups;           /**< Amount of switch ons by activity */
+    uint32_t saved_uah;         /**< Charge saved by being switched off */
+} dispctl_stats_t;
+
+/**
+ * Switch the display on or off
+ *
+ * @param on    True to switch on
+ */
+typedef void (*dispctl_power_cb_t)(bool on);
+
+/**
+ * User activity (button press), switch the display on if off
+ *
+ * @param now_ms    Current time in ms
+ * @return True if the display was off, activity should not be processed
+ *      further
+ */
+extern bool DispCtl_Activity(uint32_t now_ms);
+
+/**
+ * Switch the display off after timeout
+ *
+ * @param now_ms    Current time in ms
+ * @return Time in ms until the switch off is due, 0 if not planned
+ */
+extern uint32_t DispCtl_Process(uint32_t now_ms);
+
+/**
+ * Check if the display is on
+ *
+ * @return True if on
+ */
+extern bool DispCtl_IsOn(void);
+
+/**
+ * Set inactivity timeout, the inactivity time is not restarted
+ *
+ * @param timeout_s     Timeout in seconds, 0 to keep the display on
+ */
+extern void DispCtl_SetTimeout(uint32_t timeout_s);
+
+/**
+ * Get inactivity timeout
+ *
+ * @return Timeout in seconds, 0 if display is kept on
+ */
+extern uint32_t DispCtl_GetTimeout(void);
+
+/**
+ * Get display power statistics, times are updated by DispCtl_Process
+ *
+ * @return Statistics
+ */
+extern const dispctl_stats_t *DispCtl_GetStats(void);
+
+/**
+ * Initialize display power control, display is expected to be on
+ *
+ * @param config    Configuration, must be valid while used
+ * @param power_cb  Display power control
+ * @param now_ms    Current time in ms
+ */
+extern void DispCtl_Init(const dispctl_config_t *config,
+        dispctl_power_cb_t power_cb, uint32_t now_ms);
+
+#endif
+
+/** @} */
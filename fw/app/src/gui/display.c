@@ -0,0 +1,424 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file    app/gui/display.c
+ * @brief   Display framebuffer, only changed regions are sent to display
+ *
+ * Framebuffer has the SSD1306 RAM layout, each byte is a column of 8 rows
+ * (page). Drawing marks changed column range of each page as dirty. Flush
+ * compares dirty ranges with a copy of what was sent last time and sends
+ * only columns which differ, using the controller column and page address
+ * window. Clearing the screen and drawing the same content again costs no
+ * I2C traffic.
+ *
+ * Transfers run in background by I2C DMA. Flush copies changed columns to
+ * the shadow and sends them from there, so drawing of the next frame can
+ * continue in the framebuffer meanwhile. Flush requested while sending is
+ * postponed until the transfer ends.
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#include <string.h>
+#include <hal/i2c.h>
+
+#include "i2c_dma.h"
+#include "display.h"
+
+/** I2C control byte followed by commands */
+#define DISPLAY_CTRL_CMD 0x00
+/** I2C control byte followed by RAM data */
+#define DISPLAY_CTRL_DATA 0x40
+#define DISPLAY_CMD_ADDR_MODE 0x20
+#define DISPLAY_ADDR_MODE_HORIZONTAL 0x00
+#define DISPLAY_CMD_COLUMNS 0x21
+#define DISPLAY_CMD_PAGES 0x22
+#define DISPLAY_CMD_CHARGE_PUMP 0x8d
+#define DISPLAY_CHARGE_PUMP_OFF 0x10
+#define DISPLAY_CHARGE_PUMP_ON 0x14
+#define DISPLAY_CMD_OFF 0xae
+#define DISPLAY_CMD_ON 0xaf
+
+static display_stats_t displayi_stats;
+
+static struct {
+    const ssd1306_desc_t *desc;
+    uint8_t *fbuf;
+    display_cb_t idle_cb;
+    bool valid;                         /**< Shadow matches display RAM */
+    uint8_t dirty_min[DISPLAY_PAGES];   /**< First changed column */
+    uint8_t dirty_max[DISPLAY_PAGES];   /**< Last changed column */
+    uint8_t shadow[SSD1306_FBUF_SIZE];  /**< Content of display RAM */
+    /* Transfer running in background */
+    volatile bool busy;
+    volatile bool pending;              /**< Flush requested while busy */
+    uint8_t send_min[DISPLAY_PAGES];    /**< Columns to be sent from shadow */
+    uint8_t send_max[DISPLAY_PAGES];
+    uint8_t page;                       /**< Page being sent */
+    bool data;                          /**< Window set, data go next */
+    uint8_t cmd[6];
+} displayi;
+
+static void Displayi_Clean(void)
+{
+    memset(displayi.dirty_min, 0xff, sizeof(displayi.dirty_min));
+    memset(displayi.dirty_max, 0x00, sizeof(displayi.dirty_max));
+}
+
+static void Displayi_Done(bool ok);
+
+/**
+ * Send next part of the shadow, called from interrupt after each transfer
+ */
+static void Displayi_Next(void)
+{
+    uint8_t page = displayi.page;
+    uint8_t start, end;
+    const uint8_t *data;
+    uint8_t ctrl;
+    size_t len;
+
+    while (page < DISPLAY_PAGES &&
+            displayi.send_min[page] > displayi.send_max[page]) {
+        page++;
+    }
+    displayi.page = page;
+    if (page == DISPLAY_PAGES) {
+        displayi.busy = false;
+        if (displayi.pending && displayi.idle_cb != NULL) {
+            displayi.idle_cb();
+        }
+        return;
+    }
+
+    start = displayi.send_min[page];
+    end = displayi.send_max[page];
+    if (!displayi.data) {
+        displayi.cmd[0] = DISPLAY_CMD_COLUMNS;
+        displayi.cmd[1] = start;
+        displayi.cmd[2] = end;
+        displayi.cmd[3] = DISPLAY_CMD_PAGES;
+        displayi.cmd[4] = page;
+        displayi.cmd[5] = page;
+        ctrl = DISPLAY_CTRL_CMD;
+        data = displayi.cmd;
+        len = sizeof(displayi.cmd);
+    } else {
+        ctrl = DISPLAY_CTRL_DATA;
+        data = &displayi.shadow[page*SSD1306_WIDTH + start];
+        len = end - start + 1;
+        displayi.send_min[page] = 0xff;
+        displayi.send_max[page] = 0;
+    }
+    displayi.data = !displayi.data;
+
+    displayi_stats.transfers++;
+    displayi_stats.bytes += len + 1;
+    if (!I2cDma_Write(displayi.desc->address, ctrl, data, len,
+                Displayi_Done)) {
+        Displayi_Done(false);
+    }
+}
+
+/**
+ * Transfer finished, on error the display content is unknown
+ */
+static void Displayi_Done(bool ok)
+{
+    if (!ok) {
+        displayi.valid = false;
+        displayi.busy = false;
+        return;
+    }
+    Displayi_Next();
+}
+
+/**
+ * Copy columns from start to end (including) of given page to shadow and
+ * queue them for sending
+ */
+static void Displayi_Queue(uint8_t page, uint8_t start, uint8_t end)
+{
+    uint16_t offset = page*SSD1306_WIDTH + start;
+
+    memcpy(&displayi.shadow[offset], &displayi.fbuf[offset], end - start + 1);
+    displayi.send_min[page] = start;
+    displayi.send_max[page] = end;
+}
+
+/**
+ * Write bits selected by mask to framebuffer byte
+ *
+ * @return True if the byte changed
+ */
+static bool Displayi_Write(uint8_t *byte, uint8_t bits, uint8_t mask)
+{
+    uint8_t val = (*byte & ~mask) | (bits & mask);
+
+    if (val == *byte) {
+        return false;
+    }
+    *byte = val;
+    return true;
+}
+
+static void Displayi_Dirty(uint8_t page, uint8_t start, uint8_t end)
+{
+    if (start < displayi.dirty_min[page]) {
+        displayi.dirty_min[page] = start;
+    }
+    if (end > displayi.dirty_max[page]) {
+        displayi.dirty_max[page] = end;
+    }
+}
+
+void Display_DrawPixel(uint16_t x, uint16_t y, bool value)
+{
+    uint8_t page = y/8;
+
+    if (displayi.fbuf == NULL || x >= SSD1306_WIDTH || y >= SSD1306_HEIGHT) {
+        return;
+    }
+    if (Displayi_Write(&displayi.fbuf[page*SSD1306_WIDTH + x],
+                value ? 0xff : 0x00, 1 << (y % 8))) {
+        Displayi_Dirty(page, x, x);
+    }
+}
+
+void Display_Fill(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2,
+        bool value)
+{
+    uint8_t *row;
+    uint8_t mask;
+    uint8_t start, end;
+    uint8_t bits = value ? 0xff : 0x00;
+
+    if (displayi.fbuf == NULL || x1 > x2 || y1 > y2 ||
+            x1 >= SSD1306_WIDTH || y1 >= SSD1306_HEIGHT) {
+        return;
+    }
+    if (x2 >= SSD1306_WIDTH) {
+        x2 = SSD1306_WIDTH - 1;
+    }
+    if (y2 >= SSD1306_HEIGHT) {
+        y2 = SSD1306_HEIGHT - 1;
+    }
+
+    for (uint8_t page = y1/8; page <= y2/8; page++) {
+        mask = 0xff;
+        if (page == y1/8) {
+            mask &= 0xff << (y1 % 8);
+        }
+        if (page == y2/8) {
+            mask &= 0xff >> (7 - y2 % 8);
+        }
+
+        row = &displayi.fbuf[page*SSD1306_WIDTH];
+        start = 0xff;
+        end = 0;
+        for (uint16_t x = x1; x <= x2; x++) {
+            if (Displayi_Write(&row[x], bits, mask)) {
+                start = start > x ? x : start;
+                end = x;
+            }
+        }
+        if (start <= end) {
+            Displayi_Dirty(page, start, end);
+        }
+    }
+}
+
+void Display_Blit(uint16_t x, uint16_t y, const uint8_t *data, uint16_t width,
+        uint8_t height)
+{
+    uint8_t page = y/8;
+    uint8_t shift = y % 8;
+    uint16_t mask = ((1U << height) - 1) << shift;
+    bool second = (mask >> 8) != 0 && page + 1 < DISPLAY_PAGES;
+    uint8_t *row;
+    uint8_t start = 0xff, end = 0;
+    uint8_t start2 = 0xff, end2 = 0;
+    uint16_t bits;
+
+    if (displayi.fbuf == NULL || x >= SSD1306_WIDTH || y >= SSD1306_HEIGHT) {
+        return;
+    }
+    if (x + width > SSD1306_WIDTH) {
+        width = SSD1306_WIDTH - x;
+    }
+    row = &displayi.fbuf[page*SSD1306_WIDTH];
+
+    /* Fonts are stored in the RAM layout, aligned glyphs are just copied */
+    if (shift == 0 && height == 8) {
+        if (memcmp(&row[x], data, width) != 0) {
+            memcpy(&row[x], data, width);
+            Displayi_Dirty(page, x, x + width - 1);
+        }
+        return;
+    }
+
+    /* Unaligned rows are split to two pages */
+    for (uint16_t i = 0; i < width; i++, x++) {
+        bits = data[i] << shift;
+        if (Displayi_Write(&row[x], bits, mask)) {
+            start = start > x ? x : start;
+            end = x;
+        }
+        if (second && Displayi_Write(&row[x + SSD1306_WIDTH], bits >> 8,
+                    mask >> 8)) {
+            start2 = start2 > x ? x : start2;
+            end2 = x;
+        }
+    }
+    if (start <= end) {
+        Displayi_Dirty(page, start, end);
+    }
+    if (start2 <= end2) {
+        Displayi_Dirty(page + 1, start2, end2);
+    }
+}
+
+void Display_Flush(void)
+{
+    uint8_t start, end;
+    const uint8_t *fbuf;
+    const uint8_t *shadow;
+    bool queued = false;
+
+    if (displayi.desc == NULL) {
+        return;
+    }
+    displayi_stats.flushes++;
+
+    /* Shadow is being sent, flush again once done */
+    displayi.pending = true;
+    if (displayi.busy) {
+        return;
+    }
+    displayi.pending = false;
+
+    for (uint8_t page = 0; page < DISPLAY_PAGES; page++) {
+        if (!displayi.valid) {
+            Displayi_Queue(page, 0, SSD1306_WIDTH - 1);
+            queued = true;
+            continue;
+        }
+        start = displayi.dirty_min[page];
+        end = displayi.dirty_max[page];
+        if (start > end) {
+            continue;
+        }
+
+        /* Region could be drawn over with the same content */
+        fbuf = &displayi.fbuf[page*SSD1306_WIDTH];
+        shadow = &displayi.shadow[page*SSD1306_WIDTH];
+        while (start <= end && fbuf[start] == shadow[start]) {
+            start++;
+        }
+        while (end > start && fbuf[end] == shadow[end]) {
+            end--;
+        }
+        if (start <= end) {
+            Displayi_Queue(page, start, end);
+            queued = true;
+        }
+    }
+
+    displayi.valid = true;
+    Displayi_Clean();
+
+    if (queued) {
+        displayi.busy = true;
+        displayi.page = 0;
+        displayi.data = false;
+        Displayi_Next();
+    }
+}
+
+void Display_Process(void)
+{
+    if (displayi.pending) {
+        Display_Flush();
+    }
+}
+
+bool Display_Busy(void)
+{
+    return displayi.busy;
+}
+
+void Display_Invalidate(void)
+{
+    displayi.valid = false;
+}
+
+void Display_Power(bool on)
+{
+    const uint8_t cmd_off[] = {
+        DISPLAY_CTRL_CMD,
+        DISPLAY_CMD_OFF,
+        DISPLAY_CMD_CHARGE_PUMP, DISPLAY_CHARGE_PUMP_OFF,
+    };
+    const uint8_t cmd_on[] = {
+        DISPLAY_CTRL_CMD,
+        DISPLAY_CMD_CHARGE_PUMP, DISPLAY_CHARGE_PUMP_ON,
+        DISPLAY_CMD_ON,
+    };
+
+    if (displayi.desc == NULL) {
+        return;
+    }
+
+    /* Window commands of the running transfer must not be interleaved */
+    I2cDma_Wait();
+    I2Cd_Transceive(displayi.desc->device, displayi.desc->address,
+            on ? cmd_on : cmd_off, sizeof(cmd_on), NULL, 0);
+    displayi_stats.transfers++;
+    displayi_stats.bytes += sizeof(cmd_on);
+}
+
+const display_stats_t *Display_GetStats(void)
+{
+    return &displayi_stats;
+}
+
+void Display_Init(const ssd1306_desc_t *desc, uint8_t *fbuf,
+        display_cb_t idle_cb)
+{
+    const uint8_t cmd[] = {
+        DISPLAY_CTRL_CMD,
+        DISPLAY_CMD_ADDR_MODE, DISPLAY_ADDR_MODE_HORIZONTAL,
+    };
+
+    memset(&displayi, 0, sizeof(displayi));
+    memset(&displayi_stats, 0, sizeof(displayi_stats));
+    displayi.desc = desc;
+    displayi.fbuf = fbuf;
+    displayi.idle_cb = idle_cb;
+    Displayi_Clean();
+    memset(displayi.send_min, 0xff, sizeof(displayi.send_min));
+
+    /* Column and page window is used only in horizontal mode */
+    I2Cd_Transceive(desc->device, desc->address, cmd, sizeof(cmd), NULL, 0);
+    displayi_stats.transfers++;
+    displayi_stats.bytes += sizeof(cmd);
+}
+
+/** @} */
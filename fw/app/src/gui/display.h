@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file    app/gui/display.h
+ * @brief   Display framebuffer, only changed regions are sent to display
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#ifndef __APP_GUI_DISPLAY_H_
+#define __APP_GUI_DISPLAY_H_
+
+#include <types.h>
+#include "drivers/ssd1306.h"
+
+/** Amount of 8 row pages of the display */
+#define DISPLAY_PAGES (SSD1306_HEIGHT/8)
+
+typedef struct {
+    uint32_t flushes;           /**< Flush requests */
+    uint32_t transfers;         /**< I2C transfers done */
+    uint32_t bytes;             /**< Bytes sent over I2C */
+} display_stats_t;
+
+/** Display ready to send postponed flush, called from interrupt */
+typedef void (*display_cb_t)(void);
+
+/**
+ * Set pixel in the framebuffer
+ *
+ * @param x     Column
+ * @param y     Row
+ * @param value True for pixel on
+ */
+extern void Display_DrawPixel(uint16_t x, uint16_t y, bool value);
+
+/**
+ * Set or clear rectangle in the framebuffer, corners are included
+ *
+ * @param x1    Left column
+ * @param y1    Top row
+ * @param x2    Right column
+ * @param y2    Bottom row
+ * @param value True for pixels on
+ */
+extern void Display_Fill(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2,
+        bool value);
+
+/**
+ * Copy columns of up to 8 pixels to the framebuffer, any row alignment, full
+ * bytes at page aligned rows are copied directly
+ *
+ * @param x         Left column
+ * @param y         Top row
+ * @param data      Column bytes, LSB is the top row
+ * @param width     Amount of columns
+ * @param height    Amount of rows in each byte, 1 to 8
+ */
+extern void Display_Blit(uint16_t x, uint16_t y, const uint8_t *data,
+        uint16_t width, uint8_t height);
+
+/**
+ * Start sending changed parts of the framebuffer to the display, the
+ * framebuffer can be drawn to again right away
+ *
+ * If the previous flush is still being sent, this one is postponed until
+ * Display_Process is called after idle callback.
+ */
+extern void Display_Flush(void);
+
+/**
+ * Run postponed flush, call after idle callback
+ */
+extern void Display_Process(void);
+
+/**
+ * Check if the display transfer is running
+ */
+extern bool Display_Busy(void);
+
+/**
+ * Display content is unknown (e.g. after power up), send whole framebuffer
+ * on next flush
+ */
+extern void Display_Invalidate(void);
+
+/**
+ * Switch the display panel and its charge pump on or off, display RAM is
+ * kept and can be drawn to while off, waits for running transfer
+ *
+ * @param on    True to switch on
+ */
+extern void Display_Power(bool on);
+
+/**
+ * Get flush statistics
+ *
+ * @return Statistics
+ */
+extern const display_stats_t *Display_GetStats(void);
+
+/**
+ * Initialize framebuffer handling, display has to be initialized already
+ *
+ * @param desc      Display driver descriptor
+ * @param fbuf      Framebuffer given to the display driver
+ * @param idle_cb   Called when postponed flush can be sent, can be NULL
+ */
+extern void Display_Init(const ssd1306_desc_t *desc, uint8_t *fbuf,
+        display_cb_t idle_cb);
+
+#endif
+
+/** @} */
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file    app/gui/gfx.c
+ * @brief   Drawing primitives and text on top of display backend
+ *
+ * Boxes, horizontal and vertical lines go to the backend as fills, glyphs
+ * are copied as column bytes. If the backend lacks those, pixel callback
+ * is used instead, with exactly the same result.
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gfx.h"
+
+static struct {
+    const gfx_backend_t *backend;
+    const gfx_font_t *font;
+    uint16_t width;
+    uint16_t height;
+} gfxi;
+
+static void Gfxi_Fill(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2,
+        bool value)
+{
+    if (gfxi.backend->fill != NULL) {
+        gfxi.backend->fill(x1, y1, x2, y2, value);
+        return;
+    }
+
+    for (uint16_t y = y1; y <= y2 && y < gfxi.height; y++) {
+        for (uint16_t x = x1; x <= x2 && x < gfxi.width; x++) {
+            gfxi.backend->pixel(x, y, value);
+        }
+    }
+}
+
+static void Gfxi_Blit(uint16_t x, uint16_t y, const uint8_t *data,
+        uint16_t width, uint8_t height)
+{
+    if (gfxi.backend->blit != NULL) {
+        gfxi.backend->blit(x, y, data, width, height);
+        return;
+    }
+
+    for (uint16_t i = 0; i < width && x + i < gfxi.width; i++) {
+        for (uint8_t row = 0; row < height && y + row < gfxi.height; row++) {
+            gfxi.backend->pixel(x + i, y + row, data[i] & (1 << row));
+        }
+    }
+}
+
+uint16_t Gfx_GetWidth(void)
+{
+    return gfxi.width;
+}
+
+uint16_t Gfx_GetHeight(void)
+{
+    return gfxi.height;
+}
+
+uint16_t Gfx_GetFontWidth(void)
+{
+    return gfxi.font->width;
+}
+
+uint16_t Gfx_GetFontHeight(void)
+{
+    return gfxi.font->height;
+}
+
+void Gfx_FillScreen(bool value)
+{
+    Gfxi_Fill(0, 0, gfxi.width - 1, gfxi.height - 1, value);
+}
+
+void Gfx_DrawPixel(uint16_t x, uint16_t y, bool value)
+{
+    if (x < gfxi.width && y < gfxi.height) {
+        gfxi.backend->pixel(x, y, value);
+    }
+}
+
+void Gfx_DrawLine(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2)
+{
+    int16_t dx = abs(x2 - x1);
+    int16_t dy = -abs(y2 - y1);
+    int8_t sx = x1 < x2 ? 1 : -1;
+    int8_t sy = y1 < y2 ? 1 : -1;
+    int16_t err = dx + dy;
+    int16_t e2;
+
+    if (y1 == y2 || x1 == x2) {
+        Gfxi_Fill(x1 < x2 ? x1 : x2, y1 < y2 ? y1 : y2,
+                x1 < x2 ? x2 : x1, y1 < y2 ? y2 : y1, true);
+        return;
+    }
+
+    /* Bresenham */
+    while (true) {
+        Gfx_DrawPixel(x1, y1, true);
+        if (x1 == x2 && y1 == y2) {
+            break;
+        }
+        e2 = 2*err;
+        if (e2 >= dy) {
+            err += dy;
+            x1 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y1 += sy;
+        }
+    }
+}
+
+void Gfx_DrawFilledBox(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2,
+        bool value)
+{
+    Gfxi_Fill(x1, y1, x2, y2, value);
+}
+
+void Gfx_Putc(uint16_t x, uint16_t y, char c)
+{
+    const gfx_font_t *font = gfxi.font;
+    uint8_t pages = (font->height + 7)/8;
+    const uint8_t *glyph;
+    uint8_t rows;
+
+    if (c < font->first || c > font->last) {
+        c = '?';
+    }
+    glyph = &font->data[(c - font->first)*font->width*pages];
+
+    for (uint8_t page = 0; page < pages; page++) {
+        rows = font->height - page*8;
+        Gfxi_Blit(x, y + page*8, &glyph[page*font->width], font->width,
+                rows > 8 ? 8 : rows);
+    }
+}
+
+void Gfx_Puts(uint16_t x, uint16_t y, const char *str)
+{
+    uint16_t start = x;
+
+    while (*str != '\0') {
+        if (*str == '\n') {
+            x = start;
+            y += gfxi.font->height;
+        } else {
+            Gfx_Putc(x, y, *str);
+            x += gfxi.font->width;
+        }
+        str++;
+    }
+}
+
+void Gfx_Printf(uint16_t x, uint16_t y, const char *format, ...)
+{
+    char buf[GFX_PRINTF_LEN + 1];
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    Gfx_Puts(x, y, buf);
+}
+
+void Gfx_Init(const gfx_backend_t *backend, uint16_t width, uint16_t height)
+{
+    gfxi.backend = backend;
+    gfxi.font = &gfx_font_6x8;
+    gfxi.width = width;
+    gfxi.height = height;
+}
+
+/** @} */
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file    app/gui/gfx.h
+ * @brief   Drawing primitives and text on top of display backend
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#ifndef __APP_GUI_GFX_H_
+#define __APP_GUI_GFX_H_
+
+#include <types.h>
+
+/** Longest string printed by Gfx_Printf */
+#define GFX_PRINTF_LEN 64
+
+/**
+ * Set single pixel
+ *
+ * @param x     Column
+ * @param y     Row
+ * @param value True for pixel on
+ */
+typedef void (*gfx_pixel_cb_t)(uint16_t x, uint16_t y, bool value);
+
+/**
+ * Set or clear rectangle, corners are included, spans are rectangles one
+ * pixel high or wide
+ */
+typedef void (*gfx_fill_cb_t)(uint16_t x1, uint16_t y1, uint16_t x2,
+        uint16_t y2, bool value);
+
+/**
+ * Copy columns of up to 8 pixels (LSB is the top row) at any row
+ */
+typedef void (*gfx_blit_cb_t)(uint16_t x, uint16_t y, const uint8_t *data,
+        uint16_t width, uint8_t height);
+
+/** Display access, optional callbacks fall back to pixel drawing */
+typedef struct {
+    gfx_pixel_cb_t pixel;       /**< Mandatory */
+    gfx_fill_cb_t fill;         /**< Optional, NULL if not supported */
+    gfx_blit_cb_t blit;         /**< Optional, NULL if not supported */
+} gfx_backend_t;
+
+/**
+ * Font, glyphs are stored as columns of 8 pixels (LSB is the top row),
+ * page after page for fonts higher than 8 pixels, same as the SSD1306 RAM
+ */
+typedef struct {
+    uint8_t width;              /**< Glyph width including spacing */
+    uint8_t height;             /**< Glyph height including spacing */
+    char first;                 /**< First character in data */
+    char last;                  /**< Last character in data */
+    const uint8_t *data;
+} gfx_font_t;
+
+/** Default font, 5x7 glyphs in 6x8 cells */
+extern const gfx_font_t gfx_font_6x8;
+
+extern uint16_t Gfx_GetWidth(void);
+
+extern uint16_t Gfx_GetHeight(void);
+
+extern uint16_t Gfx_GetFontWidth(void);
+
+extern uint16_t Gfx_GetFontHeight(void);
+
+/**
+ * Set all pixels to given value
+ */
+extern void Gfx_FillScreen(bool value);
+
+extern void Gfx_DrawPixel(uint16_t x, uint16_t y, bool value);
+
+/**
+ * Draw line, horizontal and vertical lines are drawn as spans
+ */
+extern void Gfx_DrawLine(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2);
+
+/**
+ * Draw rectangle with corners included
+ */
+extern void Gfx_DrawFilledBox(uint16_t x1, uint16_t y1, uint16_t x2,
+        uint16_t y2, bool value);
+
+/**
+ * Draw character, top left corner at given position
+ */
+extern void Gfx_Putc(uint16_t x, uint16_t y, char c);
+
+/**
+ * Draw string, new line continues below the x position
+ */
+extern void Gfx_Puts(uint16_t x, uint16_t y, const char *str);
+
+/**
+ * Draw formatted string, up to GFX_PRINTF_LEN characters
+ */
+extern void Gfx_Printf(uint16_t x, uint16_t y, const char *format, ...)
+        __attribute__((format(printf, 3, 4)));
+
+/**
+ * Initialize drawing
+ *
+ * @param backend   Display access, must be valid while used
+ * @param width     Display width
+ * @param height    Display height
+ */
+extern void Gfx_Init(const gfx_backend_t *backend, uint16_t width,
+        uint16_t height);
+
+#endif
+
+/** @} */
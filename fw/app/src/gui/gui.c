@@ -25,12 +25,39 @@
 
 #include <string.h>
 #include "modules/log.h"
-#include "modules/cgui/cgui.h"
-#include "drivers/ssd1306.h"
-#include "desc.h"
+#include "config.h"
+#include "display.h"
+#include "gfx.h"
+#include "layout.h"
 #include "gui.h"
 
+/** Max amount of queued input events */
+#define GUI_QUEUE_SIZE 8
+
 static bool guii_popup_shown = false;
+static bool guii_in_menu = false;
+/** Text of the shown popup, NULL for custom popup */
+static const char *guii_popup_str;
+/** Display is off, nothing is drawn */
+static bool guii_sleep = false;
+
+/** Events waiting for Gui_Process */
+static struct {
+    gui_event_t events[GUI_QUEUE_SIZE];
+    uint8_t head;
+    uint8_t count;
+    uint8_t changed;            /**< gui_dep_t changed since last redraw */
+    uint32_t last_ms;           /**< Time of the last redraw */
+    bool drawn;                 /**< Anything was drawn yet */
+} guii_queue;
+
+static gui_stats_t guii_stats;
+
+static const gfx_backend_t guii_backend = {
+    .pixel = Display_DrawPixel,
+    .fill = Display_Fill,
+    .blit = Display_Blit,
+};
 
 /**
  * Show popup over current screen
@@ -42,8 +69,8 @@ static void Guii_DrawPopup(const char *str)
     uint16_t height = 1;
     const char *c = str;
 
-    Cgui_DrawFilledBox(10, 10, Cgui_GetWidth() - 10, Cgui_GetHeight() - 10, true);
-    Cgui_DrawFilledBox(12, 12, Cgui_GetWidth() - 12, Cgui_GetHeight() - 12, false);
+    Gfx_DrawFilledBox(10, 10, Gfx_GetWidth() - 10, Gfx_GetHeight() - 10, true);
+    Gfx_DrawFilledBox(12, 12, Gfx_GetWidth() - 12, Gfx_GetHeight() - 12, false);
 
     while (*c != '\0') {
         if (*c == '\n') {
@@ -51,32 +78,41 @@ static void Guii_DrawPopup(const char *str)
         }
         c++;
     }
-    height = height * Cgui_GetFontHeight();
+    height = height * Gfx_GetFontHeight();
 
-    Cgui_Puts(14, Cgui_GetHeight()/2-height/2, str);
-    SSD1306_Flush(&ssd1306_desc);
+    Gfx_Puts(14, Gfx_GetHeight()/2-height/2, str);
+    Display_Flush();
 }
 
-static void Guii_DrawPixel(uint16_t x, uint16_t y, bool value)
+void Gui_Popup(const char *str)
 {
-   SSD1306_DrawPixel(&ssd1306_desc, x, y, value);
+    guii_popup_shown = true;
+    guii_popup_str = str;
+    if (!guii_sleep) {
+        Guii_DrawPopup(str);
+    }
 }
 
-void Gui_Popup(const char *str)
+void Gui_PopupClose(void)
 {
-    guii_popup_shown = true;
-    Guii_DrawPopup(str);
+    if (guii_popup_shown && guii_sleep) {
+        /* Screen is drawn on wake up */
+        guii_popup_shown = false;
+        Layout_Invalidate();
+    } else if (guii_popup_shown) {
+        /* Any non redraw event closes the popup */
+        Gui_Event(GUI_EVT_ENTERED);
+    }
 }
 
 void Gui_CustomPopup(void)
 {
     guii_popup_shown = true;
+    guii_popup_str = NULL;
 }
 
 void Gui_Event(gui_event_t event)
 {
-    static bool in_menu = false;
-
     /* Any button press will close popup */
     if (guii_popup_shown) {
         /* Ignore redraws when popup is show */
@@ -85,26 +121,124 @@ void Gui_Event(gui_event_t event)
         }
         guii_popup_shown = false;
         event = GUI_EVT_REDRAW;
+        Layout_Invalidate();
     }
 
-    if (in_menu) {
-        in_menu = Gui_Menu(event);
-        if (!in_menu) {
+    if (guii_in_menu) {
+        Layout_Invalidate();
+        guii_in_menu = Gui_Menu(event);
+        if (!guii_in_menu) {
             event = GUI_EVT_REDRAW;
             Gui_Screens(event);
         }
     } else {
-        in_menu = !Gui_Screens(event);
-        if (in_menu) {
+        guii_in_menu = !Gui_Screens(event);
+        if (guii_in_menu) {
             event = GUI_EVT_ENTERED;
             Gui_Menu(event);
         }
     }
 }
 
+void Gui_Post(gui_event_t event)
+{
+    if (event == GUI_EVT_REDRAW) {
+        guii_queue.changed = GUI_DEP_ALL;
+        return;
+    }
+    if (guii_queue.count >= GUI_QUEUE_SIZE) {
+        guii_stats.dropped++;
+        return;
+    }
+    guii_queue.events[(guii_queue.head + guii_queue.count) % GUI_QUEUE_SIZE] =
+            event;
+    guii_queue.count++;
+}
+
+void Gui_Changed(uint8_t deps)
+{
+    guii_queue.changed |= deps;
+}
+
+uint32_t Gui_Process(uint32_t now_ms)
+{
+    const uint32_t period_ms = 1000/GUI_FPS;
+    uint8_t deps = GUI_DEP_ALL;
+    gui_event_t event;
+
+    /* Nothing is shown, screen is drawn from scratch on wake up */
+    if (guii_sleep) {
+        guii_stats.dropped += guii_queue.count;
+        guii_queue.count = 0;
+        guii_queue.changed = 0;
+        return 0;
+    }
+
+    /* Input first, every event draws the screen with current data */
+    if (guii_queue.count != 0) {
+        while (guii_queue.count != 0) {
+            event = guii_queue.events[guii_queue.head];
+            guii_queue.head = (guii_queue.head + 1) % GUI_QUEUE_SIZE;
+            guii_queue.count--;
+            guii_stats.events++;
+            Gui_Event(event);
+        }
+        guii_queue.changed = 0;
+        guii_queue.last_ms = now_ms;
+        guii_queue.drawn = true;
+        return 0;
+    }
+
+    if (guii_queue.changed != GUI_DEP_ALL) {
+        /* Popup and menu show no live data */
+        deps = guii_popup_shown || guii_in_menu ? 0 : Gui_ScreensDeps();
+    }
+    if ((guii_queue.changed & deps) == 0) {
+        if (guii_queue.changed != 0) {
+            guii_stats.skipped++;
+            guii_queue.changed = 0;
+        }
+        return 0;
+    }
+
+    if (guii_queue.drawn && now_ms - guii_queue.last_ms < period_ms) {
+        return period_ms - (now_ms - guii_queue.last_ms);
+    }
+    guii_queue.changed = 0;
+    guii_queue.last_ms = now_ms;
+    guii_queue.drawn = true;
+    guii_stats.redraws++;
+    Gui_Event(GUI_EVT_REDRAW);
+    return 0;
+}
+
+void Gui_Sleep(bool sleep)
+{
+    if (guii_sleep == sleep) {
+        return;
+    }
+    guii_sleep = sleep;
+    if (sleep) {
+        return;
+    }
+
+    guii_queue.changed = GUI_DEP_ALL;
+    if (guii_popup_shown && guii_popup_str != NULL) {
+        Guii_DrawPopup(guii_popup_str);
+    }
+}
+
+const gui_stats_t *Gui_GetStats(void)
+{
+    return &guii_stats;
+}
+
 void Gui_Init(void)
 {
-    Cgui_Init(Guii_DrawPixel, SSD1306_WIDTH, SSD1306_HEIGHT);
+    memset(&guii_queue, 0, sizeof(guii_queue));
+    memset(&guii_stats, 0, sizeof(guii_stats));
+    guii_sleep = false;
+    Gfx_Init(&guii_backend, SSD1306_WIDTH, SSD1306_HEIGHT);
 }
 
 /** @} */
@@ -39,6 +39,21 @@ typedef enum {
     GUI_EVT_ENTERED,        /**< Window was just entered from outside */
 } gui_event_t;
 
+/** Data shown on screens, screen is redrawn only when its data change */
+typedef enum {
+    GUI_DEP_FIX = 1 << 0,       /**< Position, time and fix quality */
+    GUI_DEP_SAT = 1 << 1,       /**< Satellite signals */
+    GUI_DEP_STATS = 1 << 2,     /**< Track statistics */
+    GUI_DEP_ALL = 0xff,
+} gui_dep_t;
+
+typedef struct {
+    uint32_t events;            /**< Input events processed */
+    uint32_t redraws;           /**< Redraws due to data change */
+    uint32_t skipped;           /**< Changes not shown on current screen */
+    uint32_t dropped;           /**< Events lost on full queue */
+} gui_stats_t;
+
 /**
  * System menu handling
  *
@@ -55,6 +70,13 @@ extern bool Gui_Menu(gui_event_t event);
  */
 extern bool Gui_Screens(gui_event_t event);
 
+/**
+ * Get data shown on the current main screen
+ *
+ * @return Mask of gui_dep_t
+ */
+extern uint8_t Gui_ScreensDeps(void);
+
 /**
  * Draw popup window
  *
@@ -62,18 +84,61 @@ extern bool Gui_Screens(gui_event_t event);
  */
 extern void Gui_Popup(const char *str);
 
+/**
+ * Close popup if shown and redraw current screen
+ */
+extern void Gui_PopupClose(void);
+
 /**
  * Custom popup graphic was drawn, notify gui for proper button handling
  */
 extern void Gui_CustomPopup(void);
 
 /**
- * Sent event to GUI
+ * Sent event to GUI, processed right away
  *
  * @param event     Event to be processed
  */
 extern void Gui_Event(gui_event_t event);
 
+/**
+ * Queue event for Gui_Process, GUI_EVT_REDRAW forces redraw of the screen
+ *
+ * @param event     Event to be processed
+ */
+extern void Gui_Post(gui_event_t event);
+
+/**
+ * Data changed, screens showing them are redrawn by Gui_Process
+ *
+ * @param deps      Mask of gui_dep_t
+ */
+extern void Gui_Changed(uint8_t deps);
+
+/**
+ * Process queued events, then redraw the screen if its data changed, at
+ * most GUI_FPS times per second
+ *
+ * @param now_ms    Current time
+ * @return Time in ms after which postponed redraw is due, 0 if none
+ */
+extern uint32_t Gui_Process(uint32_t now_ms);
+
+/**
+ * Display was switched off or on, nothing is drawn while off and queued
+ * events and data changes are dropped, current screen is redrawn on wake up
+ *
+ * @param sleep     True when display was switched off
+ */
+extern void Gui_Sleep(bool sleep);
+
+/**
+ * Get event processing statistics
+ *
+ * @return Statistics
+ */
+extern const gui_stats_t *Gui_GetStats(void);
+
 /**
  * Initialize GUI and draw main screen
  */
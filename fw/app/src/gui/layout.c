@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file    app/gui/layout.c
+ * @brief   Retained screen layouts, only changed values are redrawn
+ *
+ * Labels and lines are drawn only when the layout is shown, slots are
+ * redrawn when their value changes. Slot text is padded with spaces to the
+ * field width so the previous value is overwritten without clearing.
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "gfx.h"
+#include "layout.h"
+
+static struct {
+    const layout_t *shown;
+    int32_t values[LAYOUT_SLOTS_MAX];
+} layouti;
+
+/**
+ * Format slot value to text padded to field width
+ */
+static void Layouti_DrawSlot(const layout_slot_t *slot, int32_t value)
+{
+    char num[24];
+    char text[GFX_PRINTF_LEN + 1];
+    size_t len;
+
+    if (value == LAYOUT_NONE) {
+        strcpy(num, "--");
+    } else if (slot->type == LAYOUT_TIME) {
+        snprintf(num, sizeof(num), "%ldh %ldm", (long)value/3600,
+                (long)(value/60)%60);
+    } else if (slot->type == LAYOUT_KM) {
+        snprintf(num, sizeof(num), "%ld.%02ld", (long)value/10000,
+                (long)(value/100)%100);
+    } else {
+        snprintf(num, sizeof(num), "%ld", (long)value);
+    }
+
+    snprintf(text, sizeof(text), "%s%s", num,
+            value != LAYOUT_NONE && slot->unit != NULL ? slot->unit : "");
+    for (len = strlen(text); len < slot->chars && len < GFX_PRINTF_LEN; len++) {
+        text[len] = ' ';
+    }
+    text[len < slot->chars ? len : slot->chars] = '\0';
+    Gfx_Puts(slot->x, slot->y, text);
+}
+
+void Layout_Draw(const layout_t *layout, const int32_t *values)
+{
+    bool full = layouti.shown != layout;
+
+    if (full) {
+        Gfx_FillScreen(false);
+        for (uint8_t i = 0; i < layout->label_count; i++) {
+            Gfx_Puts(layout->labels[i].x, layout->labels[i].y,
+                    layout->labels[i].text);
+        }
+        if (layout->line_y != 0) {
+            Gfx_DrawLine(0, layout->line_y, Gfx_GetWidth() - 1,
+                    layout->line_y);
+        }
+        layouti.shown = layout;
+    }
+
+    for (uint8_t i = 0; i < layout->slot_count && i < LAYOUT_SLOTS_MAX; i++) {
+        if (full || layouti.values[i] != values[i]) {
+            Layouti_DrawSlot(&layout->slots[i], values[i]);
+            layouti.values[i] = values[i];
+        }
+    }
+}
+
+void Layout_Invalidate(void)
+{
+    layouti.shown = NULL;
+}
+
+/** @} */
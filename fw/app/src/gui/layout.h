@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file    app/gui/layout.h
+ * @brief   Retained screen layouts, only changed values are redrawn
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#ifndef __APP_GUI_LAYOUT_H_
+#define __APP_GUI_LAYOUT_H_
+
+#include <types.h>
+
+/** Max amount of slots in a layout */
+#define LAYOUT_SLOTS_MAX 12
+/** Slot value for missing data, shown as dashes */
+#define LAYOUT_NONE INT32_MIN
+
+typedef enum {
+    LAYOUT_NUMBER,          /**< Integer */
+    LAYOUT_TIME,            /**< Seconds as hours and minutes */
+    LAYOUT_KM,              /**< Decimeters as km with two decimals */
+} layout_type_t;
+
+/** Static text */
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+    const char *text;
+} layout_label_t;
+
+/** Value drawn as text of fixed width */
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+    uint8_t chars;          /**< Field width, shorter text is padded */
+    layout_type_t type;
+    const char *unit;       /**< Appended to value, NULL for none */
+} layout_slot_t;
+
+typedef struct {
+    const layout_label_t *labels;
+    uint8_t label_count;
+    const layout_slot_t *slots;
+    uint8_t slot_count;
+    uint16_t line_y;        /**< Horizontal line across screen, 0 for none */
+} layout_t;
+
+/**
+ * Draw layout with given slot values, if the layout is already shown, only
+ * slots with changed values are drawn
+ *
+ * @param layout    Layout to draw
+ * @param values    Value for each slot of the layout
+ */
+extern void Layout_Draw(const layout_t *layout, const int32_t *values);
+
+/**
+ * Something else was drawn over the layout, draw it whole next time
+ */
+extern void Layout_Invalidate(void);
+
+#endif
+
+/** @} */
@@ -24,13 +24,17 @@
  */
 
 #include <string.h>
+#include <stdio.h>
+#include <time.h>
 #include "modules/log.h"
-#include "drivers/ssd1306.h"
-#include "modules/cgui/cgui.h"
 #include "storage.h"
 #include "stats.h"
+#include "tracks.h"
 #include "version.h"
-#include "desc.h"
+#include "usb.h"
+#include "display.h"
+#include "dispctl.h"
+#include "gfx.h"
 #include "gui.h"
 
 /**
@@ -52,6 +56,26 @@ typedef uint8_t (*gui_menu_value_get_cb_t)(void);
  */
 typedef void (*gui_menu_value_set_cb_t)(uint8_t index);
 
+/**
+ * Callback to get amount of items of the generated list
+ * @return Amount of items
+ */
+typedef uint16_t (*gui_menu_list_count_cb_t)(void);
+
+/**
+ * Callback to get name of the generated list item
+ * @param index     Item index
+ * @param buf       Buffer for the name, GUI_MENU_NAME_MAX chars at most
+ */
+typedef void (*gui_menu_list_name_cb_t)(uint16_t index, char *buf);
+
+/**
+ * Callback for generated list item selection
+ * @param index     Item index
+ * @return If true, return to previous menu, else stay where you are
+ */
+typedef bool (*gui_menu_list_select_cb_t)(uint16_t index);
+
 
 /** Possible types of menu items */
 typedef enum {
@@ -62,6 +86,16 @@ typedef enum {
     GUI_MENU_EMPTY,     /**< This item marks end of menu items */
 } gui_menu_type_t;
 
+/** Longest name of the generated list item */
+#define GUI_MENU_NAME_MAX 20
+
+/** Items generated at runtime, e.g. from storage, followed by back item */
+typedef const struct {
+    gui_menu_list_count_cb_t count_cb;      /**< Get amount of items */
+    gui_menu_list_name_cb_t name_cb;        /**< Get name of the item */
+    gui_menu_list_select_cb_t select_cb;    /**< Item selected */
+} gui_menu_list_t;
+
 /** Values list for the menu */
 typedef const struct {
     char *const (*list)[];              /**< List of possible values */
@@ -86,11 +120,53 @@ typedef const struct {
 typedef struct gui_menu_t {
     const char *name;                   /**< Name of this menu */
     const gui_menu_item_t (*items)[];   /**< List of menu items */
+    const gui_menu_list_t *list;        /**< Generated items, if no items */
     struct gui_menu_t *prev;            /**< Pointer to previous menu */
-    uint8_t cursor;                     /**< Cursor pointer to item */
-    uint8_t rot;                        /**< Screen rotated to index on top */
+    uint16_t cursor;                    /**< Cursor pointer to item */
+    uint16_t rot;                       /**< Screen rotated to index on top */
 } gui_menu_t;
 
+/**
+ * Get amount of menu items
+ *
+ * @param menu      Menu structure
+ * @return Amount of items including back item
+ */
+static uint16_t Guii_MenuCount(const gui_menu_t *menu)
+{
+    uint16_t count = 0;
+
+    if (menu->list != NULL) {
+        return menu->list->count_cb() + 1;
+    }
+    while ((*menu->items)[count].type != GUI_MENU_EMPTY) {
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Get menu item name, generated list ends with back item
+ *
+ * @param menu      Menu structure
+ * @param index     Item index, lower than item count
+ * @param buf       Buffer for generated name
+ * @return Item name
+ */
+static const char *Guii_MenuName(const gui_menu_t *menu, uint16_t index,
+        char *buf)
+{
+    if (menu->list == NULL) {
+        return (*menu->items)[index].name;
+    }
+    if (index == menu->list->count_cb()) {
+        return "Back";
+    }
+    buf[0] = '\0';
+    menu->list->name_cb(index, buf);
+    return buf;
+}
+
 /**
  * Draw currently used menu to display
  *
@@ -101,41 +177,43 @@ static void Guii_DrawMenu(gui_menu_t *menu)
     uint16_t y = 0;
     uint16_t x = 0;
     uint8_t lines;
-    uint8_t end;
-    uint8_t i;
+    uint16_t end;
+    uint16_t i;
+    uint16_t count = Guii_MenuCount(menu);
     const gui_menu_item_t *item;
+    char buf[GUI_MENU_NAME_MAX + 1];
 
-    Cgui_FillScreen(0);
+    Gfx_FillScreen(0);
 
-    Cgui_Puts(0, 0, menu->name);
-    y = Cgui_GetFontHeight() + 1;
-    Cgui_DrawLine(0, y, Cgui_GetWidth()-1, y);
+    Gfx_Puts(0, 0, menu->name);
+    y = Gfx_GetFontHeight() + 1;
+    Gfx_DrawLine(0, y, Gfx_GetWidth()-1, y);
     y += 1;
 
-    lines = (Cgui_GetHeight() - y) / Cgui_GetFontHeight();
+    lines = (Gfx_GetHeight() - y) / Gfx_GetFontHeight();
     if (abs(menu->rot - menu->cursor) >= lines) {
         menu->rot += menu->rot > menu->cursor ? -1 : 1;
     }
 
     i = menu->rot;
     end = menu->rot + lines - 1;
-    while (i <= end && (*menu->items)[i].type != GUI_MENU_EMPTY) {
-        item = &(*menu->items)[i];
+    while (i <= end && i < count) {
+        item = menu->list == NULL ? &(*menu->items)[i] : NULL;
         if (i == menu->cursor) {
-            Cgui_Putc(0, y, '>');
+            Gfx_Putc(0, y, '>');
         }
-        Cgui_Puts(Cgui_GetFontWidth(), y, item->name);
-        if (item->type == GUI_MENU_VALUES &&
+        Gfx_Puts(Gfx_GetFontWidth(), y, Guii_MenuName(menu, i, buf));
+        if (item != NULL && item->type == GUI_MENU_VALUES &&
                 item->values->get_cb() < item->values->count) {
-            x = Cgui_GetFontWidth() * (strlen(item->name) + 1);
-            Cgui_Putc(x, y, ':');
-            x += Cgui_GetFontWidth();
-            Cgui_Puts(x, y, (*item->values->list)[item->values->get_cb()]);
+            x = Gfx_GetFontWidth() * (strlen(item->name) + 1);
+            Gfx_Putc(x, y, ':');
+            x += Gfx_GetFontWidth();
+            Gfx_Puts(x, y, (*item->values->list)[item->values->get_cb()]);
         }
-        y += Cgui_GetFontHeight();
+        y += Gfx_GetFontHeight();
         i++;
     }
-    SSD1306_Flush(&ssd1306_desc);
+    Display_Flush();
 }
 
 /**
@@ -144,8 +222,11 @@ static void Guii_DrawMenu(gui_menu_t *menu)
 static bool Guii_StorageErase(void)
 {
     Gui_Popup("Erasing...\n");
+    Usb_Lock();
     Storage_Erase();
     Stats_Init();
+    Tracks_Init();
+    Usb_Unlock();
     Gui_Popup("Erasing\nfinished");
     return true;
 }
@@ -155,18 +236,125 @@ static bool Guii_StorageErase(void)
  */
 static bool Guii_SysInfo(void)
 {
-    Cgui_FillScreen(0);
+    Gfx_FillScreen(0);
     uint32_t mem_used = Storage_SpaceUsed();
     uint32_t mem_size = Storage_GetSize();
-    Cgui_Printf(0, 0, "Deadbadger.cz\nMem used: %d%%\nMem: %d\nFw: v%d.%d\nHw: v%d.%d",
-            mem_used*100/mem_size, mem_size,
-            FW_MAJOR, FW_MINOR, HW_MAJOR, HW_MINOR);
+    /* Display off time is accounted when it wakes up, so it's current */
+    uint32_t saved_uah = DispCtl_GetStats()->saved_uah;
+    Gfx_Printf(0, 0, "Deadbadger.cz\nMem used: %lu%%\nMem: %lu\nFw: v%d.%d\nHw: v%d.%d\n"
+            "Disp saved: %lu.%lumAh",
+            (unsigned long)mem_used*100/mem_size, (unsigned long)mem_size,
+            FW_MAJOR, FW_MINOR, HW_MAJOR, HW_MINOR,
+            (unsigned long)saved_uah/1000, (unsigned long)saved_uah/100 % 10);
+
+    Display_Flush();
+    Gui_CustomPopup();
+    return false;
+}
+
+static uint16_t Guii_TracksCount(void)
+{
+    uint32_t count = Tracks_GetCount();
+
+    /* Back item follows the tracks, count + 1 items have to fit the cursor */
+    return count < UINT16_MAX - 1 ? count : UINT16_MAX - 1;
+}
 
-    SSD1306_Flush(&ssd1306_desc);
+/**
+ * Track list item, start date, distance, duration and ascent
+ *
+ * Tenths of km are shown below 10 km only. Duration is left out when the
+ * row doesn't fit, the detail screen shows it anyway.
+ */
+static void Guii_TracksName(uint16_t index, char *buf)
+{
+    storage_track_t track;
+    time_t start;
+    struct tm *time;
+    uint8_t day;
+    uint8_t month;
+    uint16_t km;
+    uint16_t ascent;
+    char dist[8];
+
+    if (!Tracks_Get(index, &track)) {
+        return;
+    }
+    start = track.start;
+    time = gmtime(&start);
+    day = time->tm_mday;
+    month = time->tm_mon + 1;
+    km = track.dist_dm < 100000000 ? track.dist_dm/10000 : 9999;
+    ascent = track.ascend_dm < 100000 ? track.ascend_dm/10 : 9999;
+    if (km < 10) {
+        snprintf(dist, sizeof(dist), "%u.%uk", km,
+                (unsigned)(track.dist_dm/1000 % 10));
+    } else {
+        snprintf(dist, sizeof(dist), "%uk", km);
+    }
+    if (snprintf(buf, GUI_MENU_NAME_MAX + 1, "%02u.%02u %s %lu:%02lu %um",
+            day, month, dist, (unsigned long)track.duration_s/3600,
+            (unsigned long)track.duration_s/60 % 60, ascent) >
+            GUI_MENU_NAME_MAX) {
+        /* Clamped fields fit without duration */
+        snprintf(buf, GUI_MENU_NAME_MAX + 1, "%02u.%02u %.5s %um",
+                day, month, dist, ascent);
+    }
+}
+
+/**
+ * Show track details until any button is pressed
+ */
+static bool Guii_TracksDetail(uint16_t index)
+{
+    storage_track_t track;
+    time_t start;
+    struct tm *time;
+
+    if (!Tracks_Get(index, &track)) {
+        return false;
+    }
+    start = track.start;
+    time = gmtime(&start);
+
+    Gfx_FillScreen(0);
+    Gfx_Printf(0, 0, "%d.%d.%d %d:%02d\nDist: %lu.%02lu km\n"
+            "Time: %luh %lum\nA: %lum D: %lum\nPoints: %lu",
+            time->tm_mday, time->tm_mon + 1, time->tm_year + 1900,
+            time->tm_hour, time->tm_min,
+            (unsigned long)track.dist_dm/10000,
+            (unsigned long)track.dist_dm/100 % 100,
+            (unsigned long)track.duration_s/3600,
+            (unsigned long)track.duration_s/60 % 60,
+            (unsigned long)track.ascend_dm/10,
+            (unsigned long)track.descend_dm/10,
+            (unsigned long)track.count);
+    Display_Flush();
     Gui_CustomPopup();
     return false;
 }
 
+/** Display off timeouts selectable in menu, 0 for never */
+static const uint16_t guii_disp_timeouts[] = {15, 30, 60, 300, 0};
+
+static uint8_t Guii_DispTimeoutGet(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < sizeof(guii_disp_timeouts)/sizeof(guii_disp_timeouts[0]);
+            i++) {
+        if (guii_disp_timeouts[i] == DispCtl_GetTimeout()) {
+            break;
+        }
+    }
+    return i;
+}
+
+static void Guii_DispTimeoutSet(uint8_t index)
+{
+    DispCtl_SetTimeout(guii_disp_timeouts[index]);
+}
+
 /** System menu description */
 static gui_menu_t guii_menu = {
     .name = "Menu",
@@ -175,6 +363,17 @@ static gui_menu_t guii_menu = {
           .type = GUI_MENU_ACTION,
           .action_cb = Guii_SysInfo,
         },
+        { .name = "Tracks",
+          .type = GUI_MENU_SUBMENU,
+          .submenu = &(gui_menu_t) {
+                .name = "Tracks",
+                .list = &(gui_menu_list_t) {
+                    .count_cb = Guii_TracksCount,
+                    .name_cb = Guii_TracksName,
+                    .select_cb = Guii_TracksDetail,
+                },
+            },
+        },
         { .name = "Erase memory",
           .type = GUI_MENU_SUBMENU,
           .submenu = &(gui_menu_t) {
@@ -190,6 +389,15 @@ static gui_menu_t guii_menu = {
                 },
             },
         },
+        { .name = "Display off",
+          .type = GUI_MENU_VALUES,
+          .values = &(gui_menu_values_t){
+                .list = &(char *const[]){"15s", "30s", "1m", "5m", "never"},
+                .count = 5,
+                .get_cb = Guii_DispTimeoutGet,
+                .set_cb = Guii_DispTimeoutSet,
+            }
+        },
         /*
          * TODO
         { .name = "Log period",
@@ -233,7 +441,11 @@ static gui_menu_t guii_menu = {
 bool Gui_Menu(gui_event_t event)
 {
     static gui_menu_t *current = &guii_menu;
-    const gui_menu_item_t *item = &(*current->items)[current->cursor];
+    const gui_menu_item_t *item = NULL;
+
+    if (current->list == NULL) {
+        item = &(*current->items)[current->cursor];
+    }
 
     switch (event) {
         case GUI_EVT_ENTERED:
@@ -242,12 +454,25 @@ bool Gui_Menu(gui_event_t event)
             break;
         case GUI_EVT_SHORT_NEXT:
             current->cursor += 1;
-            if ((*current->items)[current->cursor].type == GUI_MENU_EMPTY) {
+            if (current->cursor >= Guii_MenuCount(current)) {
                 current->cursor = 0;
                 current->rot = 0;
             }
             break;
         case GUI_EVT_SHORT_ENTER:
+            if (item == NULL) {
+                /* Generated list, the last item is back */
+                if (current->cursor < current->list->count_cb() &&
+                        !current->list->select_cb(current->cursor)) {
+                    /* item could draw over menu, don't redraw */
+                    return true;
+                }
+                if (current->prev == NULL) {
+                    return false;
+                }
+                current = current->prev;
+                break;
+            }
             switch (item->type) {
                 case GUI_MENU_SUBMENU:
                     if (item->submenu == NULL) {
@@ -26,13 +26,14 @@
 #include <time.h>
 #include <string.h>
 
-#include "modules/cgui/cgui.h"
-#include "drivers/ssd1306.h"
 #include "drivers/gps.h"
+#include "gps/gnss.h"
 #include "storage.h"
 #include "stats.h"
 #include "version.h"
-#include "desc.h"
+#include "display.h"
+#include "gfx.h"
+#include "layout.h"
 #include "gui.h"
 
 typedef enum {
@@ -40,9 +41,68 @@ typedef enum {
     GUI_SCR_ALL,       /**< Stats since restart */
     GUI_SCR_GPS_FIX,   /**< GPS fix info */
     GUI_SCR_GPS_SAT,   /**< GPS satellite info */
+    GUI_SCR_MAP,       /**< Shape of the track since boot */
+    GUI_SCR_PROFILE,   /**< Elevation and speed along the track */
     GUI_SCR_COUNT,     /**< Amount of main screens */
 } gui_screen_t;
 
+/** Text cell position on layouts, font is 6x8, row 0 is the header */
+#define GUII_COL(n) ((n)*6)
+#define GUII_ROW(n) ((n) == 0 ? 0 : (n)*8 + 1)
+
+/** Smallest elevation range of the profile plot */
+#define GUII_PROFILE_MIN_M 20
+
+typedef enum {
+    GUII_STATS_HDOP,
+    GUII_STATS_BAT,
+    GUII_STATS_DIST,
+    GUII_STATS_ASCEND,
+    GUII_STATS_DESCEND,
+    GUII_STATS_ALT,
+    GUII_STATS_TIME,
+    GUII_STATS_COUNT,
+} guii_stats_slot_t;
+
+/** Labels of the stats screen, the last one only for stats since restart */
+static const layout_label_t guii_stats_labels[] = {
+    { GUII_COL(0), GUII_ROW(0), "G:" },
+    { GUII_COL(16), GUII_ROW(0), "B:" },
+    { GUII_COL(0), GUII_ROW(1), "Dist:" },
+    { GUII_COL(0), GUII_ROW(2), "A:" },
+    { GUII_COL(11), GUII_ROW(2), "D:" },
+    { GUII_COL(0), GUII_ROW(3), "Alt:" },
+    { GUII_COL(0), GUII_ROW(4), "Time:" },
+    { GUII_COL(7), GUII_ROW(0), "All" },
+};
+
+/** Stats screen values, in guii_stats_slot_t order */
+static const layout_slot_t guii_stats_slots[] = {
+    { GUII_COL(2), GUII_ROW(0), 5, LAYOUT_NUMBER, "m" },
+    { GUII_COL(18), GUII_ROW(0), 3, LAYOUT_NUMBER, "%" },
+    { GUII_COL(6), GUII_ROW(1), 10, LAYOUT_KM, "km" },
+    { GUII_COL(2), GUII_ROW(2), 8, LAYOUT_NUMBER, "m" },
+    { GUII_COL(13), GUII_ROW(2), 8, LAYOUT_NUMBER, "m" },
+    { GUII_COL(5), GUII_ROW(3), 8, LAYOUT_NUMBER, "m" },
+    { GUII_COL(6), GUII_ROW(4), 12, LAYOUT_TIME, NULL },
+};
+
+static const layout_t guii_stats_today = {
+    .labels = guii_stats_labels,
+    .label_count = sizeof(guii_stats_labels)/sizeof(guii_stats_labels[0]) - 1,
+    .slots = guii_stats_slots,
+    .slot_count = GUII_STATS_COUNT,
+    .line_y = GUII_ROW(1) - 1,
+};
+
+static const layout_t guii_stats_all = {
+    .labels = guii_stats_labels,
+    .label_count = sizeof(guii_stats_labels)/sizeof(guii_stats_labels[0]),
+    .slots = guii_stats_slots,
+    .slot_count = GUII_STATS_COUNT,
+    .line_y = GUII_ROW(1) - 1,
+};
+
 /**
  * Show current GPS informations
  *
@@ -50,7 +110,7 @@ typedef enum {
  */
 static void Guii_DrawGpsFix(const gps_info_t *info)
 {
-    Cgui_FillScreen(0);
+    Gfx_FillScreen(0);
     char lat_dir = 'N';
     char lon_dir = 'E';
     nmea_float_t lat;
@@ -59,8 +119,8 @@ static void Guii_DrawGpsFix(const gps_info_t *info)
 
     if (info == NULL) {
         //TODO show satellites signals
-        Cgui_Printf(0, 0, "No GPS fix yet");
-        SSD1306_Flush(&ssd1306_desc);
+        Gfx_Printf(0, 0, "No GPS fix yet");
+        Display_Flush();
         return;
     }
 
@@ -77,14 +137,14 @@ static void Guii_DrawGpsFix(const gps_info_t *info)
 
     time = gmtime(&info->time);
 
-    Cgui_Printf(0, 0, "%c%d.%d\n%c%d.%d\nAlt:%dm\nDOP:%dm Sat:%d\n"
+    Gfx_Printf(0, 0, "%c%ld.%ld\n%c%ld.%ld\nAlt:%ldm\nDOP:%dm Sat:%d\n"
             "%d:%d %d.%d.%d",
-            lat_dir, lat.num/lat.scale, lat.num % lat.scale,
-            lon_dir, lon.num/lon.scale, lon.num % lon.scale,
-            info->altitude_dm/10, info->hdop_dm/10, info->satellites,
+            lat_dir, (long)lat.num/lat.scale, (long)lat.num % lat.scale,
+            lon_dir, (long)lon.num/lon.scale, (long)lon.num % lon.scale,
+            (long)info->altitude_dm/10, info->hdop_dm/10, info->satellites,
             time->tm_hour, time->tm_min, time->tm_mday, time->tm_mon + 1,
             time->tm_year + 1900);
-    SSD1306_Flush(&ssd1306_desc);
+    Display_Flush();
 }
 
 /**
@@ -99,19 +159,132 @@ static void Guii_DrawGpsSat(const gps_sat_t *sat)
     uint8_t i;
     uint16_t height;
     uint16_t x = margin;
-    uint16_t top = Cgui_GetFontHeight() + margin;
-    uint16_t bottom = Cgui_GetHeight() - margin;
+    uint16_t top = Gfx_GetFontHeight() + margin;
+    uint16_t bottom = Gfx_GetHeight() - margin;
 
-    Cgui_FillScreen(0);
-    Cgui_Printf(0, 0, "Gps sats: %d", sat->visible);
+    Gfx_FillScreen(0);
+    Gfx_Printf(0, 0, "Gps sats: %d", sat->visible);
 
-    for (i = 0; i < sat->count && x <= Cgui_GetWidth() - width; i++) {
+    for (i = 0; i < sat->count && x <= Gfx_GetWidth() - width; i++) {
         height = ((bottom - top) * sat->sat[i].snr) / MAX_SV_SNR;
-        Cgui_DrawFilledBox(x, bottom-height, x+width, bottom, true);
+        Gfx_DrawFilledBox(x, bottom-height, x+width, bottom, true);
         x += width+margin;
     }
 
-    SSD1306_Flush(&ssd1306_desc);
+    Display_Flush();
+}
+
+/**
+ * Draw shape of the track, scaled to fit the screen below the header
+ *
+ * @param track     Track since boot
+ */
+static void Guii_DrawMap(const breadcrumb_t *track)
+{
+    const uint16_t top = GUII_ROW(1) + 1;
+    breadcrumb_view_t view;
+    uint16_t x1, y1, x2, y2;
+    uint32_t width_m;
+
+    Gfx_FillScreen(0);
+    if (track->total == 0) {
+        Gfx_Puts(0, 0, "No track yet");
+        Display_Flush();
+        return;
+    }
+
+    Breadcrumb_Fit(track, &view, Gfx_GetWidth(), Gfx_GetHeight() - top);
+    width_m = view.mm_per_px*Gfx_GetWidth()/1000;
+    Gfx_Printf(0, 0, "Map  width %lu.%lu km", (unsigned long)width_m/1000,
+            (unsigned long)width_m % 1000/100);
+    Gfx_DrawLine(0, top - 2, Gfx_GetWidth() - 1, top - 2);
+
+    Breadcrumb_ToScreen(&view, &track->points[0], &x1, &y1);
+    for (uint16_t i = 1; i <= track->count; i++) {
+        /* Newest point is not stored until the stride is reached */
+        Breadcrumb_ToScreen(&view, i < track->count ? &track->points[i] :
+                &track->last, &x2, &y2);
+        Gfx_DrawLine(x1, top + y1, x2, top + y2);
+        x1 = x2;
+        y1 = y2;
+    }
+
+    /* Current position */
+    Gfx_DrawFilledBox(x1 > 0 ? x1 - 1 : 0, top + y1 - 1,
+            x1 + 1 < Gfx_GetWidth() ? x1 + 1 : x1,
+            top + y1 + 1 < Gfx_GetHeight() ? top + y1 + 1 : top + y1, true);
+    Display_Flush();
+}
+
+/**
+ * Plot profile to the area, each column shows all samples of its bucket
+ *
+ * @param prof      Profile to plot
+ * @param top       Top row of the area
+ * @param height    Amount of rows
+ * @param lo        Value at the bottom row
+ * @param hi        Value at the top row, larger than lo
+ */
+static void Guii_DrawPlot(const profile_t *prof, uint16_t top, uint16_t height,
+        int32_t lo, int32_t hi)
+{
+    uint16_t bottom = top + height - 1;
+    int32_t prev_min = 0;
+    int32_t prev_max = 0;
+    int32_t min, max;
+    uint16_t b;
+
+    for (uint16_t x = 0; x < Gfx_GetWidth(); x++) {
+        /* Short track is stretched over the whole width */
+        b = x*prof->count/Gfx_GetWidth();
+        min = prof->min[b];
+        max = prof->max[b];
+        /* Connect to the previous column */
+        if (x != 0) {
+            min = prev_max < min ? prev_max : min;
+            max = prev_min > max ? prev_min : max;
+        }
+        prev_min = prof->min[b];
+        prev_max = prof->max[b];
+        Gfx_DrawLine(x, bottom - (max - lo)*(height - 1)/(hi - lo),
+                x, bottom - (min - lo)*(height - 1)/(hi - lo));
+    }
+}
+
+/**
+ * Draw elevation (top) and speed (bottom) along the track
+ *
+ * @param elev      Elevation in m
+ * @param speed     Speed in dm/s
+ */
+static void Guii_DrawProfile(const profile_t *elev, const profile_t *speed)
+{
+    const uint16_t top = GUII_ROW(1) + 1;
+    const uint16_t elev_height = (Gfx_GetHeight() - top)*3/5;
+    int32_t lo = elev->lo;
+    int32_t hi = elev->hi;
+
+    Gfx_FillScreen(0);
+    if (elev->total == 0) {
+        Gfx_Puts(0, 0, "No track yet");
+        Display_Flush();
+        return;
+    }
+
+    Gfx_Printf(0, 0, "%ld-%ldm %ldkm/h", (long)lo, (long)hi,
+            (long)speed->hi*36/100);
+    Gfx_DrawLine(0, top - 2, Gfx_GetWidth() - 1, top - 2);
+
+    /* Elevation noise on flat ground is not zoomed in */
+    if (hi - lo < GUII_PROFILE_MIN_M) {
+        lo = (lo + hi)/2 - GUII_PROFILE_MIN_M/2;
+        hi = lo + GUII_PROFILE_MIN_M;
+    }
+    Guii_DrawPlot(elev, top, elev_height, lo, hi);
+    Guii_DrawPlot(speed, top + elev_height + 1,
+            Gfx_GetHeight() - top - elev_height - 1, 0,
+            speed->hi > 0 ? speed->hi : 1);
+    Display_Flush();
 }
 
 /**
@@ -126,46 +299,47 @@ static void Guii_DrawGpsSat(const gps_sat_t *sat)
 static void Guii_DrawStats(uint8_t bat_pct, const gps_info_t *gps,
         const stats_t *stats, bool today)
 {
-    const stats_comm_t *data;
-
-    Cgui_FillScreen(0);
-
-    /* header - gps state, battery */
-    if (gps == NULL) {
-        Cgui_Puts(0, 0, "NoFix");
-    } else {
-        Cgui_Printf(0, 0, "G:%dm", gps->hdop_dm/10);
-    }
-    if (!today) {
-        Cgui_Puts(Cgui_GetFontWidth()*7, 0, "All");
-        data = &stats->all;
-    } else {
-        data = &stats->today;
-    }
+    const stats_comm_t *data = today ? &stats->today : &stats->all;
+    int32_t values[GUII_STATS_COUNT];
 
     if (bat_pct == 100) {
         bat_pct = 99;
     }
-    Cgui_Printf(Cgui_GetWidth() - Cgui_GetFontWidth()*5, 0, "B:%d%%",
-            bat_pct);
 
-    Cgui_DrawLine(0, Cgui_GetFontHeight(), Cgui_GetWidth() - 1, Cgui_GetFontHeight());
+    values[GUII_STATS_HDOP] = gps != NULL ? gps->hdop_dm/10 : LAYOUT_NONE;
+    values[GUII_STATS_BAT] = bat_pct;
+    values[GUII_STATS_DIST] = data->dist_dm;
+    values[GUII_STATS_ASCEND] = data->ascend_dm/10;
+    values[GUII_STATS_DESCEND] = data->descend_dm/10;
+    values[GUII_STATS_ALT] = gps != NULL ? gps->altitude_dm/10 : LAYOUT_NONE;
+    values[GUII_STATS_TIME] = data->time_s;
+
+    /* Labels are drawn once, only changed values after that */
+    Layout_Draw(today ? &guii_stats_today : &guii_stats_all, values);
+    Display_Flush();
+}
 
-    /* Statistics */
-    Cgui_Printf(0, Cgui_GetFontHeight()+1, "Dist: %d.%dkm",
-            data->dist_dm/10/1000, ((data->dist_dm/10)%10000)/100);
-    Cgui_Printf(0, Cgui_GetFontHeight()*2+1, "A:%dm", data->ascend_dm/10);
-    Cgui_Printf(Cgui_GetWidth()/2, Cgui_GetFontHeight()*2+1, "D:%dm", data->descend_dm/10);
-    Cgui_Printf(0, Cgui_GetFontHeight()*3+1, "Alt: %dm", gps != NULL ? gps->altitude_dm/10 : 0);
-    Cgui_Printf(0, Cgui_GetFontHeight()*4+1, "Time: %dh %dm",
-            data->time_s/3600, (data->time_s/60)%60);
+static gui_screen_t guii_scr = GUI_SCR_TODAY;
 
-    SSD1306_Flush(&ssd1306_desc);
+/** Data shown on each screen */
+static const uint8_t guii_scr_deps[GUI_SCR_COUNT] = {
+    [GUI_SCR_TODAY] = GUI_DEP_FIX | GUI_DEP_STATS,
+    [GUI_SCR_ALL] = GUI_DEP_FIX | GUI_DEP_STATS,
+    [GUI_SCR_GPS_FIX] = GUI_DEP_FIX,
+    [GUI_SCR_GPS_SAT] = GUI_DEP_SAT,
+    [GUI_SCR_MAP] = GUI_DEP_STATS,
+    [GUI_SCR_PROFILE] = GUI_DEP_STATS,
+};
+
+uint8_t Gui_ScreensDeps(void)
+{
+    return guii_scr_deps[guii_scr];
 }
 
 bool Gui_Screens(gui_event_t event)
 {
-    static gui_screen_t scr = GUI_SCR_TODAY;
+    gui_screen_t scr = guii_scr;
+    gui_screen_t prev = scr;
     uint8_t bat_pct = 0;
 
     switch (event) {
@@ -180,25 +354,40 @@ bool Gui_Screens(gui_event_t event)
             }
             break;
         case GUI_EVT_SHORT_ENTER:
+            Gnss_SetSatOutput(false);
             return false;
             break;
         default:
             break;
     }
 
+    if (scr != prev) {
+        Layout_Invalidate();
+    }
+    guii_scr = scr;
+
+    /* Receiver sends satellite info only while it's shown */
+    Gnss_SetSatOutput(scr == GUI_SCR_GPS_SAT);
+
     switch (scr) {
         case GUI_SCR_TODAY:
-            Guii_DrawStats(bat_pct, Gps_Get(&gps_desc), Stats_Get(), true);
+            Guii_DrawStats(bat_pct, Gnss_Get(), Stats_Get(), true);
             break;
         case GUI_SCR_ALL:
-            Guii_DrawStats(bat_pct, Gps_Get(&gps_desc), Stats_Get(), false);
+            Guii_DrawStats(bat_pct, Gnss_Get(), Stats_Get(), false);
             break;
         case GUI_SCR_GPS_FIX:
-            Guii_DrawGpsFix(Gps_Get(&gps_desc));
+            Guii_DrawGpsFix(Gnss_Get());
             break;
         case GUI_SCR_GPS_SAT:
-            Guii_DrawGpsSat(Gps_GetSat(&gps_desc));
+            Guii_DrawGpsSat(Gnss_GetSat());
+            break;
+        case GUI_SCR_MAP:
+            Guii_DrawMap(Stats_GetTrack());
             break;
+        case GUI_SCR_PROFILE:
+            Guii_DrawProfile(Stats_GetElevationProfile(),
+                    Stats_GetSpeedProfile());
             break;
         default:
             break;
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file    app/i2c_dma.c
+ * @brief   Background I2C writes fed by DMA
+ *
+ * I2C1 TX is served by DMA1 channel 2. The prefix byte is written to TXDR
+ * before start so the DMA can read the data directly from the caller
+ * buffer, the transfer ends by automatic stop and STOPF interrupt. The
+ * I2C interrupt is enabled only while the write runs, the blocking I2C
+ * driver can be used in between.
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/stm32/i2c.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/syscfg.h>
+#include <libopencm3/cm3/nvic.h>
+
+#include "i2c_dma.h"
+
+#define I2C_DMA_I2C I2C1
+#define I2C_DMA_CHANNEL DMA_CHANNEL2
+/** I2C1 timing for 1 MHz at 16 and 48 MHz I2C clock (RM0091) */
+#define I2C_DMA_TIMING_FMP_16MHZ 0x00200204
+#define I2C_DMA_TIMING_FMP_48MHZ 0x50100103
+
+static volatile bool i2cdmai_busy;
+static i2c_dma_cb_t i2cdmai_cb;
+
+/**
+ * Write finished by stop, nack stops the transfer too
+ */
+void i2c1_isr(void)
+{
+    bool ok = (I2C_ISR(I2C_DMA_I2C) & I2C_ISR_NACKF) == 0;
+
+    if ((I2C_ISR(I2C_DMA_I2C) & I2C_ISR_STOPF) == 0) {
+        return;
+    }
+    I2C_CR1(I2C_DMA_I2C) &= ~(I2C_CR1_TXDMAEN | I2C_CR1_STOPIE);
+    I2C_ICR(I2C_DMA_I2C) = I2C_ICR_STOPCF | I2C_ICR_NACKCF;
+    /* Data left after nack */
+    I2C_ISR(I2C_DMA_I2C) |= I2C_ISR_TXE;
+    dma_disable_channel(DMA1, I2C_DMA_CHANNEL);
+
+    i2cdmai_busy = false;
+    if (i2cdmai_cb != NULL) {
+        i2cdmai_cb(ok);
+    }
+}
+
+bool I2cDma_Write(uint8_t address, uint8_t prefix, const uint8_t *data,
+        size_t len, i2c_dma_cb_t cb)
+{
+    if (i2cdmai_busy || len == 0 || len > 254) {
+        return false;
+    }
+    i2cdmai_busy = true;
+    i2cdmai_cb = cb;
+
+    dma_set_memory_address(DMA1, I2C_DMA_CHANNEL, (uint32_t) data);
+    dma_set_number_of_data(DMA1, I2C_DMA_CHANNEL, len);
+    dma_enable_channel(DMA1, I2C_DMA_CHANNEL);
+
+    I2C_TXDR(I2C_DMA_I2C) = prefix;
+    i2c_set_7bit_address(I2C_DMA_I2C, address);
+    i2c_set_write_transfer_dir(I2C_DMA_I2C);
+    i2c_set_bytes_to_transfer(I2C_DMA_I2C, len + 1);
+    i2c_enable_autoend(I2C_DMA_I2C);
+    I2C_CR1(I2C_DMA_I2C) |= I2C_CR1_TXDMAEN | I2C_CR1_STOPIE;
+    i2c_send_start(I2C_DMA_I2C);
+
+    return true;
+}
+
+bool I2cDma_Busy(void)
+{
+    return i2cdmai_busy;
+}
+
+void I2cDma_Wait(void)
+{
+    while (i2cdmai_busy) {
+        __asm__ volatile ("wfi");
+    }
+}
+
+void I2cDma_Init(bool fast_plus)
+{
+    /* I2C clock is derived from the peripheral clock like the other buses */
+    if (fast_plus) {
+        rcc_periph_clock_enable(RCC_SYSCFG_COMP);
+        SYSCFG_CFGR1 |= SYSCFG_CFGR1_I2C1_FMP;
+        i2c_peripheral_disable(I2C_DMA_I2C);
+        I2C_TIMINGR(I2C_DMA_I2C) = rcc_apb1_frequency > 16000000 ?
+                I2C_DMA_TIMING_FMP_48MHZ : I2C_DMA_TIMING_FMP_16MHZ;
+        i2c_peripheral_enable(I2C_DMA_I2C);
+    }
+
+    rcc_periph_clock_enable(RCC_DMA);
+    dma_channel_reset(DMA1, I2C_DMA_CHANNEL);
+    dma_set_peripheral_address(DMA1, I2C_DMA_CHANNEL,
+            (uint32_t) &I2C_TXDR(I2C_DMA_I2C));
+    dma_set_read_from_memory(DMA1, I2C_DMA_CHANNEL);
+    dma_enable_memory_increment_mode(DMA1, I2C_DMA_CHANNEL);
+    dma_set_peripheral_size(DMA1, I2C_DMA_CHANNEL, DMA_CCR_PSIZE_8BIT);
+    dma_set_memory_size(DMA1, I2C_DMA_CHANNEL, DMA_CCR_MSIZE_8BIT);
+    dma_set_priority(DMA1, I2C_DMA_CHANNEL, DMA_CCR_PL_LOW);
+    nvic_enable_irq(NVIC_I2C1_IRQ);
+}
+
+/** @} */
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file    app/i2c_dma.h
+ * @brief   Background I2C writes fed by DMA
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#ifndef __APP_I2C_DMA_H_
+#define __APP_I2C_DMA_H_
+
+#include <types.h>
+
+/**
+ * Write finished, called from interrupt
+ *
+ * @param ok    False if the device didn't acknowledge
+ */
+typedef void (*i2c_dma_cb_t)(bool ok);
+
+/**
+ * Start writing to the device, prefix byte is sent before data
+ *
+ * Data must stay valid until the callback is called, only one write can run
+ * at a time.
+ *
+ * @param address   7 bit device address
+ * @param prefix    First byte (e.g. register or control byte)
+ * @param data      Rest of the data
+ * @param len       Length of data, up to 254 bytes
+ * @param cb        Completion callback
+ * @return False if write could not be started
+ */
+extern bool I2cDma_Write(uint8_t address, uint8_t prefix, const uint8_t *data,
+        size_t len, i2c_dma_cb_t cb);
+
+/**
+ * Check if write is running
+ */
+extern bool I2cDma_Busy(void);
+
+/**
+ * Sleep until running write is finished
+ */
+extern void I2cDma_Wait(void);
+
+/**
+ * Set up DMA for I2C1, call after every I2C initialization
+ *
+ * @param fast_plus     Use 1 MHz clock (fast mode plus)
+ */
+extern void I2cDma_Init(bool fast_plus);
+
+#endif
+
+/** @} */
@@ -22,7 +22,11 @@
  * @addtogroup utils
  * @{
  */
+#include <string.h>
 #include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/exti.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/cortex.h>
 
 #include <hal/io.h>
 #include <hal/i2c.h>
@@ -34,127 +38,450 @@
 #include <modules/uf2.h>
 #include <drivers/spi_flash.h>
 #include <drivers/ssd1306.h>
-#include <drivers/gps.h>
 #include <utils/time.h>
 #include <utils/button.h>
 #include <modules/ramdisk.h>
 #include "storage.h"
 #include "stats.h"
+#include "tracks.h"
+#include "gpx.h"
+#include "sync.h"
 #include "usb.h"
-#include "gui/gui.h"
+#include "i2c_dma.h"
+#include "power.h"
+#include "sched.h"
+#include "config.h"
+#include "gps/gpsctl.h"
+#include "gps/gnss.h"
+#include "gps/assist.h"
+#include "gps/filter.h"
+#include "gps/simplify.h"
+#include "gui/display.h"
+#include "gui/dispctl.h"
 #include "gui/gui.h"
 #include "utils/assert.h"
 #include "version.h"
 
-gps_desc_t gps_desc;
+/** Time after button event for which buttons are polled */
+#define BUTTON_ACTIVE_MS 3000
+/** Button polling period */
+#define BUTTON_POLL_MS 5
+/**
+ * GPS ring polling period while receiver is running, DMA wakes the system
+ * every half of the ring, polling picks up the rest of the burst
+ */
+#define GPS_POLL_MS 100
+
 spiflash_desc_t spiflash_desc;
 ssd1306_desc_t ssd1306_desc;
 
+static const gpsctl_config_t gpsctl_config = {
+    .interval_s = GPS_INTERVAL_S,
+    .interval_min_s = GPS_INTERVAL_MIN_S,
+    .interval_max_s = GPS_INTERVAL_MAX_S,
+    .ref_speed_dms = GPS_REF_SPEED_DMS,
+    .still_speed_dms = GPS_STILL_SPEED_DMS,
+    .hdop_max_dm = FILTER_HDOP_MAX_DM,
+    .sats_min = FILTER_SATS_MIN,
+    .timeout_s = GPS_FIX_TIMEOUT_S,
+    .hot_window_s = GPS_HOT_WINDOW_S,
+};
+
+static const kalman_config_t kalman_config = {
+    .uere_dm = KALMAN_UERE_DM,
+    .accel_dms2 = KALMAN_ACCEL_DMS2,
+    .reset_s = KALMAN_RESET_S,
+};
+
+static const filter_config_t filter_config = {
+    .hdop_max_dm = FILTER_HDOP_MAX_DM,
+    .sats_min = FILTER_SATS_MIN,
+    .speed_max_dms = FILTER_SPEED_MAX_DMS,
+    .min_dist_m = FILTER_MIN_DIST_M,
+    .move_dist_m = FILTER_MOVE_DIST_M,
+    .keepalive_s = FILTER_KEEPALIVE_S,
+    .kalman = &kalman_config,
+};
+
+static const simplify_config_t simplify_config = {
+    .tolerance_m = SIMPLIFY_TOLERANCE_M,
+    .vtolerance_m = SIMPLIFY_VTOLERANCE_M,
+    .max_interval_s = SIMPLIFY_MAX_INTERVAL_S,
+};
+
+static const dispctl_config_t dispctl_config = {
+    .timeout_s = DISPCTL_TIMEOUT_S,
+    .on_ua = DISPCTL_ON_UA,
+    .off_ua = DISPCTL_OFF_UA,
+};
+
+static void addReadme(void)
+{
+    const char *readme = "GLogger gps logger by deadbadger.cz, for more info "
+            "check out deadbadger.cz/projects/glogger.\n\n"
+            "TRACKS.GPX contains all records, NEW.GPX only records not yet "
+            "acknowledged. Write a file containing " SYNC_ACK_MAGIC " to "
+            "acknowledge the content of NEW.GPX.";
+
+    Ramdisk_AddTextFile("README", "TXT", 0, readme);
+}
+
 /**
- * Configure system clock
- *
- * External 16 MHz used to generate precise 48 MHz for USB
- * System clock running directly from crystal (16 MHz)
+ * Store the last point held by track simplification
  */
-static void setClock(void)
+static void storeFlush(void)
 {
-    /* Enable crystal oscillator and use it as a system clock */
-    rcc_osc_on(RCC_HSE);
-    rcc_wait_for_osc_ready(RCC_HSE);
-    rcc_set_sysclk_source(RCC_HSE);
+    const gps_info_t *point = Simplify_Flush();
+
+    if (point != NULL) {
+        Usb_Lock();
+        Storage_Add(point);
+        Stats_Update(point);
+        Tracks_Update();
+        Usb_Unlock();
+    }
+}
 
-    rcc_apb1_frequency = 16000000;
-    rcc_ahb_frequency = 16000000;
+static void guiTask(void);
 
-    /* No prescalers for system clock and peripherals */
-    rcc_set_hpre(RCC_CFGR_HPRE_NODIV);
-    rcc_set_ppre(RCC_CFGR_PPRE_NODIV);
+static sched_task_t gui_task = {
+    .cb = guiTask,
+    .period_ms = 0,
+    .events = 0,
+};
+
+/**
+ * Draw queued GUI events, rate limited redraw is postponed
+ */
+static void guiTask(void)
+{
+    uint32_t delay = Gui_Process(Power_Millis());
 
-    /* Setup PLL to generate 48 MHz for usb */
-    rcc_set_pll_multiplication_factor(RCC_CFGR_PLLMUL_MUL6);
-    rcc_set_pll_source(RCC_CFGR_PLLSRC_HSE_CLK);
-    rcc_set_prediv(RCC_CFGR2_PREDIV_DIV2);
-    rcc_osc_on(RCC_PLL);
-    rcc_wait_for_osc_ready(RCC_PLL);
-    rcc_set_usbclk_source(RCC_PLL);
+    if (delay != 0) {
+        Sched_Wake(&gui_task, delay);
+    }
 }
 
-static void addReadme(void)
+static void guiPost(gui_event_t event)
 {
-    const char *readme = "GLogger gps logger by deadbadger.cz, for more info "
-            "check out deadbadger.cz/projects/glogger.";
+    Gui_Post(event);
+    Sched_Wake(&gui_task, 0);
+}
 
-    Ramdisk_AddTextFile("README", "TXT", 0, readme);
+static void dispTask(void);
+
+static sched_task_t disp_task = {
+    .cb = dispTask,
+    .period_ms = 0,
+    .events = 0,
+};
+
+/**
+ * Switch the display off after inactivity, sleeps until the timeout
+ */
+static void dispTask(void)
+{
+    uint32_t delay = DispCtl_Process(Power_Millis());
+
+    if (delay != 0) {
+        Sched_Wake(&disp_task, delay);
+    }
+}
+
+/**
+ * Display power control, GUI draws nothing and receiver sends no satellite
+ * info while the display is off
+ */
+static void dispPower(bool on)
+{
+    Display_Power(on);
+    Gui_Sleep(!on);
+    if (on) {
+        Sched_Wake(&gui_task, 0);
+    } else {
+        Gnss_SetSatOutput(false);
+    }
+}
+
+/**
+ * Restart display inactivity timeout, button press which woke the display
+ * up is consumed including its release
+ *
+ * @param event     Button event
+ * @param consumed  Press consumed by wake up, kept per button
+ * @return Event to be processed
+ */
+static button_event_t btnActivity(button_event_t event, bool *consumed)
+{
+    if (event == BTN_NONE) {
+        return event;
+    }
+    if (event == BTN_PRESSED) {
+        *consumed = DispCtl_Activity(Power_Millis());
+    } else {
+        DispCtl_Activity(Power_Millis());
+    }
+    /* Timeout could change in menu */
+    Sched_Wake(&disp_task, 0);
+    return *consumed ? BTN_NONE : event;
 }
 
 static void btnCheck(void)
 {
     static button_t bt_next = { LINE_SW_NEXT, };
     static button_t bt_enter = { LINE_SW_ENTER, };
+    static bool next_consumed;
+    static bool enter_consumed;
     button_event_t event;
 
-    event = Button(&bt_next);
+    event = btnActivity(Button(&bt_next), &next_consumed);
     if (event == BTN_RELEASED_SHORT) {
-        Gui_Event(GUI_EVT_SHORT_NEXT);
+        guiPost(GUI_EVT_SHORT_NEXT);
     } else if (event == BTN_LONG_PRESS) {
-        Gui_Event(GUI_EVT_LONG_NEXT);
+        guiPost(GUI_EVT_LONG_NEXT);
     }
 
-    event = Button(&bt_enter);
+    event = btnActivity(Button(&bt_enter), &enter_consumed);
     if (event == BTN_RELEASED_SHORT) {
-        Gui_Event(GUI_EVT_SHORT_ENTER);
+        guiPost(GUI_EVT_SHORT_ENTER);
     } else if (event == BTN_LONG_PRESS) {
+        storeFlush();
         //TODO poweroff
     }
 }
 
-static void loop(void)
-{
-    uint32_t time = millis();
-    const gps_info_t *gps;
+static void gpsTask(void);
 
-    // turn on the gps
-    // while gps not valid
-        // sleep until woken up by interrupt, process nema, if not complete, sleep
-    //store gps position
-    //turn off the gps
-    //go to stop mode, wait for rtc to wake mcu up
+static sched_task_t gps_task = {
+    .cb = gpsTask,
+    .period_ms = 0,
+    .events = 1 << SCHED_EVT_UART_RX,
+};
 
-    //wake up sources - buttons in on mode, holding button in off mode
+/**
+ * Receiver is polled only while powered, the task sleeps until next fix slot
+ * otherwise
+ */
+static void gpsTask(void)
+{
+    static gps_sat_t sat;
+    const gps_info_t *gps = NULL;
+    const gps_info_t *point;
+    uint8_t changed = 0;
 
-    //read buttons, if pressed, turn on display, set turn off timer
+    if (Power_GetMode() == POWER_MODE_USB) {
+        return;
+    }
 
-    gps = Gps_Loop(&gps_desc);
+    if (GpsCtl_IsOn()) {
+        gps = Gnss_Loop();
+        if (memcmp(&sat, Gnss_GetSat(), sizeof(sat)) != 0) {
+            memcpy(&sat, Gnss_GetSat(), sizeof(sat));
+            changed |= GUI_DEP_SAT;
+        }
+    }
+    gps = GpsCtl_Process(gps, Power_Millis());
     if (gps != NULL) {
-        //TODO verify target has moved since last gps fix
-        Stats_Update(gps);
-        Storage_Add(gps);
-        Gui_Event(GUI_EVT_REDRAW);
+        if (GpsCtl_GetStats()->fixes == 1) {
+            Log_Info("GPS", "First fix in %lu ms",
+                    (unsigned long)GpsCtl_GetStats()->ttff_cold_ms);
+        }
+        point = Filter_Process(gps);
+        Usb_Lock();
+        if (point != NULL) {
+            point = Simplify_Process(point);
+        }
+        if (point != NULL) {
+            /* Stats from stored points match the ones rebuilt from storage */
+            Storage_Add(point);
+            Stats_Update(point);
+            Tracks_Update();
+            changed |= GUI_DEP_STATS;
+        }
+        Assist_Update(gps);
+        Usb_Unlock();
+        changed |= GUI_DEP_FIX;
+    }
+    if (changed != 0 && DispCtl_IsOn()) {
+        Gui_Changed(changed);
+        Sched_Wake(&gui_task, 0);
     }
 
-    if (time % 5 == 0) {
-        btnCheck();
+    if (GpsCtl_IsOn()) {
+        Sched_Wake(&gps_task, GPS_POLL_MS);
+    } else {
+        Sched_Wake(&gps_task, GpsCtl_GetDelayMs(Power_Millis()));
     }
 }
 
+static void ramdiskInit(void);
+
+/**
+ * Switch to faster clock and pause logging while docked to USB, files are
+ * refreshed before the host can see them
+ */
+static void usbCheck(void)
+{
+    bool connected = Power_UsbConnected();
+
+    if (connected && Power_GetMode() != POWER_MODE_USB) {
+        /* Host should see the whole track */
+        storeFlush();
+        Usb_Lock();
+        ramdiskInit();
+        Usb_Unlock();
+        Usb_Connect(true);
+        Power_SetMode(POWER_MODE_USB);
+        DispCtl_Activity(Power_Millis());
+        Gui_Popup("USB connected");
+    } else if (!connected && Power_GetMode() == POWER_MODE_USB) {
+        Usb_Connect(false);
+        Power_SetMode(POWER_MODE_LOW);
+        DispCtl_Activity(Power_Millis());
+        Gui_PopupClose();
+        Sched_Wake(&gps_task, 0);
+        Sched_Wake(&disp_task, 0);
+    }
+}
+
+/** Time of the last button line change */
+static volatile uint32_t button_edge;
+
+static void buttonTask(void);
+
+static sched_task_t button_task = {
+    .cb = buttonTask,
+    .period_ms = 0,
+    .events = 1 << SCHED_EVT_BUTTON,
+};
+
+/**
+ * Buttons are polled for debouncing and long press detection only for a
+ * while after the button line changed
+ */
+static void buttonTask(void)
+{
+    btnCheck();
+    if (Power_Millis() - button_edge < BUTTON_ACTIVE_MS) {
+        Sched_Wake(&button_task, BUTTON_POLL_MS);
+    }
+}
+
+static sched_task_t usb_con_task = {
+    .cb = usbCheck,
+    .period_ms = 500,
+    .events = 1 << SCHED_EVT_USB_CON,
+};
+
+static sched_task_t display_task = {
+    .cb = Display_Process,
+    .period_ms = 0,
+    .events = 1 << SCHED_EVT_DISPLAY,
+};
+
+static sched_task_t usb_task = {
+    .cb = Usb_Process,
+    .period_ms = 0,
+    .events = 1 << SCHED_EVT_USB,
+};
+
+/**
+ * Display sent the frame, postponed flush can go
+ */
+static void displayIdle(void)
+{
+    Sched_Event(SCHED_EVT_DISPLAY);
+}
+
+/**
+ * Sleep until next event or ms, stop mode is used only when receiver is off
+ * and no display transfer runs in background
+ */
+static void sleep(uint32_t ms)
+{
+    bool stop = !GpsCtl_IsOn() && !I2cDma_Busy();
+
+    cm_disable_interrupts();
+    if (!Sched_Pending()) {
+        Power_Sleep(ms, stop);
+    }
+    cm_enable_interrupts();
+}
+
+/**
+ * Buttons and USB_CON line interrupts
+ */
+void exti4_15_isr(void)
+{
+    if (exti_get_flag_status(EXTI13)) {
+        Sched_Event(SCHED_EVT_USB_CON);
+    }
+    if (exti_get_flag_status(EXTI8 | EXTI15)) {
+        button_edge = Power_Millis();
+        Sched_Event(SCHED_EVT_BUTTON);
+    }
+    exti_reset_request(EXTI8 | EXTI13 | EXTI15);
+}
+
+/**
+ * Configure wake up interrupts on button and USB_CON lines
+ */
+static void extiInit(void)
+{
+    rcc_periph_clock_enable(RCC_SYSCFG_COMP);
+    /* SW_NEXT on PB8, USB_CON on PB13, SW_ENTER on PA15 */
+    exti_select_source(EXTI8 | EXTI13, GPIOB);
+    exti_select_source(EXTI15, GPIOA);
+    exti_set_trigger(EXTI8 | EXTI13 | EXTI15, EXTI_TRIGGER_BOTH);
+    exti_enable_request(EXTI8 | EXTI13 | EXTI15);
+    nvic_enable_irq(NVIC_EXTI4_15_IRQ);
+}
+
 static void fw_read(uint32_t offset, uint8_t *buf, size_t len)
 {
     (void)len;
     UF2_Read(buf, offset/512);
 }
 
+/** Amount of records in TRACKS.GPX, file size can't change once exposed */
+static uint32_t gpx_records;
+
+static void gpx_read(uint32_t offset, uint8_t *buf, size_t len)
+{
+    GPX_GetRange(0, gpx_records, offset, buf, len);
+}
+
 static void ramdisk_write(const uint8_t *buf, size_t size, uint32_t offset)
 {
-    (void)size;
     (void)offset;
+    if (Sync_Write(buf, size)) {
+        return;
+    }
     UF2_Write(buf);
 }
 
+/**
+ * Expose files with records stored so far, ramdisk can't resize files so
+ * the whole disk is created again, host must be detached meanwhile
+ */
+static void ramdiskInit(void)
+{
+    Ramdisk_Init(64000000, "GLogger");
+    Ramdisk_RegisterWriteCb(ramdisk_write);
+    addReadme();
+    Ramdisk_AddFile("fw", "uf2", 0, UF2_GetImgSize(), fw_read);
+    gpx_records = Storage_SpaceUsed();
+    Ramdisk_AddFile("TRACKS", "GPX", 0, GPX_GetRangeSize(0, gpx_records),
+            gpx_read);
+    Sync_Init();
+    Ramdisk_AddFile("NEW", "GPX", 0, Sync_GetSize(), Sync_Get);
+}
+
 int main(void)
 {
     static uint8_t fbuf[SSD1306_FBUF_SIZE];
     /* Initialize clock system, IO pins and systick */
-    setClock();
+    Power_Init();
     IOd_Init();
     Time_Init();
 
@@ -165,9 +492,7 @@ int main(void)
     Log_Info(NULL, "GLogger, fw version %d.%d", FW_MAJOR, FW_MINOR);
     Log_Info(NULL, "Deadbadger.cz");
 
-    I2Cd_Init(1, true);
-    SPId_Init(1, SPID_PRESC_2, SPI_MODE_0);
-    UARTd_Init(USART_GPS_TX, 9600);
+    Power_InitPeriph();
     RTCd_Init(false);
 
     if (SSD1306_Init(&ssd1306_desc, fbuf, 1,
@@ -176,26 +501,46 @@ int main(void)
     } else {
         SSD1306_SetOrientation(&ssd1306_desc, true);
         SSD1306_DispEnable(&ssd1306_desc, true);
+        Display_Init(&ssd1306_desc, fbuf, displayIdle);
     }
     Gui_Init();
+    DispCtl_Init(&dispctl_config, dispPower, Power_Millis());
 
-    Gps_Init(&gps_desc, USART_GPS_RX);
     SpiFlash_Init(&spiflash_desc, 1, LINE_FLASH_CS);
     SpiFlash_WriteUnlock(&spiflash_desc);
     Storage_Init();
+    Tracks_Init();
+
+    /* Last position is needed for assistance */
+    Gnss_Init(GNSS_PROTOCOL);
+    GpsCtl_Init(&gpsctl_config, Gnss_Power, Power_Millis());
+    Filter_Init(&filter_config);
+    Simplify_Init(&simplify_config);
+    if (Assist_Inject(GNSS_PROTOCOL)) {
+        Log_Info("GPS", "Receiver start assisted");
+    }
     //Stats_Init();
 
-    Ramdisk_Init(64000000, "GLogger");
-    Ramdisk_RegisterWriteCb(ramdisk_write);
-    addReadme();
-    Ramdisk_AddFile("fw", "uf2", 0, UF2_GetImgSize(), fw_read);
+    ramdiskInit();
     Usb_Init();
 
-    Gui_Event(GUI_EVT_REDRAW);
+    Sched_Init(Power_Millis, sleep);
+    Sched_Add(&gps_task);
+    Sched_Wake(&gps_task, 0);
+    Sched_Add(&button_task);
+    Sched_Add(&usb_con_task);
+    Sched_Add(&usb_task);
+    Sched_Add(&display_task);
+    Sched_Add(&gui_task);
+    Sched_Add(&disp_task);
+    Sched_Wake(&disp_task, 0);
+    extiInit();
+    Sched_Event(SCHED_EVT_USB_CON);
+
+    guiPost(GUI_EVT_REDRAW);
     Log_Info(NULL, "System initialized, running main loop");
     while (1) {
-        loop();
-        Usb_Poll();
+        Sched_Run();
     }
 }
 
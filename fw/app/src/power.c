@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/power.c
+ * @brief   System clock and power profiles
+ *
+ * External 16 MHz is used to generate precise 48 MHz for USB by PLL. On
+ * battery the system clock runs directly from crystal, when docked the
+ * power doesn't matter and system runs from PLL for faster downloads.
+ *
+ * Longer sleeps on battery use stop mode, all clocks except RTC are
+ * stopped and the core is woken by RTC wakeup timer or by EXTI lines
+ * (buttons, USB_CON). Systick doesn't run meanwhile, time slept is taken
+ * from RTC and added to millis().
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/flash.h>
+#include <libopencm3/stm32/pwr.h>
+#include <libopencm3/stm32/rtc.h>
+#include <libopencm3/stm32/exti.h>
+#include <libopencm3/cm3/systick.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/scb.h>
+
+#include <hal/io.h>
+#include <hal/i2c.h>
+#include <hal/spi.h>
+#include <hal/uart.h>
+#include <modules/log.h>
+#include <utils/time.h>
+#include "config.h"
+#include "i2c_dma.h"
+#include "usb.h"
+#include "power.h"
+#include "sched.h"
+#include "gps/gnss.h"
+
+/** Longest stop, wakeup timer runs from RTCCLK/16 with 16 bit reload */
+#define POWER_STOP_MAX_TICKS 0xffff
+
+static power_mode_t poweri_mode = POWER_MODE_LOW;
+/** Time spent in stop mode, systick is not running there */
+static volatile uint32_t poweri_stop_ms;
+
+/**
+ * Run system clock from 16 MHz crystal
+ */
+static void Poweri_ClockLow(void)
+{
+    rcc_set_sysclk_source(RCC_HSE);
+    rcc_apb1_frequency = 16000000;
+    rcc_ahb_frequency = 16000000;
+    flash_set_ws(FLASH_ACR_LATENCY_000_024MHZ);
+}
+
+/**
+ * Run system clock from 48 MHz PLL, it is off after stop mode
+ */
+static void Poweri_ClockHigh(void)
+{
+    rcc_osc_on(RCC_PLL);
+    rcc_wait_for_osc_ready(RCC_PLL);
+    flash_prefetch_enable();
+    flash_set_ws(FLASH_ACR_LATENCY_024_048MHZ);
+    rcc_set_sysclk_source(RCC_PLL);
+    while (rcc_system_clock_source() != RCC_PLL) {
+        ;
+    }
+    rcc_apb1_frequency = 48000000;
+    rcc_ahb_frequency = 48000000;
+}
+
+/**
+ * Get RTC time of day in ms, calendar shadow registers must be in sync
+ */
+static uint32_t Poweri_RtcMs(void)
+{
+    uint32_t prediv_s = RTC_PRER & 0x7fff;
+    /* Reading SSR locks TR until DR is read */
+    uint32_t ss = RTC_SSR & 0xffff;
+    uint32_t tr = RTC_TR;
+    uint32_t sec;
+
+    (void) RTC_DR;
+    sec = ((tr >> 20) & 0x3)*36000 + ((tr >> 16) & 0xf)*3600 +
+            ((tr >> 12) & 0x7)*600 + ((tr >> 8) & 0xf)*60 +
+            ((tr >> 4) & 0x7)*10 + (tr & 0xf);
+    return sec*1000 + (prediv_s - ss)*1000/(prediv_s + 1);
+}
+
+/**
+ * Program RTC wakeup timer, 0 ticks to disable it
+ */
+static void Poweri_WakeupTimer(uint32_t ticks)
+{
+    pwr_disable_backup_domain_write_protect();
+    rtc_unlock();
+    RTC_CR &= ~(RTC_CR_WUTE | RTC_CR_WUTIE);
+    rtc_clear_wakeup_flag();
+    if (ticks != 0) {
+        rtc_set_wakeup_time(ticks - 1, RTC_CR_WUCLKSEL_RTC_DIV16);
+        RTC_CR |= RTC_CR_WUTIE;
+    }
+    rtc_lock();
+    pwr_enable_backup_domain_write_protect();
+    exti_reset_request(EXTI20);
+}
+
+/**
+ * Stop all clocks until wakeup timer or other EXTI line, restart crystal
+ */
+static void Poweri_Stop(uint32_t ms)
+{
+    uint32_t prer = RTC_PRER;
+    /* ck_spre is 1 Hz, so RTCCLK is given by the prescalers */
+    uint32_t rtcclk = (((prer >> 16) & 0x7f) + 1)*((prer & 0x7fff) + 1);
+    uint32_t ticks = (uint64_t) ms*rtcclk/16/1000;
+    uint32_t start;
+    uint32_t slept;
+
+    if (ticks > POWER_STOP_MAX_TICKS) {
+        ticks = POWER_STOP_MAX_TICKS;
+    }
+    if (ticks == 0) {
+        __asm__ volatile ("wfi");
+        return;
+    }
+
+    start = Poweri_RtcMs();
+    Poweri_WakeupTimer(ticks);
+    pwr_set_stop_mode();
+    pwr_voltage_regulator_low_power_in_stop();
+    SCB_SCR |= SCB_SCR_SLEEPDEEP;
+    __asm__ volatile ("wfi");
+    SCB_SCR &= ~SCB_SCR_SLEEPDEEP;
+
+    /* System runs from HSI after stop */
+    rcc_osc_on(RCC_HSE);
+    rcc_wait_for_osc_ready(RCC_HSE);
+    Poweri_ClockLow();
+    Poweri_WakeupTimer(0);
+
+    rtc_wait_for_synchro();
+    slept = Poweri_RtcMs() - start;
+    if ((int32_t) slept < 0) {
+        /* Midnight */
+        slept += 86400000;
+    }
+    poweri_stop_ms += slept;
+}
+
+/**
+ * RTC wakeup timer ended stop mode
+ */
+void rtc_isr(void)
+{
+    exti_reset_request(EXTI20);
+    Sched_Event(SCHED_EVT_RTC_ALARM);
+}
+
+uint32_t Power_Millis(void)
+{
+    return millis() + poweri_stop_ms;
+}
+
+void Power_Sleep(uint32_t ms, bool allow_stop)
+{
+    /* PLL has to run for USB, stop wouldn't save anything noticeable */
+    if (!allow_stop || poweri_mode != POWER_MODE_LOW ||
+            ms < POWER_STOP_MIN_MS) {
+        __asm__ volatile ("wfi");
+        return;
+    }
+    Poweri_Stop(ms);
+}
+
+bool Power_UsbConnected(void)
+{
+    return IOd_GetLine(LINE_USB_CON);
+}
+
+void Power_SetMode(power_mode_t mode)
+{
+    if (mode == poweri_mode) {
+        return;
+    }
+
+    /* No transfers can run while clocks are changing */
+    Usb_Lock();
+    I2cDma_Wait();
+    if (mode == POWER_MODE_USB) {
+        Poweri_ClockHigh();
+    } else {
+        Poweri_ClockLow();
+    }
+    poweri_mode = mode;
+    Power_InitPeriph();
+    Usb_Unlock();
+
+    Log_Info("PWR", "Running at %lu MHz",
+            (unsigned long)rcc_ahb_frequency/1000000);
+}
+
+power_mode_t Power_GetMode(void)
+{
+    return poweri_mode;
+}
+
+void Power_InitPeriph(void)
+{
+    systick_set_frequency(1000, rcc_ahb_frequency);
+
+    /* Baudrates and bus speeds are derived from the peripheral clock */
+    UARTd_Init(USART_DEBUG_TX, 115200);
+    UARTd_Init(USART_GPS_TX, Gnss_GetBaudrate());
+    Gnss_InitUart();
+    I2Cd_Init(1, true);
+    I2cDma_Init(I2C_FAST_PLUS);
+    /* 8 MHz on battery, 24 MHz when docked */
+    SPId_Init(1, SPID_PRESC_2, SPI_MODE_0);
+}
+
+void Power_Init(void)
+{
+    /* Enable crystal oscillator and use it as a system clock */
+    rcc_osc_on(RCC_HSE);
+    rcc_wait_for_osc_ready(RCC_HSE);
+    rcc_set_sysclk_source(RCC_HSE);
+
+    rcc_apb1_frequency = 16000000;
+    rcc_ahb_frequency = 16000000;
+
+    /* No prescalers for system clock and peripherals */
+    rcc_set_hpre(RCC_CFGR_HPRE_NODIV);
+    rcc_set_ppre(RCC_CFGR_PPRE_NODIV);
+
+    /* Setup PLL to generate 48 MHz for usb */
+    rcc_set_pll_multiplication_factor(RCC_CFGR_PLLMUL_MUL6);
+    rcc_set_pll_source(RCC_CFGR_PLLSRC_HSE_CLK);
+    rcc_set_prediv(RCC_CFGR2_PREDIV_DIV2);
+    rcc_osc_on(RCC_PLL);
+    rcc_wait_for_osc_ready(RCC_PLL);
+    rcc_set_usbclk_source(RCC_PLL);
+
+    /* RTC wakeup timer is routed through EXTI line 20 */
+    rcc_periph_clock_enable(RCC_PWR);
+    exti_set_trigger(EXTI20, EXTI_TRIGGER_RISING);
+    exti_enable_request(EXTI20);
+    nvic_enable_irq(NVIC_RTC_IRQ);
+
+    poweri_mode = POWER_MODE_LOW;
+}
+
+/** @} */
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/power.h
+ * @brief   System clock and power profiles
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#ifndef __APP_POWER_H_
+#define __APP_POWER_H_
+
+#include <types.h>
+
+typedef enum {
+    POWER_MODE_LOW,     /**< Running from battery, 16 MHz from crystal */
+    POWER_MODE_USB,     /**< Docked to USB, 48 MHz from PLL */
+} power_mode_t;
+
+/**
+ * Check if device is connected to USB host (USB_CON line)
+ *
+ * @return True if connected
+ */
+extern bool Power_UsbConnected(void);
+
+/**
+ * Switch system clock and reconfigure peripherals for given mode
+ *
+ * @param mode      Mode to be used
+ */
+extern void Power_SetMode(power_mode_t mode);
+
+/**
+ * Get currently used power mode
+ *
+ * @return Power mode
+ */
+extern power_mode_t Power_GetMode(void);
+
+/**
+ * Get time in ms, continues over stop mode unlike millis()
+ *
+ * @return Time since boot in ms
+ */
+extern uint32_t Power_Millis(void);
+
+/**
+ * Sleep until interrupt, for ms at most
+ *
+ * Stop mode woken by RTC wakeup timer is used on battery for sleeps longer
+ * than POWER_STOP_MIN_MS, systick doesn't run then. Call with interrupts
+ * disabled after checking for pending work, pending interrupt ends the
+ * sleep and is served after interrupts are enabled again.
+ *
+ * @param ms            Max time to sleep
+ * @param allow_stop    No peripheral needs the bus clock (UART reception,
+ *                      DMA transfers), stop mode can be used
+ */
+extern void Power_Sleep(uint32_t ms, bool allow_stop);
+
+/**
+ * Configure peripherals depending on system clock, call after init of the
+ * drivers and after every clock change
+ */
+extern void Power_InitPeriph(void);
+
+/**
+ * Configure clock system for low power mode, PLL running for USB only
+ */
+extern void Power_Init(void);
+
+#endif
+
+/** @} */
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/profile.c
+ * @brief   Min/max downsampling of a value along the track for plotting
+ *
+ * Samples are split to buckets of the same width, only the lowest and the
+ * highest sample of each bucket is kept, so peaks are never lost when the
+ * bucket is drawn as a vertical line in one column. When all buckets are
+ * full, pairs of them are merged and the bucket width doubles, the whole
+ * track is always covered in constant memory. Adding the sample is O(1),
+ * amortized over the merges.
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#include <string.h>
+
+#include "profile.h"
+
+/**
+ * Merge pairs of buckets, the bucket width doubles
+ */
+static void Profilei_Merge(profile_t *prof)
+{
+    for (uint16_t i = 0; i < prof->count/2; i++) {
+        prof->min[i] = prof->min[2*i] < prof->min[2*i + 1] ?
+                prof->min[2*i] : prof->min[2*i + 1];
+        prof->max[i] = prof->max[2*i] > prof->max[2*i + 1] ?
+                prof->max[2*i] : prof->max[2*i + 1];
+    }
+    prof->count /= 2;
+    prof->width *= 2;
+}
+
+void Profile_Add(profile_t *prof, int16_t value)
+{
+    uint16_t last;
+
+    if (prof->total == 0) {
+        prof->lo = value;
+        prof->hi = value;
+    }
+    prof->lo = value < prof->lo ? value : prof->lo;
+    prof->hi = value > prof->hi ? value : prof->hi;
+    prof->total++;
+
+    if (prof->count == 0 || prof->filled >= prof->width) {
+        /* Sample index is a multiple of the doubled width as well */
+        if (prof->count == PROFILE_BUCKETS) {
+            Profilei_Merge(prof);
+        }
+        prof->min[prof->count] = value;
+        prof->max[prof->count] = value;
+        prof->count++;
+        prof->filled = 1;
+        return;
+    }
+
+    last = prof->count - 1;
+    prof->min[last] = value < prof->min[last] ? value : prof->min[last];
+    prof->max[last] = value > prof->max[last] ? value : prof->max[last];
+    prof->filled++;
+}
+
+void Profile_Reset(profile_t *prof)
+{
+    memset(prof, 0, sizeof(*prof));
+    prof->width = 1;
+}
+
+/** @} */
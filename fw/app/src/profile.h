@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/profile.h
+ * @brief   Min/max downsampling of a value along the track for plotting
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#ifndef __APP_PROFILE_H_
+#define __APP_PROFILE_H_
+
+#include <types.h>
+
+/** Amount of buckets, one per display column, min and max is kept for each */
+#define PROFILE_BUCKETS 128
+
+typedef struct {
+    int16_t min[PROFILE_BUCKETS];
+    int16_t max[PROFILE_BUCKETS];
+    uint16_t count;             /**< Buckets used, the last one can be partial */
+    uint32_t width;             /**< Samples per full bucket */
+    uint32_t filled;            /**< Samples in the last bucket */
+    uint32_t total;             /**< Amount of added samples */
+    int16_t lo;                 /**< Lowest of all samples */
+    int16_t hi;                 /**< Highest of all samples */
+} profile_t;
+
+/**
+ * Add sample, neighboring buckets are merged and the bucket width doubles
+ * once all buckets are full
+ *
+ * @param prof      Profile
+ * @param value     New sample
+ */
+extern void Profile_Add(profile_t *prof, int16_t value);
+
+/**
+ * Forget all samples
+ *
+ * @param prof      Profile
+ */
+extern void Profile_Reset(profile_t *prof);
+
+#endif
+
+/** @} */
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/readahead.c
+ * @brief   Sector read ahead for the mass storage transfers
+ *
+ * Hosts read files sequentially, sectors of the GPX files are expensive to
+ * generate. Next sector is generated while current one is being sent
+ * packet by packet, the host doesn't have to wait for it when requested.
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#include <string.h>
+#include "readahead.h"
+
+static readahead_read_cb_t readaheadi_read_cb;
+static readahead_write_cb_t readaheadi_write_cb;
+static uint32_t readaheadi_sectors;
+static readahead_stats_t readaheadi_stats;
+
+/** Prefetched sector */
+static uint8_t readaheadi_buf[READAHEAD_SECTOR_SIZE];
+static uint32_t readaheadi_lba;
+static bool readaheadi_valid;
+static bool readaheadi_result;
+/** Sector to be generated by Readahead_Process */
+static uint32_t readaheadi_next;
+static bool readaheadi_pending;
+
+bool Readahead_Read(uint32_t lba, uint8_t *buf)
+{
+    bool ret;
+
+    readaheadi_stats.reads++;
+    if (readaheadi_valid && readaheadi_lba == lba) {
+        memcpy(buf, readaheadi_buf, READAHEAD_SECTOR_SIZE);
+        readaheadi_stats.hits++;
+        ret = readaheadi_result;
+    } else {
+        ret = readaheadi_read_cb(lba, buf);
+    }
+
+    readaheadi_valid = false;
+    readaheadi_next = lba + 1;
+    readaheadi_pending = readaheadi_next < readaheadi_sectors;
+    return ret;
+}
+
+bool Readahead_Write(uint32_t lba, const uint8_t *buf)
+{
+    readaheadi_valid = false;
+    readaheadi_pending = false;
+    return readaheadi_write_cb(lba, buf);
+}
+
+bool Readahead_Process(void)
+{
+    if (!readaheadi_pending) {
+        return false;
+    }
+
+    readaheadi_pending = false;
+    readaheadi_lba = readaheadi_next;
+    readaheadi_result = readaheadi_read_cb(readaheadi_lba, readaheadi_buf);
+    readaheadi_valid = true;
+    readaheadi_stats.prefetched++;
+    return true;
+}
+
+const readahead_stats_t *Readahead_GetStats(void)
+{
+    return &readaheadi_stats;
+}
+
+void Readahead_Init(readahead_read_cb_t read_cb,
+        readahead_write_cb_t write_cb, uint32_t sectors)
+{
+    readaheadi_read_cb = read_cb;
+    readaheadi_write_cb = write_cb;
+    readaheadi_sectors = sectors;
+    readaheadi_valid = false;
+    readaheadi_pending = false;
+    memset(&readaheadi_stats, 0, sizeof(readaheadi_stats));
+}
+
+/** @} */
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/readahead.h
+ * @brief   Sector read ahead for the mass storage transfers
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#ifndef __APP_READAHEAD_H_
+#define __APP_READAHEAD_H_
+
+#include <types.h>
+
+/** Size of the mass storage sector */
+#define READAHEAD_SECTOR_SIZE 512
+
+/** Sector read callback, same as Ramdisk_Read */
+typedef bool (*readahead_read_cb_t)(uint32_t lba, uint8_t *buf);
+
+/** Sector write callback, same as Ramdisk_Write */
+typedef bool (*readahead_write_cb_t)(uint32_t lba, const uint8_t *buf);
+
+typedef struct {
+    uint32_t reads;         /**< Sectors requested by host */
+    uint32_t hits;          /**< Sectors served from read ahead buffer */
+    uint32_t prefetched;    /**< Sectors generated ahead */
+} readahead_stats_t;
+
+/**
+ * Read sector, served from buffer if already prefetched
+ *
+ * Schedules read of the following sector
+ *
+ * @param lba       Sector address
+ * @param buf       Buffer to store data to (READAHEAD_SECTOR_SIZE)
+ * @return  False on failure
+ */
+extern bool Readahead_Read(uint32_t lba, uint8_t *buf);
+
+/**
+ * Write sector, invalidates the read ahead buffer
+ *
+ * @param lba       Sector address
+ * @param buf       Data to be written (READAHEAD_SECTOR_SIZE)
+ * @return  False on failure
+ */
+extern bool Readahead_Write(uint32_t lba, const uint8_t *buf);
+
+/**
+ * Generate scheduled sector, call when not serving a request
+ *
+ * @return True if there was some work done
+ */
+extern bool Readahead_Process(void);
+
+/**
+ * Get read ahead statistics
+ *
+ * @return Statistics
+ */
+extern const readahead_stats_t *Readahead_GetStats(void);
+
+/**
+ * Initialize read ahead
+ *
+ * @param read_cb   Backing sector read
+ * @param write_cb  Backing sector write
+ * @param sectors   Amount of sectors of the disk
+ */
+extern void Readahead_Init(readahead_read_cb_t read_cb,
+        readahead_write_cb_t write_cb, uint32_t sectors);
+
+#endif
+
+/** @} */
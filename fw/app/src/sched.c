@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/sched.c
+ * @brief   Tickless event scheduler
+ *
+ * Tasks are run when their timer expires or when event they listen to
+ * occurs, the time until the next deadline is spent in sleep. Time source
+ * and sleep are provided by user, the scheduler can run on simulated
+ * clock.
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#include <string.h>
+#include "sched.h"
+
+static sched_task_t *schedi_tasks[SCHED_MAX_TASKS];
+static uint8_t schedi_count;
+static sched_time_cb_t schedi_time_cb;
+static sched_sleep_cb_t schedi_sleep_cb;
+static sched_stats_t schedi_stats;
+/** Byte per event, single byte access is atomic against interrupts */
+static volatile uint8_t schedi_events[SCHED_EVT_COUNT];
+
+/**
+ * Check if time a is before b, handles overflow
+ */
+static bool Schedi_Before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+/**
+ * Collect pending events and clear them
+ *
+ * @return Mask of events
+ */
+static uint32_t Schedi_GetEvents(void)
+{
+    uint32_t mask = 0;
+
+    for (uint8_t i = 0; i < SCHED_EVT_COUNT; i++) {
+        if (schedi_events[i]) {
+            schedi_events[i] = 0;
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+}
+
+bool Sched_Add(sched_task_t *task)
+{
+    if (schedi_count >= SCHED_MAX_TASKS) {
+        return false;
+    }
+
+    task->armed = task->period_ms != 0;
+    task->next = schedi_time_cb() + task->period_ms;
+    schedi_tasks[schedi_count++] = task;
+    return true;
+}
+
+void Sched_Wake(sched_task_t *task, uint32_t delay_ms)
+{
+    task->next = schedi_time_cb() + delay_ms;
+    task->armed = true;
+}
+
+void Sched_Event(sched_evt_t event)
+{
+    schedi_events[event] = 1;
+}
+
+bool Sched_Pending(void)
+{
+    for (uint8_t i = 0; i < SCHED_EVT_COUNT; i++) {
+        if (schedi_events[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Sched_Run(void)
+{
+    uint32_t start = schedi_time_cb();
+    uint32_t now = start;
+    uint32_t events = Schedi_GetEvents();
+    uint32_t next = 0;
+    bool have_next = false;
+    sched_task_t *task;
+
+    for (uint8_t i = 0; i < schedi_count; i++) {
+        task = schedi_tasks[i];
+        if (task->armed && !Schedi_Before(now, task->next)) {
+            if (task->period_ms != 0) {
+                task->next += task->period_ms;
+                /* Don't try to catch up missed periods */
+                if (Schedi_Before(task->next, now)) {
+                    task->next = now + task->period_ms;
+                }
+            } else {
+                task->armed = false;
+            }
+        } else if ((task->events & events) == 0) {
+            continue;
+        }
+        task->cb();
+        schedi_stats.runs++;
+        now = schedi_time_cb();
+    }
+    schedi_stats.awake_ms += now - start;
+
+    /* Something happened while running tasks, don't sleep */
+    if (Sched_Pending()) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < schedi_count; i++) {
+        task = schedi_tasks[i];
+        if (task->armed && (!have_next || Schedi_Before(task->next, next))) {
+            next = task->next;
+            have_next = true;
+        }
+    }
+
+    if (have_next && !Schedi_Before(now, next)) {
+        return;
+    }
+
+    schedi_stats.wakeups++;
+    schedi_sleep_cb(have_next ? next - now : UINT32_MAX);
+    schedi_stats.sleep_ms += schedi_time_cb() - now;
+}
+
+const sched_stats_t *Sched_GetStats(void)
+{
+    return &schedi_stats;
+}
+
+void Sched_Init(sched_time_cb_t time_cb, sched_sleep_cb_t sleep_cb)
+{
+    schedi_time_cb = time_cb;
+    schedi_sleep_cb = sleep_cb;
+    schedi_count = 0;
+    memset(&schedi_stats, 0, sizeof(schedi_stats));
+    Schedi_GetEvents();
+}
+
+/** @} */
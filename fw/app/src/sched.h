@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/sched.h
+ * @brief   Tickless event scheduler
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#ifndef __APP_SCHED_H_
+#define __APP_SCHED_H_
+
+#include <types.h>
+
+/** Maximal amount of registered tasks */
+#define SCHED_MAX_TASKS 8
+
+/** Event sources able to wake the system */
+typedef enum {
+    SCHED_EVT_UART_RX,      /**< Data received from GPS */
+    SCHED_EVT_BUTTON,       /**< Button line changed */
+    SCHED_EVT_USB_CON,      /**< USB cable connected or disconnected */
+    SCHED_EVT_RTC_ALARM,    /**< RTC alarm */
+    SCHED_EVT_USB,          /**< USB transfer processed in interrupt */
+    SCHED_EVT_DISPLAY,      /**< Display transfer done, next can be sent */
+    SCHED_EVT_COUNT,
+} sched_evt_t;
+
+/** Get current time in ms */
+typedef uint32_t (*sched_time_cb_t)(void);
+
+/**
+ * Sleep until next event, for ms at most
+ *
+ * Can return earlier, scheduler sleeps again if nothing is due
+ */
+typedef void (*sched_sleep_cb_t)(uint32_t ms);
+
+/** Task to be run */
+typedef void (*sched_task_cb_t)(void);
+
+/** Task description, the memory must be valid while task is registered */
+typedef struct {
+    sched_task_cb_t cb;     /**< Task callback */
+    uint32_t period_ms;     /**< Period of running, 0 for not periodic */
+    uint32_t events;        /**< Events mask (1 << sched_evt_t) running task */
+    /* internal */
+    uint32_t next;          /**< Time of the next run */
+    bool armed;             /**< Timer running */
+} sched_task_t;
+
+typedef struct {
+    uint32_t awake_ms;      /**< Time spent running tasks */
+    uint32_t sleep_ms;      /**< Time spent in sleep */
+    uint32_t wakeups;       /**< Amount of sleep calls */
+    uint32_t runs;          /**< Amount of task runs */
+} sched_stats_t;
+
+/**
+ * Register task, periodic task is run for the first time after period
+ *
+ * @param task      Task description
+ * @return False if no slot left
+ */
+extern bool Sched_Add(sched_task_t *task);
+
+/**
+ * Run task once after given delay (overrides periodic timer)
+ *
+ * @param task      Registered task
+ * @param delay_ms  Delay in ms
+ */
+extern void Sched_Wake(sched_task_t *task, uint32_t delay_ms);
+
+/**
+ * Signal event, can be called from interrupt
+ *
+ * @param event     Event that occurred
+ */
+extern void Sched_Event(sched_evt_t event);
+
+/**
+ * Check if some event is waiting to be processed
+ *
+ * Sleep implementation calls it with interrupts disabled so the event
+ * signalled right before sleep is not missed
+ *
+ * @return True if an event is pending
+ */
+extern bool Sched_Pending(void);
+
+/**
+ * Run all due tasks, then sleep until next task is due or event comes
+ */
+extern void Sched_Run(void);
+
+/**
+ * Get scheduler statistics
+ *
+ * @return Statistics
+ */
+extern const sched_stats_t *Sched_GetStats(void);
+
+/**
+ * Initialize scheduler, remove all tasks
+ *
+ * @param time_cb   Time source
+ * @param sleep_cb  Sleep implementation
+ */
+extern void Sched_Init(sched_time_cb_t time_cb, sched_sleep_cb_t sleep_cb);
+
+#endif
+
+/** @} */
@@ -25,59 +25,134 @@
 
 #include <string.h>
 
+#include "config.h"
 #include "storage.h"
+#include "elevation.h"
+#include "breadcrumb.h"
+#include "profile.h"
 #include "utils/nav.h"
 #include "stats.h"
 
-/* Min distance between logs to be considered as a movement */
-#define STATS_MIN_DIST_M 5
-
 /* Max time between points in storage to be considered as single log */
 #define STATS_MAX_TIME_MIN  10
 
 static stats_t statsi;
+static const elevation_config_t statsi_elev_cfg = {
+    .deadband_dm = STATS_ELEV_DEADBAND_DM,
+    .lowpass_shift = STATS_ELEV_LOWPASS_SHIFT,
+};
+/** Accumulation state, shared by live points and records from storage */
+static struct {
+    bool valid;                 /**< prev holds start of the segment */
+    storage_item_t prev;
+    elevation_t elev;
+} statsi_acc = { .elev = { .cfg = &statsi_elev_cfg } };
+/** Shape of the track since boot */
+static breadcrumb_t statsi_track = { .stride = 1 };
+/** Elevation in m and speed in dm/s along the track since boot */
+static profile_t statsi_elev_prof = { .width = 1 };
+static profile_t statsi_speed_prof = { .width = 1 };
 
-void Stats_Update(const gps_info_t *gps)
+/**
+ * Account elevation change in given stats
+ */
+static void Statsi_Climb(stats_comm_t *stats, int32_t altitude)
 {
-    static gps_info_t prev;
-    static bool prev_ready = false;
+    if (altitude >= 0) {
+        stats->ascend_dm += altitude;
+    } else {
+        stats->descend_dm += -altitude;
+    }
+}
 
+/**
+ * Account stored record, live points and records read from storage go
+ * through here so both give the same totals. Points are already filtered
+ * before storing, every record counts same as in the track index.
+ *
+ * @param item      Record as stored
+ * @param today     Account also to stats since power on
+ */
+static void Statsi_Add(const storage_item_t *item, bool today)
+{
+    int32_t time_diff = (int32_t)item->timestamp -
+            (int32_t)statsi_acc.prev.timestamp;
     uint32_t distance;
     int32_t altitude;
-    uint32_t time;
+    nmea_float_t lat1, lon1, lat2, lon2;
 
-    /** Skip logs with incomplete data */
-    if (gps->timestamp == 0 || gps->altitude_dm == 0) {
+    /* Ignore incomplete points (end of log), next one starts new segment */
+    if (item->timestamp == 0) {
+        statsi_acc.valid = false;
+        return;
+    }
+    /* Ignore time differences larger than 10 minutes (new record) */
+    if (!statsi_acc.valid || time_diff < 0 ||
+            time_diff > 60*STATS_MAX_TIME_MIN) {
+        Elevation_Reset(&statsi_acc.elev);
+        Elevation_Add(&statsi_acc.elev, item->elevation_m*10);
+        statsi_acc.prev = *item;
+        statsi_acc.valid = true;
         return;
     }
+    altitude = Elevation_Add(&statsi_acc.elev, item->elevation_m*10);
+    Statsi_Climb(&statsi.all, altitude);
+    if (today) {
+        Statsi_Climb(&statsi.today, altitude);
+    }
+
+    lat1.num = statsi_acc.prev.lat;
+    lat1.scale = statsi_acc.prev.lat_scale;
+    lon1.num = statsi_acc.prev.lon;
+    lon1.scale = statsi_acc.prev.lon_scale;
+    lat2.num = item->lat;
+    lat2.scale = item->lat_scale;
+    lon2.num = item->lon;
+    lon2.scale = item->lon_scale;
+    distance = Nav_GetDistanceDm(&lat1, &lon1, &lat2, &lon2);
+    statsi.all.time_s += time_diff;
+    statsi.all.dist_dm += distance;
+    if (today) {
+        statsi.today.time_s += time_diff;
+        statsi.today.dist_dm += distance;
+    }
+    statsi_acc.prev = *item;
+}
+
+void Stats_Update(const gps_info_t *gps)
+{
+    static gps_info_t prev;
+    static bool prev_ready = false;
+    storage_item_t item;
+    uint32_t distance;
+    uint32_t time;
+
+    /* Same as stored by Storage_Add */
+    item.lat = gps->lat.num;
+    item.lat_scale = gps->lat.scale;
+    item.lon = gps->lon.num;
+    item.lon_scale = gps->lon.scale;
+    item.timestamp = gps->timestamp;
+    item.elevation_m = gps->altitude_dm/10;
+    Statsi_Add(&item, true);
+    statsi.storage_used_pct = (Storage_SpaceUsed()*100)/Storage_GetSize();
+
+    Breadcrumb_Add(&statsi_track, gps);
+    Profile_Add(&statsi_elev_prof, gps->altitude_dm/10);
+
     /* First log after boot */
     if (prev_ready == false) {
         memcpy(&prev, gps, sizeof(prev));
         prev_ready = true;
+        Profile_Add(&statsi_speed_prof, 0);
         return;
     }
 
     distance = Nav_GetDistanceDm(&gps->lat, &gps->lon, &prev.lat, &prev.lon);
-    altitude = (gps->altitude_dm - prev.altitude_dm);
     time = gps->timestamp - prev.timestamp;
-    /* Points too close to each other, skip */
-    if (distance/10 < STATS_MIN_DIST_M) {
-        return;
-    }
-
-    statsi.storage_used_pct = (Storage_SpaceUsed()*100)/Storage_GetSize();
-    statsi.today.dist_dm += distance;
-    statsi.all.dist_dm += distance;
-    statsi.today.time_s += time;
-    statsi.all.time_s += time;
-    if (altitude >= 0) {
-        statsi.today.ascend_dm += altitude;
-        statsi.all.ascend_dm += altitude;
-    } else {
-        statsi.today.descend_dm += -altitude;
-        statsi.all.descend_dm += -altitude;
-    }
-
+    /* Both profiles get a sample for each point, buckets are aligned */
+    Profile_Add(&statsi_speed_prof, time != 0 && distance/time < INT16_MAX ?
+            distance/time : 0);
     memcpy(&prev, gps, sizeof(prev));
 }
 
@@ -86,56 +161,36 @@ stats_t *Stats_Get(void)
     return &statsi;
 }
 
+const breadcrumb_t *Stats_GetTrack(void)
+{
+    return &statsi_track;
+}
+
+const profile_t *Stats_GetElevationProfile(void)
+{
+    return &statsi_elev_prof;
+}
+
+const profile_t *Stats_GetSpeedProfile(void)
+{
+    return &statsi_speed_prof;
+}
+
 void Stats_Init(void)
 {
     storage_item_t item;
-    storage_item_t prev;
-    int i = 1;
+    uint32_t i = 0;
 
     memset(&statsi, 0x00, sizeof(stats_t));
-    Storage_Get(0, &prev);
+    Breadcrumb_Reset(&statsi_track);
+    Profile_Reset(&statsi_elev_prof);
+    Profile_Reset(&statsi_speed_prof);
+    Elevation_Init(&statsi_acc.elev, &statsi_elev_cfg);
+    statsi_acc.valid = false;
 
+    /* Live points continue from the last record */
     while (Storage_Get(i++, &item) != false) {
-        int32_t time_diff = (int32_t)item.timestamp - (int32_t)prev.timestamp;
-        uint32_t distance;
-        int32_t altitude;
-        nmea_float_t lat1, lon1, lat2, lon2;
-
-        /* Ignore incomplete points */
-        if (item.timestamp == 0 || item.elevation_m == 0) {
-            prev = item;
-            continue;
-        }
-        /* Ignore time differences larger than 10 minutes (new record) */
-        if (time_diff < 0 || time_diff > 60*STATS_MAX_TIME_MIN) {
-            prev = item;
-            continue;
-        }
-
-        lat1.num = prev.lat;
-        lat1.scale = prev.lat_scale;
-        lon1.num = prev.lon;
-        lon1.scale = prev.lon_scale;
-        lat2.num = item.lat;
-        lat2.scale = item.lat_scale;
-        lon2.num = item.lon;
-        lon2.scale = item.lon_scale;
-        distance = Nav_GetDistanceDm(&lat1, &lon1, &lat2, &lon2);
-        /* Ignore points too close to each other (noise, hdop,...) */
-        if (distance/10 < STATS_MIN_DIST_M) {
-            continue;
-        }
-
-        altitude = item.elevation_m - prev.timestamp;
-        statsi.all.dist_dm += distance;
-        statsi.all.time_s += time_diff;
-        if (altitude >= 0) {
-            statsi.all.ascend_dm += altitude;
-        } else {
-            statsi.all.descend_dm += -altitude;
-        }
-
-        prev = item;
+        Statsi_Add(&item, false);
     }
 
     statsi.storage_used_pct = (Storage_SpaceUsed()*100)/Storage_GetSize();
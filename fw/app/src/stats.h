@@ -28,6 +28,8 @@
 
 #include <types.h>
 #include "drivers/gps.h"
+#include "breadcrumb.h"
+#include "profile.h"
 
 typedef struct {
     uint32_t dist_dm;        /** Distance travelled */
@@ -45,7 +47,10 @@ typedef struct {
 /**
  * Add new point to statistics
  *
- * @param gps   GPS measured data
+ * Only points which are stored should be added, stats rebuilt by
+ * Stats_Init from storage are then the same
+ *
+ * @param gps   GPS measured data, as passed to Storage_Add
  */
 extern void Stats_Update(const gps_info_t *gps);
 
@@ -56,6 +61,27 @@ extern void Stats_Update(const gps_info_t *gps);
  */
 extern stats_t *Stats_Get(void);
 
+/**
+ * Get shape of the track since boot
+ *
+ * @return Breadcrumb buffer
+ */
+extern const breadcrumb_t *Stats_GetTrack(void);
+
+/**
+ * Get elevation along the track since boot
+ *
+ * @return Profile of elevation in m
+ */
+extern const profile_t *Stats_GetElevationProfile(void);
+
+/**
+ * Get speed along the track since boot, buckets match the elevation profile
+ *
+ * @return Profile of speed between points in dm/s
+ */
+extern const profile_t *Stats_GetSpeedProfile(void);
+
 /**
  * Initialize stats, will load all records from storage and calculate stats
  */
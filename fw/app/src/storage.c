@@ -24,6 +24,7 @@
  */
 
 #include <string.h>
+#include <stddef.h>
 
 #include "drivers/spi_flash.h"
 #include "desc.h"
@@ -31,6 +32,15 @@
 #include "storage.h"
 
 static uint32_t storagei_offset = 0;
+/** Offset of the first free slot in sync cursor log */
+static uint32_t storagei_sync_offset = 0;
+/** Id of the first record not yet acknowledged by host */
+static uint32_t storagei_synced = 0;
+/** Offset of the first free slot in assistance position log */
+static uint32_t storagei_assist_offset = 0;
+static storage_assist_t storagei_assist = { .reserved = 0xffff };
+/** Amount of entries in the track index */
+static uint32_t storagei_tracks = 0;
 
 /**
  * Check if storage item is empty (all bits are 0xff - erased flash)
@@ -72,6 +82,14 @@ void Storage_Erase(void)
 {
     SpiFlash_Erase(&spiflash_desc);
     storagei_offset = 0;
+    storagei_sync_offset = 0;
+    storagei_synced = 0;
+    storagei_assist_offset = 0;
+    storagei_tracks = 0;
+    /* Position is still valid, only the log was erased */
+    if (storagei_assist.reserved == 0) {
+        Storage_SetAssist(&storagei_assist);
+    }
 }
 
 size_t Storage_SpaceRemaining(void)
@@ -122,13 +140,163 @@ bool Storage_Get(uint32_t id, storage_item_t *item)
     return true;
 }
 
+uint32_t Storage_GetSynced(void)
+{
+    if (storagei_synced > Storage_SpaceUsed()) {
+        return Storage_SpaceUsed();
+    }
+    return storagei_synced;
+}
+
+bool Storage_SetSynced(uint32_t id)
+{
+    if (id <= storagei_synced) {
+        return true;
+    }
+    if (storagei_sync_offset + sizeof(id) > STORAGE_SYNC_SIZE) {
+        return false;
+    }
+
+    SpiFlash_Write(&spiflash_desc, STORAGE_SYNC_ADDR + storagei_sync_offset,
+            (uint8_t *) &id, sizeof(id));
+    storagei_sync_offset += sizeof(id);
+    storagei_synced = id;
+    return true;
+}
+
+/**
+ * Find latest sync cursor value in the log
+ */
+static void Storagei_SyncInit(void)
+{
+    uint32_t buf[16];
+
+    storagei_sync_offset = 0;
+    storagei_synced = 0;
+
+    while (storagei_sync_offset < STORAGE_SYNC_SIZE) {
+        SpiFlash_Read(&spiflash_desc, STORAGE_SYNC_ADDR + storagei_sync_offset,
+                (uint8_t *) buf, sizeof(buf));
+        for (size_t i = 0; i < sizeof(buf)/sizeof(buf[0]); i++) {
+            if (buf[i] == 0xffffffff) {
+                return;
+            }
+            storagei_synced = buf[i];
+            storagei_sync_offset += sizeof(buf[0]);
+        }
+    }
+}
+
+bool Storage_GetAssist(storage_assist_t *pos)
+{
+    if (storagei_assist.reserved != 0) {
+        return false;
+    }
+    *pos = storagei_assist;
+    return true;
+}
+
+bool Storage_SetAssist(const storage_assist_t *pos)
+{
+    if (storagei_assist_offset + sizeof(*pos) > STORAGE_ASSIST_SIZE) {
+        return false;
+    }
+
+    storagei_assist = *pos;
+    storagei_assist.reserved = 0;
+    SpiFlash_Write(&spiflash_desc, STORAGE_ASSIST_ADDR + storagei_assist_offset,
+            (uint8_t *) &storagei_assist, sizeof(storagei_assist));
+    storagei_assist_offset += sizeof(storagei_assist);
+    return true;
+}
+
+/**
+ * Find latest assistance position in the log
+ */
+static void Storagei_AssistInit(void)
+{
+    storage_assist_t pos;
+
+    storagei_assist_offset = 0;
+    memset(&storagei_assist, 0xff, sizeof(storagei_assist));
+
+    while (storagei_assist_offset + sizeof(pos) <= STORAGE_ASSIST_SIZE) {
+        SpiFlash_Read(&spiflash_desc,
+                STORAGE_ASSIST_ADDR + storagei_assist_offset,
+                (uint8_t *) &pos, sizeof(pos));
+        if (pos.reserved != 0) {
+            return;
+        }
+        storagei_assist = pos;
+        storagei_assist_offset += sizeof(pos);
+    }
+}
+
+uint32_t Storage_GetTrackCount(void)
+{
+    return storagei_tracks;
+}
+
+bool Storage_GetTrack(uint32_t index, storage_track_t *track)
+{
+    if (index >= storagei_tracks) {
+        return false;
+    }
+    SpiFlash_Read(&spiflash_desc,
+            STORAGE_TRACKS_ADDR + index*sizeof(storage_track_t),
+            (uint8_t *) track, sizeof(*track));
+    return true;
+}
+
+bool Storage_AddTrack(const storage_track_t *track)
+{
+    storage_track_t entry = *track;
+
+    if ((storagei_tracks + 1)*sizeof(entry) > STORAGE_TRACKS_SIZE) {
+        return false;
+    }
+    entry.reserved = 0;
+    SpiFlash_Write(&spiflash_desc,
+            STORAGE_TRACKS_ADDR + storagei_tracks*sizeof(entry),
+            (uint8_t *) &entry, sizeof(entry));
+    storagei_tracks++;
+    return true;
+}
+
+/**
+ * Find amount of entries in the track index, entries are written in order,
+ * the first erased one is found by bisection
+ */
+static void Storagei_TracksInit(void)
+{
+    uint32_t lo = 0;
+    uint32_t hi = STORAGE_TRACKS_SIZE/sizeof(storage_track_t);
+    uint32_t mid;
+    uint32_t reserved;
+
+    /* Entries before lo are written, entries from hi are erased */
+    while (lo < hi) {
+        mid = lo + (hi - lo)/2;
+        SpiFlash_Read(&spiflash_desc, STORAGE_TRACKS_ADDR +
+                mid*sizeof(storage_track_t) +
+                offsetof(storage_track_t, reserved),
+                (uint8_t *) &reserved, sizeof(reserved));
+        if (reserved == 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    storagei_tracks = lo;
+}
+
 void Storage_Init(void)
 {
     uint8_t buf[sizeof(storage_item_t)];
     uint8_t item_size = sizeof(storage_item_t);
     storagei_offset = 0;
 
-    while (storagei_offset < STORAGE_SIZE) {
+    while (storagei_offset + item_size <= STORAGE_SIZE) {
         SpiFlash_Read(&spiflash_desc, storagei_offset, buf, item_size);
         if (Storagei_ItemEmpty((storage_item_t *) buf)) {
             break;
@@ -136,7 +304,7 @@ void Storage_Init(void)
         storagei_offset += item_size;
     }
     /* Add new invalid item - end of log record */
-    if (storagei_offset != 0) {
+    if (storagei_offset != 0 && Storage_SpaceRemaining() != 0) {
         SpiFlash_Read(&spiflash_desc, storagei_offset - item_size, buf,
                 item_size);
         if (!Storage_IsEOL((storage_item_t *) buf)) {
@@ -145,6 +313,10 @@ void Storage_Init(void)
             storagei_offset += item_size;
         }
     }
+
+    Storagei_SyncInit();
+    Storagei_AssistInit();
+    Storagei_TracksInit();
 }
 
 /** @} */
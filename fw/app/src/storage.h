@@ -38,6 +38,27 @@ typedef struct {
     int16_t elevation_m;
 } __attribute__((packed)) storage_item_t;
 
+/** Last known position, stored for GPS receiver start assistance */
+typedef struct {
+    int32_t lat;            /**< Latitude in 1e-7 degrees */
+    int32_t lon;            /**< Longitude in 1e-7 degrees */
+    uint32_t timestamp;     /**< Time of the fix */
+    int16_t elevation_m;
+    uint16_t reserved;      /**< Always 0, keeps record != erased flash */
+} __attribute__((packed)) storage_assist_t;
+
+/** Summary of one track, tracks are indexed to be browsed quickly */
+typedef struct {
+    uint32_t first;         /**< Id of the first record */
+    uint32_t count;         /**< Amount of records */
+    uint32_t start;         /**< Timestamp of the first record */
+    uint32_t duration_s;
+    uint32_t dist_dm;
+    uint32_t ascend_dm;
+    uint32_t descend_dm;
+    uint32_t reserved;      /**< Always 0, keeps record != erased flash */
+} __attribute__((packed)) storage_track_t;
+
 /**
  * Check if given item is end of log mark
  *
@@ -92,7 +113,65 @@ extern bool Storage_Add(const gps_info_t *info);
 extern bool Storage_Get(uint32_t id, storage_item_t *item);
 
 /**
- * Check the content of the flash, find last record, add end of log mark
+ * Get id of the first record not yet acknowledged by host
+ *
+ * @return Record id (equal to Storage_SpaceUsed() if all records synced)
+ */
+extern uint32_t Storage_GetSynced(void);
+
+/**
+ * Mark all records before given id as acknowledged by host
+ *
+ * The cursor is persisted in flash and can only move forward
+ *
+ * @param id        Id of the first record not yet acknowledged
+ * @return False if cursor can't be stored (log full)
+ */
+extern bool Storage_SetSynced(uint32_t id);
+
+/**
+ * Get last stored assistance position
+ *
+ * @param pos   Position to store result to
+ * @return False if no position is stored
+ */
+extern bool Storage_GetAssist(storage_assist_t *pos);
+
+/**
+ * Store assistance position, it is kept even if records are erased
+ *
+ * @param pos   Position to be stored
+ * @return False if position can't be stored (log full)
+ */
+extern bool Storage_SetAssist(const storage_assist_t *pos);
+
+/**
+ * Get amount of indexed tracks
+ *
+ * @return Amount of tracks
+ */
+extern uint32_t Storage_GetTrackCount(void);
+
+/**
+ * Read track summary from the index
+ *
+ * @param index     Track index, from 0 (the oldest)
+ * @param track     Track to store result to
+ * @return False if track of given index does not exist
+ */
+extern bool Storage_GetTrack(uint32_t index, storage_track_t *track);
+
+/**
+ * Append track summary to the index
+ *
+ * @param track     Track to be stored
+ * @return False if track can't be stored (index full)
+ */
+extern bool Storage_AddTrack(const storage_track_t *track);
+
+/**
+ * Check the content of the flash, find last record, add end of log mark,
+ * load sync cursor, assistance position and track index
  */
 extern void Storage_Init(void);
 
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/sync.c
+ * @brief   Incremental download of records not yet acknowledged by host
+ *
+ * The file size is fixed once exposed over USB, the records range is
+ * therefore captured before the host attaches and records added later are
+ * left for the next sync.
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "modules/log.h"
+#include "storage.h"
+#include "gpx.h"
+#include "sync.h"
+
+/** First record in the sync file */
+static uint32_t synci_first;
+/** Amount of records in the sync file */
+static uint32_t synci_count;
+/** Records from the start of the file already acknowledged */
+static uint32_t synci_acked;
+
+uint32_t Sync_GetSize(void)
+{
+    return GPX_GetRangeSize(synci_first, synci_count);
+}
+
+void Sync_Get(uint32_t offset, uint8_t *buf, size_t len)
+{
+    GPX_GetRange(synci_first, synci_count, offset, buf, len);
+}
+
+bool Sync_Write(const uint8_t *buf, size_t size)
+{
+    size_t magic_len = strlen(SYNC_ACK_MAGIC);
+    char num[11];
+    uint32_t count = synci_count;
+    size_t i;
+
+    if (size < magic_len || memcmp(buf, SYNC_ACK_MAGIC, magic_len) != 0) {
+        return false;
+    }
+
+    buf += magic_len;
+    size -= magic_len;
+    if (size > 1 && buf[0] == ' ') {
+        for (i = 0; i < sizeof(num) - 1 && i < size - 1; i++) {
+            if (buf[i + 1] < '0' || buf[i + 1] > '9') {
+                break;
+            }
+            num[i] = buf[i + 1];
+        }
+        num[i] = '\0';
+        if (i != 0 && strtoul(num, NULL, 10) < count) {
+            count = strtoul(num, NULL, 10);
+        }
+    }
+
+    /* Host writes the ack file in several sectors, cursor moves once */
+    if (count <= synci_acked) {
+        return true;
+    }
+    if (!Storage_SetSynced(synci_first + count)) {
+        Log_Error("SYNC", "Sync cursor log full");
+    } else {
+        synci_acked = count;
+        Log_Info("SYNC", "Acknowledged %lu records", (unsigned long) count);
+    }
+    return true;
+}
+
+void Sync_Init(void)
+{
+    storage_item_t item;
+
+    synci_first = Storage_GetSynced();
+    synci_count = Storage_SpaceUsed() - synci_first;
+    synci_acked = 0;
+
+    /* Don't start the file with end of previous log */
+    if (synci_count != 0 && Storage_Get(synci_first, &item) &&
+            Storage_IsEOL(&item)) {
+        synci_first++;
+        synci_count--;
+    }
+}
+
+/** @} */
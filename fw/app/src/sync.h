@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/sync.h
+ * @brief   Incremental download of records not yet acknowledged by host
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#ifndef __APP_SYNC_H_
+#define __APP_SYNC_H_
+
+#include <types.h>
+
+/** Content of the file written by host to acknowledge the download */
+#define SYNC_ACK_MAGIC "GLOGGER-ACK"
+
+/**
+ * Get size of the gpx file with records not yet acknowledged
+ *
+ * @return Size in bytes
+ */
+extern uint32_t Sync_GetSize(void);
+
+/**
+ * Read gpx file with records not yet acknowledged
+ *
+ * @param offset        Offset to the file
+ * @param buf           Buffer to store data to
+ * @param len           Amount of bytes to store
+ */
+extern void Sync_Get(uint32_t offset, uint8_t *buf, size_t len);
+
+/**
+ * Process data written by host, acknowledge download if ack file found
+ *
+ * The file starts with SYNC_ACK_MAGIC optionally followed by space and
+ * number of records received, all records in the file are acknowledged
+ * if number is missing.
+ *
+ * @param buf       Data written by host
+ * @param size      Size of the data
+ * @return True if data contained ack, false if not recognized
+ */
+extern bool Sync_Write(const uint8_t *buf, size_t size);
+
+/**
+ * Take snapshot of records not yet acknowledged for the sync file
+ *
+ * Call before the file is exposed to host, size of the file is fixed then
+ */
+extern void Sync_Init(void);
+
+#endif
+
+/** @} */
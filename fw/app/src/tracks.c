@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/tracks.c
+ * @brief   Splitting of records to tracks and their summary index
+ *
+ * Track ends with the end of log mark (power cycle) or with TRACK_GAP_S
+ * without records. Summary of the finished track is appended to the index
+ * in the flash, the track being recorded is kept in RAM. Only records after
+ * the last indexed track are read at init, so browsing the tracks costs a
+ * single flash read per track.
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#include <string.h>
+
+#include "modules/log.h"
+#include "utils/nav.h"
+#include "config.h"
+#include "elevation.h"
+#include "tracks.h"
+#include "usb.h"
+
+/** Tracks with less records are not indexed */
+#define TRACKS_MIN_RECORDS 2
+
+static const elevation_config_t tracksi_elev_cfg = {
+    .deadband_dm = STATS_ELEV_DEADBAND_DM,
+    .lowpass_shift = STATS_ELEV_LOWPASS_SHIFT,
+};
+
+static struct {
+    uint32_t next;              /**< Id of the first record not accounted */
+    bool open;                  /**< Track is being recorded */
+    storage_track_t track;      /**< Track being recorded */
+    storage_item_t prev;        /**< Last record of the track */
+    elevation_t elev;
+} tracksi;
+
+/**
+ * Store the track being recorded to the index
+ */
+static void Tracksi_Close(void)
+{
+    if (tracksi.open && tracksi.track.count >= TRACKS_MIN_RECORDS &&
+            !Storage_AddTrack(&tracksi.track)) {
+        Log_Error("TRACK", "Track index full");
+    }
+    tracksi.open = false;
+}
+
+/**
+ * Account one record to the track, start a new track if needed
+ */
+static void Tracksi_Add(uint32_t id, const storage_item_t *item)
+{
+    int32_t altitude;
+    nmea_float_t lat1, lon1, lat2, lon2;
+
+    if (Storage_IsEOL(item)) {
+        Tracksi_Close();
+        return;
+    }
+    if (tracksi.open && (item->timestamp < tracksi.prev.timestamp ||
+            item->timestamp - tracksi.prev.timestamp > TRACK_GAP_S)) {
+        Tracksi_Close();
+    }
+
+    if (!tracksi.open) {
+        memset(&tracksi.track, 0, sizeof(tracksi.track));
+        tracksi.track.first = id;
+        tracksi.track.start = item->timestamp;
+        Elevation_Init(&tracksi.elev, &tracksi_elev_cfg);
+        Elevation_Add(&tracksi.elev, item->elevation_m*10);
+        tracksi.prev = *item;
+        tracksi.open = true;
+    }
+
+    lat1.num = tracksi.prev.lat;
+    lat1.scale = tracksi.prev.lat_scale;
+    lon1.num = tracksi.prev.lon;
+    lon1.scale = tracksi.prev.lon_scale;
+    lat2.num = item->lat;
+    lat2.scale = item->lat_scale;
+    lon2.num = item->lon;
+    lon2.scale = item->lon_scale;
+    if (tracksi.track.count != 0) {
+        tracksi.track.dist_dm += Nav_GetDistanceDm(&lat1, &lon1, &lat2,
+                &lon2);
+        altitude = Elevation_Add(&tracksi.elev, item->elevation_m*10);
+        if (altitude >= 0) {
+            tracksi.track.ascend_dm += altitude;
+        } else {
+            tracksi.track.descend_dm += -altitude;
+        }
+    }
+    tracksi.track.count++;
+    tracksi.track.duration_s = item->timestamp - tracksi.track.start;
+    tracksi.prev = *item;
+}
+
+uint32_t Tracks_GetCount(void)
+{
+    return Storage_GetTrackCount() + (tracksi.open ? 1 : 0);
+}
+
+bool Tracks_Get(uint32_t index, storage_track_t *track)
+{
+    uint32_t count = Storage_GetTrackCount();
+    bool ret;
+
+    if (tracksi.open) {
+        if (index == 0) {
+            *track = tracksi.track;
+            return true;
+        }
+        index--;
+    }
+    if (index >= count) {
+        return false;
+    }
+    /* Mass storage reads the flash from interrupt */
+    Usb_Lock();
+    ret = Storage_GetTrack(count - 1 - index, track);
+    Usb_Unlock();
+    return ret;
+}
+
+void Tracks_Update(void)
+{
+    storage_item_t item;
+
+    while (Storage_Get(tracksi.next, &item)) {
+        Tracksi_Add(tracksi.next, &item);
+        tracksi.next++;
+    }
+}
+
+void Tracks_Init(void)
+{
+    storage_track_t last;
+    uint32_t count = Storage_GetTrackCount();
+
+    memset(&tracksi, 0, sizeof(tracksi));
+    if (count != 0 && Storage_GetTrack(count - 1, &last)) {
+        tracksi.next = last.first + last.count;
+    }
+    Tracks_Update();
+}
+
+/** @} */
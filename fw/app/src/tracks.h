@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/tracks.h
+ * @brief   Splitting of records to tracks and their summary index
+ *
+ * @addtogroup app
+ * @{
+ */
+
+#ifndef __APP_TRACKS_H_
+#define __APP_TRACKS_H_
+
+#include <types.h>
+#include "storage.h"
+
+/**
+ * Get amount of tracks including the one being recorded
+ *
+ * @return Amount of tracks
+ */
+extern uint32_t Tracks_GetCount(void);
+
+/**
+ * Get track summary, the newest first
+ *
+ * @param index     Track index, 0 is the one being recorded if any
+ * @param track     Track to store result to
+ * @return False if track of given index does not exist
+ */
+extern bool Tracks_Get(uint32_t index, storage_track_t *track);
+
+/**
+ * Account records stored since last call, call after Storage_Add
+ */
+extern void Tracks_Update(void);
+
+/**
+ * Index records stored after the last indexed track, storage has to be
+ * initialized already
+ */
+extern void Tracks_Init(void);
+
+#endif
+
+/** @} */
@@ -23,11 +23,14 @@
  * @{
  */
 #include <libopencm3/stm32/rcc.h>
+#include <libopencm3/cm3/nvic.h>
 #include <libopencm3/usb/usbd.h>
 #include <libopencm3/usb/msc.h>
 #include <modules/msc.h>
 #include <modules/ramdisk.h>
 #include "config.h"
+#include "readahead.h"
+#include "sched.h"
 #include "usb.h"
 
 
@@ -120,10 +123,55 @@ static const struct usb_config_descriptor usbi_config_descr = {
 static usbd_device *usbi_dev;
 /* Buffer to be used for control requests. */
 static uint8_t usbi_control_buffer[128];
+/** Usb_Lock nesting */
+static uint8_t usbi_lock = 0;
 
-void Usb_Poll(void)
+/**
+ * USB interrupt, whole stack including MSC callbacks runs from here
+ */
+void usb_isr(void)
 {
     usbd_poll(usbi_dev);
+    /* Run deferred work in main loop */
+    Sched_Event(SCHED_EVT_USB);
+}
+
+void Usb_Process(void)
+{
+    /* Generate next sector while current one is being sent */
+    Usb_Lock();
+    Readahead_Process();
+    Usb_Unlock();
+}
+
+void Usb_Lock(void)
+{
+    nvic_disable_irq(NVIC_USB_IRQ);
+    usbi_lock++;
+}
+
+void Usb_Unlock(void)
+{
+    if (usbi_lock != 0) {
+        usbi_lock--;
+    }
+    if (usbi_lock == 0 && usbi_dev != NULL) {
+        nvic_enable_irq(NVIC_USB_IRQ);
+    }
+}
+
+void Usb_Connect(bool connect)
+{
+    if (usbi_dev == NULL) {
+        return;
+    }
+    if (connect) {
+        /* Drop sectors generated from the previous disk content */
+        Usb_Lock();
+        Readahead_Init(Ramdisk_Read, Ramdisk_Write, Ramdisk_GetSectors());
+        Usb_Unlock();
+    }
+    usbd_disconnect(usbi_dev, !connect);
 }
 
 void Usb_Init(void)
@@ -135,9 +183,14 @@ void Usb_Init(void)
                 sizeof(usbi_strings)/sizeof(usbi_strings[0]),
                 usbi_control_buffer, sizeof(usbi_control_buffer));
 
+    Readahead_Init(Ramdisk_Read, Ramdisk_Write, Ramdisk_GetSectors());
     Msc_Init(usbi_dev, 0x82, 64, 0x01, 64, USB_MANUFACTURE_STR,
-            USB_DEVICE_STR, USB_VERSION_STR, Ramdisk_Read, Ramdisk_Write,
+            USB_DEVICE_STR, USB_VERSION_STR, Readahead_Read, Readahead_Write,
             Ramdisk_GetSectors());
+    usbd_disconnect(usbi_dev, true);
+    if (usbi_lock == 0) {
+        nvic_enable_irq(NVIC_USB_IRQ);
+    }
 }
 
 /** @} */
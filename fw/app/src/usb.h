@@ -26,13 +26,38 @@
 #ifndef __APP_USB_H_
 #define __APP_USB_H_
 
+#include <types.h>
+
 /**
- * Poll USB stack, call periodically
+ * Run deferred USB work (sector read ahead), call from main loop
+ *
+ * USB itself is serviced from interrupt
+ */
+extern void Usb_Process(void);
+
+/**
+ * Block USB servicing while main loop uses resources shared with mass
+ * storage (SPI flash), can be nested
+ */
+extern void Usb_Lock(void);
+
+/**
+ * Resume USB servicing blocked by Usb_Lock
+ */
+extern void Usb_Unlock(void);
+
+/**
+ * Attach to or detach from host by D+ pull-up
+ *
+ * Disk content can be changed while detached, host enumerates the disk
+ * again after attach.
+ *
+ * @param connect   True to attach
  */
-extern void Usb_Poll(void);
+extern void Usb_Connect(bool connect);
 
 /**
- * Initialize the USB and it's services
+ * Initialize the USB and it's services, starts detached
  */
 extern void Usb_Init(void);
 
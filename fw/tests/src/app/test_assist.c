@@ -0,0 +1,361 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/test_assist.c
+ * @brief   Unit tests for assist.c and assistance position log in storage.c
+ *
+ * @addtogroup tests
+ * @{
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <main.h>
+#include "storage.c"
+#include "gps/nmea_ring.c"
+#include "gps/ubx_ring.c"
+#include "gps/assist.c"
+
+/** 2020-06-12 09:30:15 */
+#define NOW 1591954215
+
+static uint8_t flash[STORAGE_TRACKS_ADDR + STORAGE_TRACKS_SIZE];
+static uint8_t uart[ASSIST_MAX_LEN*2];
+static size_t uart_len;
+static time_t rtc;
+
+static const storage_assist_t brno = {
+    .lat = 492741866,
+    .lon = 165020566,
+    .timestamp = NOW - 3600,
+    .elevation_m = 545,
+};
+
+/* *****************************************************************************
+ * Mocks
+***************************************************************************** */
+void SpiFlash_Read(const spiflash_desc_t *desc, uint32_t addr, uint8_t *buf,
+        size_t len)
+{
+    (void) desc;
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(flash), addr + len);
+    memcpy(buf, &flash[addr], len);
+}
+
+void SpiFlash_Write(const spiflash_desc_t *desc, uint32_t addr,
+        const uint8_t *buf, size_t len)
+{
+    (void) desc;
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(flash), addr + len);
+    for (size_t i = 0; i < len; i++) {
+        flash[addr + i] &= buf[i];
+    }
+}
+
+void SpiFlash_Erase(const spiflash_desc_t *desc)
+{
+    (void) desc;
+    memset(flash, 0xff, sizeof(flash));
+}
+
+time_t RTCd_GetTime(void)
+{
+    return rtc;
+}
+
+void RTCd_SetTime(time_t time)
+{
+    rtc = time;
+}
+
+void UARTd_Write(uint8_t device, const uint8_t *data, size_t len)
+{
+    TEST_ASSERT_EQUAL(USART_GPS_TX, device);
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(uart), uart_len + len);
+    memcpy(&uart[uart_len], data, len);
+    uart_len += len;
+}
+
+/* Position is kept in latitude only, 1e-7 deg is roughly 0.11 dm */
+uint32_t Nav_GetDistanceDm(const nmea_float_t *lat1, const nmea_float_t *lon1,
+        const nmea_float_t *lat2, const nmea_float_t *lon2)
+{
+    (void) lon1;
+    (void) lon2;
+    return labs((long)lat1->num - lat2->num)*1113/10000;
+}
+
+/* *****************************************************************************
+ * Helpers
+***************************************************************************** */
+static gps_info_t fix(int32_t lat, time_t timestamp)
+{
+    gps_info_t gps;
+
+    memset(&gps, 0, sizeof(gps));
+    gps.lat.num = lat;
+    gps.lat.scale = 10000000;
+    gps.lon.num = 165020566;
+    gps.lon.scale = 10000000;
+    gps.altitude_dm = 5454;
+    gps.timestamp = timestamp;
+    gps.time = timestamp;
+    return gps;
+}
+
+/* *****************************************************************************
+ * Tests
+***************************************************************************** */
+TEST_GROUP(ASSIST);
+
+TEST_SETUP(ASSIST)
+{
+    memset(flash, 0xff, sizeof(flash));
+    memset(&storagei_assist, 0xff, sizeof(storagei_assist));
+    uart_len = 0;
+    rtc = 0;
+    Storage_Init();
+}
+
+TEST_TEAR_DOWN(ASSIST)
+{
+}
+
+TEST(ASSIST, Persistence)
+{
+    storage_assist_t pos;
+
+    TEST_ASSERT_FALSE(Storage_GetAssist(&pos));
+
+    pos = brno;
+    TEST_ASSERT_TRUE(Storage_SetAssist(&pos));
+    pos.lat += 1000000;
+    TEST_ASSERT_TRUE(Storage_SetAssist(&pos));
+
+    /* Latest one is found after reboot */
+    memset(&storagei_assist, 0xff, sizeof(storagei_assist));
+    Storage_Init();
+    memset(&pos, 0, sizeof(pos));
+    TEST_ASSERT_TRUE(Storage_GetAssist(&pos));
+    TEST_ASSERT_EQUAL(brno.lat + 1000000, pos.lat);
+    TEST_ASSERT_EQUAL(brno.lon, pos.lon);
+    TEST_ASSERT_EQUAL(brno.timestamp, pos.timestamp);
+    TEST_ASSERT_EQUAL(brno.elevation_m, pos.elevation_m);
+    TEST_ASSERT_EQUAL(2*sizeof(pos), storagei_assist_offset);
+
+    /* Records are erased, position survives */
+    Storage_Erase();
+    memset(&storagei_assist, 0xff, sizeof(storagei_assist));
+    Storage_Init();
+    TEST_ASSERT_TRUE(Storage_GetAssist(&pos));
+    TEST_ASSERT_EQUAL(brno.lat + 1000000, pos.lat);
+    TEST_ASSERT_EQUAL(sizeof(pos), storagei_assist_offset);
+
+    /* Full log keeps the last position */
+    while (Storage_SetAssist(&brno)) {
+        ;
+    }
+    TEST_ASSERT_EQUAL(STORAGE_ASSIST_SIZE, storagei_assist_offset);
+    pos.lat = 0;
+    TEST_ASSERT_FALSE(Storage_SetAssist(&pos));
+    Storage_Init();
+    TEST_ASSERT_TRUE(Storage_GetAssist(&pos));
+    TEST_ASSERT_EQUAL(brno.lat, pos.lat);
+}
+
+TEST(ASSIST, TrackIndex)
+{
+    storage_track_t track;
+    uint32_t max = STORAGE_TRACKS_SIZE/sizeof(track);
+
+    TEST_ASSERT_EQUAL(0, Storage_GetTrackCount());
+    TEST_ASSERT_FALSE(Storage_GetTrack(0, &track));
+
+    memset(&track, 0xff, sizeof(track));
+    for (uint32_t i = 0; i < 5; i++) {
+        track.first = i*100;
+        TEST_ASSERT_TRUE(Storage_AddTrack(&track));
+    }
+
+    /* Entries are counted after reboot, erased flash is never valid */
+    Storage_Init();
+    TEST_ASSERT_EQUAL(5, Storage_GetTrackCount());
+    TEST_ASSERT_TRUE(Storage_GetTrack(4, &track));
+    TEST_ASSERT_EQUAL(400, track.first);
+    TEST_ASSERT_EQUAL(0, track.reserved);
+
+    while (Storage_AddTrack(&track)) {
+        ;
+    }
+    TEST_ASSERT_EQUAL(max, Storage_GetTrackCount());
+    Storage_Init();
+    TEST_ASSERT_EQUAL(max, Storage_GetTrackCount());
+
+    Storage_Erase();
+    TEST_ASSERT_EQUAL(0, Storage_GetTrackCount());
+    Storage_Init();
+    TEST_ASSERT_EQUAL(0, Storage_GetTrackCount());
+}
+
+TEST(ASSIST, BuildNmea)
+{
+    storage_assist_t pos = brno;
+    uint8_t buf[ASSIST_MAX_LEN];
+    uint16_t len;
+
+    len = Assist_Build(buf, GNSS_PROTO_NMEA, &pos, NOW);
+    buf[len] = '\0';
+    TEST_ASSERT_EQUAL_STRING(
+            "$PMTK741,49.2741866,16.5020566,545,2020,06,12,09,30,15*23\r\n",
+            (char *) buf);
+
+    pos.lat = -pos.lat;
+    pos.lon = -20566;
+    pos.elevation_m = -12;
+    len = Assist_Build(buf, GNSS_PROTO_NMEA, &pos, NOW);
+    buf[len] = '\0';
+    TEST_ASSERT_EQUAL_STRING(
+            "$PMTK741,-49.2741866,-0.0020566,-12,2020,06,12,09,30,15*0B\r\n",
+            (char *) buf);
+
+    len = Assist_Build(buf, GNSS_PROTO_NMEA, NULL, NOW);
+    buf[len] = '\0';
+    TEST_ASSERT_EQUAL_STRING("$PMTK740,2020,06,12,09,30,15*3A\r\n",
+            (char *) buf);
+}
+
+TEST(ASSIST, BuildUbx)
+{
+    uint8_t buf[ASSIST_MAX_LEN];
+    const uint8_t *time = &buf[6];
+    const uint8_t *pos = &buf[UBX_OVERHEAD + UBX_MGA_INI_TIME_LEN + 6];
+    ubx_ring_t ring;
+    gps_info_t info;
+    gps_sat_t sat;
+    uint16_t len;
+
+    len = Assist_Build(buf, GNSS_PROTO_UBX, &brno, NOW);
+    TEST_ASSERT_EQUAL(UBX_MGA_INI_TIME_LEN + UBX_MGA_INI_POS_LEN +
+            2*UBX_OVERHEAD, len);
+
+    /* Frames are valid */
+    UbxRing_Init(&ring, buf, 64);
+    UbxRing_Process(&ring, len, &info, &sat);
+    TEST_ASSERT_EQUAL(2, ring.stats.ignored);
+    TEST_ASSERT_EQUAL(0, ring.stats.errors);
+
+    TEST_ASSERT_EQUAL(UBX_CLASS_MGA, buf[2]);
+    TEST_ASSERT_EQUAL(UBX_MGA_INI, buf[3]);
+    TEST_ASSERT_EQUAL(UBX_MGA_INI_TIME_UTC, time[0]);
+    TEST_ASSERT_EQUAL(2020, time[4] | time[5] << 8);
+    TEST_ASSERT_EQUAL(6, time[6]);
+    TEST_ASSERT_EQUAL(12, time[7]);
+    TEST_ASSERT_EQUAL(9, time[8]);
+    TEST_ASSERT_EQUAL(30, time[9]);
+    TEST_ASSERT_EQUAL(15, time[10]);
+    TEST_ASSERT_EQUAL(ASSIST_TIME_ACC_S, time[16]);
+
+    TEST_ASSERT_EQUAL(UBX_MGA_INI_POS_LLH, pos[0]);
+    TEST_ASSERT_EQUAL(brno.lat, (int32_t)(pos[4] | pos[5] << 8 |
+                pos[6] << 16 | (uint32_t)pos[7] << 24));
+    TEST_ASSERT_EQUAL(brno.lon, (int32_t)(pos[8] | pos[9] << 8 |
+                pos[10] << 16 | (uint32_t)pos[11] << 24));
+    TEST_ASSERT_EQUAL(54500, pos[12] | pos[13] << 8 | pos[14] << 16);
+
+    /* Time only */
+    len = Assist_Build(buf, GNSS_PROTO_UBX, NULL, NOW);
+    TEST_ASSERT_EQUAL(UBX_MGA_INI_TIME_LEN + UBX_OVERHEAD, len);
+}
+
+TEST(ASSIST, Inject)
+{
+    /* RTC was not set */
+    Storage_SetAssist(&brno);
+    TEST_ASSERT_FALSE(Assist_Inject(GNSS_PROTO_NMEA));
+    TEST_ASSERT_EQUAL(0, uart_len);
+
+    /* RTC older than the stored fix, reset meanwhile */
+    rtc = brno.timestamp - 10;
+    TEST_ASSERT_FALSE(Assist_Inject(GNSS_PROTO_NMEA));
+    TEST_ASSERT_EQUAL(0, uart_len);
+
+    rtc = NOW;
+    TEST_ASSERT_TRUE(Assist_Inject(GNSS_PROTO_NMEA));
+    uart[uart_len] = '\0';
+    TEST_ASSERT_EQUAL_STRING(
+            "$PMTK741,49.2741866,16.5020566,545,2020,06,12,09,30,15*23\r\n",
+            (char *) uart);
+}
+
+TEST(ASSIST, InjectTimeOnly)
+{
+    rtc = NOW;
+    TEST_ASSERT_TRUE(Assist_Inject(GNSS_PROTO_NMEA));
+    uart[uart_len] = '\0';
+    TEST_ASSERT_EQUAL_STRING("$PMTK740,2020,06,12,09,30,15*3A\r\n",
+            (char *) uart);
+}
+
+TEST(ASSIST, Update)
+{
+    gps_info_t gps = fix(brno.lat, NOW);
+    storage_assist_t pos;
+
+    /* First fix is stored, RTC synchronized */
+    Assist_Update(&gps);
+    TEST_ASSERT_EQUAL(NOW, rtc);
+    TEST_ASSERT_TRUE(Storage_GetAssist(&pos));
+    TEST_ASSERT_EQUAL(brno.lat, pos.lat);
+    TEST_ASSERT_EQUAL(brno.lon, pos.lon);
+    TEST_ASSERT_EQUAL(545, pos.elevation_m);
+    TEST_ASSERT_EQUAL(NOW, pos.timestamp);
+
+    /* Small drift of RTC is tolerated */
+    rtc = NOW + 11;
+    gps = fix(brno.lat + 800000, NOW + 10);
+    Assist_Update(&gps);
+    TEST_ASSERT_EQUAL(NOW + 11, rtc);
+    /* Less than 10 km away, not stored */
+    TEST_ASSERT_EQUAL(sizeof(pos), storagei_assist_offset);
+
+    rtc = NOW + 100;
+    gps = fix(brno.lat + 1000000, NOW + 20);
+    Assist_Update(&gps);
+    TEST_ASSERT_EQUAL(NOW + 20, rtc);
+    TEST_ASSERT_EQUAL(2*sizeof(pos), storagei_assist_offset);
+    TEST_ASSERT_TRUE(Storage_GetAssist(&pos));
+    TEST_ASSERT_EQUAL(brno.lat + 1000000, pos.lat);
+}
+
+TEST_GROUP_RUNNER(ASSIST)
+{
+    RUN_TEST_CASE(ASSIST, Persistence);
+    RUN_TEST_CASE(ASSIST, TrackIndex);
+    RUN_TEST_CASE(ASSIST, BuildNmea);
+    RUN_TEST_CASE(ASSIST, BuildUbx);
+    RUN_TEST_CASE(ASSIST, Inject);
+    RUN_TEST_CASE(ASSIST, InjectTimeOnly);
+    RUN_TEST_CASE(ASSIST, Update);
+}
+
+void Assist_RunTests(void)
+{
+    RUN_TEST_GROUP(ASSIST);
+}
+
+/** @} */
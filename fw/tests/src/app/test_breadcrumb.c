@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file    app/test_breadcrumb.c
+ * @brief   Unit tests for breadcrumb.c, decimation and fitting to screen
+ *
+ * @addtogroup tests
+ * @{
+ */
+
+#include <string.h>
+#include <math.h>
+#include <main.h>
+#include "gps/flat.c"
+#include "breadcrumb.c"
+
+/** 1e-7 deg of latitude in m */
+#define M_PER_UNIT 0.011132
+#define TRACK_LAT 49.5
+#define MAP_WIDTH 128
+#define MAP_HEIGHT 54
+
+static breadcrumb_t bc;
+
+/* *****************************************************************************
+ * Helpers
+***************************************************************************** */
+/**
+ * Add point given in m east and north of the start
+ */
+static void add(double x, double y)
+{
+    gps_info_t gps;
+
+    memset(&gps, 0, sizeof(gps));
+    gps.lat.num = lround(TRACK_LAT*1e7 + y/M_PER_UNIT);
+    gps.lat.scale = 10000000;
+    gps.lon.num = lround(16.5*1e7 + x/M_PER_UNIT/cos(TRACK_LAT*M_PI/180));
+    gps.lon.scale = 10000000;
+    Breadcrumb_Add(&bc, &gps);
+}
+
+/**
+ * Check point is projected inside the map
+ */
+static void checkInside(const breadcrumb_view_t *view, const flat_pos_t *pos)
+{
+    uint16_t x, y;
+
+    Breadcrumb_ToScreen(view, pos, &x, &y);
+    TEST_ASSERT_LESS_THAN(MAP_WIDTH, x);
+    TEST_ASSERT_LESS_THAN(MAP_HEIGHT, y);
+}
+
+/* *****************************************************************************
+ * Tests
+***************************************************************************** */
+TEST_GROUP(BREADCRUMB);
+
+TEST_SETUP(BREADCRUMB)
+{
+    Breadcrumb_Reset(&bc);
+}
+
+TEST_TEAR_DOWN(BREADCRUMB)
+{
+}
+
+TEST(BREADCRUMB, Decimate)
+{
+    /* Straight line to the north, point every meter */
+    for (int i = 0; i < BREADCRUMB_SIZE; i++) {
+        add(0, i);
+    }
+    TEST_ASSERT_EQUAL(BREADCRUMB_SIZE, bc.count);
+    TEST_ASSERT_EQUAL(1, bc.stride);
+
+    /* Half of the points are dropped, stored are evenly spaced */
+    add(0, BREADCRUMB_SIZE);
+    TEST_ASSERT_EQUAL(BREADCRUMB_SIZE/2 + 1, bc.count);
+    TEST_ASSERT_EQUAL(2, bc.stride);
+    for (int i = BREADCRUMB_SIZE + 1; i < 10000; i++) {
+        add(0, i);
+    }
+    TEST_ASSERT_EQUAL(10000, bc.total);
+    TEST_ASSERT_EQUAL(128, bc.stride);
+    TEST_ASSERT_EQUAL((10000 + 127)/128, bc.count);
+    /* Rounding to 1e-7 deg, about 1 cm */
+    for (uint16_t i = 0; i < bc.count; i++) {
+        TEST_ASSERT_INT_WITHIN(100, i*128*1000, bc.points[i].y);
+        TEST_ASSERT_EQUAL(0, bc.points[i].x);
+    }
+    TEST_ASSERT_INT_WITHIN(100, 9999000, bc.last.y);
+    TEST_ASSERT_INT_WITHIN(100, 9999000, bc.max.y);
+    TEST_ASSERT_EQUAL(0, bc.min.y);
+}
+
+TEST(BREADCRUMB, Box)
+{
+    /* Loop around the start, box is kept for dropped points as well,
+     * projection uses interpolated cosine */
+    for (int i = 0; i < 1000; i++) {
+        add(500*sin(i*2*M_PI/1000), 300 - 300*cos(i*2*M_PI/1000));
+    }
+    TEST_ASSERT_INT_WITHIN(5000, -500000, bc.min.x);
+    TEST_ASSERT_INT_WITHIN(5000, 500000, bc.max.x);
+    TEST_ASSERT_INT_WITHIN(100, 0, bc.min.y);
+    TEST_ASSERT_INT_WITHIN(100, 600000, bc.max.y);
+    TEST_ASSERT_TRUE(bc.count <= BREADCRUMB_SIZE);
+}
+
+TEST(BREADCRUMB, Fit)
+{
+    breadcrumb_view_t view;
+    uint16_t x, y;
+
+    /* Wide track, width is the limit */
+    add(0, 0);
+    add(1270, 100);
+    Breadcrumb_Fit(&bc, &view, MAP_WIDTH, MAP_HEIGHT);
+    TEST_ASSERT_INT_WITHIN(10, 10000, view.mm_per_px);
+    Breadcrumb_ToScreen(&view, &bc.points[0], &x, &y);
+    TEST_ASSERT_EQUAL(0, x);
+    TEST_ASSERT_INT_WITHIN(1, 31, y);
+    Breadcrumb_ToScreen(&view, &bc.points[1], &x, &y);
+    TEST_ASSERT_EQUAL(MAP_WIDTH - 1, x);
+    TEST_ASSERT_INT_WITHIN(1, 21, y);
+
+    /* Tall track, north is up and centered horizontally */
+    Breadcrumb_Reset(&bc);
+    add(0, 0);
+    add(-50, 530);
+    Breadcrumb_Fit(&bc, &view, MAP_WIDTH, MAP_HEIGHT);
+    TEST_ASSERT_INT_WITHIN(10, 10000, view.mm_per_px);
+    Breadcrumb_ToScreen(&view, &bc.points[0], &x, &y);
+    TEST_ASSERT_INT_WITHIN(1, 66, x);
+    TEST_ASSERT_EQUAL(MAP_HEIGHT - 1, y);
+    Breadcrumb_ToScreen(&view, &bc.points[1], &x, &y);
+    TEST_ASSERT_INT_WITHIN(1, 61, x);
+    TEST_ASSERT_EQUAL(0, y);
+
+    /* Standing still, the noise is not zoomed in */
+    Breadcrumb_Reset(&bc);
+    add(0, 0);
+    add(0.5, -0.3);
+    Breadcrumb_Fit(&bc, &view, MAP_WIDTH, MAP_HEIGHT);
+    TEST_ASSERT_EQUAL(BREADCRUMB_MIN_MM_PX, view.mm_per_px);
+    checkInside(&view, &bc.points[0]);
+    checkInside(&view, &bc.points[1]);
+}
+
+TEST(BREADCRUMB, Corners)
+{
+    breadcrumb_view_t view;
+
+    /* Odd sizes, all points stay inside */
+    for (int i = 1; i < 50; i++) {
+        Breadcrumb_Reset(&bc);
+        add(0, 0);
+        add(i*37.3, -i*11.1);
+        add(-i*3.7, i*5.9);
+        Breadcrumb_Fit(&bc, &view, MAP_WIDTH, MAP_HEIGHT);
+        checkInside(&view, &bc.min);
+        checkInside(&view, &bc.max);
+        for (uint16_t p = 0; p < bc.count; p++) {
+            checkInside(&view, &bc.points[p]);
+        }
+    }
+}
+
+TEST_GROUP_RUNNER(BREADCRUMB)
+{
+    RUN_TEST_CASE(BREADCRUMB, Decimate);
+    RUN_TEST_CASE(BREADCRUMB, Box);
+    RUN_TEST_CASE(BREADCRUMB, Fit);
+    RUN_TEST_CASE(BREADCRUMB, Corners);
+}
+
+void Breadcrumb_RunTests(void)
+{
+    RUN_TEST_GROUP(BREADCRUMB);
+}
+
+/** @} */
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file    app/test_dispctl.c
+ * @brief   Unit tests for dispctl.c, display switched off on inactivity
+ *
+ * @addtogroup tests
+ * @{
+ */
+
+#include <string.h>
+#include <main.h>
+#include "gui/dispctl.c"
+
+static const dispctl_config_t config = {
+    .timeout_s = 30,
+    .on_ua = 6000,
+    .off_ua = 10,
+};
+
+/** Emulated display */
+static struct {
+    bool on;
+    uint32_t switches;
+} disp;
+
+/* *****************************************************************************
+ * Mocks
+***************************************************************************** */
+static void dispPower(bool on)
+{
+    TEST_ASSERT_NOT_EQUAL(on, disp.on);
+    disp.on = on;
+    disp.switches++;
+}
+
+/* *****************************************************************************
+ * Tests
+***************************************************************************** */
+TEST_GROUP(DISPCTL);
+
+TEST_SETUP(DISPCTL)
+{
+    memset(&disp, 0, sizeof(disp));
+    disp.on = true;
+    DispCtl_Init(&config, dispPower, 1000);
+}
+
+TEST_TEAR_DOWN(DISPCTL)
+{
+}
+
+TEST(DISPCTL, Timeout)
+{
+    TEST_ASSERT_TRUE(DispCtl_IsOn());
+    TEST_ASSERT_EQUAL(30000, DispCtl_Process(1000));
+    TEST_ASSERT_EQUAL(10000, DispCtl_Process(21000));
+
+    /* Activity restarts the timeout */
+    TEST_ASSERT_FALSE(DispCtl_Activity(25000));
+    TEST_ASSERT_EQUAL(29000, DispCtl_Process(26000));
+    TEST_ASSERT_EQUAL(1, DispCtl_Process(54999));
+    TEST_ASSERT_TRUE(disp.on);
+
+    TEST_ASSERT_EQUAL(0, DispCtl_Process(55000));
+    TEST_ASSERT_FALSE(disp.on);
+    TEST_ASSERT_FALSE(DispCtl_IsOn());
+    TEST_ASSERT_EQUAL(0, DispCtl_Process(100000));
+    TEST_ASSERT_EQUAL(1, DispCtl_GetStats()->offs);
+    TEST_ASSERT_EQUAL(1, disp.switches);
+}
+
+TEST(DISPCTL, Wake)
+{
+    DispCtl_Process(31000);
+    TEST_ASSERT_FALSE(disp.on);
+
+    /* Waking press is consumed, next one is not */
+    TEST_ASSERT_TRUE(DispCtl_Activity(40000));
+    TEST_ASSERT_TRUE(disp.on);
+    TEST_ASSERT_FALSE(DispCtl_Activity(41000));
+    TEST_ASSERT_EQUAL(1, DispCtl_GetStats()->wakeups);
+    TEST_ASSERT_EQUAL(30000, DispCtl_Process(41000));
+    TEST_ASSERT_EQUAL(2, disp.switches);
+}
+
+TEST(DISPCTL, Never)
+{
+    DispCtl_SetTimeout(0);
+    TEST_ASSERT_EQUAL(0, DispCtl_GetTimeout());
+    TEST_ASSERT_EQUAL(0, DispCtl_Process(1000));
+    TEST_ASSERT_EQUAL(0, DispCtl_Process(3600000));
+    TEST_ASSERT_TRUE(disp.on);
+
+    /* Shorter timeout counts from the last activity */
+    DispCtl_SetTimeout(15);
+    TEST_ASSERT_EQUAL(0, DispCtl_Process(3600000));
+    TEST_ASSERT_FALSE(disp.on);
+    DispCtl_Activity(3700000);
+    TEST_ASSERT_EQUAL(15000, DispCtl_Process(3700000));
+}
+
+TEST(DISPCTL, Stats)
+{
+    uint32_t now = 1000;
+
+    /* Day with a button press every 10 minutes for 8 hours, idle night */
+    for (int i = 0; i < 48; i++) {
+        DispCtl_Activity(now);
+        now += DispCtl_Process(now);
+        DispCtl_Process(now);
+        now += 600000 - 30000;
+        DispCtl_Process(now);
+    }
+    now += 16*3600000UL;
+    DispCtl_Process(now);
+
+    printf("Display on %u s, off %u s, saved %u uAh\n",
+            DispCtl_GetStats()->on_s, DispCtl_GetStats()->off_s,
+            DispCtl_GetStats()->saved_uah);
+    TEST_ASSERT_EQUAL(48*30, DispCtl_GetStats()->on_s);
+    TEST_ASSERT_EQUAL(24*3600 - 48*30, DispCtl_GetStats()->off_s);
+    TEST_ASSERT_EQUAL(47, DispCtl_GetStats()->wakeups);
+    TEST_ASSERT_EQUAL(48, DispCtl_GetStats()->offs);
+    TEST_ASSERT_EQUAL((uint64_t)(24*3600 - 48*30)*(6000 - 10)/3600,
+            DispCtl_GetStats()->saved_uah);
+}
+
+TEST(DISPCTL, Overflow)
+{
+    DispCtl_Init(&config, dispPower, UINT32_MAX - 10000);
+    TEST_ASSERT_EQUAL(30000, DispCtl_Process(UINT32_MAX - 10000));
+    TEST_ASSERT_EQUAL(10999, DispCtl_Process(9000));
+    TEST_ASSERT_EQUAL(0, DispCtl_Process(19999));
+    TEST_ASSERT_FALSE(disp.on);
+    TEST_ASSERT_EQUAL(30, DispCtl_GetStats()->on_s);
+}
+
+TEST_GROUP_RUNNER(DISPCTL)
+{
+    RUN_TEST_CASE(DISPCTL, Timeout);
+    RUN_TEST_CASE(DISPCTL, Wake);
+    RUN_TEST_CASE(DISPCTL, Never);
+    RUN_TEST_CASE(DISPCTL, Stats);
+    RUN_TEST_CASE(DISPCTL, Overflow);
+}
+
+void DispCtl_RunTests(void)
+{
+    RUN_TEST_GROUP(DISPCTL);
+}
+
+/** @} */
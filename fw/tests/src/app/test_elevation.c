@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/test_elevation.c
+ * @brief   Unit tests for elevation.c, noisy climbs are accumulated
+ *
+ * @addtogroup tests
+ * @{
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <main.h>
+#include "elevation.c"
+
+static const elevation_config_t config = {
+    .deadband_dm = 50,
+    .lowpass_shift = 2,
+};
+
+static elevation_t elev;
+static int32_t ascend;
+static int32_t descend;
+
+/* *****************************************************************************
+ * Helpers
+***************************************************************************** */
+static int32_t noise(int32_t amplitude_dm)
+{
+    return (rand() % (2*amplitude_dm + 1)) - amplitude_dm;
+}
+
+static void add(int32_t elevation_dm)
+{
+    int32_t altitude = Elevation_Add(&elev, elevation_dm);
+
+    if (altitude >= 0) {
+        ascend += altitude;
+    } else {
+        descend += -altitude;
+    }
+}
+
+/**
+ * Climb linearly with noise
+ *
+ * @param from_dm   Start elevation
+ * @param to_dm     End elevation
+ * @param points    Amount of points on the way
+ * @param noise_dm  Max elevation error
+ */
+static void climb(int32_t from_dm, int32_t to_dm, int32_t points,
+        int32_t noise_dm)
+{
+    for (int32_t i = 0; i < points; i++) {
+        add(from_dm + (to_dm - from_dm)*i/(points - 1) + noise(noise_dm));
+    }
+}
+
+/* *****************************************************************************
+ * Tests
+***************************************************************************** */
+TEST_GROUP(ELEVATION);
+
+TEST_SETUP(ELEVATION)
+{
+    srand(1);
+    ascend = 0;
+    descend = 0;
+    Elevation_Init(&elev, &config);
+}
+
+TEST_TEAR_DOWN(ELEVATION)
+{
+}
+
+TEST(ELEVATION, Flat)
+{
+    /* Whole day on flat ground, 3 m vertical noise */
+    climb(2000, 2000, 10000, 30);
+    TEST_ASSERT_EQUAL(0, ascend);
+    TEST_ASSERT_EQUAL(0, descend);
+}
+
+TEST(ELEVATION, Hill)
+{
+    /* Up 300 m and back down, 5 m vertical noise */
+    climb(2000, 5000, 2000, 50);
+    climb(5000, 2000, 2000, 50);
+    TEST_ASSERT_INT_WITHIN(150, 3000, ascend);
+    TEST_ASSERT_INT_WITHIN(150, 3000, descend);
+}
+
+TEST(ELEVATION, Steps)
+{
+    /* Changes add up, no rounding drift over many steps */
+    for (int32_t i = 0; i < 100; i++) {
+        climb(i*100, (i + 1)*100, 2, 0);
+        climb((i + 1)*100, (i + 1)*100, 20, 0);
+    }
+    TEST_ASSERT_INT_WITHIN(config.deadband_dm, 10000, ascend);
+    TEST_ASSERT_TRUE(ascend <= 10000);
+    TEST_ASSERT_EQUAL(0, descend);
+
+    /* Changes below deadband are kept until they add up */
+    for (int32_t i = 0; i < 10; i++) {
+        climb(10000 + i*10, 10000 + (i + 1)*10, 2, 0);
+        climb(10000 + (i + 1)*10, 10000 + (i + 1)*10, 20, 0);
+    }
+    TEST_ASSERT_INT_WITHIN(config.deadband_dm, 10100, ascend);
+    TEST_ASSERT_TRUE(ascend > 10000);
+}
+
+TEST(ELEVATION, Reset)
+{
+    add(1000);
+    add(1000);
+    Elevation_Reset(&elev);
+    climb(5000, 5000, 20, 0);
+    TEST_ASSERT_EQUAL(0, ascend);
+    climb(5000, 4000, 10, 0);
+    climb(4000, 4000, 20, 0);
+    TEST_ASSERT_INT_WITHIN(config.deadband_dm, 1000, descend);
+    TEST_ASSERT_EQUAL(0, ascend);
+}
+
+TEST_GROUP_RUNNER(ELEVATION)
+{
+    RUN_TEST_CASE(ELEVATION, Flat);
+    RUN_TEST_CASE(ELEVATION, Hill);
+    RUN_TEST_CASE(ELEVATION, Steps);
+    RUN_TEST_CASE(ELEVATION, Reset);
+}
+
+void Elevation_RunTests(void)
+{
+    RUN_TEST_GROUP(ELEVATION);
+}
+
+/** @} */
@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/test_filter.c
+ * @brief   Unit tests for filter.c, noisy tracks are replayed through filter
+ *
+ * @addtogroup tests
+ * @{
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <main.h>
+#include "gps/flat.c"
+#include "gps/kalman.c"
+#include "gps/filter.c"
+
+/** 1e-7 deg of latitude in dm */
+#define DM_PER_UNIT 0.0111
+
+static const filter_config_t config = {
+    .hdop_max_dm = 30,
+    .sats_min = 5,
+    .speed_max_dms = 700,
+    .min_dist_m = 5,
+    .move_dist_m = 25,
+    .keepalive_s = 300,
+};
+
+/** Recorded track state */
+static struct {
+    time_t time;
+    double north_dm;        /**< True position */
+    double east_dm;
+    uint32_t stored;
+    uint32_t dist_dm;       /**< Length of the stored track */
+    gps_info_t last;
+    bool last_valid;
+} trk;
+
+/* *****************************************************************************
+ * Mocks
+***************************************************************************** */
+uint32_t Nav_GetDistanceDm(const nmea_float_t *lat1, const nmea_float_t *lon1,
+        const nmea_float_t *lat2, const nmea_float_t *lon2)
+{
+    double dn = (lat1->num - lat2->num)*DM_PER_UNIT;
+    double de = (lon1->num - lon2->num)*DM_PER_UNIT;
+
+    return sqrt(dn*dn + de*de);
+}
+
+/* *****************************************************************************
+ * Helpers
+***************************************************************************** */
+/**
+ * Position error of given amplitude in dm
+ */
+static double noise(uint32_t amplitude_dm)
+{
+    return ((rand() % 2001) - 1000)/1000.0*amplitude_dm;
+}
+
+/**
+ * Feed one fix to filter
+ *
+ * @param err_dm    Error of the reported position
+ * @return True if stored
+ */
+static bool feed(uint32_t err_dm, uint16_t hdop_dm, uint8_t sats)
+{
+    const gps_info_t *point;
+    gps_info_t gps;
+
+    memset(&gps, 0, sizeof(gps));
+    gps.lat.num = (trk.north_dm + noise(err_dm))/DM_PER_UNIT;
+    gps.lat.scale = 10000000;
+    gps.lon.num = (trk.east_dm + noise(err_dm))/DM_PER_UNIT;
+    gps.lon.scale = 10000000;
+    gps.timestamp = trk.time;
+    gps.time = trk.time;
+    gps.hdop_dm = hdop_dm;
+    gps.satellites = sats;
+    gps.altitude_dm = 2000;
+
+    point = Filter_Process(&gps);
+    if (point == NULL) {
+        return false;
+    }
+
+    if (trk.last_valid) {
+        trk.dist_dm += Nav_GetDistanceDm(&trk.last.lat, &trk.last.lon,
+                &point->lat, &point->lon);
+    }
+    memcpy(&trk.last, point, sizeof(trk.last));
+    trk.last_valid = true;
+    trk.stored++;
+    return true;
+}
+
+/**
+ * Move along the track, fix every interval
+ *
+ * @param speed_dms     Speed in dm/s, heading north
+ * @param duration_s    Time to move
+ * @param interval_s    Fix interval
+ * @param err_dm        Position error
+ */
+static void move(uint32_t speed_dms, uint32_t duration_s, uint32_t interval_s,
+        uint32_t err_dm)
+{
+    for (uint32_t t = 0; t < duration_s; t += interval_s) {
+        trk.time += interval_s;
+        trk.north_dm += speed_dms*interval_s;
+        feed(err_dm, 12, 8);
+    }
+}
+
+/* *****************************************************************************
+ * Tests
+***************************************************************************** */
+TEST_GROUP(FILTER);
+
+TEST_SETUP(FILTER)
+{
+    srand(1);
+    memset(&trk, 0, sizeof(trk));
+    trk.time = 1591954215;
+    Filter_Init(&config);
+}
+
+TEST_TEAR_DOWN(FILTER)
+{
+}
+
+TEST(FILTER, Walk)
+{
+    /* 30 minutes at 5 km/h, 14 m between fixes, 3 m error */
+    move(14, 1800, 10, 30);
+
+    TEST_ASSERT_EQUAL(180, Filter_GetStats()->fixes);
+    TEST_ASSERT_EQUAL(180, trk.stored);
+    TEST_ASSERT_EQUAL(0, Filter_GetStats()->jumps);
+    /* Noise doesn't add much to the distance */
+    TEST_ASSERT_UINT_WITHIN(14*1800/20, 14*1800, trk.dist_dm);
+}
+
+TEST(FILTER, Stationary)
+{
+    move(14, 600, 10, 30);
+    trk.stored = 0;
+    trk.dist_dm = 0;
+
+    /* One hour on a bench, fix every 30 s, up to 5 m error */
+    move(0, 3600, 30, 50);
+    /* Few noisy points until it gets stationary, then one per keepalive */
+    TEST_ASSERT_LESS_THAN(3600/300 + 10, trk.stored);
+    TEST_ASSERT_GREATER_OR_EQUAL(3600/300 - 2, Filter_GetStats()->keepalive);
+    TEST_ASSERT_GREATER_THAN(90, Filter_GetStats()->still);
+    /* Noise is added to distance only before it got stationary */
+    TEST_ASSERT_LESS_THAN(1000, trk.dist_dm);
+    TEST_ASSERT_LESS_THAN(300, trk.time - trk.last.timestamp);
+
+    /* Walking again */
+    trk.stored = 0;
+    move(14, 600, 10, 30);
+    TEST_ASSERT_GREATER_THAN(55, trk.stored);
+}
+
+TEST(FILTER, Quality)
+{
+    trk.time++;
+    TEST_ASSERT_TRUE(feed(30, 12, 8));
+    trk.time += 10;
+    trk.north_dm += 140;
+    TEST_ASSERT_FALSE(feed(30, 31, 8));
+    TEST_ASSERT_FALSE(feed(30, 12, 4));
+    TEST_ASSERT_FALSE(feed(30, 0, 8));
+    /* Time must move on */
+    trk.time -= 10;
+    TEST_ASSERT_FALSE(feed(30, 12, 8));
+    trk.time += 10;
+    TEST_ASSERT_TRUE(feed(30, 30, 5));
+    TEST_ASSERT_EQUAL(4, Filter_GetStats()->quality);
+}
+
+TEST(FILTER, Jumps)
+{
+    double north;
+
+    move(14, 600, 10, 30);
+
+    /* Reflections in a city, single fixes 2 km off */
+    for (int i = 0; i < 5; i++) {
+        trk.time += 10;
+        trk.north_dm += 140;
+        north = trk.north_dm;
+        trk.east_dm = 20000;
+        TEST_ASSERT_FALSE(feed(30, 12, 8));
+        trk.east_dm = 0;
+        trk.north_dm = north;
+        move(14, 30, 10, 30);
+    }
+    TEST_ASSERT_EQUAL(5, Filter_GetStats()->jumps);
+    TEST_ASSERT_EQUAL(0, Filter_GetStats()->resets);
+    TEST_ASSERT_UINT_WITHIN(14*750/10, 14*750, trk.dist_dm);
+
+    /* Train ride with receiver off, fixes agree at the new place */
+    trk.time += 20;
+    trk.north_dm += 500000;
+    TEST_ASSERT_FALSE(feed(30, 12, 8));
+    trk.time += 10;
+    TEST_ASSERT_TRUE(feed(30, 12, 8));
+    TEST_ASSERT_EQUAL(1, Filter_GetStats()->resets);
+
+    /* Slow movement after a long off time is not a jump */
+    trk.stored = 0;
+    trk.time += 3600;
+    trk.north_dm += 300000;
+    TEST_ASSERT_TRUE(feed(30, 12, 8));
+    TEST_ASSERT_EQUAL(6, Filter_GetStats()->jumps);
+}
+
+TEST(FILTER, Counters)
+{
+    const filter_stats_t *stats = Filter_GetStats();
+
+    move(14, 600, 10, 30);
+    move(0, 1800, 30, 80);
+    move(14, 600, 10, 30);
+    trk.time += 10;
+    feed(30, 50, 8);
+
+    TEST_ASSERT_EQUAL(stats->fixes, stats->quality + stats->jumps +
+            stats->still + stats->stored);
+    TEST_ASSERT_EQUAL(trk.stored, stats->stored);
+}
+
+TEST_GROUP_RUNNER(FILTER)
+{
+    RUN_TEST_CASE(FILTER, Walk);
+    RUN_TEST_CASE(FILTER, Stationary);
+    RUN_TEST_CASE(FILTER, Quality);
+    RUN_TEST_CASE(FILTER, Jumps);
+    RUN_TEST_CASE(FILTER, Counters);
+}
+
+void Filter_RunTests(void)
+{
+    RUN_TEST_GROUP(FILTER);
+}
+
+/** @} */
@@ -0,0 +1,348 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/test_gpsctl.c
+ * @brief   Unit tests for gpsctl.c, simulates receiver on a multi day trip
+ *
+ * @addtogroup tests
+ * @{
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <main.h>
+#include "gps/gpsctl.c"
+
+/** Simulation step while receiver is running */
+#define SIM_STEP_MS 100
+/** Start of the trip, 2020-06-01 00:00:00 */
+#define SIM_EPOCH 1590969600
+#define SIM_HOUR_MS (3600UL*1000)
+
+static const gpsctl_config_t config = {
+    .interval_s = 10,
+    .interval_min_s = 2,
+    .interval_max_s = 600,
+    .ref_speed_dms = 14,
+    .still_speed_dms = 3,
+    .hdop_max_dm = 30,
+    .sats_min = 5,
+    .timeout_s = 60,
+    .hot_window_s = 1800,
+};
+
+/** Simulated receiver and trip */
+static struct {
+    uint32_t now;           /**< Time since simulation start */
+    bool on;
+    uint32_t fix_at;        /**< Time the receiver gets a fix */
+    uint32_t off_at;
+    bool cold;
+    bool signal;            /**< Sky visible */
+    uint8_t sats;           /**< Satellites used for the fix */
+    uint32_t speed_dms;     /**< Current speed */
+    int64_t pos;            /**< Position along the track in 0.1 mm */
+    uint32_t last_sec;      /**< Last second an output was generated */
+    gps_info_t info;
+} sim;
+
+/** Results of the simulation */
+static struct {
+    uint32_t stored;
+    uint32_t max_gap_s;     /**< Longest time between two stored fixes */
+    time_t last;
+} res;
+
+/* *****************************************************************************
+ * Mocks
+***************************************************************************** */
+/* Position is kept in latitude only, 1e-7 deg is roughly 0.11 dm */
+uint32_t Nav_GetDistanceDm(const nmea_float_t *lat1, const nmea_float_t *lon1,
+        const nmea_float_t *lat2, const nmea_float_t *lon2)
+{
+    (void) lon1;
+    (void) lon2;
+    return labs((long)lat1->num - lat2->num)*1113/10000;
+}
+
+static void simPower(bool on)
+{
+    TEST_ASSERT_NOT_EQUAL(on, sim.on);
+    sim.on = on;
+    if (!on) {
+        sim.off_at = sim.now;
+        return;
+    }
+
+    if (sim.cold) {
+        sim.fix_at = sim.now + 30000 + rand() % 10000;
+        sim.cold = false;
+    } else if (sim.now - sim.off_at <= 1800*1000) {
+        sim.fix_at = sim.now + 1000 + rand() % 2000;
+    } else {
+        sim.fix_at = sim.now + 15000 + rand() % 10000;
+    }
+}
+
+/* *****************************************************************************
+ * Helpers
+***************************************************************************** */
+/**
+ * Move by given time, generate receiver output once per second
+ *
+ * @return Receiver output or NULL
+ */
+static const gps_info_t *simStep(uint32_t ms)
+{
+    uint32_t sec;
+
+    sim.now += ms;
+    sim.pos += (int64_t)sim.speed_dms*ms;
+
+    sec = sim.now/1000;
+    if (!sim.on || sec == sim.last_sec) {
+        return NULL;
+    }
+    sim.last_sec = sec;
+
+    memset(&sim.info, 0, sizeof(sim.info));
+    sim.info.timestamp = SIM_EPOCH + sec;
+    if (!sim.signal || sim.now < sim.fix_at) {
+        sim.info.hdop_dm = 999;
+        sim.info.satellites = 2;
+        return &sim.info;
+    }
+
+    sim.info.lat.num = 500000000 + sim.pos*10/1113;
+    sim.info.lat.scale = 10000000;
+    sim.info.lon.num = 140000000;
+    sim.info.lon.scale = 10000000;
+    sim.info.altitude_dm = 3000;
+    sim.info.hdop_dm = sim.sats > 4 ? 12 : 45;
+    sim.info.satellites = sim.sats;
+    return &sim.info;
+}
+
+/**
+ * Run the logger for given time with given speed
+ */
+static void simRun(uint32_t duration_ms, uint32_t speed_dms, bool signal)
+{
+    uint32_t end = sim.now + duration_ms;
+    const gps_info_t *gps;
+    uint32_t delay;
+
+    sim.speed_dms = speed_dms;
+    sim.signal = signal;
+    while (sim.now < end) {
+        delay = GpsCtl_GetDelayMs(sim.now);
+        if (delay == 0) {
+            delay = SIM_STEP_MS;
+        }
+        if (sim.now + delay > end) {
+            delay = end - sim.now;
+        }
+
+        gps = GpsCtl_Process(simStep(delay), sim.now);
+        TEST_ASSERT_EQUAL(sim.on, GpsCtl_IsOn());
+        if (gps == NULL) {
+            continue;
+        }
+
+        TEST_ASSERT_LESS_OR_EQUAL(config.hdop_max_dm, gps->hdop_dm);
+        if (res.last != 0) {
+            TEST_ASSERT_GREATER_THAN(res.last, gps->timestamp);
+            if ((uint32_t)(gps->timestamp - res.last) > res.max_gap_s) {
+                res.max_gap_s = gps->timestamp - res.last;
+            }
+        }
+        res.last = gps->timestamp;
+        res.stored++;
+    }
+}
+
+/**
+ * Start counting results from now
+ */
+static void resClear(void)
+{
+    res.stored = 0;
+    res.max_gap_s = 0;
+    res.last = 0;
+}
+
+/* *****************************************************************************
+ * Tests
+***************************************************************************** */
+TEST_GROUP(GPSCTL);
+
+TEST_SETUP(GPSCTL)
+{
+    srand(1);
+    memset(&sim, 0, sizeof(sim));
+    memset(&res, 0, sizeof(res));
+    sim.cold = true;
+    sim.signal = true;
+    sim.sats = 8;
+    GpsCtl_Init(&config, simPower, sim.now);
+}
+
+TEST_TEAR_DOWN(GPSCTL)
+{
+}
+
+TEST(GPSCTL, ColdStart)
+{
+    TEST_ASSERT_TRUE(GpsCtl_IsOn());
+    simRun(60000, 0, true);
+
+    TEST_ASSERT_GREATER_OR_EQUAL(1, res.stored);
+    TEST_ASSERT_INT_WITHIN(5000, 35000, GpsCtl_GetStats()->ttff_max_ms);
+    /* Cold start is not used for planning */
+    TEST_ASSERT_LESS_THAN(5000, GpsCtl_GetStats()->ttff_hot_ms);
+}
+
+TEST(GPSCTL, Walking)
+{
+    const gpsctl_stats_t *stats = GpsCtl_GetStats();
+
+    simRun(60000, 14, true);
+    resClear();
+    simRun(SIM_HOUR_MS, 14, true);
+
+    /* One fix per 10 s, hot start every time */
+    TEST_ASSERT_INT_WITHIN(40, 360, res.stored);
+    TEST_ASSERT_LESS_OR_EQUAL(12, res.max_gap_s);
+    TEST_ASSERT_INT_WITHIN(1000, 2000, stats->ttff_hot_ms);
+    TEST_ASSERT_EQUAL(0, stats->timeouts);
+}
+
+TEST(GPSCTL, Driving)
+{
+    const gpsctl_stats_t *stats = GpsCtl_GetStats();
+    uint32_t starts;
+
+    simRun(60000, 250, true);
+    starts = stats->starts;
+    resClear();
+    simRun(SIM_HOUR_MS, 250, true);
+
+    /* Interval too short for power cycling, receiver kept running */
+    TEST_ASSERT_EQUAL(config.interval_min_s, stats->interval_s);
+    TEST_ASSERT_EQUAL(starts, stats->starts);
+    TEST_ASSERT_INT_WITHIN(100, 1800, res.stored);
+    TEST_ASSERT_LESS_OR_EQUAL(3, res.max_gap_s);
+}
+
+TEST(GPSCTL, Stationary)
+{
+    const gpsctl_stats_t *stats = GpsCtl_GetStats();
+
+    simRun(60000, 0, true);
+    resClear();
+    simRun(8*SIM_HOUR_MS, 0, true);
+
+    TEST_ASSERT_EQUAL(config.interval_max_s, stats->interval_s);
+    TEST_ASSERT_INT_WITHIN(5, 8*3600/config.interval_max_s, res.stored);
+    TEST_ASSERT_LESS_OR_EQUAL(config.interval_max_s + 1, res.max_gap_s);
+}
+
+TEST(GPSCTL, Marginal)
+{
+    const gpsctl_stats_t *stats = GpsCtl_GetStats();
+
+    simRun(60000, 14, true);
+    resClear();
+
+    /* Fix the filter would reject doesn't end the slot */
+    sim.sats = 4;
+    simRun(10*60000, 14, true);
+    TEST_ASSERT_EQUAL(0, res.stored);
+    TEST_ASSERT_GREATER_THAN(0, stats->timeouts);
+
+    sim.sats = 5;
+    simRun(60000, 14, true);
+    TEST_ASSERT_GREATER_THAN(0, res.stored);
+}
+
+TEST(GPSCTL, Tunnel)
+{
+    const gpsctl_stats_t *stats = GpsCtl_GetStats();
+    uint32_t on_s;
+
+    simRun(60000, 14, true);
+    on_s = stats->on_s;
+    simRun(10*60*1000, 14, false);
+
+    /* Receiver gives up after timeout and tries again in next slot */
+    TEST_ASSERT_GREATER_THAN(0, stats->timeouts);
+    TEST_ASSERT_LESS_OR_EQUAL(10*60, stats->on_s - on_s);
+    TEST_ASSERT_FALSE(stats->on_s - on_s > 10*60*9/10);
+
+    resClear();
+    simRun(60000, 14, true);
+    TEST_ASSERT_GREATER_OR_EQUAL(4, res.stored);
+}
+
+TEST(GPSCTL, MultiDayTrip)
+{
+    const gpsctl_stats_t *stats = GpsCtl_GetStats();
+    uint32_t day_start;
+
+    for (int day = 0; day < 5; day++) {
+        day_start = stats->on_s;
+        simRun(8*SIM_HOUR_MS, 0, true);         /* night */
+        simRun(2*SIM_HOUR_MS, 14, true);        /* walk to the car */
+        simRun(SIM_HOUR_MS, 250, true);         /* drive */
+        simRun(30*60*1000, 0, true);            /* lunch */
+        simRun(10*60*1000, 14, false);          /* cave */
+        simRun(3*SIM_HOUR_MS, 12, true);        /* hike */
+        simRun(9*SIM_HOUR_MS + 20*60*1000, 0, true);   /* camp */
+
+        /* Receiver on for a small part of the day only (driving mostly) */
+        TEST_ASSERT_LESS_THAN(3*3600, stats->on_s - day_start);
+    }
+    TEST_ASSERT_EQUAL(5*24*SIM_HOUR_MS, sim.now);
+
+    /* Never waited for the fix longer than timeout */
+    TEST_ASSERT_LESS_OR_EQUAL(config.timeout_s*1000, stats->ttff_max_ms);
+    TEST_ASSERT_INT_WITHIN(1000, 2000, stats->ttff_hot_ms);
+    /* Longest gap is the cave entered with stationary interval */
+    TEST_ASSERT_LESS_OR_EQUAL(10*60 + config.interval_max_s +
+            config.timeout_s + 10, res.max_gap_s);
+    /* Far less than one record per second */
+    TEST_ASSERT_LESS_THAN(5*24*3600/20, res.stored);
+}
+
+TEST_GROUP_RUNNER(GPSCTL)
+{
+    RUN_TEST_CASE(GPSCTL, ColdStart);
+    RUN_TEST_CASE(GPSCTL, Walking);
+    RUN_TEST_CASE(GPSCTL, Driving);
+    RUN_TEST_CASE(GPSCTL, Stationary);
+    RUN_TEST_CASE(GPSCTL, Marginal);
+    RUN_TEST_CASE(GPSCTL, Tunnel);
+    RUN_TEST_CASE(GPSCTL, MultiDayTrip);
+}
+
+void GpsCtl_RunTests(void)
+{
+    RUN_TEST_GROUP(GPSCTL);
+}
+
+/** @} */
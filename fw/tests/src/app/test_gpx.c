@@ -89,14 +89,16 @@ TEST(GPX, GetTrkpt)
         "        <time>1970-01-01T00:16:40Z</time>\n"\
         "      </trkpt>";
 
-    TEST_ASSERT_TRUE(GPXi_GetTrkpt(1, buf));
+    TEST_ASSERT_TRUE(GPXi_GetTrkpt(1, Storage_SpaceUsed(), buf));
     TEST_ASSERT_EQUAL(GPX_ITEM_SIZE, strlen(buf));
     TEST_ASSERT_EQUAL_STRING_LEN(expected, buf, strlen(expected));
     TEST_ASSERT_EQUAL('\n', buf[strlen(buf) - 1]);
     /* enough space to make all message fields as long as possible */
     TEST_ASSERT_EQUAL(6, (strlen(buf) + 1) - strlen(expected));
 
-    TEST_ASSERT_FALSE(GPXi_GetTrkpt(Storage_SpaceUsed(), buf));
+    TEST_ASSERT_FALSE(GPXi_GetTrkpt(Storage_SpaceUsed(), Storage_SpaceUsed(),
+                buf));
+    TEST_ASSERT_FALSE(GPXi_GetTrkpt(5, 5, buf));
 }
 
 TEST(GPX, GetTrkHeader)
@@ -109,12 +111,16 @@ TEST(GPX, GetTrkHeader)
         "    <name>Track 01.01.1970 00:16</name>\n"\
         "    <trkseg>";
 
-    TEST_ASSERT_TRUE(GPXi_GetTrkHeader(1, buf));
+    TEST_ASSERT_TRUE(GPXi_GetTrkHeader(1, Storage_SpaceUsed(), true, buf));
     TEST_ASSERT_EQUAL(GPX_ITEM_SIZE, strlen(buf));
     TEST_ASSERT_EQUAL_STRING_LEN(expected, buf, strlen(expected));
     TEST_ASSERT_EQUAL('\n', buf[strlen(buf) - 1]);
 
-    TEST_ASSERT_FALSE(GPXi_GetTrkHeader(Storage_SpaceUsed(), buf));
+    TEST_ASSERT_FALSE(GPXi_GetTrkHeader(Storage_SpaceUsed(),
+                Storage_SpaceUsed(), true, buf));
+
+    TEST_ASSERT_TRUE(GPXi_GetTrkHeader(1, Storage_SpaceUsed(), false, buf));
+    TEST_ASSERT_EQUAL_STRING_LEN("  <trk>", buf, 7);
 }
 
 TEST(GPX, Generate)
@@ -151,11 +157,80 @@ TEST(GPX, Generate)
     TEST_ASSERT_EQUAL_STRING_LEN(GPX_FOOTER, pos, strlen(GPX_FOOTER));
 }
 
+TEST(GPX, GenerateUnaligned)
+{
+    uint32_t size = GPX_GetSize();
+    uint8_t expected[size+512];
+    uint8_t buf[size+512];
+    uint32_t offset = 0;
+    uint32_t len;
+
+    GPX_Get(0, expected, size);
+
+    /* Odd chunk sizes to cross item and footer boundaries at random places */
+    while (offset < size) {
+        len = 7 + offset % 61;
+        GPX_Get(offset, &buf[offset], len);
+        offset += len;
+    }
+    TEST_ASSERT_EQUAL_MEMORY(expected, buf, size);
+
+    /* Same backwards, item split by previous read must not be reused */
+    memset(buf, 0x00, sizeof(buf));
+    while (offset > 0) {
+        len = 7 + offset % 61;
+        len = len > offset ? offset : len;
+        offset -= len;
+        GPX_Get(offset, &buf[offset], len);
+    }
+    TEST_ASSERT_EQUAL_MEMORY(expected, buf, size);
+
+    /* Reading past the end of the file gives zeros */
+    memset(buf, 0xff, sizeof(buf));
+    GPX_Get(size - 10, buf, 100);
+    TEST_ASSERT_EQUAL_MEMORY(&expected[size - 10], buf, 10);
+    TEST_ASSERT_EQUAL(0, buf[10]);
+    TEST_ASSERT_EQUAL(0, buf[99]);
+}
+
+TEST(GPX, GenerateRange)
+{
+    uint32_t size = GPX_GetRangeSize(5, 10);
+    uint8_t buf[size+1];
+    uint8_t *pos = buf;
+
+    GPX_GetRange(5, 10, 0, buf, size + 1);
+    TEST_ASSERT_EQUAL(size, strlen((char *)buf));
+
+    /* header, track header, 5 points, new track, 4 points, footer */
+    TEST_ASSERT_EQUAL(strlen(GPX_HEADER) + 11*GPX_ITEM_SIZE +
+            strlen(GPX_FOOTER), size);
+    pos += strlen(GPX_HEADER);
+    TEST_ASSERT_EQUAL_STRING_LEN("  <trk>\n    <name>Track 01.01.1970 01:23",
+            pos, 40);
+    pos += GPX_ITEM_SIZE*6;
+    TEST_ASSERT_EQUAL_STRING_LEN("    </trkseg>", pos, 13);
+    pos += GPX_ITEM_SIZE*5;
+    TEST_ASSERT_EQUAL_STRING(GPX_FOOTER, pos);
+
+    /* Range ending with end of log mark */
+    TEST_ASSERT_EQUAL(strlen(GPX_HEADER) + 10*GPX_ITEM_SIZE +
+            strlen(GPX_FOOTER), GPX_GetRangeSize(11, 10));
+
+    /* Empty range is still valid file */
+    size = GPX_GetRangeSize(21, 0);
+    GPX_GetRange(21, 0, 0, buf, size + 1);
+    TEST_ASSERT_EQUAL(size, strlen((char *)buf));
+    TEST_ASSERT_EQUAL_STRING(GPX_FOOTER_EMPTY, &buf[strlen(GPX_HEADER)]);
+}
+
 TEST_GROUP_RUNNER(GPX)
 {
     RUN_TEST_CASE(GPX, GetTrkpt);
     RUN_TEST_CASE(GPX, GetTrkHeader);
     RUN_TEST_CASE(GPX, Generate);
+    RUN_TEST_CASE(GPX, GenerateUnaligned);
+    RUN_TEST_CASE(GPX, GenerateRange);
 }
 
 void Gpx_RunTests(void)
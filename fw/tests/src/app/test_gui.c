@@ -25,21 +25,187 @@
 
 #include <string.h>
 #include <time.h>
-#include "modules/cgui/cgui.c"
-#include "modules/cgui/fonts.c"
+#include <math.h>
+#include "gui/gfx.c"
+#include "gui/font_6x8.c"
 #include <main.h>
+#include "i2c_dma.h"
+#include "gui/display.c"
+#include "gui/layout.c"
+#include "gui/dispctl.c"
+#include "gps/flat.c"
+#include "breadcrumb.c"
+#include "profile.c"
 #include "gui/gui.c"
 #include "gui/menu.c"
 #include "gui/screens.c"
 
-static bool pixmap[SSD1306_WIDTH][SSD1306_HEIGHT];
+static const ssd1306_desc_t desc = {
+    .device = 1,
+    .address = SSD1306_ADDR_0,
+};
+static uint8_t fbuf[SSD1306_FBUF_SIZE];
+
+/** Emulated display controller */
+static struct {
+    uint8_t ram[SSD1306_FBUF_SIZE];
+    uint8_t col_start;
+    uint8_t col_end;
+    uint8_t page_start;
+    uint8_t page_end;
+    uint8_t col;
+    uint8_t page;
+    bool on;                /**< Panel and charge pump enabled */
+} oled;
+
+/** Background transfer in progress */
+static struct {
+    i2c_dma_cb_t cb;
+    uint32_t idle;          /**< Idle callback calls */
+} i2c;
 static gps_info_t info;
 static gps_sat_t sat;
 static stats_t stats;
+static breadcrumb_t track;
+static profile_t elev_prof;
+static profile_t speed_prof;
+
+/** Track index, newest first */
+static struct {
+    uint32_t count;
+    uint32_t reads;
+} tracks;
+
+/** Backend calls made while drawing */
+static struct {
+    uint32_t pixel;
+    uint32_t fill;
+    uint32_t blit;
+} ops;
+
+static void countPixel(uint16_t x, uint16_t y, bool value)
+{
+    ops.pixel++;
+    Display_DrawPixel(x, y, value);
+}
+
+static void countFill(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2,
+        bool value)
+{
+    ops.fill++;
+    Display_Fill(x1, y1, x2, y2, value);
+}
+
+static void countBlit(uint16_t x, uint16_t y, const uint8_t *data,
+        uint16_t width, uint8_t height)
+{
+    ops.blit++;
+    Display_Blit(x, y, data, width, height);
+}
+
+static const gfx_backend_t span_backend = {
+    .pixel = countPixel,
+    .fill = countFill,
+    .blit = countBlit,
+};
+static const gfx_backend_t pixel_backend = {
+    .pixel = countPixel,
+};
 
 /* *****************************************************************************
  * Helpers
 ***************************************************************************** */
+/**
+ * Process I2C write in emulated display controller
+ */
+static void oledWrite(const uint8_t *txbuf, size_t txlen)
+{
+    size_t i = 1;
+
+    if (txbuf[0] == DISPLAY_CTRL_DATA) {
+        /* Horizontal addressing, wraps around the window */
+        for (; i < txlen; i++) {
+            oled.ram[oled.page*SSD1306_WIDTH + oled.col] = txbuf[i];
+            if (oled.col++ == oled.col_end) {
+                oled.col = oled.col_start;
+                oled.page = oled.page == oled.page_end ? oled.page_start :
+                        oled.page + 1;
+            }
+        }
+        return;
+    }
+
+    TEST_ASSERT_EQUAL(DISPLAY_CTRL_CMD, txbuf[0]);
+    while (i < txlen) {
+        switch (txbuf[i]) {
+            case DISPLAY_CMD_ADDR_MODE:
+                TEST_ASSERT_EQUAL(DISPLAY_ADDR_MODE_HORIZONTAL, txbuf[i + 1]);
+                i += 2;
+                break;
+            case DISPLAY_CMD_COLUMNS:
+                oled.col_start = oled.col = txbuf[i + 1];
+                oled.col_end = txbuf[i + 2];
+                i += 3;
+                break;
+            case DISPLAY_CMD_PAGES:
+                oled.page_start = oled.page = txbuf[i + 1];
+                oled.page_end = txbuf[i + 2];
+                i += 3;
+                break;
+            case DISPLAY_CMD_CHARGE_PUMP:
+                /* Pump has to be off while panel is off */
+                TEST_ASSERT_FALSE(oled.on);
+                i += 2;
+                break;
+            case DISPLAY_CMD_OFF:
+                oled.on = false;
+                i++;
+                break;
+            case DISPLAY_CMD_ON:
+                oled.on = true;
+                i++;
+                break;
+            default:
+                TEST_FAIL_MESSAGE("Unexpected command");
+                return;
+        }
+    }
+}
+
+/**
+ * Finish background transfers
+ *
+ * @return Amount of transfers finished
+ */
+static uint32_t i2cComplete(void)
+{
+    i2c_dma_cb_t cb;
+    uint32_t count = 0;
+
+    while (i2c.cb != NULL) {
+        cb = i2c.cb;
+        i2c.cb = NULL;
+        count++;
+        cb(true);
+    }
+    return count;
+}
+
+static void displayIdle(void)
+{
+    i2c.idle++;
+}
+
+/**
+ * Finish all transfers including postponed flush
+ */
+static void displaySync(void)
+{
+    i2cComplete();
+    Display_Process();
+    i2cComplete();
+}
+
 /**
  * @brief convert framebuffer content to PBM format image
  *
@@ -47,7 +213,10 @@ static stats_t stats;
  */
 static void print2pbm(const char *name)
 {
-    FILE *f = fopen(name, "w");
+    FILE *f;
+
+    displaySync();
+    f = fopen(name, "w");
     if (f == NULL) {
         return;
     }
@@ -56,7 +225,7 @@ static void print2pbm(const char *name)
 
     for (int y = 0; y < SSD1306_HEIGHT; y++) {
         for (int x = 0; x < SSD1306_WIDTH; x++) {
-            if (pixmap[x][y]) {
+            if (oled.ram[(y/8)*SSD1306_WIDTH + x] & (1 << (y % 8))) {
                 fputc('1', f);
             } else {
                 fputc('0', f);
@@ -67,36 +236,186 @@ static void print2pbm(const char *name)
     fclose(f);
 }
 
+/**
+ * Draw screen and check the display shows the same as framebuffer
+ *
+ * @return Bytes sent to display
+ */
+static uint32_t redraw(void (*draw)(void))
+{
+    uint32_t bytes = Display_GetStats()->bytes;
+
+    draw();
+    displaySync();
+    TEST_ASSERT_EQUAL_MEMORY(fbuf, oled.ram, sizeof(fbuf));
+    return Display_GetStats()->bytes - bytes;
+}
+
+static void drawToday(void)
+{
+    Guii_DrawStats(50, &info, &stats, true);
+}
+
+static void drawGpsFix(void)
+{
+    Guii_DrawGpsFix(&info);
+}
+
+static void drawGpsSat(void)
+{
+    Guii_DrawGpsSat(&sat);
+}
+
+static void drawMenu(void)
+{
+    Gui_Menu(GUI_EVT_REDRAW);
+}
+
+static void drawPopup(void)
+{
+    Gui_Popup("Foo\nBar");
+}
+
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Draw screen repeatedly with given backend
+ *
+ * @return Time per redraw in ns
+ */
+static uint32_t bench(const gfx_backend_t *backend, void (*draw)(void),
+        uint32_t rounds)
+{
+    uint64_t start;
+
+    Gfx_Init(backend, SSD1306_WIDTH, SSD1306_HEIGHT);
+    memset(&ops, 0, sizeof(ops));
+    start = nowNs();
+    for (uint32_t i = 0; i < rounds; i++) {
+        Layout_Invalidate();
+        draw();
+    }
+    return (nowNs() - start)/rounds;
+}
+
+/**
+ * Next fix moves the time and the track a bit
+ */
+static void nextFix(void)
+{
+    info.time += 60;
+    info.lat.num += 12;
+    stats.today.dist_dm += 840;
+    stats.today.time_s += 60;
+    sat.sat[1].snr -= 5;
+}
+
 /* *****************************************************************************
  * Mocks
 ***************************************************************************** */
-void SSD1306_Flush(void)
+bool I2Cd_Transceive(uint8_t device, uint8_t address, const uint8_t *txbuf,
+        size_t txlen, uint8_t *rxbuf, size_t rxlen)
+{
+    TEST_ASSERT_EQUAL(desc.device, device);
+    TEST_ASSERT_EQUAL(desc.address, address);
+    TEST_ASSERT_NULL(rxbuf);
+    TEST_ASSERT_EQUAL(0, rxlen);
+    TEST_ASSERT_NULL(i2c.cb);
+
+    oledWrite(txbuf, txlen);
+    return true;
+}
+
+bool I2cDma_Write(uint8_t address, uint8_t prefix, const uint8_t *data,
+        size_t len, i2c_dma_cb_t cb)
 {
-    return;
+    uint8_t txbuf[SSD1306_WIDTH + 1];
+
+    TEST_ASSERT_EQUAL(desc.address, address);
+    TEST_ASSERT_NULL(i2c.cb);
+    TEST_ASSERT_TRUE(len < sizeof(txbuf));
+
+    /* Data are sent in background, controller gets them at the end */
+    txbuf[0] = prefix;
+    memcpy(&txbuf[1], data, len);
+    oledWrite(txbuf, len + 1);
+    i2c.cb = cb;
+    return true;
 }
 
-void SSD1306_DrawPixel(uint16_t x, uint16_t y, bool value)
+void I2cDma_Wait(void)
 {
-    TEST_ASSERT_LESS_THAN(SSD1306_WIDTH, x);
-    TEST_ASSERT_LESS_THAN(SSD1306_HEIGHT, y);
-    pixmap[x][y] = value;
+    i2cComplete();
 }
 
-gps_info_t *Gps_Get(void)
+const gps_info_t *Gnss_Get(void)
 {
     return &info;
 }
 
-gps_sat_t *Gps_GetSat(void)
+const gps_sat_t *Gnss_GetSat(void)
 {
     return &sat;
 }
 
+void Gnss_SetSatOutput(bool enable)
+{
+    (void) enable;
+}
+
 stats_t *Stats_Get(void)
 {
     return &stats;
 }
 
+const breadcrumb_t *Stats_GetTrack(void)
+{
+    return &track;
+}
+
+const profile_t *Stats_GetElevationProfile(void)
+{
+    return &elev_prof;
+}
+
+const profile_t *Stats_GetSpeedProfile(void)
+{
+    return &speed_prof;
+}
+
+uint32_t Tracks_GetCount(void)
+{
+    return tracks.count;
+}
+
+bool Tracks_Get(uint32_t index, storage_track_t *track)
+{
+    if (index >= tracks.count) {
+        return false;
+    }
+    tracks.reads++;
+    memset(track, 0, sizeof(*track));
+    track->first = (tracks.count - 1 - index)*100;
+    track->count = 100;
+    track->start = 1591954215 + (tracks.count - 1 - index)*86400;
+    track->duration_s = 3600 + index*60;
+    track->dist_dm = 12345 + index*1000;
+    track->ascend_dm = 1234;
+    track->descend_dm = 987;
+    return true;
+}
+
+void Tracks_Init(void)
+{
+
+}
+
 void Storage_Erase(void)
 {
 
@@ -117,6 +436,16 @@ void Stats_Init(void)
 
 }
 
+void Usb_Lock(void)
+{
+
+}
+
+void Usb_Unlock(void)
+{
+
+}
+
 void Log_Raw(log_level_t level, const char *source,
         const char *format, ...)
 {
@@ -131,9 +460,13 @@ TEST_GROUP(GUI);
 
 TEST_SETUP(GUI)
 {
-    /* clear pix map */
-    memset((bool *)pixmap, 0xff, sizeof(pixmap));
+    /* Display RAM content is random after power up */
+    memset(&oled, 0xa5, sizeof(oled));
+    memset(&i2c, 0, sizeof(i2c));
+    Display_Init(&desc, fbuf, displayIdle);
+    oled.on = true;
     Gui_Init();
+    Layout_Invalidate();
 
     info.lat.num = -49123456;
     info.lat.scale = 1000000;
@@ -206,6 +539,67 @@ TEST(GUI, ScrGpsSat)
     print2pbm("scr_gps_sat.pbm");
 }
 
+TEST(GUI, ScrMap)
+{
+    gps_info_t gps = info;
+    uint32_t pixels = 0;
+
+    Breadcrumb_Reset(&track);
+    Guii_DrawMap(&track);
+    print2pbm("scr_map.pbm");
+
+    /* Figure eight, 2 km across, more points than the buffer holds */
+    for (int i = 0; i < 1000; i++) {
+        gps.lat.num = 491234560 + lround(4000*sin(i*4*M_PI/1000));
+        gps.lat.scale = 10000000;
+        gps.lon.num = 162123456 + lround(140000*sin(i*2*M_PI/1000));
+        gps.lon.scale = 10000000;
+        Breadcrumb_Add(&track, &gps);
+    }
+    Guii_DrawMap(&track);
+    print2pbm("scr_map.pbm");
+    for (size_t i = SSD1306_WIDTH*2; i < sizeof(fbuf); i++) {
+        pixels += __builtin_popcount(fbuf[i]);
+    }
+    TEST_ASSERT_TRUE(pixels > 200);
+}
+
+TEST(GUI, ScrProfile)
+{
+    uint32_t columns = 0;
+
+    Profile_Reset(&elev_prof);
+    Profile_Reset(&speed_prof);
+    Guii_DrawProfile(&elev_prof, &speed_prof);
+    print2pbm("scr_profile.pbm");
+
+    /* Short track is stretched, every column has a sample */
+    for (int i = 0; i < 50; i++) {
+        Profile_Add(&elev_prof, 400 + i*3);
+        Profile_Add(&speed_prof, 14);
+    }
+    Guii_DrawProfile(&elev_prof, &speed_prof);
+    for (int x = 0; x < SSD1306_WIDTH; x++) {
+        uint8_t column = 0;
+
+        /* Below the header */
+        for (int page = 2; page < SSD1306_HEIGHT/8; page++) {
+            column |= fbuf[SSD1306_WIDTH*page + x];
+        }
+        columns += column != 0;
+    }
+    TEST_ASSERT_EQUAL(SSD1306_WIDTH, columns);
+
+    /* Climb with a break, walking slows down uphill */
+    for (int i = 0; i < 3000; i++) {
+        Profile_Add(&elev_prof, 450 + (i < 1500 ? i/3 : 500) +
+                (i % 7) - 3);
+        Profile_Add(&speed_prof, i < 1500 ? 10 + i % 5 : 14 + i % 3);
+    }
+    Guii_DrawProfile(&elev_prof, &speed_prof);
+    print2pbm("scr_profile.pbm");
+}
+
 TEST(GUI, ScrStats)
 {
     Guii_DrawStats(12, &info, &stats, true);
@@ -227,15 +621,400 @@ TEST(GUI, ScrMenu)
     print2pbm("scr_menu.pbm");
 }
 
+TEST(GUI, ScrTracks)
+{
+    uint32_t reads;
+
+    tracks.count = 300;
+    Gui_Menu(GUI_EVT_ENTERED);
+    Gui_Menu(GUI_EVT_SHORT_NEXT);
+    Gui_Menu(GUI_EVT_SHORT_ENTER);
+    print2pbm("scr_tracks.pbm");
+
+    /* Only visible lines are generated */
+    for (uint32_t i = 0; i < 150; i++) {
+        tracks.reads = 0;
+        Gui_Menu(GUI_EVT_SHORT_NEXT);
+        TEST_ASSERT_TRUE(tracks.reads <= 6);
+    }
+    print2pbm("scr_tracks_scroll.pbm");
+
+    reads = tracks.reads;
+    Gui_Menu(GUI_EVT_SHORT_ENTER);
+    TEST_ASSERT_EQUAL(reads + 1, tracks.reads);
+    print2pbm("scr_track_detail.pbm");
+
+    /* Back item follows the tracks */
+    for (uint32_t i = 150; i < tracks.count; i++) {
+        Gui_Menu(GUI_EVT_SHORT_NEXT);
+    }
+    Gui_Menu(GUI_EVT_SHORT_ENTER);
+    tracks.reads = 0;
+    Gui_Menu(GUI_EVT_REDRAW);
+    TEST_ASSERT_EQUAL(0, tracks.reads);
+    Gui_Menu(GUI_EVT_ENTERED);
+    tracks.count = 0;
+}
+
+TEST(GUI, FlushBytes)
+{
+    static const struct {
+        const char *name;
+        void (*draw)(void);
+    } screens[] = {
+        { "Today", drawToday },
+        { "GpsFix", drawGpsFix },
+        { "GpsSat", drawGpsSat },
+        { "Menu", drawMenu },
+    };
+    uint32_t full, same, next;
+
+    for (size_t i = 0; i < sizeof(screens)/sizeof(screens[0]); i++) {
+        Display_Invalidate();
+        full = redraw(screens[i].draw);
+        same = redraw(screens[i].draw);
+        nextFix();
+        next = redraw(screens[i].draw);
+
+        printf("%-8s I2C bytes: full %u, same content %u, next fix %u\n",
+                screens[i].name, full, same, next);
+        TEST_ASSERT_EQUAL(DISPLAY_PAGES*(7 + 1 + SSD1306_WIDTH), full);
+        TEST_ASSERT_EQUAL(0, same);
+        TEST_ASSERT_LESS_THAN(full/4, next);
+    }
+}
+
+TEST(GUI, Backend)
+{
+    static const struct {
+        const char *name;
+        void (*draw)(void);
+    } screens[] = {
+        { "Today", drawToday },
+        { "GpsFix", drawGpsFix },
+        { "GpsSat", drawGpsSat },
+        { "Menu", drawMenu },
+        { "Popup", drawPopup },
+    };
+    static uint8_t pixel_fbuf[SSD1306_FBUF_SIZE];
+    uint32_t pixel_ns, pixel_ops, span_ns, span_ops;
+
+    for (size_t i = 0; i < sizeof(screens)/sizeof(screens[0]); i++) {
+        /* Output is the same pixel by pixel */
+        pixel_ns = bench(&pixel_backend, screens[i].draw, 100);
+        pixel_ops = (ops.pixel + ops.fill + ops.blit)/100;
+        memcpy(pixel_fbuf, fbuf, sizeof(fbuf));
+
+        span_ns = bench(&span_backend, screens[i].draw, 100);
+        span_ops = (ops.pixel + ops.fill + ops.blit)/100;
+        TEST_ASSERT_EQUAL_MEMORY(pixel_fbuf, fbuf, sizeof(fbuf));
+
+        printf("%-8s backend calls %5u -> %4u, host ns per redraw "
+                "%6u -> %6u\n", screens[i].name, pixel_ops, span_ops,
+                pixel_ns, span_ns);
+        TEST_ASSERT_LESS_THAN(pixel_ops/4, span_ops);
+    }
+}
+
+TEST(GUI, Retained)
+{
+    static uint8_t full_fbuf[SSD1306_FBUF_SIZE];
+    uint32_t bytes;
+
+    Gfx_Init(&span_backend, SSD1306_WIDTH, SSD1306_HEIGHT);
+    redraw(drawToday);
+
+    /* Nothing changed, nothing drawn */
+    memset(&ops, 0, sizeof(ops));
+    TEST_ASSERT_EQUAL(0, redraw(drawToday));
+    TEST_ASSERT_EQUAL(0, ops.pixel + ops.fill + ops.blit);
+
+    /* Only changed values are drawn, result is the same as full redraw */
+    nextFix();
+    memset(&ops, 0, sizeof(ops));
+    bytes = redraw(drawToday);
+    printf("Next fix: %u backend calls, %u I2C bytes\n",
+            ops.pixel + ops.fill + ops.blit, bytes);
+    TEST_ASSERT_LESS_THAN(40, bytes);
+    TEST_ASSERT_EQUAL(0, ops.fill);
+    print2pbm("scr_today_next.pbm");
+    memcpy(full_fbuf, fbuf, sizeof(fbuf));
+    Layout_Invalidate();
+    drawToday();
+    TEST_ASSERT_EQUAL_MEMORY(full_fbuf, fbuf, sizeof(fbuf));
+
+    /* Lost fix shows dashes */
+    Guii_DrawStats(50, NULL, &stats, true);
+    print2pbm("scr_today_nofix.pbm");
+    memcpy(full_fbuf, fbuf, sizeof(fbuf));
+    Layout_Invalidate();
+    Guii_DrawStats(50, NULL, &stats, true);
+    TEST_ASSERT_EQUAL_MEMORY(full_fbuf, fbuf, sizeof(fbuf));
+
+    /* Popup over the screen is removed by the next redraw */
+    Gui_Popup("Foo");
+    Gui_Event(GUI_EVT_SHORT_ENTER);
+    Guii_DrawStats(50, NULL, &stats, true);
+    TEST_ASSERT_EQUAL_MEMORY(full_fbuf, fbuf, sizeof(fbuf));
+}
+
+TEST(GUI, Async)
+{
+    static uint8_t first[SSD1306_FBUF_SIZE];
+
+    Guii_DrawStats(50, &info, &stats, true);
+    displaySync();
+    TEST_ASSERT_FALSE(Display_Busy());
+
+    /* Next frame is drawn while the previous one is being sent */
+    nextFix();
+    Guii_DrawStats(50, &info, &stats, true);
+    TEST_ASSERT_TRUE(Display_Busy());
+    memcpy(first, fbuf, sizeof(fbuf));
+    nextFix();
+    Guii_DrawStats(50, &info, &stats, true);
+    TEST_ASSERT_TRUE(i2cComplete() > 0);
+    TEST_ASSERT_FALSE(Display_Busy());
+    TEST_ASSERT_EQUAL_MEMORY(first, oled.ram, sizeof(fbuf));
+
+    /* Postponed flush is signalled and sends the last frame */
+    TEST_ASSERT_EQUAL(1, i2c.idle);
+    Display_Process();
+    TEST_ASSERT_TRUE(Display_Busy());
+    i2cComplete();
+    TEST_ASSERT_EQUAL_MEMORY(fbuf, oled.ram, sizeof(fbuf));
+    TEST_ASSERT_EQUAL(1, i2c.idle);
+
+    /* Nothing left */
+    Display_Process();
+    TEST_ASSERT_FALSE(Display_Busy());
+}
+
+TEST(GUI, Coalesce)
+{
+    uint32_t flushes = Display_GetStats()->flushes;
+    uint32_t now = 1000;
+
+    /* First change is drawn right away, more of them wait for next frame */
+    Gui_Changed(GUI_DEP_FIX);
+    TEST_ASSERT_EQUAL(0, Gui_Process(now));
+    Gui_Changed(GUI_DEP_FIX);
+    Gui_Changed(GUI_DEP_STATS);
+    TEST_ASSERT_EQUAL(1000/GUI_FPS, Gui_Process(now));
+    now += 100;
+    Gui_Changed(GUI_DEP_FIX);
+    TEST_ASSERT_EQUAL(1000/GUI_FPS - 100, Gui_Process(now));
+    now += 1000/GUI_FPS - 100;
+    TEST_ASSERT_EQUAL(0, Gui_Process(now));
+    TEST_ASSERT_EQUAL(0, Gui_Process(now));
+    TEST_ASSERT_EQUAL(2, Gui_GetStats()->redraws);
+    TEST_ASSERT_EQUAL(2, Display_GetStats()->flushes - flushes);
+
+    /* Button press and fix together draw once, button goes first */
+    now += 1000;
+    Gui_Changed(GUI_DEP_FIX | GUI_DEP_STATS);
+    Gui_Post(GUI_EVT_SHORT_NEXT);
+    TEST_ASSERT_EQUAL(0, Gui_Process(now));
+    TEST_ASSERT_EQUAL(0, Gui_Process(now));
+    TEST_ASSERT_EQUAL(1, Gui_GetStats()->events);
+    TEST_ASSERT_EQUAL(2, Gui_GetStats()->redraws);
+    TEST_ASSERT_EQUAL(3, Display_GetStats()->flushes - flushes);
+
+    /* Input is not rate limited */
+    Gui_Post(GUI_EVT_SHORT_NEXT);
+    Gui_Post(GUI_EVT_SHORT_NEXT);
+    TEST_ASSERT_EQUAL(0, Gui_Process(now));
+    TEST_ASSERT_EQUAL(3, Gui_GetStats()->events);
+    TEST_ASSERT_EQUAL(5, Display_GetStats()->flushes - flushes);
+
+    /* Satellite screen doesn't care about stats */
+    now += 1000;
+    Gui_Changed(GUI_DEP_FIX | GUI_DEP_STATS);
+    TEST_ASSERT_EQUAL(0, Gui_Process(now));
+    TEST_ASSERT_EQUAL(1, Gui_GetStats()->skipped);
+    now += 1000;
+    Gui_Changed(GUI_DEP_SAT);
+    TEST_ASSERT_EQUAL(0, Gui_Process(now));
+    TEST_ASSERT_EQUAL(3, Gui_GetStats()->redraws);
+    TEST_ASSERT_EQUAL(6, Display_GetStats()->flushes - flushes);
+
+    /* Forced redraw */
+    now += 1000;
+    Gui_Post(GUI_EVT_REDRAW);
+    TEST_ASSERT_EQUAL(0, Gui_Process(now));
+    TEST_ASSERT_EQUAL(4, Gui_GetStats()->redraws);
+}
+
+TEST(GUI, Script)
+{
+    static const struct {
+        uint32_t time_ms;
+        bool next;              /**< Next button pressed */
+        uint8_t deps;           /**< Data changed */
+    } script[] = {
+        /* Fixes every second, satellites twice per second */
+        { 0, false, GUI_DEP_FIX | GUI_DEP_SAT | GUI_DEP_STATS },
+        { 500, false, GUI_DEP_SAT },
+        { 1000, false, GUI_DEP_FIX | GUI_DEP_SAT | GUI_DEP_STATS },
+        { 1010, true, 0 },
+        { 1020, false, GUI_DEP_SAT },
+        { 1500, false, GUI_DEP_SAT },
+        { 2000, false, GUI_DEP_FIX | GUI_DEP_SAT | GUI_DEP_STATS },
+        { 2050, false, GUI_DEP_FIX },
+        { 2100, false, GUI_DEP_FIX },
+        { 2500, false, GUI_DEP_SAT },
+    };
+    uint32_t delay = 0;
+    uint32_t due = 0;
+
+    /* Today screen, then fix screen */
+    Gui_Post(GUI_EVT_LONG_NEXT);
+    Gui_Process(0);
+    for (size_t i = 0; i < sizeof(script)/sizeof(script[0]); i++) {
+        if (delay != 0 && due <= script[i].time_ms) {
+            delay = Gui_Process(due);
+        }
+        if (script[i].next) {
+            Gui_Post(GUI_EVT_SHORT_NEXT);
+        }
+        Gui_Changed(script[i].deps);
+        delay = Gui_Process(script[i].time_ms);
+        due = script[i].time_ms + delay;
+    }
+    if (delay != 0) {
+        Gui_Process(due);
+    }
+
+    printf("Script: %u events, %u redraws, %u skipped, %u flushes\n",
+            Gui_GetStats()->events, Gui_GetStats()->redraws,
+            Gui_GetStats()->skipped, Display_GetStats()->flushes);
+    TEST_ASSERT_EQUAL(2, Gui_GetStats()->events);
+    /* Postponed after button at 0, fixes at 1000 and 2000, then 2050 and
+     * 2100 together. Satellites are never shown */
+    TEST_ASSERT_EQUAL(4, Gui_GetStats()->redraws);
+    TEST_ASSERT_EQUAL(4, Gui_GetStats()->skipped);
+}
+
+TEST(GUI, Sleep)
+{
+    uint32_t flushes;
+    uint32_t bytes;
+    uint32_t redraws;
+
+    Gui_Post(GUI_EVT_REDRAW);
+    Gui_Process(0);
+    displaySync();
+
+    /* Transfer in progress is finished before switching off */
+    Gui_Post(GUI_EVT_SHORT_NEXT);
+    Gui_Process(1000);
+    TEST_ASSERT_TRUE(Display_Busy());
+    Display_Power(false);
+    TEST_ASSERT_FALSE(Display_Busy());
+    TEST_ASSERT_FALSE(oled.on);
+    TEST_ASSERT_EQUAL_MEMORY(fbuf, oled.ram, sizeof(fbuf));
+    Gui_Sleep(true);
+
+    /* Nothing is drawn while off */
+    flushes = Display_GetStats()->flushes;
+    bytes = Display_GetStats()->bytes;
+    redraws = Gui_GetStats()->redraws;
+    for (uint32_t now = 2000; now < 10000; now += 500) {
+        nextFix();
+        Gui_Changed(GUI_DEP_FIX | GUI_DEP_SAT | GUI_DEP_STATS);
+        TEST_ASSERT_EQUAL(0, Gui_Process(now));
+    }
+    Gui_Popup("USB connected");
+    Gui_Post(GUI_EVT_SHORT_NEXT);
+    TEST_ASSERT_EQUAL(0, Gui_Process(10000));
+    TEST_ASSERT_EQUAL(flushes, Display_GetStats()->flushes);
+    TEST_ASSERT_EQUAL(bytes, Display_GetStats()->bytes);
+    TEST_ASSERT_EQUAL(redraws, Gui_GetStats()->redraws);
+
+    /* Popup shown while off appears on wake up */
+    Display_Power(true);
+    TEST_ASSERT_TRUE(oled.on);
+    Gui_Sleep(false);
+    displaySync();
+    TEST_ASSERT_EQUAL_MEMORY(fbuf, oled.ram, sizeof(fbuf));
+    print2pbm("sleep_popup.pbm");
+
+    /* Closed popup while off, screen with current data on wake up */
+    Gui_Sleep(true);
+    Gui_PopupClose();
+    TEST_ASSERT_EQUAL(flushes + 1, Display_GetStats()->flushes);
+    Gui_Sleep(false);
+    TEST_ASSERT_EQUAL(0, Gui_Process(20000));
+    TEST_ASSERT_EQUAL(redraws + 1, Gui_GetStats()->redraws);
+    TEST_ASSERT_EQUAL(flushes + 2, Display_GetStats()->flushes);
+    displaySync();
+    TEST_ASSERT_EQUAL_MEMORY(fbuf, oled.ram, sizeof(fbuf));
+}
+
+TEST(GUI, Glyphs)
+{
+    static const char *text[] = {
+        "ABCDEFGHIJKLMNOPQRSTU",
+        "abcdefghijklmnopqrstu",
+    };
+    static const struct {
+        const char *name;
+        const gfx_backend_t *backend;
+        uint16_t y;
+    } paths[] = {
+        { "Pixel", &pixel_backend, 8 },
+        { "Shifted", &span_backend, 11 },
+        { "Aligned", &span_backend, 8 },
+    };
+    static uint8_t pixel_fbuf[SSD1306_FBUF_SIZE];
+    uint32_t glyphs = strlen(text[0])*1000;
+    uint64_t start;
+    uint32_t ns[3];
+
+    for (size_t i = 0; i < sizeof(paths)/sizeof(paths[0]); i++) {
+        Gfx_Init(paths[i].backend, SSD1306_WIDTH, SSD1306_HEIGHT);
+        Gfx_FillScreen(false);
+        start = nowNs();
+        for (int round = 0; round < 1000; round++) {
+            Gfx_Puts(0, paths[i].y, text[round % 2]);
+        }
+        ns[i] = nowNs() - start;
+        printf("%-8s glyphs per ms on host: %u\n", paths[i].name,
+                (unsigned)((uint64_t)glyphs*1000000/ns[i]));
+
+        /* Copied glyphs look the same as drawn ones */
+        if (paths[i].y == paths[0].y) {
+            if (i == 0) {
+                memcpy(pixel_fbuf, fbuf, sizeof(fbuf));
+            } else {
+                TEST_ASSERT_EQUAL_MEMORY(pixel_fbuf, fbuf, sizeof(fbuf));
+            }
+        }
+    }
+    TEST_ASSERT_LESS_THAN(ns[0], ns[2]);
+    TEST_ASSERT_LESS_THAN(ns[1], ns[2]);
+}
+
 TEST_GROUP_RUNNER(GUI)
 {
     RUN_TEST_CASE(GUI, Popup);
     RUN_TEST_CASE(GUI, Popup2);
     RUN_TEST_CASE(GUI, ScrGpsFix);
     RUN_TEST_CASE(GUI, ScrGpsSat);
+    RUN_TEST_CASE(GUI, ScrMap);
+    RUN_TEST_CASE(GUI, ScrProfile);
     RUN_TEST_CASE(GUI, ScrStats);
     RUN_TEST_CASE(GUI, ScrDevInfo);
     RUN_TEST_CASE(GUI, ScrMenu);
+    RUN_TEST_CASE(GUI, ScrTracks);
+    RUN_TEST_CASE(GUI, FlushBytes);
+    RUN_TEST_CASE(GUI, Backend);
+    RUN_TEST_CASE(GUI, Retained);
+    RUN_TEST_CASE(GUI, Async);
+    RUN_TEST_CASE(GUI, Coalesce);
+    RUN_TEST_CASE(GUI, Script);
+    RUN_TEST_CASE(GUI, Sleep);
+    RUN_TEST_CASE(GUI, Glyphs);
 }
 
 void Gui_RunTests(void)
@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/test_kalman.c
+ * @brief   Unit tests for kalman.c, compares filtering with and without
+ *          smoothing on generated tracks
+ *
+ * @addtogroup tests
+ * @{
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <main.h>
+#include "gps/flat.c"
+#include "gps/kalman.c"
+#include "gps/filter.c"
+
+/** 1e-7 deg in m, tracks are on equator so it's the same for lon */
+#define M_PER_UNIT 0.011132
+#define START_TIME 1591954215
+
+static const kalman_config_t kalman_config = {
+    .uere_dm = 40,
+    .accel_dms2 = 10,
+    .reset_s = 30,
+};
+
+static filter_config_t config = {
+    .hdop_max_dm = 30,
+    .sats_min = 5,
+    .speed_max_dms = 700,
+    .min_dist_m = 5,
+    .move_dist_m = 25,
+    .keepalive_s = 300,
+};
+
+/** Generated track and results of its filtering */
+static struct {
+    time_t time;
+    double x;               /**< True position in m east */
+    double y;               /**< True position in m north */
+    double alt;
+    double heading;         /**< rad, 0 is north */
+    double dist;            /**< True track length in m */
+    double err2;            /**< Sum of squared errors of fixes, m^2 */
+    uint32_t fixes;
+    uint32_t stored;
+    double stored_dist;     /**< Length of stored track in m */
+    double stored_x;
+    double stored_y;
+} trk;
+
+/* *****************************************************************************
+ * Mocks
+***************************************************************************** */
+uint32_t Nav_GetDistanceDm(const nmea_float_t *lat1, const nmea_float_t *lon1,
+        const nmea_float_t *lat2, const nmea_float_t *lon2)
+{
+    double dn = (lat1->num - lat2->num)*M_PER_UNIT*10;
+    double de = (lon1->num - lon2->num)*M_PER_UNIT*10;
+
+    return sqrt(dn*dn + de*de);
+}
+
+/* *****************************************************************************
+ * Helpers
+***************************************************************************** */
+/**
+ * Roughly normal distributed error with given deviation
+ */
+static double noise(double sigma)
+{
+    double sum = 0;
+
+    for (int i = 0; i < 12; i++) {
+        sum += rand()/(double)RAND_MAX;
+    }
+    return (sum - 6)*sigma;
+}
+
+static void toGps(gps_info_t *gps, double x, double y, double alt)
+{
+    memset(gps, 0, sizeof(*gps));
+    gps->lat.num = lround(y/M_PER_UNIT);
+    gps->lat.scale = 10000000;
+    gps->lon.num = lround(x/M_PER_UNIT);
+    gps->lon.scale = 10000000;
+    gps->altitude_dm = lround(alt*10);
+    gps->timestamp = trk.time;
+    gps->time = trk.time;
+    gps->satellites = 8;
+}
+
+/**
+ * Pass one noisy fix of the current position to the filter
+ */
+static void feed(uint16_t hdop_dm)
+{
+    const gps_info_t *point;
+    gps_info_t gps;
+    double sigma = hdop_dm/10.0*kalman_config.uere_dm/10.0/M_SQRT2;
+    double x, y;
+
+    toGps(&gps, trk.x + noise(sigma), trk.y + noise(sigma),
+            trk.alt + noise(sigma*1.5));
+    gps.hdop_dm = hdop_dm;
+
+    point = Filter_Process(&gps);
+    if (point == NULL) {
+        return;
+    }
+
+    x = point->lon.num*M_PER_UNIT;
+    y = point->lat.num*M_PER_UNIT;
+    if (point->timestamp == trk.time) {
+        trk.err2 += (x - trk.x)*(x - trk.x) + (y - trk.y)*(y - trk.y);
+        trk.fixes++;
+    }
+    if (trk.stored != 0) {
+        trk.stored_dist += hypot(x - trk.stored_x, y - trk.stored_y);
+    }
+    trk.stored_x = x;
+    trk.stored_y = y;
+    trk.stored++;
+}
+
+/**
+ * Move along the track, fix every second
+ *
+ * @param speed_ms      Speed in m/s
+ * @param duration_s    Time to move
+ * @param turn_ds       Heading change in deg per second
+ */
+static void move(double speed_ms, uint32_t duration_s, double turn_ds)
+{
+    for (uint32_t i = 0; i < duration_s; i++) {
+        trk.time++;
+        trk.heading += turn_ds*M_PI/180;
+        trk.x += speed_ms*sin(trk.heading);
+        trk.y += speed_ms*cos(trk.heading);
+        trk.dist += speed_ms;
+        feed(12);
+    }
+}
+
+/**
+ * Hike with stops and turns, one fix per second
+ *
+ * @param smooth    Enable smoothing
+ */
+static void hike(bool smooth)
+{
+    srand(1);
+    memset(&trk, 0, sizeof(trk));
+    trk.time = START_TIME;
+    config.kalman = smooth ? &kalman_config : NULL;
+    Filter_Init(&config);
+
+    for (int i = 0; i < 20; i++) {
+        move(1.4, 120, 0);
+        move(1.4, 30, 3*(i % 2 ? 1 : -1));
+    }
+    /* Lunch break */
+    move(0, 1200, 0);
+    for (int i = 0; i < 10; i++) {
+        move(1.2, 90, 1.5);
+        move(1.2, 60, 0);
+    }
+}
+
+static void report(const char *name)
+{
+    printf("%-12s %u points stored, track %.0f m of %.0f m (%+.1f %%), "
+            "fix rms error %.2f m\n", name, trk.stored, trk.stored_dist,
+            trk.dist, (trk.stored_dist - trk.dist)*100/trk.dist,
+            sqrt(trk.err2/trk.fixes));
+}
+
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+/* *****************************************************************************
+ * Tests
+***************************************************************************** */
+TEST_GROUP(KALMAN);
+
+TEST_SETUP(KALMAN)
+{
+    srand(1);
+    memset(&trk, 0, sizeof(trk));
+    trk.time = START_TIME;
+    Kalman_Init(&kalman_config);
+}
+
+TEST_TEAR_DOWN(KALMAN)
+{
+}
+
+TEST(KALMAN, Still)
+{
+    const gps_info_t *point = NULL;
+    gps_info_t gps;
+    double raw2 = 0;
+    double err2 = 0;
+
+    for (int i = 0; i < 600; i++) {
+        trk.time++;
+        toGps(&gps, noise(3), noise(3), 200 + noise(5));
+        gps.hdop_dm = 12;
+        raw2 += pow(gps.lon.num*M_PER_UNIT, 2) +
+                pow(gps.lat.num*M_PER_UNIT, 2);
+        point = Kalman_Process(&gps);
+        TEST_ASSERT_EQUAL(trk.time, point->timestamp);
+        if (i >= 60) {
+            err2 += pow(point->lon.num*M_PER_UNIT, 2) +
+                    pow(point->lat.num*M_PER_UNIT, 2);
+        }
+    }
+
+    /* Model allows for acceleration, noise is not averaged out entirely */
+    TEST_ASSERT_TRUE(sqrt(err2/540) < sqrt(raw2/600)/1.5);
+    TEST_ASSERT_INT_WITHIN(50, 2000, point->altitude_dm);
+    TEST_ASSERT_EQUAL(8, point->satellites);
+    TEST_ASSERT_EQUAL(600, Kalman_GetStats()->fixes);
+    TEST_ASSERT_EQUAL(0, Kalman_GetStats()->resets);
+}
+
+TEST(KALMAN, Follow)
+{
+    const gps_info_t *point = NULL;
+    gps_info_t gps;
+
+    /* Exact fixes of a car accelerating to 25 m/s and turning */
+    for (int i = 0; i < 120; i++) {
+        double speed = i < 25 ? i : 25;
+
+        trk.time++;
+        trk.heading += i > 60 ? 2*M_PI/180 : 0;
+        trk.x += speed*sin(trk.heading);
+        trk.y += speed*cos(trk.heading);
+        toGps(&gps, trk.x, trk.y, 0);
+        gps.hdop_dm = 10;
+        point = Kalman_Process(&gps);
+    }
+
+    /* Estimate lags a bit behind the turn */
+    TEST_ASSERT_TRUE(hypot(point->lon.num*M_PER_UNIT - trk.x,
+            point->lat.num*M_PER_UNIT - trk.y) < 3);
+}
+
+TEST(KALMAN, Reset)
+{
+    const gps_info_t *point;
+    gps_info_t gps;
+
+    trk.time++;
+    toGps(&gps, 0, 0, 100);
+    gps.hdop_dm = 10;
+    Kalman_Process(&gps);
+    trk.time += 10;
+    toGps(&gps, 30, 0, 100);
+    gps.hdop_dm = 10;
+    point = Kalman_Process(&gps);
+    TEST_ASSERT_TRUE(point->lon.num < gps.lon.num);
+
+    /* Duty cycled receiver, long gap */
+    trk.time += 31;
+    toGps(&gps, 1000, 200, 150);
+    gps.hdop_dm = 10;
+    point = Kalman_Process(&gps);
+    TEST_ASSERT_EQUAL(gps.lon.num, point->lon.num);
+    TEST_ASSERT_EQUAL(gps.lat.num, point->lat.num);
+    TEST_ASSERT_EQUAL(1500, point->altitude_dm);
+    TEST_ASSERT_EQUAL(1, Kalman_GetStats()->resets);
+
+    /* Jump confirmed by the filter */
+    trk.time += 1;
+    Kalman_Reset();
+    toGps(&gps, 5000, 200, 150);
+    gps.hdop_dm = 10;
+    point = Kalman_Process(&gps);
+    TEST_ASSERT_EQUAL(gps.lon.num, point->lon.num);
+}
+
+TEST(KALMAN, Compare)
+{
+    uint32_t raw_stored;
+    double raw_err, raw_dist;
+
+    hike(false);
+    report("Raw");
+    raw_stored = trk.stored;
+    raw_err = sqrt(trk.err2/trk.fixes);
+    raw_dist = fabs(trk.stored_dist - trk.dist);
+
+    hike(true);
+    report("Smoothed");
+    TEST_ASSERT_TRUE(sqrt(trk.err2/trk.fixes) < raw_err);
+    TEST_ASSERT_TRUE(fabs(trk.stored_dist - trk.dist) < raw_dist);
+    TEST_ASSERT_TRUE(trk.stored < raw_stored);
+}
+
+TEST(KALMAN, Benchmark)
+{
+    gps_info_t gps[64];
+    uint64_t start;
+
+    for (int i = 0; i < 64; i++) {
+        trk.time++;
+        toGps(&gps[i], noise(3), noise(3), 200 + noise(5));
+        gps[i].hdop_dm = 12;
+    }
+
+    start = nowNs();
+    for (int i = 0; i < 100000; i++) {
+        gps[i % 64].timestamp = START_TIME + 1 + i;
+        Kalman_Process(&gps[i % 64]);
+    }
+    printf("Host ns per fix: %u\n", (unsigned)((nowNs() - start)/100000));
+}
+
+TEST_GROUP_RUNNER(KALMAN)
+{
+    RUN_TEST_CASE(KALMAN, Still);
+    RUN_TEST_CASE(KALMAN, Follow);
+    RUN_TEST_CASE(KALMAN, Reset);
+    RUN_TEST_CASE(KALMAN, Compare);
+    RUN_TEST_CASE(KALMAN, Benchmark);
+}
+
+void Kalman_RunTests(void)
+{
+    RUN_TEST_GROUP(KALMAN);
+}
+
+/** @} */
@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/test_nmea_ring.c
+ * @brief   Unit tests for nmea_ring.c, replays captured data through a ring
+ *
+ * @addtogroup tests
+ * @{
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <main.h>
+#include "gps/nmea_ring.c"
+
+/** Small ring to get sentences split over the ring end */
+#define RING_SIZE 128
+
+/** Three epochs from receiver with default output */
+static const char *capture =
+    "$GPGGA,093015.000,4916.4512,N,01630.1234,E,1,08,0.9,545.4,M,46.9,M,,*50\r\n"
+    "$GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1*39\r\n"
+    "$GPGSV,3,1,11,03,03,111,00,04,15,270,00,06,01,010,00,13,06,292,00*74\r\n"
+    "$GPGSV,3,2,11,14,25,170,00,16,57,208,39,18,67,296,40,19,40,246,00*74\r\n"
+    "$GPGSV,3,3,11,22,42,067,42,24,14,311,43,27,05,244,00*4D\r\n"
+    "$GPRMC,093015.000,A,4916.4512,N,01630.1234,E,0.13,309.62,120598,,,A*63\r\n"
+    "$GPVTG,309.62,T,,M,0.13,N,0.2,K,A*03\r\n"
+    "$GPGGA,093016.000,4916.4522,N,01630.1234,E,1,08,0.9,545.4,M,46.9,M,,*50\r\n"
+    "$GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1*39\r\n"
+    "$GPGSV,3,1,11,03,03,111,00,04,15,270,00,06,01,010,00,13,06,292,00*74\r\n"
+    "$GPGSV,3,2,11,14,25,170,00,16,57,208,39,18,67,296,40,19,40,246,00*74\r\n"
+    "$GPGSV,3,3,11,22,42,067,42,24,14,311,43,27,05,244,00*4D\r\n"
+    "$GPRMC,093016.000,A,4916.4522,N,01630.1234,E,0.13,309.62,120598,,,A*63\r\n"
+    "$GPVTG,309.62,T,,M,0.13,N,0.2,K,A*03\r\n"
+    "$GPGGA,093017.000,4916.4532,N,01630.1234,E,1,08,0.9,545.4,M,46.9,M,,*50\r\n"
+    "$GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1*39\r\n"
+    "$GPGSV,3,1,11,03,03,111,00,04,15,270,00,06,01,010,00,13,06,292,00*74\r\n"
+    "$GPGSV,3,2,11,14,25,170,00,16,57,208,39,18,67,296,40,19,40,246,00*74\r\n"
+    "$GPGSV,3,3,11,22,42,067,42,24,14,311,43,27,05,244,00*4D\r\n"
+    "$GPRMC,093017.000,A,4916.4532,N,01630.1234,E,0.13,309.62,120598,,,A*63\r\n"
+    "$GPVTG,309.62,T,,M,0.13,N,0.2,K,A*03\r\n";
+
+static const char *nofix =
+    "$GPRMC,093018.000,V,,,,,,,120598,,,N*49\r\n"
+    "$GPGGA,093018.000,,,,,0,00,,,M,,M,,*7B\r\n";
+
+static uint8_t ring_buf[RING_SIZE];
+static nmea_ring_t ring;
+/** Write position of the simulated DMA */
+static uint16_t head;
+static gps_info_t info;
+static gps_sat_t sat;
+
+/* *****************************************************************************
+ * Helpers
+***************************************************************************** */
+/**
+ * Write data to ring as DMA would
+ */
+static void dmaWrite(const char *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        ring_buf[head] = data[i];
+        head = (head + 1) % RING_SIZE;
+    }
+}
+
+/**
+ * Replay data, parser runs after random amount of bytes received
+ *
+ * @param data      Data to replay
+ * @param max_delay Max amount of bytes received between parser runs
+ * @param fixes     Amount of reported fixes
+ * @return Flags of all parser runs
+ */
+static uint8_t replay(const char *data, size_t max_delay, uint32_t *fixes)
+{
+    size_t len = strlen(data);
+    size_t chunk;
+    uint8_t flags;
+    uint8_t all = 0;
+
+    while (len != 0) {
+        chunk = 1 + rand() % max_delay;
+        if (chunk > len) {
+            chunk = len;
+        }
+        dmaWrite(data, chunk);
+        data += chunk;
+        len -= chunk;
+
+        flags = NmeaRing_Process(&ring, head, &info, &sat);
+        if ((flags & NMEA_RING_FIX) && fixes != NULL) {
+            (*fixes)++;
+        }
+        all |= flags;
+    }
+    return all;
+}
+
+/* *****************************************************************************
+ * Tests
+***************************************************************************** */
+TEST_GROUP(NMEA_RING);
+
+TEST_SETUP(NMEA_RING)
+{
+    srand(1);
+    head = 0;
+    memset(&info, 0, sizeof(info));
+    memset(&sat, 0, sizeof(sat));
+    NmeaRing_Init(&ring, ring_buf, RING_SIZE);
+}
+
+TEST_TEAR_DOWN(NMEA_RING)
+{
+}
+
+TEST(NMEA_RING, Parse)
+{
+    uint32_t fixes = 0;
+
+    /* Parser can be late by less than ring size - longest sentence */
+    replay(capture, RING_SIZE - NMEA_RING_MAX_LEN, &fixes);
+
+    TEST_ASSERT_EQUAL(3, fixes);
+    TEST_ASSERT_EQUAL(492742200, info.lat.num);
+    TEST_ASSERT_EQUAL(10000000, info.lat.scale);
+    TEST_ASSERT_EQUAL(165020566, info.lon.num);
+    TEST_ASSERT_EQUAL(10000000, info.lon.scale);
+    TEST_ASSERT_EQUAL(894965417, info.timestamp);
+    TEST_ASSERT_EQUAL(894965417, info.time);
+    TEST_ASSERT_EQUAL(5454, info.altitude_dm);
+    TEST_ASSERT_EQUAL(9, info.hdop_dm);
+    TEST_ASSERT_EQUAL(8, info.satellites);
+
+    TEST_ASSERT_EQUAL(11, sat.visible);
+    TEST_ASSERT_EQUAL(11, sat.count);
+    TEST_ASSERT_EQUAL(39, sat.sat[5].snr);
+    TEST_ASSERT_EQUAL(43, sat.sat[9].snr);
+
+    TEST_ASSERT_EQUAL(strlen(capture), ring.stats.bytes);
+    TEST_ASSERT_EQUAL(3, ring.stats.rmc);
+    TEST_ASSERT_EQUAL(3, ring.stats.gga);
+    TEST_ASSERT_EQUAL(9, ring.stats.gsv);
+    TEST_ASSERT_EQUAL(3, ring.stats.gsa);
+    TEST_ASSERT_EQUAL(3, ring.stats.vtg);
+    TEST_ASSERT_EQUAL(0, ring.stats.ignored);
+    TEST_ASSERT_EQUAL(0, ring.stats.errors);
+}
+
+TEST(NMEA_RING, Delays)
+{
+    uint32_t fixes = 0;
+
+    /* Byte by byte, same result as a large chunk */
+    for (int i = 0; i < 10; i++) {
+        replay(capture, 1 + i*4, &fixes);
+    }
+    TEST_ASSERT_EQUAL(30, fixes);
+    TEST_ASSERT_EQUAL(0, ring.stats.errors);
+}
+
+TEST(NMEA_RING, Overrun)
+{
+    uint32_t fixes = 0;
+
+    /* Parser too late, data overwritten before parsed */
+    replay(capture, RING_SIZE, &fixes);
+    TEST_ASSERT_NOT_EQUAL(0, ring.stats.errors);
+    TEST_ASSERT_LESS_THAN(3, fixes);
+
+    /* Recovers once on time again */
+    fixes = 0;
+    replay(capture, 16, &fixes);
+    TEST_ASSERT_EQUAL(3, fixes);
+}
+
+TEST(NMEA_RING, Corrupted)
+{
+    char data[2048];
+    uint32_t fixes = 0;
+
+    strcpy(data, capture);
+    /* Flip digit in the first RMC */
+    *(strstr(data, "GPRMC") + 10) ^= 0x01;
+    replay(data, 16, &fixes);
+
+    TEST_ASSERT_EQUAL(1, ring.stats.errors);
+    TEST_ASSERT_EQUAL(2, ring.stats.rmc);
+    TEST_ASSERT_EQUAL(2, fixes);
+}
+
+TEST(NMEA_RING, Garbage)
+{
+    uint32_t fixes = 0;
+
+    /* Cut sentence, noise and line longer than allowed */
+    replay("$GPRMC,0930", 16, NULL);
+    replay("\x01\xff\x13*12", 16, NULL);
+    replay("$GPTXT,01,01,02,aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+            "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa*00\r\n", 16, NULL);
+    TEST_ASSERT_EQUAL(2, ring.stats.errors);
+
+    replay(capture, 16, &fixes);
+    TEST_ASSERT_EQUAL(3, fixes);
+}
+
+TEST(NMEA_RING, NoFix)
+{
+    uint32_t fixes = 0;
+    uint8_t flags;
+
+    replay(capture, 16, &fixes);
+    flags = replay(nofix, 16, &fixes);
+
+    TEST_ASSERT_EQUAL(NMEA_RING_RMC | NMEA_RING_GGA, flags);
+    TEST_ASSERT_EQUAL(3, fixes);
+    TEST_ASSERT_EQUAL(0, info.timestamp);
+    TEST_ASSERT_EQUAL(0, info.hdop_dm);
+    TEST_ASSERT_EQUAL(0, info.satellites);
+    /* Receiver clock is still valid */
+    TEST_ASSERT_EQUAL(894965418, info.time);
+}
+
+TEST(NMEA_RING, Ack)
+{
+    uint8_t flags;
+
+    TEST_ASSERT_EQUAL(-1, ring.ack_cmd);
+
+    /* Startup message is not an acknowledge */
+    flags = replay("$PMTK010,002*2D\r\n", 16, NULL);
+    TEST_ASSERT_EQUAL(0, flags);
+    TEST_ASSERT_EQUAL(1, ring.stats.ignored);
+
+    flags = replay("$PMTK001,314,3*36\r\n", 16, NULL);
+    TEST_ASSERT_EQUAL(NMEA_RING_ACK, flags);
+    TEST_ASSERT_EQUAL(314, ring.ack_cmd);
+    TEST_ASSERT_EQUAL(NMEA_ACK_SUCCESS, ring.ack_flag);
+
+    flags = replay("$PMTK001,251,1*34\r\n", 16, NULL);
+    TEST_ASSERT_EQUAL(NMEA_RING_ACK, flags);
+    TEST_ASSERT_EQUAL(251, ring.ack_cmd);
+    TEST_ASSERT_EQUAL(NMEA_ACK_UNSUPPORTED, ring.ack_flag);
+    TEST_ASSERT_EQUAL(2, ring.stats.ack);
+    TEST_ASSERT_EQUAL(0, ring.stats.errors);
+}
+
+TEST_GROUP_RUNNER(NMEA_RING)
+{
+    RUN_TEST_CASE(NMEA_RING, Parse);
+    RUN_TEST_CASE(NMEA_RING, Delays);
+    RUN_TEST_CASE(NMEA_RING, Overrun);
+    RUN_TEST_CASE(NMEA_RING, Corrupted);
+    RUN_TEST_CASE(NMEA_RING, Garbage);
+    RUN_TEST_CASE(NMEA_RING, NoFix);
+    RUN_TEST_CASE(NMEA_RING, Ack);
+}
+
+void NmeaRing_RunTests(void)
+{
+    RUN_TEST_GROUP(NMEA_RING);
+}
+
+/** @} */
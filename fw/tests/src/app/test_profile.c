@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file    app/test_profile.c
+ * @brief   Unit tests for profile.c, streaming result is compared with
+ *          downsampling of the whole track at once
+ *
+ * @addtogroup tests
+ * @{
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <main.h>
+#include "profile.c"
+
+#define TRACK_MAX 20000
+
+/** Generated elevation of the track, one sample per fix */
+static struct {
+    int16_t value[TRACK_MAX];
+    uint32_t count;
+} trk;
+
+static profile_t prof;
+
+/* *****************************************************************************
+ * Helpers
+***************************************************************************** */
+static int32_t noise(int32_t amplitude)
+{
+    return (rand() % (2*amplitude + 1)) - amplitude;
+}
+
+/**
+ * Climb linearly with noise
+ *
+ * @param from_m    Start elevation
+ * @param to_m      End elevation
+ * @param points    Amount of points on the way
+ * @param noise_m   Max elevation error
+ */
+static void climb(int32_t from_m, int32_t to_m, uint32_t points,
+        int32_t noise_m)
+{
+    for (uint32_t i = 0; i < points && trk.count < TRACK_MAX; i++) {
+        trk.value[trk.count++] = from_m + (to_m - from_m)*(int32_t)i/
+                (int32_t)points + noise(noise_m);
+    }
+}
+
+/**
+ * Day in mountains, couple of climbs and descents, lunch break on a peak
+ */
+static void hike(void)
+{
+    climb(800, 1600, 3000, 3);
+    climb(1600, 1350, 1000, 3);
+    climb(1350, 2100, 2500, 3);
+    climb(2100, 2100, 1200, 2);
+    climb(2100, 1200, 3500, 3);
+    /* Spike of a bad fix */
+    trk.value[trk.count++] = 2500;
+    climb(1200, 900, 1700, 3);
+}
+
+/**
+ * Stream the whole track through the profile
+ */
+static void replay(void)
+{
+    Profile_Reset(&prof);
+    for (uint32_t i = 0; i < trk.count; i++) {
+        Profile_Add(&prof, trk.value[i]);
+    }
+}
+
+/**
+ * Downsample the whole track at once to buckets of given width and compare
+ */
+static void compare(uint32_t width)
+{
+    uint16_t buckets = (trk.count + width - 1)/width;
+    int16_t min, max;
+    uint32_t start;
+
+    TEST_ASSERT_EQUAL(width, prof.width);
+    TEST_ASSERT_EQUAL(buckets, prof.count);
+    for (uint16_t b = 0; b < buckets; b++) {
+        start = b*width;
+        min = max = trk.value[start];
+        for (uint32_t i = start; i < start + width && i < trk.count; i++) {
+            min = trk.value[i] < min ? trk.value[i] : min;
+            max = trk.value[i] > max ? trk.value[i] : max;
+        }
+        TEST_ASSERT_EQUAL(min, prof.min[b]);
+        TEST_ASSERT_EQUAL(max, prof.max[b]);
+    }
+}
+
+/* *****************************************************************************
+ * Tests
+***************************************************************************** */
+TEST_GROUP(PROFILE);
+
+TEST_SETUP(PROFILE)
+{
+    srand(1);
+    memset(&trk, 0, sizeof(trk));
+    Profile_Reset(&prof);
+}
+
+TEST_TEAR_DOWN(PROFILE)
+{
+}
+
+TEST(PROFILE, Short)
+{
+    /* Less samples than buckets, each sample has its own */
+    climb(100, 200, 100, 0);
+    replay();
+    compare(1);
+    TEST_ASSERT_EQUAL(100, prof.lo);
+    TEST_ASSERT_EQUAL(199, prof.hi);
+
+    /* All buckets full, next sample merges them */
+    climb(200, 228, 28, 0);
+    replay();
+    compare(1);
+    TEST_ASSERT_EQUAL(PROFILE_BUCKETS, prof.count);
+    trk.value[trk.count++] = 300;
+    replay();
+    compare(2);
+    TEST_ASSERT_EQUAL(PROFILE_BUCKETS/2 + 1, prof.count);
+}
+
+TEST(PROFILE, Hike)
+{
+    uint32_t peak = 0;
+
+    hike();
+    replay();
+    printf("Profile: %u samples in %u buckets of %u\n", prof.total,
+            prof.count, prof.width);
+
+    /* Same as downsampling the whole track offline */
+    TEST_ASSERT_EQUAL(trk.count, prof.total);
+    compare(128);
+    TEST_ASSERT_TRUE(prof.count <= PROFILE_BUCKETS);
+
+    /* Peaks are never averaged out */
+    for (uint16_t b = 0; b < prof.count; b++) {
+        peak += prof.max[b] == 2500;
+    }
+    TEST_ASSERT_EQUAL(1, peak);
+    TEST_ASSERT_EQUAL(2500, prof.hi);
+    TEST_ASSERT_INT_WITHIN(3, 800, prof.lo);
+}
+
+TEST(PROFILE, Every)
+{
+    /* Profile matches the offline result after every sample */
+    hike();
+    Profile_Reset(&prof);
+    for (uint32_t i = 0; i < 1500; i++) {
+        uint32_t count = trk.count;
+        uint32_t width = 1;
+
+        Profile_Add(&prof, trk.value[i]);
+        while ((i + 1 + width - 1)/width > PROFILE_BUCKETS) {
+            width *= 2;
+        }
+        trk.count = i + 1;
+        compare(width);
+        trk.count = count;
+    }
+}
+
+TEST_GROUP_RUNNER(PROFILE)
+{
+    RUN_TEST_CASE(PROFILE, Short);
+    RUN_TEST_CASE(PROFILE, Hike);
+    RUN_TEST_CASE(PROFILE, Every);
+}
+
+void Profile_RunTests(void)
+{
+    RUN_TEST_GROUP(PROFILE);
+}
+
+/** @} */
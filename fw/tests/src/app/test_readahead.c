@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/test_readahead.c
+ * @brief   Unit tests for readahead.c, simulation of MSC transfers
+ *
+ * @addtogroup tests
+ * @{
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <main.h>
+#include "readahead.c"
+
+/** Simulated time of 64 B bulk packet on full speed bus in us */
+#define SIM_PACKET_US 50
+/** Simulated time of main loop iteration reloading the endpoint in us */
+#define SIM_POLL_US 10
+/** Simulated time of GPX sector generation in us */
+#define SIM_SECTOR_US 600
+/** Packets per sector */
+#define SIM_PACKETS (READAHEAD_SECTOR_SIZE/64)
+
+static uint32_t sim_now;
+static uint32_t sim_reads;
+
+/* *****************************************************************************
+ * Mocks
+***************************************************************************** */
+static bool readCb(uint32_t lba, uint8_t *buf)
+{
+    memset(buf, lba & 0xff, READAHEAD_SECTOR_SIZE);
+    sim_now += SIM_SECTOR_US;
+    sim_reads++;
+    return true;
+}
+
+static bool writeCb(uint32_t lba, const uint8_t *buf)
+{
+    (void) lba;
+    (void) buf;
+    return true;
+}
+
+/* *****************************************************************************
+ * Helpers
+***************************************************************************** */
+/**
+ * Simulate sequential read of sectors by host
+ *
+ * @param sectors   Amount of sectors to read
+ * @param prefetch  Run read ahead between packets
+ * @param buffers   Packet buffers of the endpoint (2 for double buffered)
+ * @return Sectors per second
+ */
+static uint32_t simulate(uint32_t sectors, bool prefetch, uint8_t buffers)
+{
+    uint8_t buf[READAHEAD_SECTOR_SIZE];
+    uint32_t done[SIM_PACKETS];
+    uint32_t wire = 0;
+    uint32_t start;
+
+    sim_now = 0;
+    Readahead_Init(readCb, writeCb, sectors + 1);
+
+    for (uint32_t lba = 0; lba < sectors; lba++) {
+        Readahead_Read(lba, buf);
+        TEST_ASSERT_EQUAL(lba & 0xff, buf[0]);
+        TEST_ASSERT_EQUAL(lba & 0xff, buf[READAHEAD_SECTOR_SIZE - 1]);
+
+        for (uint8_t p = 0; p < SIM_PACKETS; p++) {
+            /* wait for free packet buffer */
+            if (p >= buffers && sim_now < done[p - buffers]) {
+                sim_now = done[p - buffers];
+            }
+            start = sim_now > wire ? sim_now : wire;
+            wire = start + SIM_PACKET_US;
+            done[p] = wire;
+            sim_now += SIM_POLL_US;
+            if (prefetch) {
+                Readahead_Process();
+            }
+        }
+        /* host issues next read once whole sector received */
+        if (sim_now < wire) {
+            sim_now = wire;
+        }
+    }
+
+    return (uint64_t) sectors * 1000000 / sim_now;
+}
+
+/* *****************************************************************************
+ * Tests
+***************************************************************************** */
+TEST_GROUP(READAHEAD);
+
+TEST_SETUP(READAHEAD)
+{
+    sim_now = 0;
+    sim_reads = 0;
+    Readahead_Init(readCb, writeCb, 100);
+}
+
+TEST_TEAR_DOWN(READAHEAD)
+{
+}
+
+TEST(READAHEAD, Sequential)
+{
+    uint8_t buf[READAHEAD_SECTOR_SIZE];
+
+    TEST_ASSERT_FALSE(Readahead_Process());
+    TEST_ASSERT_TRUE(Readahead_Read(10, buf));
+    TEST_ASSERT_EQUAL(1, sim_reads);
+    TEST_ASSERT_TRUE(Readahead_Process());
+    TEST_ASSERT_EQUAL(2, sim_reads);
+    TEST_ASSERT_FALSE(Readahead_Process());
+
+    memset(buf, 0, sizeof(buf));
+    TEST_ASSERT_TRUE(Readahead_Read(11, buf));
+    TEST_ASSERT_EQUAL(2, sim_reads);
+    TEST_ASSERT_EQUAL(11, buf[0]);
+    TEST_ASSERT_EQUAL(1, Readahead_GetStats()->hits);
+
+    /* Prefetched sector not requested */
+    TEST_ASSERT_TRUE(Readahead_Process());
+    TEST_ASSERT_TRUE(Readahead_Read(50, buf));
+    TEST_ASSERT_EQUAL(50, buf[0]);
+    TEST_ASSERT_EQUAL(4, sim_reads);
+    TEST_ASSERT_EQUAL(1, Readahead_GetStats()->hits);
+}
+
+TEST(READAHEAD, LastSector)
+{
+    uint8_t buf[READAHEAD_SECTOR_SIZE];
+
+    TEST_ASSERT_TRUE(Readahead_Read(99, buf));
+    TEST_ASSERT_FALSE(Readahead_Process());
+}
+
+TEST(READAHEAD, WriteInvalidates)
+{
+    uint8_t buf[READAHEAD_SECTOR_SIZE];
+
+    Readahead_Read(10, buf);
+    Readahead_Process();
+    Readahead_Write(11, buf);
+    Readahead_Read(11, buf);
+    TEST_ASSERT_EQUAL(0, Readahead_GetStats()->hits);
+    TEST_ASSERT_EQUAL(3, sim_reads);
+}
+
+TEST(READAHEAD, Throughput)
+{
+    uint32_t plain = simulate(1000, false, 1);
+    uint32_t plain_dbl = simulate(1000, false, 2);
+    uint32_t ahead = simulate(1000, true, 1);
+    uint32_t ahead_dbl = simulate(1000, true, 2);
+
+    printf("MSC sectors/s: plain %u, double buffered %u, read ahead %u, "
+            "read ahead double buffered %u\n",
+            plain, plain_dbl, ahead, ahead_dbl);
+
+    TEST_ASSERT_GREATER_THAN(plain, ahead);
+    TEST_ASSERT_EQUAL(999, Readahead_GetStats()->hits);
+}
+
+TEST_GROUP_RUNNER(READAHEAD)
+{
+    RUN_TEST_CASE(READAHEAD, Sequential);
+    RUN_TEST_CASE(READAHEAD, LastSector);
+    RUN_TEST_CASE(READAHEAD, WriteInvalidates);
+    RUN_TEST_CASE(READAHEAD, Throughput);
+}
+
+void Readahead_RunTests(void)
+{
+    RUN_TEST_GROUP(READAHEAD);
+}
+
+/** @} */
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/test_sched.c
+ * @brief   Unit tests for sched.c, runs on simulated clock
+ *
+ * @addtogroup tests
+ * @{
+ */
+
+#include <string.h>
+#include <main.h>
+#include "sched.c"
+
+static uint32_t sim_now;
+/** Time of the simulated interrupt, 0 for none */
+static uint32_t sim_irq_at;
+static sched_evt_t sim_irq_evt;
+static uint32_t sim_last_sleep;
+
+static uint32_t fast_runs;
+static uint32_t slow_runs;
+static uint32_t event_runs;
+static uint32_t oneshot_runs;
+
+/* *****************************************************************************
+ * Mocks
+***************************************************************************** */
+static uint32_t simTime(void)
+{
+    return sim_now;
+}
+
+static void simSleep(uint32_t ms)
+{
+    sim_last_sleep = ms;
+    if (sim_irq_at != 0 && sim_irq_at - sim_now <= ms) {
+        sim_now = sim_irq_at;
+        sim_irq_at = 0;
+        Sched_Event(sim_irq_evt);
+    } else {
+        sim_now += ms;
+    }
+}
+
+static void fastTask(void)
+{
+    fast_runs++;
+    sim_now += 1;
+}
+
+static void slowTask(void)
+{
+    slow_runs++;
+    sim_now += 5;
+}
+
+static void eventTask(void)
+{
+    event_runs++;
+}
+
+static void oneshotTask(void)
+{
+    oneshot_runs++;
+}
+
+static sched_task_t fast = { fastTask, 100, 0 };
+static sched_task_t slow = { slowTask, 1000, 0 };
+static sched_task_t event = { eventTask, 0, 1 << SCHED_EVT_BUTTON };
+static sched_task_t oneshot = { oneshotTask, 0, 0 };
+
+/* *****************************************************************************
+ * Tests
+***************************************************************************** */
+TEST_GROUP(SCHED);
+
+TEST_SETUP(SCHED)
+{
+    sim_now = 12345;
+    sim_irq_at = 0;
+    fast_runs = slow_runs = event_runs = oneshot_runs = 0;
+    Sched_Init(simTime, simSleep);
+}
+
+TEST_TEAR_DOWN(SCHED)
+{
+}
+
+TEST(SCHED, Periodic)
+{
+    uint32_t end = sim_now + 10000;
+
+    TEST_ASSERT_TRUE(Sched_Add(&fast));
+    TEST_ASSERT_TRUE(Sched_Add(&slow));
+
+    while (!Schedi_Before(end, sim_now)) {
+        Sched_Run();
+    }
+    TEST_ASSERT_INT_WITHIN(1, 100, fast_runs);
+    TEST_ASSERT_EQUAL(10, slow_runs);
+    /* Only woken up for tasks due */
+    TEST_ASSERT_INT_WITHIN(1, 100, Sched_GetStats()->wakeups);
+}
+
+TEST(SCHED, Event)
+{
+    Sched_Add(&slow);
+    Sched_Add(&event);
+
+    sim_irq_at = sim_now + 300;
+    sim_irq_evt = SCHED_EVT_BUTTON;
+    Sched_Run();
+    TEST_ASSERT_EQUAL(1000, sim_last_sleep);
+    TEST_ASSERT_EQUAL(0, event_runs);
+    Sched_Run();
+    TEST_ASSERT_EQUAL(1, event_runs);
+    TEST_ASSERT_EQUAL(0, slow_runs);
+    TEST_ASSERT_EQUAL(700, sim_last_sleep);
+
+    /* Event not listened to only wakes the system */
+    sim_irq_at = sim_now + 105;
+    sim_irq_evt = SCHED_EVT_USB;
+    Sched_Run();
+    TEST_ASSERT_EQUAL(1, slow_runs);
+    Sched_Run();
+    TEST_ASSERT_EQUAL(1, event_runs);
+    TEST_ASSERT_EQUAL(1, slow_runs);
+    TEST_ASSERT_EQUAL(895, sim_last_sleep);
+}
+
+TEST(SCHED, Pending)
+{
+    Sched_Add(&event);
+
+    TEST_ASSERT_FALSE(Sched_Pending());
+    Sched_Event(SCHED_EVT_BUTTON);
+    TEST_ASSERT_TRUE(Sched_Pending());
+    Sched_Run();
+    TEST_ASSERT_EQUAL(1, event_runs);
+    TEST_ASSERT_FALSE(Sched_Pending());
+}
+
+TEST(SCHED, Oneshot)
+{
+    Sched_Add(&oneshot);
+    Sched_Add(&event);
+
+    /* No timer at all, sleep until event */
+    sim_irq_at = sim_now + 50000;
+    sim_irq_evt = SCHED_EVT_BUTTON;
+    Sched_Run();
+    TEST_ASSERT_EQUAL(UINT32_MAX, sim_last_sleep);
+
+    Sched_Wake(&oneshot, 20);
+    Sched_Run();
+    Sched_Run();
+    TEST_ASSERT_EQUAL(1, oneshot_runs);
+    Sched_Run();
+    TEST_ASSERT_EQUAL(1, oneshot_runs);
+}
+
+TEST(SCHED, Overflow)
+{
+    sim_now = UINT32_MAX - 150;
+    Sched_Add(&fast);
+
+    /* first run only sleeps until the task is due */
+    for (int i = 0; i < 10; i++) {
+        Sched_Run();
+    }
+    TEST_ASSERT_EQUAL(9, fast_runs);
+    TEST_ASSERT_EQUAL(UINT32_MAX - 150 + 1000, sim_now);
+}
+
+TEST(SCHED, DutyCycle)
+{
+    const sched_stats_t *stats = Sched_GetStats();
+
+    Sched_Add(&fast);
+    Sched_Add(&slow);
+    for (int i = 0; i < 10000; i++) {
+        Sched_Run();
+    }
+
+    /* 1 ms per 100 ms and 5 ms per 1000 ms */
+    TEST_ASSERT_INT_WITHIN(5, 15, stats->awake_ms*1000/
+            (stats->awake_ms + stats->sleep_ms));
+}
+
+TEST_GROUP_RUNNER(SCHED)
+{
+    RUN_TEST_CASE(SCHED, Periodic);
+    RUN_TEST_CASE(SCHED, Event);
+    RUN_TEST_CASE(SCHED, Pending);
+    RUN_TEST_CASE(SCHED, Oneshot);
+    RUN_TEST_CASE(SCHED, Overflow);
+    RUN_TEST_CASE(SCHED, DutyCycle);
+}
+
+void Sched_RunTests(void)
+{
+    RUN_TEST_GROUP(SCHED);
+}
+
+/** @} */
@@ -0,0 +1,434 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/test_simplify.c
+ * @brief   Unit tests for simplify.c, reports compression on generated tracks
+ *
+ * @addtogroup tests
+ * @{
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <main.h>
+#include "gps/flat.c"
+#include "gps/simplify.c"
+
+#define TRACK_MAX 4000
+/** 1e-7 deg of latitude in m */
+#define M_PER_UNIT 0.011132
+/** Latitude of generated tracks */
+#define TRACK_LAT 49.5
+
+/** Generated track, m east and north of the start */
+static struct {
+    double x[TRACK_MAX];
+    double y[TRACK_MAX];
+    double z[TRACK_MAX];        /**< Elevation in m */
+    uint32_t t[TRACK_MAX];      /**< Time from start in s */
+    uint32_t count;
+    double heading;     /**< Heading in rad, 0 is north */
+} trk;
+
+/** Stored points, index to the track */
+static uint32_t stored[TRACK_MAX];
+static uint32_t stored_count;
+
+static simplify_config_t config = {
+    .tolerance_m = 5,
+    .vtolerance_m = 3,
+    .max_interval_s = 3600,
+};
+
+/* *****************************************************************************
+ * Helpers
+***************************************************************************** */
+static double noise(double amplitude_m)
+{
+    return ((rand() % 2001) - 1000)/1000.0*amplitude_m;
+}
+
+/**
+ * Drive along the track, one point per second
+ *
+ * @param speed_ms      Speed in m/s
+ * @param duration_s    Time to drive
+ * @param turn_ds       Heading change in deg per second
+ */
+static void drive(double speed_ms, uint32_t duration_s, double turn_ds)
+{
+    double x = trk.count ? trk.x[trk.count - 1] : 0;
+    double y = trk.count ? trk.y[trk.count - 1] : 0;
+    double z = trk.count ? trk.z[trk.count - 1] : 0;
+    uint32_t t = trk.count ? trk.t[trk.count - 1] + 1 : 0;
+
+    for (uint32_t i = 0; i < duration_s && trk.count < TRACK_MAX; i++) {
+        trk.heading += turn_ds*M_PI/180;
+        x += speed_ms*sin(trk.heading);
+        y += speed_ms*cos(trk.heading);
+        trk.x[trk.count] = x;
+        trk.y[trk.count] = y;
+        trk.z[trk.count] = z;
+        trk.t[trk.count] = t + i;
+        trk.count++;
+    }
+}
+
+/**
+ * Change elevation linearly over the last points of the track
+ *
+ * @param points    Amount of points from the end
+ * @param climb_m   Elevation change over these points
+ */
+static void climb(uint32_t points, double climb_m)
+{
+    uint32_t start = trk.count - points;
+
+    for (uint32_t i = start; i < trk.count; i++) {
+        trk.z[i] += climb_m*(i - start + 1)/points;
+    }
+}
+
+/**
+ * Stationary position reported by the filter every keepalive_s
+ *
+ * @param duration_s    Time of the stop
+ * @param keepalive_s   Interval of the points
+ */
+static void stop(uint32_t duration_s, uint32_t keepalive_s)
+{
+    uint32_t last = trk.count - 1;
+
+    for (uint32_t t = keepalive_s; t <= duration_s && trk.count < TRACK_MAX;
+            t += keepalive_s) {
+        trk.x[trk.count] = trk.x[last];
+        trk.y[trk.count] = trk.y[last];
+        trk.z[trk.count] = trk.z[last];
+        trk.t[trk.count] = trk.t[last] + t;
+        trk.count++;
+    }
+}
+
+static void addNoise(double amplitude_m)
+{
+    for (uint32_t i = 0; i < trk.count; i++) {
+        trk.x[i] += noise(amplitude_m);
+        trk.y[i] += noise(amplitude_m);
+    }
+}
+
+static void toGps(uint32_t i, gps_info_t *gps)
+{
+    double cos_lat = cos(TRACK_LAT*M_PI/180);
+
+    memset(gps, 0, sizeof(*gps));
+    gps->lat.num = TRACK_LAT*1e7 + trk.y[i]/M_PER_UNIT;
+    gps->lat.scale = 10000000;
+    gps->lon.num = 16.5*1e7 + trk.x[i]/M_PER_UNIT/cos_lat;
+    gps->lon.scale = 10000000;
+    gps->altitude_dm = lround(trk.z[i]*10);
+    gps->timestamp = 1591954215 + trk.t[i];
+}
+
+/**
+ * Remember which track point was stored, found by timestamp
+ */
+static void store(const gps_info_t *point)
+{
+    uint32_t i = stored_count ? stored[stored_count - 1] : 0;
+
+    while (trk.t[i] != point->timestamp - 1591954215) {
+        i++;
+        TEST_ASSERT_LESS_THAN(trk.count, i);
+    }
+    stored[stored_count++] = i;
+}
+
+/**
+ * Run the whole track through simplification
+ */
+static void replay(void)
+{
+    const gps_info_t *point;
+    gps_info_t gps;
+
+    stored_count = 0;
+    for (uint32_t i = 0; i < trk.count; i++) {
+        toGps(i, &gps);
+        point = Simplify_Process(&gps);
+        if (point != NULL) {
+            store(point);
+        }
+    }
+    point = Simplify_Flush();
+    if (point != NULL) {
+        store(point);
+    }
+}
+
+static double segmentDist(uint32_t p, uint32_t a, uint32_t b)
+{
+    double dx = trk.x[b] - trk.x[a];
+    double dy = trk.y[b] - trk.y[a];
+    double len2 = dx*dx + dy*dy;
+    double t = 0;
+
+    if (len2 > 0) {
+        t = ((trk.x[p] - trk.x[a])*dx + (trk.y[p] - trk.y[a])*dy)/len2;
+        t = t < 0 ? 0 : (t > 1 ? 1 : t);
+    }
+    dx = trk.x[a] + t*dx - trk.x[p];
+    dy = trk.y[a] + t*dy - trk.y[p];
+    return sqrt(dx*dx + dy*dy);
+}
+
+/**
+ * Get the largest elevation error of dropped point to the stored track
+ */
+static double maxAltError(void)
+{
+    double max = 0;
+    double err, len, t;
+    uint32_t a, b;
+
+    for (uint32_t s = 1; s < stored_count; s++) {
+        a = stored[s - 1];
+        b = stored[s];
+        len = hypot(trk.x[b] - trk.x[a], trk.y[b] - trk.y[a]);
+        for (uint32_t p = a + 1; p < b; p++) {
+            t = 0;
+            if (len > 0) {
+                t = ((trk.x[p] - trk.x[a])*(trk.x[b] - trk.x[a]) +
+                        (trk.y[p] - trk.y[a])*(trk.y[b] - trk.y[a]))/len/len;
+                t = t < 0 ? 0 : (t > 1 ? 1 : t);
+            }
+            err = fabs(trk.z[a] + t*(trk.z[b] - trk.z[a]) - trk.z[p]);
+            max = err > max ? err : max;
+        }
+    }
+    return max;
+}
+
+/**
+ * Get the largest distance of dropped point to the stored track
+ */
+static double maxError(void)
+{
+    double max = 0;
+    double dist;
+
+    TEST_ASSERT_EQUAL(0, stored[0]);
+    TEST_ASSERT_EQUAL(trk.count - 1, stored[stored_count - 1]);
+    for (uint32_t s = 1; s < stored_count; s++) {
+        TEST_ASSERT_LESS_THAN(stored[s], stored[s - 1]);
+        for (uint32_t p = stored[s - 1] + 1; p < stored[s]; p++) {
+            dist = segmentDist(p, stored[s - 1], stored[s]);
+            max = dist > max ? dist : max;
+        }
+    }
+    return max;
+}
+
+/**
+ * Replay the track, check error is within tolerance and print results
+ */
+static void bench(const char *name, uint16_t tolerance_m)
+{
+    double err;
+
+    config.tolerance_m = tolerance_m;
+    Simplify_Init(&config);
+    replay();
+    err = maxError();
+    printf("%-12s tolerance %u m: %u of %u points stored (%.1f:1), "
+            "max error %.2f m\n", name, tolerance_m, stored_count,
+            trk.count, (double)trk.count/stored_count, err);
+    /* Projection and rounding to dm */
+    TEST_ASSERT_TRUE(err <= tolerance_m*1.01 + 0.3);
+    TEST_ASSERT_TRUE(maxAltError() <= config.vtolerance_m + 0.1);
+    TEST_ASSERT_EQUAL(trk.count, Simplify_GetStats()->points);
+    TEST_ASSERT_EQUAL(stored_count, Simplify_GetStats()->stored);
+}
+
+/* *****************************************************************************
+ * Tests
+***************************************************************************** */
+TEST_GROUP(SIMPLIFY);
+
+TEST_SETUP(SIMPLIFY)
+{
+    srand(1);
+    memset(&trk, 0, sizeof(trk));
+    stored_count = 0;
+    config.tolerance_m = 5;
+    config.max_interval_s = 3600;
+    Simplify_Init(&config);
+}
+
+TEST_TEAR_DOWN(SIMPLIFY)
+{
+}
+
+TEST(SIMPLIFY, Straight)
+{
+    /* Highway at 90 km/h, only window limit stores points */
+    drive(25, 600, 0);
+    bench("Straight", 5);
+    TEST_ASSERT_EQUAL(1 + (600 - 1 + SIMPLIFY_WINDOW - 1)/SIMPLIFY_WINDOW,
+            stored_count);
+}
+
+TEST(SIMPLIFY, Road)
+{
+    /* Straight parts, bends, crossroads and a hairpin */
+    trk.heading = 0.3;
+    drive(14, 120, 0);
+    drive(14, 30, 1.5);
+    drive(14, 200, 0);
+    drive(8, 10, -9);
+    drive(14, 300, 0);
+    drive(10, 60, 0.6);
+    drive(6, 20, 9);
+    drive(12, 240, -0.2);
+    drive(5, 18, 10);
+    drive(14, 400, 0);
+    addNoise(1);
+
+    bench("Road", 2);
+    bench("Road", 5);
+    bench("Road", 10);
+    TEST_ASSERT_LESS_THAN(trk.count/5, stored_count);
+}
+
+TEST(SIMPLIFY, Walk)
+{
+    /* Winding forest path, 1.4 m/s with 3 m noise */
+    for (int i = 0; i < 30; i++) {
+        drive(1.4, 60, noise(3));
+    }
+    addNoise(3);
+
+    bench("Walk", 5);
+    bench("Walk", 10);
+}
+
+TEST(SIMPLIFY, OutAndBack)
+{
+    bool turn = false;
+
+    /* Way back over the same points must not be dropped */
+    drive(10, 100, 0);
+    trk.heading = M_PI;
+    drive(10, 100, 0);
+
+    bench("Out and back", 5);
+    /* Turning point is kept */
+    for (uint32_t i = 0; i < stored_count; i++) {
+        turn |= stored[i] == 99;
+    }
+    TEST_ASSERT_TRUE(turn);
+}
+
+TEST(SIMPLIFY, Flush)
+{
+    gps_info_t gps;
+
+    TEST_ASSERT_NULL(Simplify_Flush());
+    drive(10, 5, 0);
+
+    toGps(0, &gps);
+    TEST_ASSERT_NOT_NULL(Simplify_Process(&gps));
+    TEST_ASSERT_NULL(Simplify_Flush());
+    toGps(1, &gps);
+    TEST_ASSERT_NULL(Simplify_Process(&gps));
+    toGps(2, &gps);
+    TEST_ASSERT_NULL(Simplify_Process(&gps));
+
+    /* Newest point is emitted and becomes the anchor */
+    TEST_ASSERT_EQUAL(gps.timestamp, Simplify_Flush()->timestamp);
+    TEST_ASSERT_NULL(Simplify_Flush());
+    toGps(3, &gps);
+    TEST_ASSERT_NULL(Simplify_Process(&gps));
+    TEST_ASSERT_EQUAL(gps.timestamp, Simplify_Flush()->timestamp);
+    TEST_ASSERT_EQUAL(4, Simplify_GetStats()->points);
+    TEST_ASSERT_EQUAL(3, Simplify_GetStats()->stored);
+}
+
+TEST(SIMPLIFY, Climb)
+{
+    uint32_t summit = 0;
+
+    /* Straight road over a hill shorter than the window, only elevation
+     * keeps the points */
+    drive(10, 100, 0);
+    drive(10, 12, 0);
+    climb(12, 30);
+    drive(10, 12, 0);
+    climb(12, -30);
+    drive(10, 100, 0);
+
+    bench("Climb", 5);
+    for (uint32_t i = 0; i < stored_count; i++) {
+        if (trk.z[stored[i]] > trk.z[summit]) {
+            summit = stored[i];
+        }
+    }
+    TEST_ASSERT_TRUE(fabs(trk.z[summit] - 30) <= 3);
+}
+
+TEST(SIMPLIFY, Stop)
+{
+    uint32_t gap = 0;
+
+    /* Hour long stop, filter reports the position every 5 minutes */
+    config.max_interval_s = 300;
+    drive(1.4, 600, 0);
+    stop(3600, 300);
+    drive(1.4, 600, 0);
+
+    Simplify_Init(&config);
+    replay();
+    for (uint32_t i = 1; i < stored_count; i++) {
+        if (trk.t[stored[i]] - trk.t[stored[i - 1]] > gap) {
+            gap = trk.t[stored[i]] - trk.t[stored[i - 1]];
+        }
+    }
+    printf("Stop: %u of %u points stored, longest gap %u s\n", stored_count,
+            trk.count, gap);
+    TEST_ASSERT_LESS_OR_EQUAL(config.max_interval_s, gap);
+    TEST_ASSERT_TRUE(stored_count >= 3600/300);
+}
+
+TEST_GROUP_RUNNER(SIMPLIFY)
+{
+    RUN_TEST_CASE(SIMPLIFY, Straight);
+    RUN_TEST_CASE(SIMPLIFY, Road);
+    RUN_TEST_CASE(SIMPLIFY, Walk);
+    RUN_TEST_CASE(SIMPLIFY, OutAndBack);
+    RUN_TEST_CASE(SIMPLIFY, Flush);
+    RUN_TEST_CASE(SIMPLIFY, Climb);
+    RUN_TEST_CASE(SIMPLIFY, Stop);
+}
+
+void Simplify_RunTests(void)
+{
+    RUN_TEST_GROUP(SIMPLIFY);
+}
+
+/** @} */
@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file    app/test_stats.c
+ * @brief   Unit tests for stats.c, live stats match the ones from storage
+ *
+ * @addtogroup tests
+ * @{
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <main.h>
+#include "gps/flat.c"
+#include "elevation.c"
+#include "breadcrumb.c"
+#include "profile.c"
+#include "stats.c"
+
+#define RECORDS_MAX 4000
+#define START_TIME 1591954215
+
+/** Emulated storage */
+static struct {
+    storage_item_t records[RECORDS_MAX];
+    uint32_t count;
+} flash;
+
+/** Position of the generated track */
+static struct {
+    uint32_t time;
+    int32_t lat;
+    int32_t alt_dm;
+} pos;
+
+/* *****************************************************************************
+ * Mocks
+***************************************************************************** */
+bool Storage_Get(uint32_t id, storage_item_t *item)
+{
+    if (id >= flash.count) {
+        return false;
+    }
+    *item = flash.records[id];
+    return true;
+}
+
+size_t Storage_SpaceUsed(void)
+{
+    return flash.count;
+}
+
+size_t Storage_GetSize(void)
+{
+    return RECORDS_MAX;
+}
+
+/* Track is on a meridian, 1e-7 deg is roughly 0.11 dm */
+uint32_t Nav_GetDistanceDm(const nmea_float_t *lat1, const nmea_float_t *lon1,
+        const nmea_float_t *lat2, const nmea_float_t *lon2)
+{
+    (void) lon1;
+    (void) lon2;
+    return labs((long)lat1->num - lat2->num)*1113/10000;
+}
+
+/* *****************************************************************************
+ * Helpers
+***************************************************************************** */
+/**
+ * Store point and pass it to live stats, as the main loop does
+ */
+static void store(void)
+{
+    gps_info_t gps;
+    storage_item_t *item = &flash.records[flash.count++];
+
+    memset(&gps, 0, sizeof(gps));
+    gps.lat.num = pos.lat;
+    gps.lat.scale = 10000000;
+    gps.lon.num = 160000000;
+    gps.lon.scale = 10000000;
+    gps.altitude_dm = pos.alt_dm;
+    gps.timestamp = pos.time;
+
+    item->lat = gps.lat.num;
+    item->lat_scale = gps.lat.scale;
+    item->lon = gps.lon.num;
+    item->lon_scale = gps.lon.scale;
+    item->timestamp = gps.timestamp;
+    item->elevation_m = gps.altitude_dm/10;
+    Stats_Update(&gps);
+}
+
+/**
+ * Walk north with noisy elevation
+ *
+ * @param points    Amount of stored points
+ * @param step_s    Time between points
+ * @param step_dm   Distance between points
+ * @param climb_dm  Elevation change between points
+ */
+static void walk(uint32_t points, uint32_t step_s, uint32_t step_dm,
+        int32_t climb_dm)
+{
+    for (uint32_t i = 0; i < points && flash.count < RECORDS_MAX; i++) {
+        pos.time += step_s;
+        pos.lat += step_dm*10000/1113;
+        pos.alt_dm += climb_dm + (rand() % 41) - 20;
+        store();
+    }
+}
+
+/**
+ * Power cycle, end of log mark is stored
+ */
+static void reboot(void)
+{
+    memset(&flash.records[flash.count++], 0, sizeof(storage_item_t));
+}
+
+/**
+ * Whole day with stops, gap and sea level
+ */
+static void day(void)
+{
+    walk(200, 10, 140, 8);
+    /* Stop with keepalive points, position noise */
+    walk(12, 300, 20, 0);
+    walk(300, 5, 100, -5);
+    /* Receiver off for half an hour */
+    pos.time += 1800;
+    walk(100, 10, 140, 10);
+    walk(200, 10, 140, -3);
+    /* Along the shore */
+    pos.alt_dm = 0;
+    walk(10, 10, 140, 0);
+}
+
+static void assertSame(const stats_comm_t *expected, const stats_comm_t *actual)
+{
+    TEST_ASSERT_EQUAL(expected->dist_dm, actual->dist_dm);
+    TEST_ASSERT_EQUAL(expected->time_s, actual->time_s);
+    TEST_ASSERT_EQUAL(expected->ascend_dm, actual->ascend_dm);
+    TEST_ASSERT_EQUAL(expected->descend_dm, actual->descend_dm);
+}
+
+/* *****************************************************************************
+ * Tests
+***************************************************************************** */
+TEST_GROUP(STATS);
+
+TEST_SETUP(STATS)
+{
+    srand(1);
+    memset(&flash, 0, sizeof(flash));
+    pos.time = START_TIME;
+    pos.lat = 490000000;
+    pos.alt_dm = 3000;
+    Stats_Init();
+}
+
+TEST_TEAR_DOWN(STATS)
+{
+}
+
+TEST(STATS, Rebuild)
+{
+    stats_t live;
+
+    day();
+    live = *Stats_Get();
+    TEST_ASSERT_TRUE(live.all.dist_dm > 90000);
+    TEST_ASSERT_TRUE(live.all.ascend_dm > 1000);
+    TEST_ASSERT_TRUE(live.all.descend_dm > 1000);
+    assertSame(&live.all, &live.today);
+
+    /* Gap is not counted, stop is */
+    TEST_ASSERT_TRUE(live.all.time_s >= 200*10 + 12*300);
+    TEST_ASSERT_TRUE(live.all.time_s < pos.time - START_TIME - 1800);
+
+    Stats_Init();
+    assertSame(&live.all, &Stats_Get()->all);
+    TEST_ASSERT_EQUAL(0, Stats_Get()->today.dist_dm);
+}
+
+TEST(STATS, SeaLevel)
+{
+    /* Points at 0 m are valid, the segment goes on */
+    pos.alt_dm = 0;
+    walk(10, 10, 140, 0);
+    TEST_ASSERT_EQUAL(9*10, Stats_Get()->all.time_s);
+    TEST_ASSERT_INT_WITHIN(9, 9*140, Stats_Get()->all.dist_dm);
+}
+
+TEST(STATS, Continue)
+{
+    stats_t live;
+
+    /* Records from previous days, live points follow the rebuilt stats */
+    day();
+    reboot();
+    pos.time += 86400;
+    Stats_Init();
+    day();
+    live = *Stats_Get();
+
+    Stats_Init();
+    assertSame(&live.all, &Stats_Get()->all);
+}
+
+TEST_GROUP_RUNNER(STATS)
+{
+    RUN_TEST_CASE(STATS, Rebuild);
+    RUN_TEST_CASE(STATS, SeaLevel);
+    RUN_TEST_CASE(STATS, Continue);
+}
+
+void Stats_RunTests(void)
+{
+    RUN_TEST_GROUP(STATS);
+}
+
+/** @} */
@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2019 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file    app/test_sync.c
+ * @brief   Unit tests for sync.c and sync cursor log in storage.c
+ *
+ * @addtogroup tests
+ * @{
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <main.h>
+#include "storage.c"
+#include "sync.c"
+
+static uint8_t flash[STORAGE_TRACKS_ADDR + STORAGE_TRACKS_SIZE];
+
+/* *****************************************************************************
+ * Mocks
+***************************************************************************** */
+void SpiFlash_Read(const spiflash_desc_t *desc, uint32_t addr, uint8_t *buf,
+        size_t len)
+{
+    (void) desc;
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(flash), addr + len);
+    memcpy(buf, &flash[addr], len);
+}
+
+void SpiFlash_Write(const spiflash_desc_t *desc, uint32_t addr,
+        const uint8_t *buf, size_t len)
+{
+    (void) desc;
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(flash), addr + len);
+    for (size_t i = 0; i < len; i++) {
+        flash[addr + i] &= buf[i];
+    }
+}
+
+void SpiFlash_Erase(const spiflash_desc_t *desc)
+{
+    (void) desc;
+    memset(flash, 0xff, sizeof(flash));
+}
+
+/* File with one line per record, first record id on each line */
+uint32_t GPX_GetRangeSize(uint32_t first, uint32_t count)
+{
+    (void) first;
+    return count*16;
+}
+
+bool GPX_GetRange(uint32_t first, uint32_t count, uint32_t offset,
+        uint8_t *buf, uint32_t len)
+{
+    (void) count;
+    (void) offset;
+    memset(buf, 0, len);
+    snprintf((char *) buf, len, "%lu", (unsigned long) first);
+    return true;
+}
+
+void Log_Raw(log_level_t level, const char *source,
+        const char *format, ...)
+{
+    (void) level;
+    (void) source;
+    (void) format;
+}
+
+/* *****************************************************************************
+ * Helpers
+***************************************************************************** */
+static void record(uint32_t count)
+{
+    gps_info_t gps;
+
+    memset(&gps, 0, sizeof(gps));
+    gps.lat.num = 492741866;
+    gps.lat.scale = 10000000;
+    gps.lon.num = 165020566;
+    gps.lon.scale = 10000000;
+    for (uint32_t i = 0; i < count; i++) {
+        gps.timestamp = 1591954215 + i;
+        TEST_ASSERT_TRUE(Storage_Add(&gps));
+    }
+}
+
+static bool ack(const char *str)
+{
+    return Sync_Write((const uint8_t *) str, strlen(str));
+}
+
+/* *****************************************************************************
+ * Tests
+***************************************************************************** */
+TEST_GROUP(SYNC);
+
+TEST_SETUP(SYNC)
+{
+    memset(flash, 0xff, sizeof(flash));
+    Storage_Init();
+    record(10);
+    Sync_Init();
+}
+
+TEST_TEAR_DOWN(SYNC)
+{
+}
+
+TEST(SYNC, AckAll)
+{
+    uint32_t offset;
+
+    TEST_ASSERT_EQUAL(10*16, Sync_GetSize());
+    TEST_ASSERT_FALSE(ack("GLOGGER"));
+    TEST_ASSERT_FALSE(ack("foo GLOGGER-ACK"));
+    TEST_ASSERT_EQUAL(0, Storage_GetSynced());
+
+    TEST_ASSERT_TRUE(ack("GLOGGER-ACK"));
+    TEST_ASSERT_EQUAL(10, Storage_GetSynced());
+    offset = storagei_sync_offset;
+
+    /* Every sector of the ack file, cursor is logged once */
+    for (int i = 0; i < 8; i++) {
+        TEST_ASSERT_TRUE(ack("GLOGGER-ACK\n"));
+    }
+    TEST_ASSERT_EQUAL(offset, storagei_sync_offset);
+
+    /* File content stays while exposed */
+    TEST_ASSERT_EQUAL(10*16, Sync_GetSize());
+}
+
+TEST(SYNC, AckCount)
+{
+    uint32_t offset;
+
+    TEST_ASSERT_TRUE(ack("GLOGGER-ACK 4"));
+    TEST_ASSERT_EQUAL(4, Storage_GetSynced());
+    offset = storagei_sync_offset;
+    TEST_ASSERT_TRUE(ack("GLOGGER-ACK 4\n"));
+    TEST_ASSERT_TRUE(ack("GLOGGER-ACK 2"));
+    TEST_ASSERT_EQUAL(offset, storagei_sync_offset);
+    TEST_ASSERT_EQUAL(4, Storage_GetSynced());
+
+    TEST_ASSERT_TRUE(ack("GLOGGER-ACK 7"));
+    TEST_ASSERT_EQUAL(7, Storage_GetSynced());
+
+    /* Can't acknowledge more than the file contains */
+    TEST_ASSERT_TRUE(ack("GLOGGER-ACK 99999999999"));
+    TEST_ASSERT_EQUAL(10, Storage_GetSynced());
+}
+
+TEST(SYNC, AckGarbage)
+{
+    /* Not a number, whole file is acknowledged */
+    TEST_ASSERT_TRUE(ack("GLOGGER-ACK xyz"));
+    TEST_ASSERT_EQUAL(10, Storage_GetSynced());
+}
+
+TEST(SYNC, AckZero)
+{
+    uint32_t offset = storagei_sync_offset;
+
+    TEST_ASSERT_TRUE(ack("GLOGGER-ACK 0"));
+    TEST_ASSERT_EQUAL(0, Storage_GetSynced());
+    TEST_ASSERT_EQUAL(offset, storagei_sync_offset);
+}
+
+TEST(SYNC, Persistence)
+{
+    uint8_t buf[16];
+
+    TEST_ASSERT_TRUE(ack("GLOGGER-ACK 6"));
+
+    /* Reboot adds end of log mark, file starts after acknowledged records */
+    Storage_Init();
+    TEST_ASSERT_EQUAL(6, Storage_GetSynced());
+    record(5);
+    Sync_Init();
+    TEST_ASSERT_EQUAL((4 + 1 + 5)*16, Sync_GetSize());
+    Sync_Get(0, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("6", (char *) buf);
+
+    /* Acked up to end of log, it's skipped at the file start */
+    TEST_ASSERT_TRUE(ack("GLOGGER-ACK 4"));
+    Storage_Init();
+    Sync_Init();
+    TEST_ASSERT_EQUAL((5 + 1)*16, Sync_GetSize());
+    Sync_Get(0, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("11", (char *) buf);
+}
+
+TEST_GROUP_RUNNER(SYNC)
+{
+    RUN_TEST_CASE(SYNC, AckAll);
+    RUN_TEST_CASE(SYNC, AckCount);
+    RUN_TEST_CASE(SYNC, AckGarbage);
+    RUN_TEST_CASE(SYNC, AckZero);
+    RUN_TEST_CASE(SYNC, Persistence);
+}
+
+void Sync_RunTests(void)
+{
+    RUN_TEST_GROUP(SYNC);
+}
+
+/** @} */
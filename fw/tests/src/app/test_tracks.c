@@ -0,0 +1,289 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file    app/test_tracks.c
+ * @brief   Unit tests for tracks.c, records are split to tracks and indexed
+ *
+ * @addtogroup tests
+ * @{
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <main.h>
+#include "elevation.c"
+#include "tracks.c"
+
+#define RECORDS_MAX 10000
+#define TRACKS_MAX 64
+#define START_TIME 1591954215
+
+/** Emulated storage */
+static struct {
+    storage_item_t records[RECORDS_MAX];
+    uint32_t count;
+    storage_track_t tracks[TRACKS_MAX];
+    uint32_t track_count;
+    uint32_t reads;         /**< Records read */
+    uint8_t lock;           /**< Usb_Lock nesting */
+    bool locked;            /**< Last track was read under the lock */
+} flash;
+
+/* *****************************************************************************
+ * Mocks
+***************************************************************************** */
+bool Storage_IsEOL(const storage_item_t *item)
+{
+    const uint8_t *pos = (uint8_t *) item;
+
+    for (size_t i = 0; i < sizeof(storage_item_t); i++) {
+        if (*pos++ != 0x00) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Storage_Get(uint32_t id, storage_item_t *item)
+{
+    if (id >= flash.count) {
+        return false;
+    }
+    flash.reads++;
+    *item = flash.records[id];
+    return true;
+}
+
+uint32_t Storage_GetTrackCount(void)
+{
+    return flash.track_count;
+}
+
+bool Storage_GetTrack(uint32_t index, storage_track_t *track)
+{
+    if (index >= flash.track_count) {
+        return false;
+    }
+    *track = flash.tracks[index];
+    flash.locked = flash.lock != 0;
+    return true;
+}
+
+bool Storage_AddTrack(const storage_track_t *track)
+{
+    if (flash.track_count >= TRACKS_MAX) {
+        return false;
+    }
+    flash.tracks[flash.track_count++] = *track;
+    return true;
+}
+
+void Usb_Lock(void)
+{
+    flash.lock++;
+}
+
+void Usb_Unlock(void)
+{
+    flash.lock--;
+}
+
+/* Records are on a meridian, 1e-7 deg is roughly 0.11 dm */
+uint32_t Nav_GetDistanceDm(const nmea_float_t *lat1, const nmea_float_t *lon1,
+        const nmea_float_t *lat2, const nmea_float_t *lon2)
+{
+    (void) lon1;
+    (void) lon2;
+    return labs((long)lat1->num - lat2->num)*1113/10000;
+}
+
+void Log_Raw(log_level_t level, const char *source,
+        const char *format, ...)
+{
+    (void) level;
+    (void) source;
+    (void) format;
+}
+
+/* *****************************************************************************
+ * Helpers
+***************************************************************************** */
+/**
+ * Store records of the walk to the north, 1 m/s
+ *
+ * @param time      Timestamp of the first record
+ * @param points    Amount of records
+ * @param step_s    Time between records
+ * @param climb_m   Elevation change per record
+ */
+static void walk(uint32_t time, uint32_t points, uint32_t step_s,
+        int16_t climb_m)
+{
+    storage_item_t *item;
+
+    for (uint32_t i = 0; i < points && flash.count < RECORDS_MAX; i++) {
+        item = &flash.records[flash.count];
+        item->lat = 490000000 + (time + i*step_s - START_TIME)*898/10;
+        item->lat_scale = 10000000;
+        item->lon = 160000000;
+        item->lon_scale = 10000000;
+        item->timestamp = time + i*step_s;
+        item->elevation_m = 300 + i*climb_m;
+        flash.count++;
+        Tracks_Update();
+    }
+}
+
+/**
+ * Power cycle, storage adds end of log mark
+ */
+static void reboot(void)
+{
+    memset(&flash.records[flash.count++], 0, sizeof(storage_item_t));
+    Tracks_Init();
+}
+
+/* *****************************************************************************
+ * Tests
+***************************************************************************** */
+TEST_GROUP(TRACKS);
+
+TEST_SETUP(TRACKS)
+{
+    memset(&flash, 0, sizeof(flash));
+    Tracks_Init();
+}
+
+TEST_TEAR_DOWN(TRACKS)
+{
+}
+
+TEST(TRACKS, Live)
+{
+    storage_track_t track;
+
+    TEST_ASSERT_EQUAL(0, Tracks_GetCount());
+    TEST_ASSERT_FALSE(Tracks_Get(0, &track));
+
+    /* Track being recorded is the first one, kept in RAM */
+    walk(START_TIME, 100, 10, 1);
+    TEST_ASSERT_EQUAL(1, Tracks_GetCount());
+    TEST_ASSERT_EQUAL(0, flash.track_count);
+    TEST_ASSERT_TRUE(Tracks_Get(0, &track));
+    TEST_ASSERT_EQUAL(0, track.first);
+    TEST_ASSERT_EQUAL(100, track.count);
+    TEST_ASSERT_EQUAL(START_TIME, track.start);
+    TEST_ASSERT_EQUAL(990, track.duration_s);
+    TEST_ASSERT_INT_WITHIN(100, 9900, track.dist_dm);
+    /* Low pass filter lags behind the climb */
+    TEST_ASSERT_INT_WITHIN(100, 990, track.ascend_dm);
+    TEST_ASSERT_EQUAL(0, track.descend_dm);
+
+    /* Long gap starts new track, the previous one is indexed */
+    walk(START_TIME + 990 + TRACK_GAP_S + 1, 50, 10, -2);
+    TEST_ASSERT_EQUAL(2, Tracks_GetCount());
+    TEST_ASSERT_EQUAL(1, flash.track_count);
+    TEST_ASSERT_TRUE(Tracks_Get(0, &track));
+    TEST_ASSERT_EQUAL(100, track.first);
+    TEST_ASSERT_EQUAL(50, track.count);
+    TEST_ASSERT_INT_WITHIN(100, 980, track.descend_dm);
+    TEST_ASSERT_TRUE(Tracks_Get(1, &track));
+    TEST_ASSERT_EQUAL(0, track.first);
+    /* Mass storage can't read flash meanwhile */
+    TEST_ASSERT_TRUE(flash.locked);
+    TEST_ASSERT_EQUAL(0, flash.lock);
+    TEST_ASSERT_FALSE(Tracks_Get(2, &track));
+
+    /* Shorter gap continues the track */
+    walk(START_TIME + 990 + TRACK_GAP_S + 1 + 490 + TRACK_GAP_S, 10, 10, 0);
+    TEST_ASSERT_EQUAL(2, Tracks_GetCount());
+    TEST_ASSERT_TRUE(Tracks_Get(0, &track));
+    TEST_ASSERT_EQUAL(60, track.count);
+}
+
+TEST(TRACKS, Reboot)
+{
+    storage_track_t track;
+    uint32_t reads;
+
+    walk(START_TIME, 100, 10, 1);
+    reboot();
+    TEST_ASSERT_EQUAL(1, flash.track_count);
+    TEST_ASSERT_EQUAL(1, Tracks_GetCount());
+
+    /* Next day, only records after the last indexed track are read, the
+     * open track is rebuilt including end of log marks */
+    walk(START_TIME + 86400, 200, 5, 0);
+    flash.reads = 0;
+    reboot();
+    TEST_ASSERT_EQUAL(2, flash.track_count);
+    TEST_ASSERT_EQUAL(200 + 2, flash.reads);
+    TEST_ASSERT_TRUE(Tracks_Get(0, &track));
+    TEST_ASSERT_EQUAL(101, track.first);
+    TEST_ASSERT_EQUAL(200, track.count);
+    TEST_ASSERT_EQUAL(995, track.duration_s);
+
+    /* Single record is not a track */
+    walk(START_TIME + 2*86400, 1, 5, 0);
+    reboot();
+    TEST_ASSERT_EQUAL(2, Tracks_GetCount());
+
+    /* Browsing reads no records */
+    reads = flash.reads;
+    for (uint32_t i = 0; i < Tracks_GetCount(); i++) {
+        TEST_ASSERT_TRUE(Tracks_Get(i, &track));
+    }
+    TEST_ASSERT_EQUAL(reads, flash.reads);
+}
+
+TEST(TRACKS, Many)
+{
+    storage_track_t track;
+
+    /* Power cycled every hour, each start is a new track */
+    for (uint32_t i = 0; i < TRACKS_MAX; i++) {
+        walk(START_TIME + i*3600, 20, 30, 0);
+        reboot();
+    }
+    TEST_ASSERT_EQUAL(TRACKS_MAX, Tracks_GetCount());
+    TEST_ASSERT_TRUE(Tracks_Get(0, &track));
+    TEST_ASSERT_EQUAL(START_TIME + (TRACKS_MAX - 1)*3600, track.start);
+    TEST_ASSERT_TRUE(Tracks_Get(TRACKS_MAX - 1, &track));
+    TEST_ASSERT_EQUAL(START_TIME, track.start);
+
+    /* Index full, track is shown while recorded only */
+    walk(START_TIME + 86400*10, 20, 30, 0);
+    TEST_ASSERT_EQUAL(TRACKS_MAX + 1, Tracks_GetCount());
+    reboot();
+    TEST_ASSERT_EQUAL(TRACKS_MAX, Tracks_GetCount());
+}
+
+TEST_GROUP_RUNNER(TRACKS)
+{
+    RUN_TEST_CASE(TRACKS, Live);
+    RUN_TEST_CASE(TRACKS, Reboot);
+    RUN_TEST_CASE(TRACKS, Many);
+}
+
+void Tracks_RunTests(void)
+{
+    RUN_TEST_GROUP(TRACKS);
+}
+
+/** @} */
@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/test_ubx_ring.c
+ * @brief   Unit tests for ubx_ring.c, compares parsing cost with NMEA
+ *
+ * @addtogroup tests
+ * @{
+ */
+
+#include <string.h>
+#include <time.h>
+#include <main.h>
+#include "gps/nmea_ring.c"
+#include "gps/ubx_ring.c"
+
+#define RING_SIZE 256
+/** Epochs parsed by benchmark */
+#define BENCH_EPOCHS 20000
+
+/** One epoch of the default receiver output */
+static const char *nmea_epoch =
+    "$GPGGA,093015.000,4916.4512,N,01630.1234,E,1,08,0.9,545.4,M,46.9,M,,*50\r\n"
+    "$GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1*39\r\n"
+    "$GPGSV,3,1,11,03,03,111,00,04,15,270,00,06,01,010,00,13,06,292,00*74\r\n"
+    "$GPGSV,3,2,11,14,25,170,00,16,57,208,39,18,67,296,40,19,40,246,00*74\r\n"
+    "$GPGSV,3,3,11,22,42,067,42,24,14,311,43,27,05,244,00*4D\r\n"
+    "$GPRMC,093015.000,A,4916.4512,N,01630.1234,E,0.13,309.62,120598,,,A*63\r\n"
+    "$GPVTG,309.62,T,,M,0.13,N,0.2,K,A*03\r\n";
+
+/** Epoch with RMC and GGA only */
+static const char *nmea_trimmed =
+    "$GPGGA,093015.000,4916.4512,N,01630.1234,E,1,08,0.9,545.4,M,46.9,M,,*50\r\n"
+    "$GPRMC,093015.000,A,4916.4512,N,01630.1234,E,0.13,309.62,120598,,,A*63\r\n";
+
+static uint8_t ring_buf[RING_SIZE];
+static uint16_t head;
+static ubx_ring_t ring;
+static gps_info_t info;
+static gps_sat_t sat;
+
+/* *****************************************************************************
+ * Helpers
+***************************************************************************** */
+static void dmaWrite(const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        ring_buf[head] = data[i];
+        head = (head + 1) % RING_SIZE;
+    }
+}
+
+static void put16(uint8_t *buf, uint16_t val)
+{
+    buf[0] = val & 0xff;
+    buf[1] = val >> 8;
+}
+
+static void put32(uint8_t *buf, int32_t val)
+{
+    put16(buf, (uint32_t)val & 0xffff);
+    put16(buf + 2, (uint32_t)val >> 16);
+}
+
+/**
+ * Build NAV-PVT message of the same position as in NMEA data
+ *
+ * @return Message size
+ */
+static uint16_t pvtFrame(uint8_t *buf, uint8_t fix_type, uint8_t sec)
+{
+    uint8_t payload[UBX_PVT_LEN];
+
+    memset(payload, 0, sizeof(payload));
+    put16(&payload[UBX_PVT_YEAR], 2020);
+    payload[UBX_PVT_MONTH] = 6;
+    payload[UBX_PVT_DAY] = 12;
+    payload[UBX_PVT_HOUR] = 9;
+    payload[UBX_PVT_MIN] = 30;
+    payload[UBX_PVT_SEC] = sec;
+    payload[UBX_PVT_VALID] = 0x07;
+    payload[UBX_PVT_FIX_TYPE] = fix_type;
+    payload[UBX_PVT_FLAGS] = fix_type == 3 ? 0x01 : 0x00;
+    payload[UBX_PVT_NUM_SV] = 8;
+    put32(&payload[UBX_PVT_LON], 165020566);
+    put32(&payload[UBX_PVT_LAT], -492741866);
+    put32(&payload[UBX_PVT_HMSL], 545432);
+    put16(&payload[UBX_PVT_PDOP], 131);
+
+    return UbxRing_Frame(buf, UBX_CLASS_NAV, UBX_NAV_PVT, payload,
+            sizeof(payload));
+}
+
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Parse given epoch repeatedly through NMEA parser
+ *
+ * @return Time per fix in ns
+ */
+static uint32_t benchNmea(const char *epoch)
+{
+    nmea_ring_t nmea;
+    size_t len = strlen(epoch);
+    uint32_t fixes = 0;
+    uint64_t start;
+    uint64_t total = 0;
+
+    NmeaRing_Init(&nmea, ring_buf, RING_SIZE);
+    nmea.pos = head;
+    for (int i = 0; i < BENCH_EPOCHS; i++) {
+        /* Feed by parts as DMA half transfer interrupts would */
+        for (size_t j = 0; j < len; j += RING_SIZE/2) {
+            size_t chunk = len - j < RING_SIZE/2 ? len - j : RING_SIZE/2;
+
+            dmaWrite((const uint8_t *)epoch + j, chunk);
+            start = nowNs();
+            if (NmeaRing_Process(&nmea, head, &info, &sat) & NMEA_RING_FIX) {
+                fixes++;
+            }
+            total += nowNs() - start;
+        }
+        /* Same epoch repeated, make it look new */
+        nmea.gga_tod = -1;
+    }
+    TEST_ASSERT_EQUAL(BENCH_EPOCHS, fixes);
+    return total/fixes;
+}
+
+/* *****************************************************************************
+ * Tests
+***************************************************************************** */
+TEST_GROUP(UBX_RING);
+
+TEST_SETUP(UBX_RING)
+{
+    head = 0;
+    memset(&info, 0, sizeof(info));
+    memset(&sat, 0, sizeof(sat));
+    UbxRing_Init(&ring, ring_buf, RING_SIZE);
+}
+
+TEST_TEAR_DOWN(UBX_RING)
+{
+}
+
+TEST(UBX_RING, Pvt)
+{
+    uint8_t frame[UBX_PVT_LEN + UBX_OVERHEAD];
+    uint16_t len;
+
+    len = pvtFrame(frame, 3, 15);
+    TEST_ASSERT_EQUAL(100, len);
+    /* Split over the ring end */
+    head = RING_SIZE - 40;
+    ring.pos = head;
+    dmaWrite(frame, len);
+
+    TEST_ASSERT_EQUAL(UBX_RING_PVT | UBX_RING_FIX,
+            UbxRing_Process(&ring, head, &info, &sat));
+    TEST_ASSERT_EQUAL(-492741866, info.lat.num);
+    TEST_ASSERT_EQUAL(10000000, info.lat.scale);
+    TEST_ASSERT_EQUAL(165020566, info.lon.num);
+    TEST_ASSERT_EQUAL(5454, info.altitude_dm);
+    TEST_ASSERT_EQUAL(13, info.hdop_dm);
+    TEST_ASSERT_EQUAL(8, info.satellites);
+    TEST_ASSERT_EQUAL(1591954215, info.timestamp);
+    TEST_ASSERT_EQUAL(1, ring.stats.pvt);
+    TEST_ASSERT_EQUAL(100, ring.stats.bytes);
+}
+
+TEST(UBX_RING, NoFix)
+{
+    uint8_t frame[UBX_PVT_LEN + UBX_OVERHEAD];
+    uint16_t len;
+
+    len = pvtFrame(frame, 2, 15);
+    dmaWrite(frame, len);
+
+    TEST_ASSERT_EQUAL(UBX_RING_PVT, UbxRing_Process(&ring, head, &info, &sat));
+    TEST_ASSERT_EQUAL(0, info.timestamp);
+    TEST_ASSERT_EQUAL(1591954215, info.time);
+}
+
+TEST(UBX_RING, Sat)
+{
+    uint8_t payload[8 + 3*12];
+    uint8_t frame[sizeof(payload) + UBX_OVERHEAD];
+    uint16_t len;
+
+    memset(payload, 0, sizeof(payload));
+    payload[UBX_SAT_NUM_SVS] = 3;
+    payload[8 + UBX_SAT_CNO] = 20;
+    payload[8 + 12 + UBX_SAT_CNO] = 35;
+    payload[8 + 24 + UBX_SAT_CNO] = 41;
+    len = UbxRing_Frame(frame, UBX_CLASS_NAV, UBX_NAV_SAT, payload,
+            sizeof(payload));
+    dmaWrite(frame, len);
+
+    TEST_ASSERT_EQUAL(UBX_RING_SAT, UbxRing_Process(&ring, head, &info, &sat));
+    TEST_ASSERT_EQUAL(3, sat.visible);
+    TEST_ASSERT_EQUAL(3, sat.count);
+    TEST_ASSERT_EQUAL(35, sat.sat[1].snr);
+}
+
+TEST(UBX_RING, Errors)
+{
+    uint8_t frame[UBX_PVT_LEN + UBX_OVERHEAD];
+    uint8_t big[6] = { 0xb5, 0x62, 0x01, 0x35, 0x00, 0x04 };
+    uint16_t len;
+
+    len = pvtFrame(frame, 3, 15);
+    frame[50] ^= 0x10;
+    dmaWrite(frame, len);
+    TEST_ASSERT_EQUAL(0, UbxRing_Process(&ring, head, &info, &sat));
+    TEST_ASSERT_EQUAL(1, ring.stats.errors);
+
+    /* NMEA noise and message longer than ring are skipped */
+    dmaWrite((const uint8_t *)nmea_trimmed, 60);
+    dmaWrite(big, sizeof(big));
+    UbxRing_Process(&ring, head, &info, &sat);
+    for (int i = 0; i < 1024 + 2; i += 64) {
+        uint8_t fill[64];
+
+        memset(fill, 0xb5, sizeof(fill));
+        dmaWrite(fill, 1024 + 2 - i < 64 ? 1024 + 2 - i : 64);
+        UbxRing_Process(&ring, head, &info, &sat);
+    }
+    TEST_ASSERT_EQUAL(2, ring.stats.errors);
+
+    len = pvtFrame(frame, 3, 16);
+    dmaWrite(frame, len);
+    TEST_ASSERT_EQUAL(UBX_RING_PVT | UBX_RING_FIX,
+            UbxRing_Process(&ring, head, &info, &sat));
+}
+
+TEST(UBX_RING, Benchmark)
+{
+    uint8_t frame[UBX_PVT_LEN + UBX_OVERHEAD];
+    uint32_t nmea_ns, trimmed_ns, ubx_ns;
+    uint32_t fixes = 0;
+    uint64_t start;
+    uint64_t total = 0;
+    uint16_t len;
+
+    nmea_ns = benchNmea(nmea_epoch);
+    trimmed_ns = benchNmea(nmea_trimmed);
+
+    ring.pos = head;
+    for (int i = 0; i < BENCH_EPOCHS; i++) {
+        len = pvtFrame(frame, 3, i % 60);
+        dmaWrite(frame, len);
+        start = nowNs();
+        if (UbxRing_Process(&ring, head, &info, &sat) & UBX_RING_FIX) {
+            fixes++;
+        }
+        total += nowNs() - start;
+    }
+    TEST_ASSERT_EQUAL(BENCH_EPOCHS, fixes);
+    ubx_ns = total/fixes;
+
+    printf("Host ns per fix: NMEA default %u (%u B), NMEA RMC+GGA %u (%u B), "
+            "UBX NAV-PVT %u (%u B)\n", nmea_ns, (unsigned)strlen(nmea_epoch),
+            trimmed_ns, (unsigned)strlen(nmea_trimmed), ubx_ns, len);
+    TEST_ASSERT_LESS_THAN(nmea_ns, ubx_ns);
+}
+
+TEST_GROUP_RUNNER(UBX_RING)
+{
+    RUN_TEST_CASE(UBX_RING, Pvt);
+    RUN_TEST_CASE(UBX_RING, NoFix);
+    RUN_TEST_CASE(UBX_RING, Sat);
+    RUN_TEST_CASE(UBX_RING, Errors);
+    RUN_TEST_CASE(UBX_RING, Benchmark);
+}
+
+void UbxRing_RunTests(void)
+{
+    RUN_TEST_GROUP(UBX_RING);
+}
+
+/** @} */
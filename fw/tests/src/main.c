@@ -30,7 +30,23 @@ uint8_t assert_should_fail = false;
 static void RunAll(void)
 {
     Gpx_RunTests();
+    Sync_RunTests();
     Gui_RunTests();
+    Readahead_RunTests();
+    Sched_RunTests();
+    GpsCtl_RunTests();
+    NmeaRing_RunTests();
+    UbxRing_RunTests();
+    Assist_RunTests();
+    Filter_RunTests();
+    Simplify_RunTests();
+    Kalman_RunTests();
+    Elevation_RunTests();
+    DispCtl_RunTests();
+    Breadcrumb_RunTests();
+    Profile_RunTests();
+    Tracks_RunTests();
+    Stats_RunTests();
 }
 
 int main(int argc, const char *argv[])
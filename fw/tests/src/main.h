@@ -30,7 +30,23 @@
 #include <types.h>
 
 extern void Gpx_RunTests(void);
+extern void Sync_RunTests(void);
 extern void Gui_RunTests(void);
+extern void Readahead_RunTests(void);
+extern void Sched_RunTests(void);
+extern void GpsCtl_RunTests(void);
+extern void NmeaRing_RunTests(void);
+extern void UbxRing_RunTests(void);
+extern void Assist_RunTests(void);
+extern void Filter_RunTests(void);
+extern void Simplify_RunTests(void);
+extern void Kalman_RunTests(void);
+extern void Elevation_RunTests(void);
+extern void DispCtl_RunTests(void);
+extern void Breadcrumb_RunTests(void);
+extern void Profile_RunTests(void);
+extern void Tracks_RunTests(void);
+extern void Stats_RunTests(void);
 
 extern uint8_t assert_should_fail;
 
@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2020 Jakub Kaderka
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#
+"""
+Generate gfx font table from glyphs drawn as text
+
+Source file starts with 'width' and 'height' lines giving the cell size,
+followed by glyphs of consecutive characters. Each glyph is a header line
+with character code in hex (rest of the line is ignored) and 'height' rows
+of 'width' pixels, '#' is pixel on and '.' pixel off. Lines starting with
+'%' are comments.
+
+Glyphs are stored as columns of 8 pixels with LSB on the top row, page
+after page, same as the SSD1306 RAM, so aligned text is copied to the
+framebuffer without any conversion.
+"""
+
+import argparse
+import os
+import sys
+
+HEADER = """/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    app/gui/{file}
+ * @brief   {brief}
+ *
+ * Generated by tools/fontgen/fontgen.py from {source}, do not edit
+ *
+ * @addtogroup app
+ * @{{
+ */
+
+#include "gfx.h"
+
+"""
+
+
+def fail(source, line, msg):
+    sys.exit('{}:{}: {}'.format(source, line, msg))
+
+
+def parse(path):
+    """Parse source file, return cell size and list of (code, rows)"""
+    size = {}
+    glyphs = []
+    rows = None
+
+    with open(path) as f:
+        lines = [(n + 1, l.rstrip('\n')) for n, l in enumerate(f)]
+
+    for num, line in lines:
+        if line.startswith('%') or (line.strip() == '' and rows is None):
+            continue
+
+        if len(size) < 2:
+            key, value = line.split()
+            if key not in ('width', 'height'):
+                fail(path, num, 'expected width and height')
+            size[key] = int(value)
+            continue
+
+        if rows is None:
+            code = int(line.split()[0], 16)
+            if glyphs and code != glyphs[-1][0] + 1:
+                fail(path, num, 'characters must be consecutive')
+            rows = []
+            glyphs.append((code, rows))
+            continue
+
+        if len(line) != size['width'] or line.strip('#.') != '':
+            fail(path, num, 'glyph row must be {} of # or .'.format(
+                size['width']))
+        rows.append(line)
+        if len(rows) == size['height']:
+            rows = None
+
+    if rows is not None:
+        fail(path, len(lines), 'incomplete glyph')
+    if not glyphs:
+        fail(path, len(lines), 'no glyphs')
+    return size['width'], size['height'], glyphs
+
+
+def columns(rows, width, height):
+    """Convert glyph rows to column bytes, page after page"""
+    data = []
+    for page in range(0, height, 8):
+        for x in range(width):
+            byte = 0
+            for bit in range(8):
+                if page + bit < height and rows[page + bit][x] == '#':
+                    byte |= 1 << bit
+            data.append(byte)
+    return data
+
+
+def char(code):
+    """Character literal for C"""
+    if chr(code) in '\'\\':
+        return "'\\{}'".format(chr(code))
+    return "'{}'".format(chr(code))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[1])
+    parser.add_argument('-i', '--input', required=True,
+                        help='glyphs drawn as text')
+    parser.add_argument('-o', '--output', required=True,
+                        help='generated C file')
+    parser.add_argument('-n', '--name', required=True,
+                        help='name of the gfx_font_t variable')
+    args = parser.parse_args()
+
+    width, height, glyphs = parse(args.input)
+    first = glyphs[0][0]
+    last = glyphs[-1][0]
+    array = args.name.replace('gfx_font_', 'fonti_', 1)
+
+    with open(args.output, 'w') as f:
+        f.write(HEADER.format(
+            file=os.path.basename(args.output),
+            source=os.path.basename(args.input),
+            brief='Font with {}x{} cells, ASCII 0x{:02x} to 0x{:02x}'.format(
+                width, height, first, last)))
+        f.write('static const uint8_t {}[] = {{\n'.format(array))
+        for code, rows in glyphs:
+            data = columns(rows, width, height)
+            f.write('    {},    /* {} */\n'.format(
+                ', '.join('0x{:02x}'.format(b) for b in data), char(code)))
+        f.write('};\n\n')
+        f.write('const gfx_font_t {} = {{\n'.format(args.name))
+        f.write('    .width = {},\n'.format(width))
+        f.write('    .height = {},\n'.format(height))
+        f.write('    .first = {},\n'.format(char(first)))
+        f.write('    .last = {},\n'.format(char(last)))
+        f.write('    .data = {},\n'.format(array))
+        f.write('};\n\n/** @} */\n')
+
+
+if __name__ == '__main__':
+    main()
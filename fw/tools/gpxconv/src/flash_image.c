@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    tools/gpxconv/flash_image.c
+ * @brief   SPI flash driver backed by memory mapped flash image
+ *
+ * Replaces drivers/spi_flash.c from AFW, storage.c and gpx.c from the
+ * firmware are linked against this one to produce identical output.
+ *
+ * @addtogroup tools
+ * @{
+ */
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "drivers/spi_flash.h"
+#include "desc.h"
+#include "config.h"
+#include "flash_image.h"
+
+spiflash_desc_t spiflash_desc;
+
+/** Content of the flash, memory beyond the image end reads as erased */
+static uint8_t *flashi_data = NULL;
+static size_t flashi_size = 0;
+
+void SpiFlash_Read(const spiflash_desc_t *desc, uint32_t addr, uint8_t *buf,
+        size_t len)
+{
+    size_t bytes = 0;
+
+    (void) desc;
+    if (addr < flashi_size) {
+        bytes = flashi_size - addr;
+        if (bytes > len) {
+            bytes = len;
+        }
+        memcpy(buf, &flashi_data[addr], bytes);
+    }
+    memset(buf + bytes, 0xff, len - bytes);
+}
+
+void SpiFlash_Write(const spiflash_desc_t *desc, uint32_t addr,
+        const uint8_t *buf, size_t len)
+{
+    (void) desc;
+    /* Flash can only clear bits, data past the image end are dropped */
+    for (size_t i = 0; i < len && addr + i < flashi_size; i++) {
+        flashi_data[addr + i] &= buf[i];
+    }
+}
+
+void SpiFlash_Erase(const spiflash_desc_t *desc)
+{
+    (void) desc;
+    memset(flashi_data, 0xff, flashi_size);
+}
+
+bool FlashImage_Open(const char *path)
+{
+    struct stat st;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    flashi_size = st.st_size;
+    if (flashi_size > STORAGE_SIZE) {
+        flashi_size = STORAGE_SIZE;
+    }
+    flashi_data = mmap(NULL, flashi_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (flashi_data == MAP_FAILED) {
+        flashi_data = NULL;
+        flashi_size = 0;
+        return false;
+    }
+    madvise(flashi_data, flashi_size, MADV_SEQUENTIAL);
+    return true;
+}
+
+void FlashImage_Close(void)
+{
+    if (flashi_data != NULL) {
+        munmap(flashi_data, flashi_size);
+    }
+    flashi_data = NULL;
+    flashi_size = 0;
+}
+
+/** @} */
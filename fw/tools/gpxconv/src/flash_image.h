@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    tools/gpxconv/flash_image.h
+ * @brief   SPI flash driver backed by memory mapped flash image
+ *
+ * @addtogroup tools
+ * @{
+ */
+
+#ifndef __GPXCONV_FLASH_IMAGE_H_
+#define __GPXCONV_FLASH_IMAGE_H_
+
+#include <types.h>
+
+/**
+ * Map flash image file as a content of the SPI flash
+ *
+ * The image is mapped privately, writes done by the storage module (end of
+ * log marks) are never written back to the file.
+ *
+ * @param path      Path to the flash image
+ * @return  False if file can't be mapped
+ */
+extern bool FlashImage_Open(const char *path);
+
+/**
+ * Unmap currently opened image
+ */
+extern void FlashImage_Close(void);
+
+#endif
+
+/** @} */
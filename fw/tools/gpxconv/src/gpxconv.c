@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2020 Jakub Kaderka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file    tools/gpxconv/gpxconv.c
+ * @brief   Convert raw SPI flash images pulled from loggers to GPX files
+ *
+ * The GPX file is generated by the same code that serves it over USB, the
+ * output is byte-identical to the file downloaded from the device. The
+ * generator allows random access to the file, each image is split to
+ * several ranges rendered in parallel by forked workers.
+ *
+ * @addtogroup tools
+ * @{
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <libgen.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "storage.h"
+#include "gpx.h"
+#include "config.h"
+#include "flash_image.h"
+
+/** Size of the block rendered by single GPX_Get call */
+#define GPXCONV_CHUNK_SIZE (64*1024U)
+
+/** Don't split files smaller than this between workers */
+#define GPXCONV_MIN_RANGE (1024*1024U)
+
+/** Amount of points in single synthetic track */
+#define GPXCONV_SYNTH_TRACK 3600
+
+/**
+ * Render part of the GPX file and write it to output
+ *
+ * @param fd        Output file descriptor or -1 to discard the data
+ * @param start     First byte of the range
+ * @param end       Byte after the end of the range
+ * @return  False on write failure
+ */
+static bool render(int fd, uint32_t start, uint32_t end)
+{
+    static uint8_t buf[GPXCONV_CHUNK_SIZE];
+    uint32_t len;
+
+    while (start < end) {
+        len = end - start;
+        if (len > sizeof(buf)) {
+            len = sizeof(buf);
+        }
+        GPX_Get(start, buf, len);
+        if (fd >= 0 && pwrite(fd, buf, len, start) != (ssize_t) len) {
+            return false;
+        }
+        start += len;
+    }
+    return true;
+}
+
+/**
+ * Build output file name from image name, extension is replaced by .gpx
+ *
+ * @param image     Path to the image
+ * @param outdir    Output directory or NULL to store next to image
+ * @param buf       Buffer for resulting path
+ * @param len       Size of the buffer
+ */
+static void outputName(const char *image, const char *outdir, char *buf,
+        size_t len)
+{
+    char tmp[len];
+    char *ext;
+
+    strncpy(tmp, image, len - 1);
+    tmp[len - 1] = '\0';
+    if (outdir != NULL) {
+        snprintf(buf, len, "%s/%s", outdir, basename(tmp));
+    } else {
+        snprintf(buf, len, "%s", tmp);
+    }
+
+    ext = strrchr(buf, '.');
+    if (ext != NULL && strchr(ext, '/') == NULL) {
+        *ext = '\0';
+    }
+    strncat(buf, ".gpx", len - strlen(buf) - 1);
+}
+
+/**
+ * Convert single flash image to GPX file
+ *
+ * @param image     Path to the image
+ * @param outdir    Output directory or NULL to store next to image
+ * @param jobs      Maximal amount of workers
+ * @param discard   Render data but don't write them anywhere (benchmark)
+ * @return  False on failure
+ */
+static bool convert(const char *image, const char *outdir, int jobs,
+        bool discard)
+{
+    char name[4096];
+    uint32_t size;
+    int fd = -1;
+    int status;
+    bool ret = true;
+
+    if (!FlashImage_Open(image)) {
+        fprintf(stderr, "%s: unable to open image\n", image);
+        return false;
+    }
+    Storage_Init();
+    if (Storage_SpaceUsed() == 0) {
+        fprintf(stderr, "%s: no records found\n", image);
+        FlashImage_Close();
+        return true;
+    }
+    size = GPX_GetSize();
+
+    if (!discard) {
+        outputName(image, outdir, name, sizeof(name));
+        fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || ftruncate(fd, size) != 0) {
+            fprintf(stderr, "%s: unable to create output file\n", name);
+            FlashImage_Close();
+            return false;
+        }
+    }
+
+    if (jobs > (int)(size / GPXCONV_MIN_RANGE) + 1) {
+        jobs = size / GPXCONV_MIN_RANGE + 1;
+    }
+
+    if (jobs == 1) {
+        ret = render(fd, 0, size);
+    } else {
+        /* Workers inherit mapped image and initialized storage state */
+        for (int i = 0; i < jobs; i++) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                _exit(render(fd, (uint64_t) size*i/jobs,
+                            (uint64_t) size*(i + 1)/jobs) ? 0 : 1);
+            } else if (pid < 0) {
+                ret &= render(fd, (uint64_t) size*i/jobs,
+                        (uint64_t) size*(i + 1)/jobs);
+            }
+        }
+        while (wait(&status) > 0) {
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                ret = false;
+            }
+        }
+    }
+
+    if (!ret) {
+        fprintf(stderr, "%s: failed to write output\n", image);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    FlashImage_Close();
+    return ret;
+}
+
+/**
+ * Generate synthetic flash image with random walk tracks
+ *
+ * @param image     Path to the image
+ * @param records   Amount of records to be generated
+ * @return  False on failure
+ */
+static bool synthesize(const char *image, uint32_t records)
+{
+    storage_item_t item;
+    FILE *f;
+
+    if (records > STORAGE_SIZE/sizeof(storage_item_t)) {
+        records = STORAGE_SIZE/sizeof(storage_item_t);
+    }
+
+    f = fopen(image, "wb");
+    if (f == NULL) {
+        fprintf(stderr, "%s: unable to create image\n", image);
+        return false;
+    }
+
+    srand(records);
+    item.lat = 49000000;
+    item.lat_scale = 1000000;
+    item.lon = 16000000;
+    item.lon_scale = 1000000;
+    item.timestamp = 1577836800;
+    item.elevation_m = 300;
+    for (uint32_t i = 0; i < records; i++) {
+        if (i % GPXCONV_SYNTH_TRACK == GPXCONV_SYNTH_TRACK - 1) {
+            /* End of log mark */
+            storage_item_t eol;
+            memset(&eol, 0x00, sizeof(eol));
+            fwrite(&eol, sizeof(eol), 1, f);
+            item.timestamp += 12*3600;
+            continue;
+        }
+        item.lat += rand() % 201 - 100;
+        item.lon += rand() % 201 - 100;
+        item.elevation_m += rand() % 3 - 1;
+        item.timestamp += 1;
+        fwrite(&item, sizeof(item), 1, f);
+    }
+
+    fclose(f);
+    return true;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [-j jobs] [-o outdir] [-n] image...\n"
+            "       %s -g records image\n"
+            "  -j   Amount of parallel workers per image (default all cores)\n"
+            "  -o   Output directory (default next to the image)\n"
+            "  -n   Render GPX but don't write output (benchmark)\n"
+            "  -g   Generate synthetic image with given amount of records\n",
+            name, name);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *outdir = NULL;
+    int jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    long synth = -1;
+    bool discard = false;
+    bool ret = true;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:o:ng:h")) != -1) {
+        switch (opt) {
+            case 'j':
+                jobs = atoi(optarg);
+                break;
+            case 'o':
+                outdir = optarg;
+                break;
+            case 'n':
+                discard = true;
+                break;
+            case 'g':
+                synth = atol(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc || jobs < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (synth >= 0) {
+        return synthesize(argv[optind], synth) ? 0 : 1;
+    }
+
+    for (int i = optind; i < argc; i++) {
+        ret &= convert(argv[i], outdir, jobs, discard);
+    }
+    return ret ? 0 : 1;
+}
+
+/** @} */